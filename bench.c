@@ -0,0 +1,766 @@
+/*
+ *  leptjson 的性能测试，输出 JSON 格式的结果，便于在各版本之间比较
+ *  用法：leptjson_bench [每项的最短时间（秒），默认 0.5] [语料规模倍数，默认 1]
+ *  直接包含 leptjson.c 并替换其中的分配函数，以统计分配次数和字节数
+ */
+#if (defined(__unix__) || defined(__APPLE__)) && !defined(_POSIX_C_SOURCE)
+#define _POSIX_C_SOURCE 200112L
+#endif
+#include <stddef.h>
+
+static void* bench_malloc(size_t size);
+static void* bench_realloc(void* ptr, size_t size);
+static void bench_free(void* ptr);
+
+#define LEPT_MALLOC(size) bench_malloc(size)
+#define LEPT_REALLOC(ptr, size) bench_realloc(ptr, size)
+#define LEPT_FREE(ptr) bench_free(ptr)
+#include "leptjson.c"
+
+/*  语料生成器使用固定种子的线性同余随机数，每次运行的输入完全相同 */
+static unsigned long bench_seed = 1;
+
+static double bench_seconds = 0.5;
+static size_t bench_scale = 1;
+
+/*  分配统计；多线程测试中也会被并发调用 */
+static volatile size_t bench_alloc_count = 0;
+static volatile size_t bench_alloc_bytes = 0;
+/*  单线程测试中的存活字节数及其峰值 */
+static size_t bench_live_bytes = 0;
+static size_t bench_peak_bytes = 0;
+
+/*  每块内存前面记录大小，realloc 时按新增的大小计入字节数 */
+typedef union BENCH_HEADER {
+    size_t size;
+    double align;
+} bench_header;
+
+void* bench_malloc(size_t size)
+{
+    bench_header* h = (bench_header*)malloc(sizeof(bench_header) + size);
+    if(NULL == h)
+        return NULL;
+    h->size = size;
+    LEPT_ATOMIC_INC(&bench_alloc_count);
+#if defined(__GNUC__) || defined(__clang__)
+    __sync_add_and_fetch(&bench_alloc_bytes, size);
+#else
+    bench_alloc_bytes += size;
+#endif
+    if((bench_live_bytes += size) > bench_peak_bytes)
+        bench_peak_bytes = bench_live_bytes;
+    return h + 1;
+}
+
+void* bench_realloc(void* ptr, size_t size)
+{
+    bench_header* h;
+    size_t old;
+    if(NULL == ptr)
+        return bench_malloc(size);
+    h = (bench_header*)ptr - 1;
+    old = h->size;
+    if(NULL == (h = (bench_header*)realloc(h, sizeof(bench_header) + size)))
+        return NULL;
+    h->size = size;
+    LEPT_ATOMIC_INC(&bench_alloc_count);
+    if(size > old)
+    {
+#if defined(__GNUC__) || defined(__clang__)
+        __sync_add_and_fetch(&bench_alloc_bytes, size - old);
+#else
+        bench_alloc_bytes += size - old;
+#endif
+    }
+    if((bench_live_bytes += size - old) > bench_peak_bytes)
+        bench_peak_bytes = bench_live_bytes;
+    return h + 1;
+}
+
+void bench_free(void* ptr)
+{
+    if(NULL != ptr)
+    {
+        bench_live_bytes -= ((bench_header*)ptr - 1)->size;
+        free((bench_header*)ptr - 1);
+    }
+}
+
+
+static unsigned long bench_rand(void)
+{
+    bench_seed = (bench_seed * 1103515245ul + 12345ul) & 0x7ffffffful;
+    return bench_seed >> 8;
+}
+
+/*  生成语料用的缓冲区 */
+typedef struct BENCH_BUF {
+    char* s;
+    size_t len, cap;
+} bench_buf;
+
+static void bench_put(bench_buf* b, const char* s)
+{
+    size_t n = strlen(s);
+    if(b->len + n + 1 > b->cap)
+    {
+        b->cap = (b->len + n + 1) * 2;
+        b->s = (char*)realloc(b->s, b->cap);
+    }
+    memcpy(b->s + b->len, s, n + 1);
+    b->len += n;
+}
+
+/*  数值密集：GeoJSON 多边形，每个坐标 6 位小数 */
+static void bench_gen_geo(bench_buf* b, size_t target)
+{
+    char tmp[128];
+    size_t f, k, n;
+    bench_put(b, "{\"type\":\"FeatureCollection\",\"features\":[");
+    for(f = 0; b->len < target; f++)
+    {
+        sprintf(tmp, "%s{\"type\":\"Feature\",\"properties\":{\"name\":\"region %lu\",\"admin_level\":%lu},",
+            f > 0 ? "," : "", (unsigned long)f, (unsigned long)(bench_rand() % 10));
+        bench_put(b, tmp);
+        bench_put(b, "\"geometry\":{\"type\":\"Polygon\",\"coordinates\":[[");
+        n = 50 + bench_rand() % 200;
+        for(k = 0; k < n; k++)
+        {
+            sprintf(tmp, "%s[%.6f,%.6f]", k > 0 ? "," : "",
+                -180.0 + (double)(bench_rand() % 360000000) / 1e6, -90.0 + (double)(bench_rand() % 180000000) / 1e6);
+            bench_put(b, tmp);
+        }
+        bench_put(b, "]]}}");
+    }
+    bench_put(b, "]}");
+}
+
+/*  字符串密集：社交网络的时间线，含转义、\u 转义和 UTF-8 */
+static void bench_gen_social(bench_buf* b, size_t target)
+{
+    static const char* const words[] = {
+        "the", "quick", "brown", "fox", "jumps", "over", "lazy", "dog", "\\\"quoted\\\"",
+        "line\\nbreak", "caf\\u00e9", "\xe4\xb8\xad\xe6\x96\x87", "emoji \\ud83d\\ude00", "http:\\/\\/example.com"
+    };
+    char tmp[256];
+    size_t i, k, n;
+    bench_put(b, "[");
+    for(i = 0; b->len < target; i++)
+    {
+        sprintf(tmp, "%s{\"id\":%lu,\"created_at\":\"2024-%02lu-%02luT%02lu:%02lu:00Z\",\"user\":{\"id\":%lu,"
+            "\"name\":\"user_%lu\",\"followers\":%lu,\"verified\":%s},\"text\":\"",
+            i > 0 ? "," : "", (unsigned long)(1000000 + i), (unsigned long)(1 + bench_rand() % 12),
+            (unsigned long)(1 + bench_rand() % 28), (unsigned long)(bench_rand() % 24), (unsigned long)(bench_rand() % 60),
+            (unsigned long)(bench_rand() % 100000), (unsigned long)(bench_rand() % 100000),
+            (unsigned long)(bench_rand() % 1000000), bench_rand() % 2 ? "true" : "false");
+        bench_put(b, tmp);
+        n = 8 + bench_rand() % 30;
+        for(k = 0; k < n; k++)
+        {
+            if(k > 0)
+                bench_put(b, " ");
+            bench_put(b, words[bench_rand() % (sizeof(words) / sizeof(words[0]))]);
+        }
+        bench_put(b, "\",\"tags\":[");
+        n = bench_rand() % 4;
+        for(k = 0; k < n; k++)
+        {
+            sprintf(tmp, "%s\"#tag%lu\"", k > 0 ? "," : "", (unsigned long)(bench_rand() % 50));
+            bench_put(b, tmp);
+        }
+        sprintf(tmp, "],\"retweets\":%lu,\"reply_to\":null}", (unsigned long)(bench_rand() % 5000));
+        bench_put(b, tmp);
+    }
+    bench_put(b, "]");
+}
+
+/*  深层嵌套：配置文件，每段 48 层对象，每层有几个标量和一个小数组，带缩进 */
+static void bench_gen_config(bench_buf* b, size_t target)
+{
+    char tmp[256];
+    size_t sec, d, depth = 48;
+    bench_put(b, "{\n");
+    for(sec = 0; b->len < target; sec++)
+    {
+        sprintf(tmp, "%s  \"section_%lu\": ", sec > 0 ? ",\n" : "", (unsigned long)sec);
+        bench_put(b, tmp);
+        for(d = 0; d < depth; d++)
+        {
+            sprintf(tmp, "{\n    \"enabled\": %s, \"timeout_ms\": %lu, \"label\": \"level %lu\", \"ports\": [%lu, %lu],\n    \"child\": ",
+                bench_rand() % 2 ? "true" : "false", (unsigned long)(bench_rand() % 10000), (unsigned long)d,
+                (unsigned long)(1024 + bench_rand() % 60000), (unsigned long)(1024 + bench_rand() % 60000));
+            bench_put(b, tmp);
+        }
+        bench_put(b, "null");
+        for(d = 0; d < depth; d++)
+            bench_put(b, "}");
+    }
+    bench_put(b, "\n}\n");
+}
+
+/*  大量小消息：每行一个文档，以 '\n' 分隔（用于 NDJSON 和流水线） */
+static void bench_gen_messages(bench_buf* b, size_t target)
+{
+    static const char* const sides[] = { "buy", "sell" };
+    char tmp[256];
+    size_t i;
+    for(i = 0; b->len < target; i++)
+    {
+        sprintf(tmp, "{\"type\":\"trade\",\"seq\":%lu,\"symbol\":\"SYM%lu\",\"px\":%lu.%02lu,\"qty\":%lu,\"side\":\"%s\"}\n",
+            (unsigned long)i, (unsigned long)(bench_rand() % 500), (unsigned long)(bench_rand() % 1000),
+            (unsigned long)(bench_rand() % 100), (unsigned long)(1 + bench_rand() % 1000), sides[bench_rand() % 2]);
+        bench_put(b, tmp);
+    }
+}
+
+
+static double bench_now(void)
+{
+    return lept_now() * 1e-9;
+}
+
+static size_t bench_count_values(const lept_value* v)
+{
+    size_t i, n = 1;
+    if(LEPT_ARRAY == v->type)
+        for(i = 0; i < v->u.a.size; i++)
+            n += bench_count_values(&v->u.a.e[i]);
+    else if(LEPT_OBJECT == v->type)
+        for(i = 0; i < v->u.o.size; i++)
+            n += bench_count_values(&v->u.o.m[i].val);
+    return n;
+}
+
+/*  一项结果：每秒处理的 MB（按 bytes 计），每个值的纳秒数，一次操作的分配次数和字节数 */
+static void bench_report(lept_value* obj, const char* name, size_t bytes, size_t values, double seconds, size_t iters,
+                         size_t allocs, size_t alloc_bytes)
+{
+    lept_value* r = lept_set_object_value(obj, name, strlen(name));
+    lept_set_object(r, 4);
+    lept_set_number(lept_set_object_value(r, "mb_s", 4), (double)bytes * iters / seconds / 1e6);
+    lept_set_number(lept_set_object_value(r, "ns_per_value", 12), seconds * 1e9 / iters / (double)values);
+    lept_set_number(lept_set_object_value(r, "allocs", 6), (double)allocs);
+    lept_set_number(lept_set_object_value(r, "alloc_bytes", 11), (double)alloc_bytes);
+}
+
+/*  lept_array_iter 的读取回调：从内存中的文本每次交出一块 */
+typedef struct {
+    const char* json;
+    size_t pos, len;
+} bench_reader;
+
+static int bench_read(void* user, char* buf, size_t size, size_t* nread)
+{
+    bench_reader* r = (bench_reader*)user;
+    size_t n = r->len - r->pos < size ? r->len - r->pos : size;
+    memcpy(buf, r->json + r->pos, n);
+    r->pos += n;
+    *nread = n;
+    return 0;
+}
+
+/*  解析、生成、释放，以及 CBOR/MessagePack 的编解码 */
+static void bench_corpus(lept_value* corpora, const char* name, const char* json, size_t len)
+{
+    lept_value* c = lept_pushback_array_element(corpora);
+    lept_value v;
+    size_t iters, values, allocs, bytes, n, base, peak;
+    double t, parse_time = 0.0, free_time = 0.0, start;
+    char* out;
+    int (*from[2])(lept_value*, const char*, size_t);
+    char* (*to[2])(const lept_value*, size_t*);
+    static const char* const bin_names[] = { "cbor", "msgpack" };
+    int k;
+    from[0] = lept_from_cbor;
+    from[1] = lept_from_msgpack;
+    to[0] = lept_to_cbor;
+    to[1] = lept_to_msgpack;
+
+    lept_set_object(c, 0);
+    lept_set_string(lept_set_object_value(c, "name", 4), name, strlen(name));
+    lept_set_number(lept_set_object_value(c, "bytes", 5), (double)len);
+
+    bench_alloc_count = bench_alloc_bytes = 0;
+    base = bench_peak_bytes = bench_live_bytes;
+    if(LEPT_PARSE_OK != lept_parse(&v, json))
+    {
+        fprintf(stderr, "%s: parse error\n", name);
+        exit(1);
+    }
+    allocs = bench_alloc_count;
+    bytes = bench_alloc_bytes;
+    peak = bench_peak_bytes - base;
+    values = bench_count_values(&v);
+    lept_set_number(lept_set_object_value(c, "values", 6), (double)values);
+    lept_free(&v);
+
+    for(iters = 0, start = bench_now(); bench_now() - start < bench_seconds; iters++)
+    {
+        t = bench_now();
+        lept_parse(&v, json);
+        parse_time += bench_now() - t;
+        t = bench_now();
+        lept_free(&v);
+        free_time += bench_now() - t;
+    }
+    bench_report(c, "parse", len, values, parse_time, iters, allocs, bytes);
+    bench_report(c, "free", len, values, free_time, iters, 0, 0);
+    lept_set_number(lept_set_object_value(lept_find_object_value(c, "parse", 5), "peak_bytes", 10), (double)peak);
+
+    /*  LEPT_OPT_VALIDATE_UTF8 的开销 */
+    for(iters = 0, start = t = bench_now(); (t = bench_now()) - start < bench_seconds; iters++)
+    {
+        lept_parse_opts(&v, json, LEPT_OPT_VALIDATE_UTF8);
+        lept_free(&v);
+    }
+    bench_report(c, "parse_free_utf8", len, values, t - start, iters, allocs, bytes);
+
+    /*  LEPT_OPT_PACK_NUMBERS：数值数组紧凑存储后的分配和峰值内存 */
+    bench_alloc_count = bench_alloc_bytes = 0;
+    base = bench_peak_bytes = bench_live_bytes;
+    lept_parse_opts(&v, json, LEPT_OPT_PACK_NUMBERS);
+    allocs = bench_alloc_count;
+    bytes = bench_alloc_bytes;
+    peak = bench_peak_bytes - base;
+    lept_free(&v);
+    for(iters = 0, start = t = bench_now(); (t = bench_now()) - start < bench_seconds; iters++)
+    {
+        lept_parse_opts(&v, json, LEPT_OPT_PACK_NUMBERS);
+        lept_free(&v);
+    }
+    bench_report(c, "parse_free_packed", len, values, t - start, iters, allocs, bytes);
+    lept_set_number(lept_set_object_value(lept_find_object_value(c, "parse_free_packed", 17), "peak_bytes", 10), (double)peak);
+
+    /*  顶层是数组时，逐个元素解析再释放，对比峰值内存 */
+    if('[' == json[0])
+    {
+        bench_reader r;
+        lept_array_iter* it;
+        allocs = bytes = 0;
+        base = bench_peak_bytes = bench_live_bytes;
+        for(iters = 0, start = t = bench_now(); (t = bench_now()) - start < bench_seconds; iters++)
+        {
+            bench_alloc_count = bench_alloc_bytes = 0;
+            r.json = json;
+            r.pos = 0;
+            r.len = len;
+            it = lept_array_iter_open(bench_read, &r);
+            while(lept_array_iter_next(it, &v))
+                lept_free(&v);
+            if(LEPT_PARSE_OK != lept_array_iter_error(it))
+            {
+                fprintf(stderr, "%s: array_iter error\n", name);
+                exit(1);
+            }
+            lept_array_iter_close(it);
+            allocs = bench_alloc_count;
+            bytes = bench_alloc_bytes;
+        }
+        bench_report(c, "array_iter", len, values, t - start, iters, allocs, bytes);
+        lept_set_number(lept_set_object_value(lept_find_object_value(c, "array_iter", 10), "peak_bytes", 10),
+                        (double)(bench_peak_bytes - base));
+    }
+
+    lept_parse(&v, json);
+    bench_alloc_count = bench_alloc_bytes = 0;
+    out = lept_stringify(&v, &n);
+    allocs = bench_alloc_count;
+    bytes = bench_alloc_bytes;
+    bench_free(out);
+    for(iters = 0, start = t = bench_now(); (t = bench_now()) - start < bench_seconds; iters++)
+        bench_free(lept_stringify(&v, NULL));
+    bench_report(c, "stringify", len, values, t - start, iters, allocs, bytes);
+
+    for(k = 0; k < 2; k++)
+    {
+        lept_value* r = lept_set_object_value(c, bin_names[k], strlen(bin_names[k]));
+        lept_value back;
+        char* bin = to[k](&v, &n);
+        lept_set_object(r, 3);
+        lept_set_number(lept_set_object_value(r, "bytes", 5), (double)n);
+        for(iters = 0, start = t = bench_now(); (t = bench_now()) - start < bench_seconds; iters++)
+            bench_free(to[k](&v, NULL));
+        lept_set_number(lept_set_object_value(r, "encode_mb_s", 11), (double)n * iters / (t - start) / 1e6);
+        for(iters = 0, start = t = bench_now(); (t = bench_now()) - start < bench_seconds; iters++)
+        {
+            from[k](&back, bin, n);
+            lept_free(&back);
+        }
+        lept_set_number(lept_set_object_value(r, "decode_mb_s", 11), (double)n * iters / (t - start) / 1e6);
+        bench_free(bin);
+    }
+    lept_free(&v);
+}
+
+static int bench_many_cb(void* user, size_t offset, size_t length, int ret, lept_value* val)
+{
+    (void)user;
+    (void)offset;
+    (void)length;
+    (void)ret;
+    lept_free(val);
+    return 0;
+}
+
+/*  大量小消息逐个调用 lept_parse，文本以 '\0' 分隔 */
+static void bench_messages(lept_value* corpora, const char* lines, size_t len)
+{
+    lept_value* c = lept_pushback_array_element(corpora);
+    char* buf = (char*)malloc(len + 1);
+    const char* p;
+    lept_value v;
+    size_t i, iters, count = 0, values = 0, allocs, bytes;
+    double start, t;
+    memcpy(buf, lines, len + 1);
+    for(i = 0; i < len; i++)
+        if('\n' == buf[i])
+            buf[i] = '\0', count++;
+    lept_set_object(c, 0);
+    lept_set_string(lept_set_object_value(c, "name", 4), "messages", 8);
+    lept_set_number(lept_set_object_value(c, "bytes", 5), (double)len);
+    lept_set_number(lept_set_object_value(c, "documents", 9), (double)count);
+    bench_alloc_count = bench_alloc_bytes = 0;
+    for(p = buf; p < buf + len; p += strlen(p) + 1)
+    {
+        lept_parse(&v, p);
+        values += bench_count_values(&v);
+        lept_free(&v);
+    }
+    allocs = bench_alloc_count;
+    bytes = bench_alloc_bytes;
+    lept_set_number(lept_set_object_value(c, "values", 6), (double)values);
+    for(iters = 0, start = t = bench_now(); (t = bench_now()) - start < bench_seconds; iters++)
+        for(p = buf; p < buf + len; p += strlen(p) + 1)
+        {
+            lept_parse(&v, p);
+            lept_free(&v);
+        }
+    bench_report(c, "parse_free", len, values, t - start, iters, allocs, bytes);
+
+    /*  不切分行，由 lept_parse_many 直接在整个缓冲区上逐个解析 */
+    bench_alloc_count = bench_alloc_bytes = 0;
+    for(iters = 0, start = t = bench_now(); (t = bench_now()) - start < bench_seconds; iters++)
+        lept_parse_many(lines, len, bench_many_cb, NULL);
+    bench_report(c, "parse_many", len, values, t - start, iters, bench_alloc_count / (iters ? iters : 1),
+                 bench_alloc_bytes / (iters ? iters : 1));
+
+    /*  用游标只取每条消息的 "px"，对比建立整棵树 */
+    bench_alloc_count = bench_alloc_bytes = 0;
+    for(iters = 0, start = t = bench_now(); (t = bench_now()) - start < bench_seconds; iters++)
+        for(p = buf; p < buf + len; p += strlen(p) + 1)
+        {
+            lept_cursor cur;
+            double px;
+            lept_cursor_init(&cur, p);
+            if(lept_cursor_find_field(&cur, "px", 2))
+                lept_cursor_get_number(&cur, &px);
+            lept_cursor_free(&cur);
+        }
+    bench_report(c, "cursor_field", len, values, t - start, iters, bench_alloc_count / (iters ? iters : 1),
+                 bench_alloc_bytes / (iters ? iters : 1));
+
+    /*  把 "px"、"qty"、"symbol" 按列抽取出来，不建立树 */
+    {
+        static const char* paths[] = { "/px", "/qty", "/symbol" };
+        const char** docs = (const char**)malloc((count + 1) * sizeof(const char*));
+        lept_column cols[3];
+        size_t ndocs = 0;
+        for(p = buf; p < buf + len; p += strlen(p) + 1)
+            docs[ndocs++] = p;
+        bench_alloc_count = bench_alloc_bytes = 0;
+        for(iters = 0, start = t = bench_now(); (t = bench_now()) - start < bench_seconds; iters++)
+        {
+            lept_column_init(&cols[0], LEPT_COLUMN_NUMBER);
+            lept_column_init(&cols[1], LEPT_COLUMN_INT64);
+            lept_column_init(&cols[2], LEPT_COLUMN_STRING);
+            lept_extract_columns(docs, ndocs, paths, 3, cols, NULL);
+            for(i = 0; i < 3; i++)
+                lept_column_free(&cols[i]);
+        }
+        bench_report(c, "columns", len, values, t - start, iters, bench_alloc_count / (iters ? iters : 1),
+                     bench_alloc_bytes / (iters ? iters : 1));
+        free((void*)docs);
+    }
+    free(buf);
+}
+
+
+/*  线程数 1、2、4、… 直到 CPU 核数（至少测到 2） */
+static int bench_next_threads(int n)
+{
+    int max = lept_thread_count(0);
+    if(max < 2)
+        max = 2;
+    return n >= max ? 0 : 2 * n > max ? max : 2 * n;
+}
+
+static int bench_ndjson_cb(void* user, size_t offset, int ret, lept_value* val)
+{
+    (void)user;
+    (void)offset;
+    (void)ret;
+    lept_free(val);
+    return 0;
+}
+
+static void bench_scaling(lept_value* report, const char* lines, size_t lines_len, const char* geo, size_t geo_len)
+{
+    lept_value results[3], *nd = &results[0], *pp = &results[1], *sp = &results[2];
+    lept_value v;
+    size_t iters;
+    double start, t;
+    int n;
+    /*  先在局部构建，最后再移入 report，避免 report 扩容使指针失效 */
+    lept_init(nd);
+    lept_init(pp);
+    lept_init(sp);
+    lept_set_array(nd, 0);
+    lept_set_array(pp, 0);
+    lept_set_array(sp, 0);
+    /*  geo 语料的顶层是对象，取出其中的大数组 */
+    lept_parse(&v, geo);
+    {
+        char* features = lept_stringify(lept_find_object_value(&v, "features", 8), &geo_len);
+        lept_free(&v);
+        lept_parse(&v, features);
+        for(n = 1; n > 0; n = bench_next_threads(n))
+        {
+            lept_value* r;
+            lept_value tmp;
+            for(iters = 0, start = t = bench_now(); (t = bench_now()) - start < bench_seconds; iters++)
+                lept_parse_ndjson(lines, lines_len, n, LEPT_NDJSON_UNORDERED, bench_ndjson_cb, NULL);
+            r = lept_pushback_array_element(nd);
+            lept_set_object(r, 2);
+            lept_set_number(lept_set_object_value(r, "threads", 7), n);
+            lept_set_number(lept_set_object_value(r, "mb_s", 4), (double)lines_len * iters / (t - start) / 1e6);
+
+            for(iters = 0, start = t = bench_now(); (t = bench_now()) - start < bench_seconds; iters++)
+            {
+                lept_parse_parallel(&tmp, features, n);
+                lept_free(&tmp);
+            }
+            r = lept_pushback_array_element(pp);
+            lept_set_object(r, 2);
+            lept_set_number(lept_set_object_value(r, "threads", 7), n);
+            lept_set_number(lept_set_object_value(r, "mb_s", 4), (double)geo_len * iters / (t - start) / 1e6);
+
+            for(iters = 0, start = t = bench_now(); (t = bench_now()) - start < bench_seconds; iters++)
+                bench_free(lept_stringify_parallel(&v, NULL, n));
+            r = lept_pushback_array_element(sp);
+            lept_set_object(r, 2);
+            lept_set_number(lept_set_object_value(r, "threads", 7), n);
+            lept_set_number(lept_set_object_value(r, "mb_s", 4), (double)geo_len * iters / (t - start) / 1e6);
+        }
+        bench_free(features);
+    }
+    lept_free(&v);
+    lept_move(lept_set_object_value(report, "ndjson", 6), nd);
+    lept_move(lept_set_object_value(report, "parse_parallel", 14), pp);
+    lept_move(lept_set_object_value(report, "stringify_parallel", 18), sp);
+}
+
+
+#ifdef LEPT_THREADS
+/*  流水线：一个生产者线程以最快速度提交消息，调用线程作为消费者 */
+typedef struct BENCH_PRODUCER {
+    lept_pipeline* p;
+    const char** msgs;
+    size_t n;
+} bench_producer;
+
+static void* bench_produce(void* arg)
+{
+    bench_producer* bp = (bench_producer*)arg;
+    size_t i;
+    for(i = 0; i < bp->n; )
+    {
+        if(LEPT_PIPELINE_OK == lept_pipeline_submit(bp->p, bp->msgs[i], NULL))
+            i++;
+        else
+            sched_yield();
+    }
+    lept_pipeline_close(bp->p);
+    return NULL;
+}
+
+/*  直方图的第 q 分位数，取桶的上界 */
+static double bench_percentile(const size_t* hist, double q)
+{
+    size_t i, total = 0, acc = 0;
+    for(i = 0; i < LEPT_PIPELINE_HIST_SIZE; i++)
+        total += hist[i];
+    for(i = 0; i < LEPT_PIPELINE_HIST_SIZE; i++)
+        if((acc += hist[i]) >= q * total)
+            break;
+    return ldexp(1.0, (int)i + 1);
+}
+
+static void bench_pipeline(lept_value* report, const char* lines, size_t len)
+{
+    lept_value* r = lept_set_object_value(report, "pipeline", 8);
+    lept_value* h;
+    char* buf = (char*)malloc(len + 1);
+    const char** msgs;
+    size_t i, n = 0, got = 0, k;
+    lept_pipeline_result res[64];
+    lept_pipeline_stats st;
+    bench_producer bp;
+    pthread_t tid;
+    double start, t;
+    static const char* const hist_names[] = { "queue_wait", "parse", "result_wait" };
+    const size_t* hists[3];
+    int j;
+    memcpy(buf, lines, len + 1);
+    for(i = 0; i < len; i++)
+        n += '\n' == buf[i];
+    msgs = (const char**)malloc(n * sizeof(const char*));
+    for(i = 0, k = 0; i < len; i++)
+        if(0 == i || '\0' == buf[i - 1])
+        {
+            msgs[k++] = buf + i;
+            buf[i + strcspn(buf + i, "\n")] = '\0';
+        }
+    bp.p = lept_pipeline_create(1024, 0);
+    bp.msgs = msgs;
+    bp.n = n;
+    start = bench_now();
+    pthread_create(&tid, NULL, bench_produce, &bp);
+    while(!lept_pipeline_done(bp.p))
+    {
+        size_t m = lept_pipeline_poll(bp.p, res, 64);
+        for(i = 0; i < m; i++)
+            lept_free(&res[i].val);
+        got += m;
+        if(0 == m)
+            sched_yield();
+    }
+    t = bench_now();
+    pthread_join(tid, NULL);
+    lept_pipeline_get_stats(bp.p, &st);
+    lept_pipeline_destroy(bp.p);
+
+    lept_set_object(r, 0);
+    lept_set_number(lept_set_object_value(r, "messages", 8), (double)got);
+    lept_set_number(lept_set_object_value(r, "msg_per_s", 9), (double)got / (t - start));
+    lept_set_number(lept_set_object_value(r, "mb_s", 4), (double)len / (t - start) / 1e6);
+    lept_set_number(lept_set_object_value(r, "rejected", 8), (double)st.rejected);
+    lept_set_number(lept_set_object_value(r, "stalls", 6), (double)st.stalls);
+    hists[0] = st.queue_wait;
+    hists[1] = st.parse;
+    hists[2] = st.result_wait;
+    for(j = 0; j < 3; j++)
+    {
+        h = lept_set_object_value(r, hist_names[j], strlen(hist_names[j]));
+        lept_set_object(h, 3);
+        lept_set_number(lept_set_object_value(h, "p50_ns", 6), bench_percentile(hists[j], 0.5));
+        lept_set_number(lept_set_object_value(h, "p99_ns", 6), bench_percentile(hists[j], 0.99));
+        lept_set_number(lept_set_object_value(h, "p999_ns", 7), bench_percentile(hists[j], 0.999));
+    }
+    free(msgs);
+    free(buf);
+}
+#endif
+
+
+/*  遍历整棵树，累加数值和字符串长度；与 bench_hpp.cpp 中用 leptjson.hpp 写的版本对比 */
+static double bench_walk_c(const lept_value* v)
+{
+    double sum = 0.0;
+    size_t i;
+    switch(lept_get_type(v))
+    {
+        case LEPT_NUMBER:
+            return lept_get_number(v);
+        case LEPT_STRING:
+            return (double)lept_get_string_length(v);
+        case LEPT_TRUE:
+            return 1.0;
+        case LEPT_ARRAY:
+            for(i = 0; i < lept_get_array_size(v); i++)
+                sum += bench_walk_c(lept_get_array_element(v, i));
+            return sum;
+        case LEPT_OBJECT:
+            for(i = 0; i < lept_get_object_size(v); i++)
+                sum += (double)lept_get_object_key_length(v, i) + bench_walk_c(lept_get_object_value(v, i));
+            return sum;
+        default:
+            return 0.0;
+    }
+}
+
+double bench_walk_hpp(const lept_value* v);
+
+static void bench_wrapper(lept_value* report, const char* json)
+{
+    lept_value* r = lept_set_object_value(report, "cpp_wrapper", 11);
+    lept_value v;
+    size_t iters, values;
+    double start, t, sum_c = 0.0, sum_hpp = 0.0;
+    lept_parse(&v, json);
+    values = bench_count_values(&v);
+    lept_set_object(r, 3);
+    for(iters = 0, start = t = bench_now(); (t = bench_now()) - start < bench_seconds; iters++)
+        sum_c += bench_walk_c(&v);
+    lept_set_number(lept_set_object_value(r, "c_ns_per_value", 14), (t - start) * 1e9 / iters / (double)values);
+    for(iters = 0, start = t = bench_now(); (t = bench_now()) - start < bench_seconds; iters++)
+        sum_hpp += bench_walk_hpp(&v);
+    lept_set_number(lept_set_object_value(r, "hpp_ns_per_value", 16), (t - start) * 1e9 / iters / (double)values);
+    /*  两种遍历的结果必须相同 */
+    lept_set_boolean(lept_set_object_value(r, "same_result", 11), bench_walk_c(&v) == bench_walk_hpp(&v));
+    (void)sum_c;
+    (void)sum_hpp;
+    lept_free(&v);
+}
+
+
+int main(int argc, char** argv)
+{
+    bench_buf geo = { NULL, 0, 0 }, social = { NULL, 0, 0 }, config = { NULL, 0, 0 }, messages = { NULL, 0, 0 };
+    lept_value report, *cfg, *corpora;
+    size_t target;
+    char* json;
+    if(argc > 1)
+        bench_seconds = atof(argv[1]);
+    if(argc > 2)
+        bench_scale = (size_t)atol(argv[2]);
+    if(bench_scale < 1)
+        bench_scale = 1;
+    target = bench_scale * 2 * 1024 * 1024;
+    bench_gen_geo(&geo, target);
+    bench_gen_social(&social, target);
+    bench_gen_config(&config, target);
+    bench_gen_messages(&messages, target);
+
+    lept_init(&report);
+    lept_set_object(&report, 0);
+    lept_set_number(lept_set_object_value(&report, "version", 7), 1);
+    cfg = lept_set_object_value(&report, "config", 6);
+    lept_set_object(cfg, 3);
+    lept_set_number(lept_set_object_value(cfg, "seconds", 7), bench_seconds);
+    lept_set_number(lept_set_object_value(cfg, "scale", 5), (double)bench_scale);
+    lept_set_number(lept_set_object_value(cfg, "cpus", 4), lept_thread_count(0));
+
+    corpora = lept_set_object_value(&report, "corpora", 7);
+    lept_set_array(corpora, 4);
+    bench_corpus(corpora, "geo", geo.s, geo.len);
+    bench_corpus(corpora, "social", social.s, social.len);
+    bench_corpus(corpora, "config", config.s, config.len);
+    bench_messages(corpora, messages.s, messages.len);
+
+    bench_scaling(&report, messages.s, messages.len, geo.s, geo.len);
+#ifdef LEPT_THREADS
+    bench_pipeline(&report, messages.s, messages.len);
+#endif
+    bench_wrapper(&report, social.s);
+
+    json = lept_stringify(&report, NULL);
+    printf("%s\n", json);
+    bench_free(json);
+    lept_free(&report);
+    free(geo.s);
+    free(social.s);
+    free(config.s);
+    free(messages.s);
+    return 0;
+}
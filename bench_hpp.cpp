@@ -0,0 +1,33 @@
+/*
+ *  bench.c 的 C++ 部分：用 leptjson.hpp 写的遍历，与 bench_walk_c 做相同的计算
+ */
+
+#include "leptjson.hpp"
+
+static double walk(lept::view v)
+{
+    double sum = 0.0;
+    switch (v.type()) {
+        case LEPT_NUMBER:
+            return v.get_number();
+        case LEPT_STRING:
+            return static_cast<double>(v.get_string().size());
+        case LEPT_TRUE:
+            return 1.0;
+        case LEPT_ARRAY:
+            for (lept::view e : v)
+                sum += walk(e);
+            return sum;
+        case LEPT_OBJECT:
+            for (lept::member m : v.members())
+                sum += static_cast<double>(m.key.size()) + walk(m.value);
+            return sum;
+        default:
+            return 0.0;
+    }
+}
+
+extern "C" double bench_walk_hpp(const lept_value* v)
+{
+    return walk(lept::view(v));
+}
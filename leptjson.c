@@ -2,6 +2,10 @@
  *  leptjson 的实现文件（implementation file），含有内部的类型声明和函数实现。
  *  此文件会编译成库。
  */
+/*  快照使用 POSIX 的 mmap，-ansi 下需要显式打开 POSIX 的声明 */
+#if (defined(__unix__) || defined(__APPLE__)) && !defined(_POSIX_C_SOURCE)
+#define _POSIX_C_SOURCE 200112L
+#endif
 #include <stdio.h>
 #include <assert.h>
 #include <stdlib.h>
@@ -9,8 +13,44 @@
 #include <math.h>
 #include <string.h>
 #include <ctype.h>
+#include <float.h>
+#include <stdint.h>
+#include <time.h>
 #include "leptjson.h"
 
+#if defined(__unix__) || defined(__APPLE__)
+#define LEPT_SNAPSHOT_MMAP
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+/*  多线程解析使用 pthread 和 GCC 的原子操作，定义 LEPT_NO_THREADS 或其他平台退化为单线程 */
+#if (defined(__unix__) || defined(__APPLE__)) && (defined(__GNUC__) || defined(__clang__)) && !defined(LEPT_NO_THREADS)
+#define LEPT_THREADS
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+/*  UTF-8 校验跳过 ASCII 时使用 SSE2，定义 LEPT_NO_SIMD 或其他平台按机器字处理 */
+#if defined(__SSE2__) && !defined(LEPT_NO_SIMD)
+#define LEPT_SSE2
+#include <emmintrin.h>
+#endif
+
+/*  库内所有的内存分配都经过这三个宏，可以在编译时替换为自己的分配器（例如统计分配次数），
+    语义与 malloc、realloc、free 相同；lept_stringify 等返回的缓冲区也由 LEPT_MALLOC 分配 */
+#ifndef LEPT_MALLOC
+#define LEPT_MALLOC(size) malloc(size)
+#endif
+#ifndef LEPT_REALLOC
+#define LEPT_REALLOC(ptr, size) realloc(ptr, size)
+#endif
+#ifndef LEPT_FREE
+#define LEPT_FREE(ptr) free(ptr)
+#endif
+
 #ifndef LEPT_PARSE_STACK_INIT_SIZE
 #define LEPT_PARSE_STACK_INIT_SIZE 256
 #endif
@@ -19,6 +59,41 @@
 #define LEPT_PARSE_STRINGIFY_INIT_SIZE 256
 #endif
 
+/*  lept_parse_ndjson 每个任务的字节数，任务从 k * LEPT_NDJSON_CHUNK_SIZE 之后的第一个行首开始 */
+#ifndef LEPT_NDJSON_CHUNK_SIZE
+#define LEPT_NDJSON_CHUNK_SIZE (256 * 1024)
+#endif
+
+/*  lept_parse_parallel 对小于这个字节数的输入直接使用 lept_parse */
+#ifndef LEPT_PARALLEL_PARSE_THRESHOLD
+#define LEPT_PARALLEL_PARSE_THRESHOLD (1024 * 1024)
+#endif
+
+/*  lept_stringify_parallel 只并行生成元素（成员）个数不少于这个值的根容器 */
+#ifndef LEPT_PARALLEL_STRINGIFY_THRESHOLD
+#define LEPT_PARALLEL_STRINGIFY_THRESHOLD 1024
+#endif
+
+/*  流水线的解析线程每次最多从输入队列取出的消息数 */
+#ifndef LEPT_PIPELINE_BATCH
+#define LEPT_PIPELINE_BATCH 16
+#endif
+
+/*  lept_array_iter 每次从回调读取的字节数 */
+#ifndef LEPT_ARRAY_ITER_CHUNK_SIZE
+#define LEPT_ARRAY_ITER_CHUNK_SIZE (64 * 1024)
+#endif
+
+/*  lept_free 的显式栈先使用栈上的这么多层，更深时才 malloc */
+#ifndef LEPT_FREE_STACK_INIT_SIZE
+#define LEPT_FREE_STACK_INIT_SIZE 32
+#endif
+
+/*  比较成员数超过这个值的对象时，为右边的对象建立键的哈希索引 */
+#ifndef LEPT_EQUAL_INDEX_THRESHOLD
+#define LEPT_EQUAL_INDEX_THRESHOLD 16
+#endif
+
 /*  assert() 宏 assert，如果括号内的为 true，则不做任何动作
     如果为 false，输出标准错误 stderr */
 #define EXPECT(con, ch) \
@@ -38,27 +113,361 @@
 #define PUTS(con, s, len) \
      memcpy(lept_context_push(con, len), s, len)
 
+/*  运行时统计，con->stats 为 NULL 时不统计；未定义 LEPT_ENABLE_STATS 时全部展开为空 */
+#ifdef LEPT_ENABLE_STATS
+#define LEPT_STAT_ADD(con, field, n) \
+    do { \
+        if(NULL != (con)->stats) \
+            (con)->stats->field += (n); \
+    } while(0)
+#define LEPT_STAT_MAX(con, field, n) \
+    do { \
+        if(NULL != (con)->stats && (con)->stats->field < (n)) \
+            (con)->stats->field = (n); \
+    } while(0)
+#define LEPT_STAT_ENTER(con) \
+    do { \
+        (con)->depth++; \
+        LEPT_STAT_MAX(con, max_depth, (con)->depth); \
+    } while(0)
+#define LEPT_STAT_LEAVE(con) ((con)->depth--)
+#else
+#define LEPT_STAT_ADD(con, field, n) ((void)0)
+#define LEPT_STAT_MAX(con, field, n) ((void)0)
+#define LEPT_STAT_ENTER(con) ((void)0)
+#define LEPT_STAT_LEAVE(con) ((void)0)
+#endif
+
+/*  lept_value.flags
+    LEPT_FLAG_BLOCK： lept_copy 的根节点，存储（e/m）和子树的存储都在 lept_copy 分配的整块内存中，持有整块内存的一个引用
+    LEPT_FLAG_POOLED：存储位于祖先节点的整块内存中，不能单独 free/realloc
+    整块内存带引用计数头，其中每个容器的存储前面有一个 lept_refhdr，p 指向整块内存 */
+#define LEPT_FLAG_BLOCK     0x1u
+#define LEPT_FLAG_POOLED    0x2u
+/*  LEPT_FLAG_SHARED：存储前面有引用计数头，可被多个值共享；这样的对象的键也都带引用计数头 */
+#define LEPT_FLAG_SHARED    0x4u
+/*  LEPT_FLAG_ESCAPED：字符串的存储是带引号、未解码的原文（LEPT_OPT_LAZY_STRINGS），
+    复制、共享、比较之前先由 lept_string_decode 解码，所以带这个标记的存储只属于一个值 */
+#define LEPT_FLAG_ESCAPED   0x8u
+/*  LEPT_FLAG_PACKED：数组的存储是 size 个 double（再有 LEPT_FLAG_PACKED_INT64 时是 int64_t），没有 lept_value，
+    capacity 总是等于 size；BLOCK/POOLED/SHARED 的含义不变 */
+#define LEPT_FLAG_PACKED    0x10u
+#define LEPT_FLAG_PACKED_INT64 0x20u
+#define LEPT_PACKED_MASK    (LEPT_FLAG_PACKED | LEPT_FLAG_PACKED_INT64)
+/*  LEPT_FLAG_ANCHORED：容器的存储是从整块内存中复制出来的，子节点仍有位于整块内存中的；
+    存储前面的 lept_refhdr 的 p 指向整块内存，并持有它的一个引用，释放存储时一起释放 */
+#define LEPT_FLAG_ANCHORED  0x40u
+
+/*  lept_value.u.n.len：低 7 位是惰性数值原文的长度，最高位表示还没有转换为 double */
+#define LEPT_NUMBER_PENDING  0x80u
+#define LEPT_NUMBER_LEN_MASK 0x7fu
+
+/*  引用计数的原子增减，其他编译器退化为普通的读改写：这时 LEPT_THREADS 不会定义，
+    共享子树、lept_free_deferred/lept_reclaim 也只能在一个线程中使用（见 leptjson.h） */
+#if defined(__GNUC__) || defined(__clang__)
+#define LEPT_ATOMIC_INC(p)  __sync_add_and_fetch((p), 1)
+#define LEPT_ATOMIC_DEC(p)  __sync_sub_and_fetch((p), 1)
+#define LEPT_ATOMIC_LOAD(p) __sync_fetch_and_add((p), 0)
+#define LEPT_ATOMIC_CAS(p, oldval, newval) __sync_bool_compare_and_swap((p), (oldval), (newval))
+#define LEPT_ATOMIC_XCHG(p, newval) __sync_lock_test_and_set((p), (newval))
+/*  无锁队列需要的 acquire 读和 release 写 */
+#if defined(__ATOMIC_ACQUIRE)
+#define LEPT_ATOMIC_LOAD_ACQ(p) __atomic_load_n((p), __ATOMIC_ACQUIRE)
+#define LEPT_ATOMIC_STORE_REL(p, v) __atomic_store_n((p), (v), __ATOMIC_RELEASE)
+#else
+#define LEPT_ATOMIC_LOAD_ACQ(p) LEPT_ATOMIC_LOAD(p)
+#define LEPT_ATOMIC_STORE_REL(p, v) do { __sync_synchronize(); *(p) = (v); __sync_synchronize(); } while(0)
+#endif
+#else
+#define LEPT_ATOMIC_INC(p)  (++*(p))
+#define LEPT_ATOMIC_DEC(p)  (--*(p))
+#define LEPT_ATOMIC_LOAD(p) (*(p))
+#define LEPT_ATOMIC_CAS(p, oldval, newval) (*(p) == (oldval) ? (*(p) = (newval), 1) : 0)
+#define LEPT_ATOMIC_XCHG(p, newval) lept_xchg_ptr((void**)(p), (newval))
+#define LEPT_ATOMIC_LOAD_ACQ(p) (*(p))
+#define LEPT_ATOMIC_STORE_REL(p, v) (*(p) = (v))
+static void* lept_xchg_ptr(void** p, void* newval) { void* old = *p; *p = newval; return old; }
+#endif
+
 #define STRING_ERROR(ret) \
     do { \
         con->top = head; \
         return ret; \
         } while(0)
 
-typedef struct LEPT_CONTEST {
-    const char* json;
-    char* stack;
-    size_t size, top;   /*  size 是当前的堆栈容量，top 是栈顶的位置 */
-} lept_context;
+/*  解析和生成使用的上下文，即公开的 lept_stream
+    size 是当前的堆栈容量，top 是栈顶的位置 */
+typedef lept_stream lept_context;
+
+/*  lept_free 显式栈中的一层：正在释放的容器和下一个要释放的子节点下标 */
+typedef struct LEPT_FREE_FRAME {
+    lept_value v;
+    size_t i;
+} lept_free_frame;
+
+/*  lept_free_deferred 的待释放队列（无锁栈） */
+typedef struct LEPT_DEFERRED {
+    struct LEPT_DEFERRED* next;
+    lept_value val;
+} lept_deferred;
+
+static lept_deferred* volatile lept_deferred_head = NULL;
+
+static int lept_free_begin(lept_value* val);
+static void lept_free_end(const lept_value* val);
+
+static const char* lept_pointer_token(lept_context* con, const char* p, const char* end, const char** tok, size_t* len);
+static size_t lept_pointer_index(const char* s, size_t len, size_t size);
+static lept_value* lept_pointer_walk(lept_value* val, const char* p, const char* end, lept_value* tmp, lept_context* con);
+static const char* lept_pointer_last(const char* p, const char* end);
+static int lept_patch_add(lept_value* doc, const char* path, size_t plen, lept_value* v, lept_context* con);
+static int lept_patch_remove(lept_value* doc, const char* path, size_t plen, lept_value* out, lept_context* con);
+static int lept_patch_op(lept_value* doc, const lept_value* op, lept_context* con);
+static void lept_diff_value(lept_value* patch, lept_context* path, const lept_value* from, const lept_value* to);
+static void lept_diff_emit(lept_value* patch, const char* op, const lept_context* path, const lept_value* value);
+static void lept_diff_push_key(lept_context* path, const char* k, size_t klen);
 
 static void* lept_context_push(lept_context* con, size_t size);
 static void* lept_context_pop(lept_context* con, size_t size);
 
+/*  CBOR/MessagePack 的读取位置，stack 用来拼接 CBOR 的分段字符串 */
+typedef struct LEPT_READER {
+    const unsigned char* p;
+    const unsigned char* end;
+    lept_context con;
+} lept_reader;
+
+/*  lept_extract_columns 中路径的一个标记：文本是 keys 的 [off, off + len)，index 是它作为数组下标的值 */
+typedef struct LEPT_COLUMN_TOKEN {
+    size_t off, len, index;
+} lept_column_token;
+
+/*  lept_extract_columns 的状态：第 i 个路径的标记是 tok[first[i], first[i + 1])，
+    alive 每层一段，存放在当前位置仍可能匹配的路径下标 */
+typedef struct LEPT_COLUMNS {
+    lept_column* cols;
+    const char* keys;
+    lept_column_token* tok;
+    size_t* first;
+    size_t* alive;
+    size_t npaths, row;
+} lept_columns;
+
+static int lept_is_negative_zero(double num);
+static int lept_is_integer(double num);
+static int lept_is_float32(double num);
+static void lept_put_uint(lept_context* con, double n, int bytes);
+static void lept_put_op(lept_context* con, int op, double n, int bytes);
+static void lept_put_float(lept_context* con, int op, double num, int bytes);
+static double lept_get_uint(const unsigned char* p, int bytes);
+static int lept_get_float(const unsigned char* p, int bytes, double* num);
+static lept_value* lept_bin_member(lept_value* obj, lept_value* key);
+static void lept_cbor_head(lept_context* con, int major, double n);
+static void lept_cbor_value(lept_context* con, const lept_value* val);
+static int lept_cbor_parse_arg(lept_reader* r, int info, double* n);
+static int lept_cbor_parse_string(lept_reader* r, lept_value* val, int info);
+static int lept_cbor_parse_value(lept_reader* r, lept_value* val);
+/*  快照中的节点，偏移都相对于节点（或成员）自身的地址，所以映像可以加载到任意地址
+    字符串以 '\0' 结尾，所有节点 8 字节对齐 */
+struct lept_snap_value {
+    uint32_t type;
+    uint32_t reserved;
+    union {
+        double num;
+        struct { uint64_t off, n; } r;  /*  字符串的字节、数组的节点、对象的成员，n 为长度或个数 */
+    } u;
+};
+
+typedef struct LEPT_SNAP_MEMBER {
+    uint64_t koff, klen;    /*  koff 相对于成员的地址 */
+    uint32_t khash;
+    uint32_t reserved;
+    lept_snap_value val;
+} lept_snap_member;
+
+#define LEPT_SNAPSHOT_MAGIC "LEPTSNAP"
+#define LEPT_SNAPSHOT_VERSION 1u
+#define LEPT_SNAPSHOT_ENDIAN 0x01020304u
+
+typedef struct LEPT_SNAP_HEADER {
+    char magic[8];
+    uint32_t version;
+    uint32_t endian;    /*  按写入机器的字节序存放 LEPT_SNAPSHOT_ENDIAN */
+    uint64_t size;      /*  整个文件的字节数 */
+    lept_snap_value root;
+} lept_snap_header;
+
+struct lept_snapshot {
+    void* base;     /*  mmap 的映像，没有 mmap 的平台是 malloc 后读入的 */
+    size_t size;
+};
+
+static size_t lept_snap_reserve(lept_context* img, size_t size);
+static void lept_snap_fill(lept_context* img, size_t node, const lept_value* val);
+static int lept_snap_write_file(const char* path, const void* data, size_t size);
+static void lept_snapshot_unmap(const lept_snapshot* snap);
+
+static void lept_msgpack_head(lept_context* con, unsigned char fix, size_t fixmax, unsigned char op16, size_t n);
+static void lept_msgpack_value(lept_context* con, const lept_value* val);
+static int lept_msgpack_parse_value(lept_reader* r, lept_value* val);
+
+/*  lept_parse_ndjson 的一行结果（按序交付时暂存） */
+typedef struct LEPT_NDJSON_RESULT {
+    size_t offset;
+    int ret;
+    lept_value val;
+} lept_ndjson_result;
+
+/*  一个任务（一段输入）的结果 */
+typedef struct LEPT_NDJSON_CHUNK {
+    lept_ndjson_result* r;
+    size_t n, cap;
+    int done;
+} lept_ndjson_chunk;
+
+/*  lept_parse_ndjson 的共享状态，next、delivered、stop 由 lock 保护 */
+typedef struct LEPT_NDJSON {
+    const char* buf;
+    size_t len, nchunks, next, delivered, window;
+    int flags, stop;
+    lept_ndjson_callback cb;
+    void* user;
+    lept_ndjson_chunk* chunks;
+#ifdef LEPT_THREADS
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+#endif
+} lept_ndjson;
+
+/*  每个线程复用的解析上下文和行缓冲区 */
+typedef struct LEPT_NDJSON_WORKER {
+    lept_ndjson* nd;
+    lept_context con;
+    char* line;
+    size_t cap;
+} lept_ndjson_worker;
+
+/*  lept_parse_parallel 的共享状态：第 i 个元素的文本从 json + start[i] 开始，
+    到 json + start[i + 1] - 1（逗号）或 json + end（']'）结束，解析结果直接写入 e[i] */
+typedef struct LEPT_PARALLEL_ARRAY {
+    const char* json;
+    size_t* start;
+    size_t n, end, ntasks;
+    lept_value* e;
+    volatile size_t next;
+    volatile int failed;
+} lept_parallel_array;
+
+typedef struct LEPT_PARALLEL_ARRAY_WORKER {
+    lept_parallel_array* pa;
+    lept_context con;
+} lept_parallel_array_worker;
+
+/*  lept_stringify_parallel 的共享状态：第 t 段生成到 out[t] */
+typedef struct LEPT_PARALLEL_STRINGIFY {
+    const lept_value* val;
+    size_t n, ntasks;
+    lept_context* out;
+    volatile size_t next;
+} lept_parallel_stringify;
+
+/*  有界无锁多生产者多消费者队列（Dmitry Vyukov 的算法），容量为 2 的幂
+    每个格子的 seq 表示它当前可以被第几次入队（seq == pos）或出队（seq == pos + 1）使用 */
+typedef struct LEPT_MPMC_CELL {
+    volatile size_t seq;
+    void* data;
+} lept_mpmc_cell;
+
+typedef struct LEPT_MPMC {
+    lept_mpmc_cell* cells;
+    size_t mask;
+    char pad0[64];  /*  入队和出队的位置放在不同的缓存行 */
+    volatile size_t enq;
+    char pad1[64];
+    volatile size_t deq;
+    char pad2[64];
+} lept_mpmc;
+
+/*  流水线中的一条消息，从空闲队列取出，经输入队列、解析、输出队列后回到空闲队列 */
+typedef struct LEPT_PIPELINE_ITEM {
+    const char* json;
+    void* user;
+    int ret;
+    lept_value val;
+    double t;       /*  入队的时间（纳秒） */
+} lept_pipeline_item;
+
+typedef struct LEPT_PIPELINE_WORKER {
+    lept_pipeline* p;
+    lept_context con;
+    size_t stalls;
+    size_t queue_wait[LEPT_PIPELINE_HIST_SIZE];
+    size_t parse[LEPT_PIPELINE_HIST_SIZE];
+} lept_pipeline_worker;
+
+struct lept_pipeline {
+    lept_mpmc in, out, free;
+    lept_pipeline_item* items;
+    lept_pipeline_worker* workers;
+    size_t nworkers, nitems;
+    volatile int closed;
+    volatile int destroying;    /*  正在销毁，不会再有人取结果 */
+    volatile size_t rejected;
+    size_t result_wait[LEPT_PIPELINE_HIST_SIZE];
+#ifdef LEPT_THREADS
+    pthread_t* tid;
+#endif
+};
+
+/*  lept_array_iter：buf[pos, len) 是还没有处理的输入，当前元素从 pos 开始，已经扫描到 scan */
+struct lept_array_iter {
+    lept_read_callback read;
+    void* user;
+    int fd;
+    char* buf;
+    size_t size, len, pos, scan;
+    int depth, in_string, escape;
+    int started, done, eof, ret;
+    lept_context con;   /*  解析元素的栈，在元素之间复用 */
+};
+
+static void* lept_calloc(size_t n, size_t size);
+static int lept_parse_with(lept_context* con, lept_value* val, const char* json);
+static void lept_mpmc_init(lept_mpmc* q, size_t capacity);
+static int lept_mpmc_push(lept_mpmc* q, void* data);
+static size_t lept_mpmc_pop(lept_mpmc* q, void** data, size_t max);
+static double lept_now(void);
+static void lept_hist_add(size_t* hist, double ns);
+static void lept_pipeline_parse(lept_pipeline_worker* w, lept_pipeline_item** items, size_t n);
+#ifdef LEPT_THREADS
+static void lept_backoff(unsigned* spins);
+static void* lept_pipeline_work(void* arg);
+#endif
+static int lept_thread_count(int nthreads);
+static void lept_run_parallel(void* (*fn)(void*), void* args, size_t size, size_t n);
+static int lept_parallel_scan(lept_parallel_array* pa, lept_context* starts);
+static void* lept_parallel_array_work(void* arg);
+static void* lept_parallel_stringify_work(void* arg);
+static int lept_ndjson_chunk_run(lept_ndjson_worker* w, size_t k);
+#ifdef LEPT_THREADS
+static int lept_ndjson_grab(lept_ndjson* nd, size_t* k);
+static void* lept_ndjson_work(void* arg);
+#endif
+
 static int lept_parse_value(lept_context* con, lept_value* val);
 static void lept_parse_whitespace(lept_context* con); 
 static int lept_parse_literal(lept_context* con, lept_value* val, const char* literal, lept_type tpye);
 static int lept_parse_number(lept_context* con, lept_value* val);
 static int lept_parse_string_raw(lept_context* con, char** str, size_t* len);
 static int lept_parse_string(lept_context* con, lept_value* val);
+static int lept_parse_string_lazy(lept_context* con, const char** str, size_t* len, int* escaped);
+static void lept_string_decode(const lept_value* val);
+static void lept_array_pack(lept_context* con, lept_value* val, size_t size);
+static void lept_array_unpack(lept_value* val);
+static const lept_value* lept_array_at(const lept_value* val, size_t index, lept_value* tmp);
+static size_t lept_packed_bytes(const lept_value* val);
+static size_t lept_utf8_ascii_prefix(const unsigned char* s, size_t len);
+static int lept_utf8_valid(const char* str, size_t len);
 
 
 static char* lept_parse_hex4(const char *p, unsigned* u);
@@ -66,10 +475,70 @@ static void lept_encode_utf8(lept_context* c, unsigned u);
 static int lept_parse_array(lept_context* con, lept_value* val);
 static int lept_parse_object(lept_context* con, lept_value* val);
 
+static int lept_stream_mismatch(const lept_stream* s);
+static int lept_cursor_fail(lept_cursor* c, int ret);
+static int lept_cursor_enter(lept_cursor* c);
+static int lept_cursor_advance(lept_cursor* c);
+static int lept_cursor_read_key(lept_cursor* c);
+static void lept_column_begin_row(lept_column* col, size_t row);
+static int lept_columns_store(lept_columns* x, size_t k, lept_type type, double num, const char* str, size_t len);
+static int lept_columns_walk(lept_columns* x, lept_cursor* c, size_t depth, size_t* alive, size_t nalive);
+static int lept_array_iter_fill(lept_array_iter* it);
+static int lept_array_iter_skip_ws(lept_array_iter* it);
+static int lept_array_iter_fail(lept_array_iter* it, int ret);
+static int lept_array_iter_parse(lept_array_iter* it, lept_value* out);
+static const char* lept_many_extent(const char* p, const char* end, int* safe);
+#if defined(__unix__) || defined(__APPLE__)
+static int lept_array_iter_read_fd(void* user, char* buf, size_t size, size_t* nread);
+#endif
+
 static void lept_stringify_value(lept_context*con, const lept_value* val);
 static void lept_stringify_string(lept_context* con, const char* s, size_t len);
 static void lept_stringify_array(lept_context* con, const lept_value* val);
 static void lept_stringify_object(lept_context* con, const lept_value* val);
+static void lept_stringify_range(lept_context* con, const lept_value* val, size_t first, size_t last);
+
+static size_t lept_grow_capacity(size_t capacity);
+
+/*  lept_copy 的整块内存：前半部分放 lept_value/lept_member 数组，后半部分放字符串 */
+typedef struct LEPT_BLOCK {
+    void* block;
+    char* node;
+    char* data;
+} lept_block;
+
+static void lept_copy_measure(const lept_value* val, size_t* node, size_t* data);
+static void lept_copy_value(lept_value* dst, const lept_value* src, lept_block* b);
+static void lept_unpool(lept_value* val);
+static void lept_block_release(void* block);
+
+/*  共享存储前面的引用计数头，用 union 保证其后的存储对齐 */
+typedef union LEPT_REFHDR {
+    size_t refs;
+    double d;
+    void* p;
+} lept_refhdr;
+
+#define LEPT_REFS(p) (((lept_refhdr*)(void*)(p) - 1)->refs)
+
+static void* lept_shared_alloc(size_t size);
+static void* lept_shared_realloc(void* p, size_t size);
+static void lept_shared_retain(void* p);
+static int lept_shared_release(void* p);
+static void lept_shared_dealloc(void* p);
+static void* lept_storage(const lept_value* val);
+static void* lept_data_realloc(const lept_value* val, void* p, size_t size);
+static void lept_data_free(const lept_value* val, void* p);
+static char* lept_key_alloc(const lept_value* obj, size_t klen);
+static void lept_key_free(const lept_value* obj, char* k);
+static void lept_share_convert(lept_value* val);
+static void lept_retain_into(lept_value* dst, const lept_value* src);
+
+static unsigned lept_hash_key(const char* key, size_t klen);
+static size_t lept_find_member(const lept_value* val, const char* key, size_t klen, unsigned khash);
+static size_t lept_hash_combine(size_t seed, size_t h);
+static int lept_is_equal_with(lept_context* con, const lept_value* lhs, const lept_value* rhs);
+static int lept_is_equal_object(lept_context* con, const lept_value* lhs, const lept_value* rhs);
 
 
 /*  入栈，返回数据起始的指针 ret */
@@ -83,12 +552,14 @@ void* lept_context_push(lept_context* con, size_t size)
             con->size = LEPT_PARSE_STACK_INIT_SIZE;
         while (con->top + size >= con->size)
             con->size += con->size >> 1;  /* c->size * 1.5 */
-        con->stack = (char*)realloc(con->stack, con->size);
+        con->stack = (char*)LEPT_REALLOC(con->stack, con->size);
+        LEPT_STAT_ADD(con, stack_reallocs, 1);
     }
     /*  当前传入的字符存储在 con->stack 偏移 top 这个内存中
         通过 PUTC 宏把字符 ch 写到这个地址 */
     ret = con->stack + con->top;
     con->top += size;
+    LEPT_STAT_MAX(con, stack_high, con->top);
     return ret;
 }
 
@@ -100,184 +571,826 @@ void* lept_context_pop(lept_context* con, size_t size)
 }
 
 
+/*  释放 val 自身能直接释放的部分，返回 1 表示它是有子节点的容器，需要继续遍历子节点 */
+int lept_free_begin(lept_value* val)
+{
+    /*  共享的存储只减少引用计数，最后一个引用才释放 */
+    if((val->flags & LEPT_FLAG_SHARED) && !lept_shared_release(lept_storage(val)))
+        return 0;
+    switch(val->type)
+    {
+        case LEPT_STRING:
+            /*  位于整块内存中的存储随整块一起释放 */
+            if(!(val->flags & LEPT_FLAG_POOLED))
+                lept_data_free(val, val->u.s.str);
+            return 0;
+        case LEPT_ARRAY:
+            if(val->u.a.size > 0 && !(val->flags & LEPT_FLAG_PACKED))
+                return 1;
+            lept_free_end(val);
+            return 0;
+        case LEPT_OBJECT:
+            if(val->u.o.size > 0)
+                return 1;
+            lept_free_end(val);
+            return 0;
+        default:
+            return 0;
+    }
+}
+
+
+/*  子节点都已释放，释放容器自身的存储 */
+void lept_free_end(const lept_value* val)
+{
+    if(!(val->flags & LEPT_FLAG_POOLED))
+        lept_data_free(val, LEPT_ARRAY == val->type ? (void*)val->u.a.e : (void*)val->u.o.m);
+}
+
+
+/*  用显式栈代替递归：栈顶是正在释放子节点的容器
+    整块内存中的容器不拥有存储，但其中可能有单独分配的子节点，仍需遍历 */
 void lept_free(lept_value* val)
 {
-    int i = 0;
+    lept_free_frame local[LEPT_FREE_STACK_INIT_SIZE];
+    lept_free_frame* stack = local;
+    size_t top = 0, size = LEPT_FREE_STACK_INIT_SIZE;
+    lept_free_frame* f;
+    lept_value* child;
     assert(NULL != val);
-    /*  只有当 val 存储的时字符串才 frre */
-    if(LEPT_STRING == val->type)
-        free(val->u.s.str);
-    /*  free 完设为 null，可以避免 type 仍是 string 导致重复释放 */
-    if(LEPT_ARRAY == val->type)
+    if(lept_free_begin(val))
     {
-        for (i = 0; i < val->u.a.size; i++)
-            lept_free(&val->u.a.e[i]);
-        free(val->u.a.e);
+        stack[top].v = *val;
+        stack[top++].i = 0;
     }
-    if(LEPT_OBJECT == val->type)
+    lept_init(val);
+    while(top > 0)
     {
-        for (i = 0; i < val->u.o.size; i++) {
-                free(val->u.o.m[i].k);
-                lept_free(&val->u.o.m[i].val);
-            }
-            free(val->u.o.m);
+        f = &stack[top - 1];
+        if(LEPT_ARRAY == f->v.type && f->i < f->v.u.a.size)
+            child = &f->v.u.a.e[f->i++];
+        else if(LEPT_OBJECT == f->v.type && f->i < f->v.u.o.size)
+        {
+            lept_key_free(&f->v, f->v.u.o.m[f->i].k);
+            child = &f->v.u.o.m[f->i++].val;
+        }
+        else
+        {
+            lept_free_end(&f->v);
+            top--;
+            continue;
+        }
+        if(!lept_free_begin(child))
+            continue;
+        if(top == size)
+        {
+            f = (lept_free_frame*)LEPT_MALLOC(2 * size * sizeof(lept_free_frame));
+            memcpy(f, stack, size * sizeof(lept_free_frame));
+            if(stack != local)
+                LEPT_FREE(stack);
+            stack = f;
+            size *= 2;
+        }
+        stack[top].v = *child;
+        stack[top++].i = 0;
     }
-    lept_init(val);
+    if(stack != local)
+        LEPT_FREE(stack);
 }
 
 
-int lept_parse_value(lept_context* con, lept_value* val) 
+void lept_free_deferred(lept_value* val)
 {
-    switch (*con->json) 
+    lept_deferred* d;
+    assert(NULL != val);
+    /*  没有存储的值不需要排队 */
+    if(NULL == lept_storage(val))
     {
-        case '\0': 
-            return LEPT_PARSE_EXPECT_VALUE;
-        case 'n':
-            return lept_parse_literal(con, val, "null", LEPT_NULL);
-        case 't':
-            return lept_parse_literal(con, val, "true", LEPT_TRUE);
-        case 'f':
-            return lept_parse_literal(con, val, "false", LEPT_FALSE);
-        case '"':
-            return lept_parse_string(con, val);
-        case '[':
-            return lept_parse_array(con, val);
-        case '{':
-            return lept_parse_object(con, val);
-        default:   
-            return lept_parse_number(con, val);
-            /*  return LEPT_PARSE_INVALID_VALUE; */
+        lept_init(val);
+        return;
     }
+    d = (lept_deferred*)LEPT_MALLOC(sizeof(lept_deferred));
+    lept_init(&d->val);
+    lept_move(&d->val, val);
+    do {
+        d->next = lept_deferred_head;
+    } while(!LEPT_ATOMIC_CAS(&lept_deferred_head, d->next, d));
 }
 
 
-/*  解析 JSON 的函数 */
-int lept_parse(lept_value* val, const char* json)
+/*  一次取走整个队列，不存在 ABA 问题 */
+size_t lept_reclaim(void)
 {
-    lept_context con;
-    int ret = 0;
-    assert(NULL != val);
-    con.json = json;
-    con.stack = NULL;   /*  初始化栈指针 */
-    con.size = con.top = 0; /*  初始化 stack 的容量和位置 */
-    lept_init(val);
-    lept_parse_whitespace(&con);
-    if(LEPT_PARSE_OK == (ret = lept_parse_value(&con, val)))
+    size_t count = 0;
+    lept_deferred* d = (lept_deferred*)LEPT_ATOMIC_XCHG(&lept_deferred_head, NULL);
+    lept_deferred* next;
+    while(NULL != d)
     {
-        lept_parse_whitespace(&con);
-        if('\0' != con.json[0])
-        {
-            val->type = LEPT_NULL;
-            ret = LEPT_PARSE_ROOT_NOT_SINGULAR;
-        }          
-    }    
+        next = d->next;
+        lept_free(&d->val);
+        LEPT_FREE(d);
+        d = next;
+        count++;
+    }
+    return count;
+}
 
-    assert(0 == con.top); /*  确保栈中的所有数据都被弹出 */
-    free(con.stack);
-    return ret;
+
+void* lept_shared_alloc(size_t size)
+{
+    lept_refhdr* h = (lept_refhdr*)LEPT_MALLOC(sizeof(lept_refhdr) + size);
+    h->refs = 1;
+    return h + 1;
 }
 
 
-/*  让 con->json 指针跳过空白区域 whitespace, ws = *(%x20 / %x09 / %x0A / %x0D) */
-void lept_parse_whitespace(lept_context* con)
+void* lept_shared_realloc(void* p, size_t size)
 {
-    const char *p = con->json;
-    while(' ' == *p || '\t' == *p || '\n' == *p || '\r'== *p )
-        p++;
-    con->json = p;
+    lept_refhdr* h = (lept_refhdr*)LEPT_REALLOC((lept_refhdr*)p - 1, sizeof(lept_refhdr) + size);
+    return h + 1;
 }
 
 
-/*  重构，合并代码相似的 null true false 部分 */
-int lept_parse_literal(lept_context* con, lept_value* val, const char* literal, lept_type type)
+void lept_shared_retain(void* p)
 {
-    size_t i = 0;
-    EXPECT(con, literal[0]);
-    /*  literal 是传入的字符串，定长，拿来做 for 的中止条件
-        即判断到字符串结束后跳出循环 */
-    for(i = 0; literal[i+1]; i++)
-    {
-        if(literal[i+1] != con->json[i])
-            return LEPT_PARSE_INVALID_VALUE;
-    }
-    con->json += i;
-    val->type = type;
-    return LEPT_PARSE_OK;
+    LEPT_ATOMIC_INC(&LEPT_REFS(p));
 }
 
 
-int lept_parse_number(lept_context* con, lept_value* val)
+/*  返回 1 表示这是最后一个引用，调用者负责释放子节点和存储 */
+int lept_shared_release(void* p)
 {
-    /*  使用 stdlib.h 函数 strtod()，把字符串转换成 double 的数值
-        double strtod(const char *str, char **endptr)
-        如果 endptr 不为空，则指向转换中最后一个字符后的字符 */
-    /*  使用 errno.h 定义的宏 erron、ERANGE，测试返回值得知数值是否过大 
-        C 库宏 ERANGE 表示一个范围错误
-        它在输入参数超出数学函数定义的范围时发生，errno 被设置为 ERANGE */
-    const char* p;
-    p = con->json;
-    errno = 0;
-    /*  如果文本中的数值是无效数值，则不需要转换 */
-    /*  number = [ "-" ] int [ frac ] [ exp ] */
-    /*  符号部分 */
-    if('+' == *p)
-        return LEPT_PARSE_INVALID_VALUE;
-    if('-' == *p) p++;
-    /*  整数部分 int = "0" / digit1-9 *digit */
-    /*  0 开头只能有且只有 0 */
-    if('0' == *p) p++;
-    else    /*  1-9 开头 */
-    {   
-        if(ISDIGIT1TO9(*p))
-            for(p++; ISDIGIT(*p); p++);
-        else
-            return LEPT_PARSE_INVALID_VALUE; 
-    }
-    /*  小数部分 frac = "." 1*digit */
-    if('.' == *p)
+    return 0 == LEPT_ATOMIC_DEC(&LEPT_REFS(p));
+}
+
+
+void lept_shared_dealloc(void* p)
+{
+    LEPT_FREE((lept_refhdr*)p - 1);
+}
+
+
+/*  字符串、数组、对象的存储地址，其他类型返回 NULL */
+void* lept_storage(const lept_value* val)
+{
+    switch(val->type)
     {
-        p++;
-        if(ISDIGIT(*p))
-            for(p++; ISDIGIT(*p); p++);
-        else
-            return LEPT_PARSE_INVALID_VALUE; 
+        case LEPT_STRING: return val->u.s.str;
+        case LEPT_ARRAY:  return val->u.a.e;
+        case LEPT_OBJECT: return val->u.o.m;
+        default:          return NULL;
     }
-    /*  指数部分 exp = ("e" / "E") ["-" / "+"] 1*digit */
-    if('e' == *p || 'E' == *p)
+}
+
+
+/*  按 val 的存储方式重新分配/释放它的 e/m/str */
+void* lept_data_realloc(const lept_value* val, void* p, size_t size)
+{
+    lept_refhdr* h;
+    assert(!(val->flags & (LEPT_FLAG_POOLED | LEPT_FLAG_BLOCK)));
+    if(val->flags & LEPT_FLAG_SHARED)
+        return lept_shared_realloc(p, size);
+    if(!(val->flags & LEPT_FLAG_ANCHORED))
+        return LEPT_REALLOC(p, size);
+    h = (lept_refhdr*)LEPT_REALLOC((lept_refhdr*)p - 1, sizeof(lept_refhdr) + size);
+    return h + 1;
+}
+
+
+/*  整块内存中的存储只减少整块内存的引用 */
+void lept_data_free(const lept_value* val, void* p)
+{
+    void* block;
+    if(val->flags & LEPT_FLAG_SHARED)
+        lept_shared_dealloc(p);
+    else if(val->flags & (LEPT_FLAG_BLOCK | LEPT_FLAG_ANCHORED))
     {
-        p++;
-        if('+' == *p || '-' == *p) p++;
-        if(ISDIGIT(*p))
-            for(p++; ISDIGIT(*p); p++);
-        else 
-            return LEPT_PARSE_INVALID_VALUE;
+        block = ((lept_refhdr*)p - 1)->p;
+        if(val->flags & LEPT_FLAG_ANCHORED)
+            LEPT_FREE((lept_refhdr*)p - 1);
+        lept_block_release(block);
     }
+    else
+        LEPT_FREE(p);
+}
 
-    /*  把文本中的数值存到 val->u.num 中 */
-    val->u.num = strtod(con->json, NULL);
-
-    /*  如果没有正确的数值转换，则指针位置没有发生变化 
-    if(p == con->json)
-        return LEPT_PARSE_INVALID_VALUE; */
-    
-    /*  如果结果的幅度太大以致于无法表示，则使用 ekkrrno.h 的宏： errno == ERANGE
-        仅使用 errno == ERANGE 判断有可能误判
-        如果这个值真的很大，则会返回 math.h 的宏 HUGE_VAL 或 -HUGE_VAL
-        如果结果的幅度太小，则会返回零值，但 error 可能为 ERANGE，也有可能不为 ERANGE */
-    /*  理论上只 (-)HUGE_VAL == val->u.num 验证过大过小足够 */
-    if(errno == ERANGE && (HUGE_VAL == val->u.num || -HUGE_VAL == val->u.num))
-        return LEPT_PARSE_NUMBER_TOO_BIG;
-        
-    con->json = p;
-    val->type = LEPT_NUMBER;
-    return LEPT_PARSE_OK;
 
+/*  对象 obj 的键：整块内存中的键随整块释放，共享对象的键带引用计数 */
+char* lept_key_alloc(const lept_value* obj, size_t klen)
+{
+    return (obj->flags & LEPT_FLAG_SHARED) ? (char*)lept_shared_alloc(klen + 1) : (char*)LEPT_MALLOC(klen + 1);
 }
 
 
-/* 解析 JSON 字符串，把结果写入 str 和 len */
-/* str 指向 c->stack 中的元素，需要在 c->stack  */
-int lept_parse_string_raw(lept_context* con, char** str, size_t* len) 
+void lept_key_free(const lept_value* obj, char* k)
+{
+    if(obj->flags & (LEPT_FLAG_POOLED | LEPT_FLAG_BLOCK))
+        return;
+    if(!(obj->flags & LEPT_FLAG_SHARED))
+        LEPT_FREE(k);
+    else if(lept_shared_release(k))
+        lept_shared_dealloc(k);
+}
+
+
+/*  把 val 整棵子树转为共享存储，已经是共享存储的子树不再深入 */
+void lept_share_convert(lept_value* val)
+{
+    size_t i = 0;
+    void* p;
+    if(val->flags & LEPT_FLAG_SHARED)
+        return;
+    lept_unpool(val);
+    lept_string_decode(val);
+    switch(val->type)
+    {
+        case LEPT_STRING:
+            memcpy(p = lept_shared_alloc(val->u.s.len + 1), val->u.s.str, val->u.s.len + 1);
+            LEPT_FREE(val->u.s.str);
+            val->u.s.str = (char*)p;
+            val->flags = LEPT_FLAG_SHARED;
+            break;
+        case LEPT_ARRAY:
+            if(val->flags & LEPT_FLAG_PACKED)
+            {
+                memcpy(p = lept_shared_alloc(lept_packed_bytes(val)), val->u.a.e, lept_packed_bytes(val));
+                lept_data_free(val, val->u.a.e);
+                val->u.a.e = (lept_value*)p;
+                val->flags = LEPT_FLAG_SHARED | (val->flags & LEPT_PACKED_MASK);
+                break;
+            }
+            for(i = 0; i < val->u.a.size; i++)
+                lept_share_convert(&val->u.a.e[i]);
+            if(0 == val->u.a.size)
+            {
+                /*  空数组没有需要共享的存储 */
+                lept_data_free(val, val->u.a.e);
+                val->u.a.e = NULL;
+                val->u.a.capacity = 0;
+                val->flags = 0;
+                break;
+            }
+            memcpy(p = lept_shared_alloc(val->u.a.size * sizeof(lept_value)), val->u.a.e, val->u.a.size * sizeof(lept_value));
+            lept_data_free(val, val->u.a.e);
+            val->u.a.e = (lept_value*)p;
+            val->u.a.capacity = val->u.a.size;
+            val->flags = LEPT_FLAG_SHARED;
+            break;
+        case LEPT_OBJECT:
+            for(i = 0; i < val->u.o.size; i++)
+            {
+                lept_member* m = &val->u.o.m[i];
+                lept_share_convert(&m->val);
+                memcpy(p = lept_shared_alloc(m->klen + 1), m->k, m->klen + 1);
+                LEPT_FREE(m->k);
+                m->k = (char*)p;
+            }
+            if(0 == val->u.o.size)
+            {
+                lept_data_free(val, val->u.o.m);
+                val->u.o.m = NULL;
+                val->u.o.capacity = 0;
+                val->flags = 0;
+                break;
+            }
+            memcpy(p = lept_shared_alloc(val->u.o.size * sizeof(lept_member)), val->u.o.m, val->u.o.size * sizeof(lept_member));
+            lept_data_free(val, val->u.o.m);
+            val->u.o.m = (lept_member*)p;
+            val->u.o.capacity = val->u.o.size;
+            val->flags = LEPT_FLAG_SHARED;
+            break;
+        default:
+            break;
+    }
+}
+
+
+void lept_share(lept_value* dst, lept_value* src)
+{
+    lept_value tmp;
+    assert((NULL != dst) && (NULL != src) && (dst != src));
+    lept_share_convert(src);
+    tmp = *src;
+    if(tmp.flags & LEPT_FLAG_SHARED)
+        lept_shared_retain(lept_storage(&tmp));
+    /*  src 可能是 dst 的子节点，先增加引用计数再释放 dst */
+    lept_free(dst);
+    *dst = tmp;
+}
+
+
+/*  dst 引用 src：共享存储增加引用计数，否则深拷贝（只读 src，不修改正被共享的存储） */
+void lept_retain_into(lept_value* dst, const lept_value* src)
+{
+    if(src->flags & LEPT_FLAG_SHARED)
+    {
+        *dst = *src;
+        lept_shared_retain(lept_storage(src));
+    }
+    else
+    {
+        lept_init(dst);
+        lept_copy(dst, src);
+    }
+}
+
+
+/*  写时复制：存储被多个值共享时，只复制这一层，子节点和键增加引用计数 */
+void lept_unshare(lept_value* val)
+{
+    size_t i = 0;
+    lept_value old;
+    assert(NULL != val);
+    /*  紧凑数组没有可以写入的元素，转换回普通数组，转换本身不再共享原存储 */
+    if(LEPT_ARRAY == val->type && (val->flags & LEPT_FLAG_PACKED))
+    {
+        lept_array_unpack(val);
+        return;
+    }
+    if(!(val->flags & LEPT_FLAG_SHARED) || 1 == LEPT_ATOMIC_LOAD(&LEPT_REFS(lept_storage(val))))
+        return;
+    old = *val;
+    switch(val->type)
+    {
+        case LEPT_STRING:
+            memcpy(val->u.s.str = (char*)lept_shared_alloc(old.u.s.len + 1), old.u.s.str, old.u.s.len + 1);
+            break;
+        case LEPT_ARRAY:
+            val->u.a.e = (lept_value*)lept_shared_alloc(old.u.a.size * sizeof(lept_value));
+            val->u.a.capacity = old.u.a.size;
+            for(i = 0; i < old.u.a.size; i++)
+                lept_retain_into(&val->u.a.e[i], &old.u.a.e[i]);
+            break;
+        case LEPT_OBJECT:
+            val->u.o.m = (lept_member*)lept_shared_alloc(old.u.o.size * sizeof(lept_member));
+            val->u.o.capacity = old.u.o.size;
+            for(i = 0; i < old.u.o.size; i++)
+            {
+                lept_member* m = &val->u.o.m[i];
+                m->k = old.u.o.m[i].k;
+                m->klen = old.u.o.m[i].klen;
+                m->khash = old.u.o.m[i].khash;
+                lept_shared_retain(m->k);
+                lept_retain_into(&m->val, &old.u.o.m[i].val);
+            }
+            break;
+        default:
+            break;
+    }
+    /*  释放对原存储的引用 */
+    lept_free(&old);
+}
+
+
+/*  统计拷贝 val 需要的节点数组和字符串的字节数 */
+void lept_copy_measure(const lept_value* val, size_t* node, size_t* data)
+{
+    size_t i = 0;
+    switch(val->type)
+    {
+        case LEPT_STRING:
+            lept_string_decode(val);
+            *data += val->u.s.len + 1;
+            break;
+        case LEPT_ARRAY:
+            if(0 == val->u.a.size)
+                break;
+            *node += sizeof(lept_refhdr);
+            if(val->flags & LEPT_FLAG_PACKED)
+            {
+                *node += lept_packed_bytes(val);
+                break;
+            }
+            *node += val->u.a.size * sizeof(lept_value);
+            for(i = 0; i < val->u.a.size; i++)
+                lept_copy_measure(&val->u.a.e[i], node, data);
+            break;
+        case LEPT_OBJECT:
+            if(0 == val->u.o.size)
+                break;
+            *node += sizeof(lept_refhdr) + val->u.o.size * sizeof(lept_member);
+            for(i = 0; i < val->u.o.size; i++)
+            {
+                *data += val->u.o.m[i].klen + 1;
+                lept_copy_measure(&val->u.o.m[i].val, node, data);
+            }
+            break;
+        default:
+            break;
+    }
+}
+
+
+/*  把 src 拷贝到整块内存 b 中，有存储的节点标记为 LEPT_FLAG_POOLED，容器的存储前面记录整块内存的地址 */
+void lept_copy_value(lept_value* dst, const lept_value* src, lept_block* b)
+{
+    size_t i = 0;
+    *dst = *src;
+    dst->flags = 0;
+    switch(src->type)
+    {
+        case LEPT_STRING:
+            memcpy(dst->u.s.str = b->data, src->u.s.str, src->u.s.len + 1);
+            b->data += src->u.s.len + 1;
+            dst->flags = LEPT_FLAG_POOLED;
+            break;
+        case LEPT_ARRAY:
+            dst->u.a.capacity = src->u.a.size;
+            if(0 == src->u.a.size)
+            {
+                dst->u.a.e = NULL;
+                break;
+            }
+            ((lept_refhdr*)b->node)->p = b->block;
+            b->node += sizeof(lept_refhdr);
+            dst->u.a.e = (lept_value*)b->node;
+            dst->flags = LEPT_FLAG_POOLED;
+            if(src->flags & LEPT_FLAG_PACKED)
+            {
+                memcpy(b->node, src->u.a.e, lept_packed_bytes(src));
+                b->node += lept_packed_bytes(src);
+                dst->flags |= src->flags & LEPT_PACKED_MASK;
+                break;
+            }
+            b->node += src->u.a.size * sizeof(lept_value);
+            for(i = 0; i < src->u.a.size; i++)
+                lept_copy_value(&dst->u.a.e[i], &src->u.a.e[i], b);
+            break;
+        case LEPT_OBJECT:
+            dst->u.o.capacity = src->u.o.size;
+            if(0 == src->u.o.size)
+            {
+                dst->u.o.m = NULL;
+                break;
+            }
+            ((lept_refhdr*)b->node)->p = b->block;
+            b->node += sizeof(lept_refhdr);
+            dst->u.o.m = (lept_member*)b->node;
+            b->node += src->u.o.size * sizeof(lept_member);
+            dst->flags = LEPT_FLAG_POOLED;
+            for(i = 0; i < src->u.o.size; i++)
+            {
+                lept_member* m = &dst->u.o.m[i];
+                memcpy(m->k = b->data, src->u.o.m[i].k, src->u.o.m[i].klen + 1);
+                b->data += src->u.o.m[i].klen + 1;
+                m->klen = src->u.o.m[i].klen;
+                m->khash = src->u.o.m[i].khash;
+                lept_copy_value(&m->val, &src->u.o.m[i].val, b);
+            }
+            break;
+        default:
+            break;
+    }
+}
+
+
+void lept_copy(lept_value* dst, const lept_value* src)
+{
+    size_t node = 0, data = 0;
+    lept_block b;
+    lept_value tmp;
+    assert((NULL != dst) && (NULL != src) && (dst != src));
+    lept_copy_measure(src, &node, &data);
+    if(0 == node)
+    {
+        /*  标量、字符串和空容器不需要整块内存 */
+        tmp = *src;
+        tmp.flags = 0;
+        if(LEPT_STRING == src->type)
+            memcpy(tmp.u.s.str = (char*)LEPT_MALLOC(data), src->u.s.str, data);
+        if(LEPT_ARRAY == src->type || LEPT_OBJECT == src->type)
+        {
+            tmp.u.a.e = NULL;
+            tmp.u.a.capacity = 0;
+        }
+    }
+    else
+    {
+        /*  节点数组放在前面，保证 lept_value/lept_member 对齐
+            整块内存带引用计数，根节点持有一个引用，lept_unpool 复制出来的容器各持有一个 */
+        b.node = (char*)(b.block = lept_shared_alloc(node + data));
+        b.data = b.node + node;
+        lept_copy_value(&tmp, src, &b);
+        tmp.flags = LEPT_FLAG_BLOCK | (tmp.flags & LEPT_PACKED_MASK);
+    }
+    /*  src 可能是 dst 的子节点，所以拷贝完再释放 dst */
+    lept_free(dst);
+    *dst = tmp;
+}
+
+
+/*  把 val 自身的存储从整块内存中复制出来，使它可以单独 realloc/free，子节点不动（对象的键一起复制）
+    还有子节点位于整块内存中时，新存储是 LEPT_FLAG_ANCHORED 的，持有整块内存的一个引用 */
+void lept_unpool(lept_value* val)
+{
+    lept_value old = *val;
+    lept_refhdr* h;
+    void* block;
+    char* p = NULL;
+    size_t i, n, size;
+    int anchored = 0;
+    if(!(val->flags & (LEPT_FLAG_POOLED | LEPT_FLAG_BLOCK)))
+        return;
+    if(LEPT_STRING == val->type)
+    {
+        memcpy(val->u.s.str = (char*)LEPT_MALLOC(old.u.s.len + 1), old.u.s.str, old.u.s.len + 1);
+        val->flags = 0;
+        return;
+    }
+    /*  整块内存中每个容器的存储之前都有一个 lept_refhdr，p 指向整块内存 */
+    if(LEPT_ARRAY == val->type)
+    {
+        block = ((lept_refhdr*)val->u.a.e - 1)->p;
+        n = val->u.a.size;
+        size = (val->flags & LEPT_FLAG_PACKED) ? lept_packed_bytes(val) : n * sizeof(lept_value);
+        for(i = 0; i < n && !(val->flags & LEPT_FLAG_PACKED); i++)
+            anchored |= 0 != (val->u.a.e[i].flags & LEPT_FLAG_POOLED);
+    }
+    else
+    {
+        block = ((lept_refhdr*)val->u.o.m - 1)->p;
+        n = val->u.o.size;
+        size = n * sizeof(lept_member);
+        for(i = 0; i < n; i++)
+            anchored |= 0 != (val->u.o.m[i].val.flags & LEPT_FLAG_POOLED);
+    }
+    if(anchored)
+    {
+        h = (lept_refhdr*)LEPT_MALLOC(sizeof(lept_refhdr) + size);
+        h->p = block;
+        lept_shared_retain(block);
+        p = (char*)(h + 1);
+    }
+    else if(n > 0)
+        p = (char*)LEPT_MALLOC(size);
+    if(n > 0)
+        memcpy(p, lept_storage(&old), size);
+    if(LEPT_ARRAY == val->type)
+    {
+        val->u.a.e = (lept_value*)p;
+        val->u.a.capacity = n;
+    }
+    else
+    {
+        val->u.o.m = (lept_member*)p;
+        val->u.o.capacity = n;
+        for(i = 0; i < n; i++)
+            memcpy(val->u.o.m[i].k = (char*)LEPT_MALLOC(old.u.o.m[i].klen + 1), old.u.o.m[i].k, old.u.o.m[i].klen + 1);
+    }
+    val->flags = (anchored ? LEPT_FLAG_ANCHORED : 0) | (old.flags & LEPT_PACKED_MASK);
+    if(old.flags & LEPT_FLAG_BLOCK)
+        lept_block_release(block);
+}
+
+
+void lept_block_release(void* block)
+{
+    if(lept_shared_release(block))
+        lept_shared_dealloc(block);
+}
+
+
+void lept_move(lept_value* dst, lept_value* src)
+{
+    lept_value tmp;
+    assert((NULL != dst) && (NULL != src) && (dst != src));
+    /*  整块内存中的子节点不能单独转移，先复制出来 */
+    if(src->flags & LEPT_FLAG_POOLED)
+        lept_unpool(src);
+    tmp = *src;
+    lept_init(src);
+    lept_free(dst);
+    *dst = tmp;
+}
+
+
+void lept_swap(lept_value* lhs, lept_value* rhs)
+{
+    lept_value tmp;
+    assert((NULL != lhs) && (NULL != rhs));
+    if(lhs == rhs)
+        return;
+    if(lhs->flags & LEPT_FLAG_POOLED)
+        lept_unpool(lhs);
+    if(rhs->flags & LEPT_FLAG_POOLED)
+        lept_unpool(rhs);
+    memcpy(&tmp, lhs, sizeof(lept_value));
+    memcpy(lhs,  rhs, sizeof(lept_value));
+    memcpy(rhs, &tmp, sizeof(lept_value));
+}
+
+
+int lept_parse_value(lept_context* con, lept_value* val) 
+{
+    switch (*con->json) 
+    {
+        case '\0': 
+            return LEPT_PARSE_EXPECT_VALUE;
+        case 'n':
+            return lept_parse_literal(con, val, "null", LEPT_NULL);
+        case 't':
+            return lept_parse_literal(con, val, "true", LEPT_TRUE);
+        case 'f':
+            return lept_parse_literal(con, val, "false", LEPT_FALSE);
+        case '"':
+            return lept_parse_string(con, val);
+        case '[':
+            return lept_parse_array(con, val);
+        case '{':
+            return lept_parse_object(con, val);
+        default:   
+            return lept_parse_number(con, val);
+            /*  return LEPT_PARSE_INVALID_VALUE; */
+    }
+}
+
+
+/*  解析 JSON 的函数 */
+int lept_parse(lept_value* val, const char* json)
+{
+    return lept_parse_opts(val, json, 0);
+}
+
+
+int lept_parse_opts(lept_value* val, const char* json, unsigned opts)
+{
+    lept_context con;
+    int ret = 0;
+    assert(NULL != val);
+    lept_stream_init(&con, NULL);   /*  初始化栈指针、stack 的容量和位置 */
+    con.opts = opts;
+    ret = lept_parse_with(&con, val, json);
+    LEPT_FREE(con.stack);
+    return ret;
+}
+
+
+#ifdef LEPT_ENABLE_STATS
+int lept_parse_stats(lept_value* val, const char* json, lept_stats* stats)
+{
+    lept_context con;
+    double start = lept_now();
+    int ret;
+    assert(NULL != val && NULL != stats);
+    lept_stream_init(&con, NULL);
+    con.stats = stats;
+    ret = lept_parse_with(&con, val, json);
+    LEPT_FREE(con.stack);
+    stats->parse_ns += lept_now() - start;
+    return ret;
+}
+#endif
+
+
+/*  calloc 也经过 LEPT_MALLOC，保证与 LEPT_FREE 配对 */
+void* lept_calloc(size_t n, size_t size)
+{
+    void* p = LEPT_MALLOC(n * size);
+    if(NULL != p)
+        memset(p, 0, n * size);
+    return p;
+}
+
+
+/*  使用调用者的上下文解析，栈在多次解析之间复用，不释放 */
+int lept_parse_with(lept_context* con, lept_value* val, const char* json)
+{
+    int ret;
+    con->json = json;
+    lept_init(val);
+    lept_parse_whitespace(con);
+    if(LEPT_PARSE_OK == (ret = lept_parse_value(con, val)))
+    {
+        lept_parse_whitespace(con);
+        if('\0' != con->json[0])
+        {
+            lept_free(val);
+            ret = LEPT_PARSE_ROOT_NOT_SINGULAR;
+        }          
+    }    
+
+    assert(0 == con->top); /*  确保栈中的所有数据都被弹出 */
+    return ret;
+}
+
+
+/*  让 con->json 指针跳过空白区域 whitespace, ws = *(%x20 / %x09 / %x0A / %x0D) */
+void lept_parse_whitespace(lept_context* con)
+{
+    const char *p = con->json;
+    while(' ' == *p || '\t' == *p || '\n' == *p || '\r'== *p )
+        p++;
+    con->json = p;
+}
+
+
+/*  重构，合并代码相似的 null true false 部分 */
+int lept_parse_literal(lept_context* con, lept_value* val, const char* literal, lept_type type)
+{
+    size_t i = 0;
+    EXPECT(con, literal[0]);
+    /*  literal 是传入的字符串，定长，拿来做 for 的中止条件
+        即判断到字符串结束后跳出循环 */
+    for(i = 0; literal[i+1]; i++)
+    {
+        if(literal[i+1] != con->json[i])
+            return LEPT_PARSE_INVALID_VALUE;
+    }
+    con->json += i;
+    val->type = type;
+    LEPT_STAT_ADD(con, values[type], 1);
+    return LEPT_PARSE_OK;
+}
+
+
+int lept_parse_number(lept_context* con, lept_value* val)
+{
+    /*  使用 stdlib.h 函数 strtod()，把字符串转换成 double 的数值
+        double strtod(const char *str, char **endptr)
+        如果 endptr 不为空，则指向转换中最后一个字符后的字符 */
+    /*  使用 errno.h 定义的宏 erron、ERANGE，测试返回值得知数值是否过大 
+        C 库宏 ERANGE 表示一个范围错误
+        它在输入参数超出数学函数定义的范围时发生，errno 被设置为 ERANGE */
+    const char *p, *exp = NULL;
+    p = con->json;
+    errno = 0;
+    /*  如果文本中的数值是无效数值，则不需要转换 */
+    /*  number = [ "-" ] int [ frac ] [ exp ] */
+    /*  符号部分 */
+    if('+' == *p)
+        return LEPT_PARSE_INVALID_VALUE;
+    if('-' == *p) p++;
+    /*  整数部分 int = "0" / digit1-9 *digit */
+    /*  0 开头只能有且只有 0 */
+    if('0' == *p) p++;
+    else    /*  1-9 开头 */
+    {   
+        if(ISDIGIT1TO9(*p))
+            for(p++; ISDIGIT(*p); p++);
+        else
+            return LEPT_PARSE_INVALID_VALUE; 
+    }
+    /*  小数部分 frac = "." 1*digit */
+    if('.' == *p)
+    {
+        p++;
+        if(ISDIGIT(*p))
+            for(p++; ISDIGIT(*p); p++);
+        else
+            return LEPT_PARSE_INVALID_VALUE; 
+    }
+    /*  指数部分 exp = ("e" / "E") ["-" / "+"] 1*digit */
+    if('e' == *p || 'E' == *p)
+    {
+        p++;
+        if('+' == *p || '-' == *p) p++;
+        exp = p;
+        if(ISDIGIT(*p))
+            for(p++; ISDIGIT(*p); p++);
+        else 
+            return LEPT_PARSE_INVALID_VALUE;
+    }
+
+    /*  惰性数值只保存原文，不调用 strtod
+        不超过 15 个字符且指数不超过 2 位的数值不会溢出，不需要检查 LEPT_PARSE_NUMBER_TOO_BIG */
+    if((con->opts & LEPT_OPT_LAZY_NUMBERS) && (size_t)(p - con->json) <= sizeof(val->u.n.raw)
+        && (NULL == exp || p - exp <= 2))
+    {
+        memcpy(val->u.n.raw, con->json, p - con->json);
+        val->u.n.len = (unsigned char)(LEPT_NUMBER_PENDING | (p - con->json));
+        con->json = p;
+        val->type = LEPT_NUMBER;
+        LEPT_STAT_ADD(con, values[LEPT_NUMBER], 1);
+        return LEPT_PARSE_OK;
+    }
+
+    /*  把文本中的数值存到 val->u.num 中 */
+    val->u.n.num = strtod(con->json, NULL);
+    val->u.n.len = 0;
+
+    /*  如果没有正确的数值转换，则指针位置没有发生变化 
+    if(p == con->json)
+        return LEPT_PARSE_INVALID_VALUE; */
+    
+    /*  如果结果的幅度太大以致于无法表示，则使用 ekkrrno.h 的宏： errno == ERANGE
+        仅使用 errno == ERANGE 判断有可能误判
+        如果这个值真的很大，则会返回 math.h 的宏 HUGE_VAL 或 -HUGE_VAL
+        如果结果的幅度太小，则会返回零值，但 error 可能为 ERANGE，也有可能不为 ERANGE */
+    /*  理论上只 (-)HUGE_VAL == val->u.num 验证过大过小足够 */
+    if(errno == ERANGE && (HUGE_VAL == val->u.n.num || -HUGE_VAL == val->u.n.num))
+        return LEPT_PARSE_NUMBER_TOO_BIG;
+        
+    con->json = p;
+    val->type = LEPT_NUMBER;
+    LEPT_STAT_ADD(con, values[LEPT_NUMBER], 1);
+    return LEPT_PARSE_OK;
+
+}
+
+
+/* 解析 JSON 字符串，把结果写入 str 和 len */
+/* str 指向 c->stack 中的元素，需要在 c->stack  */
+int lept_parse_string_raw(lept_context* con, char** str, size_t* len) 
 {
     size_t head;
     const char* p;
@@ -288,552 +1401,4434 @@ int lept_parse_string_raw(lept_context* con, char** str, size_t* len)
     p = con->json;
     while(1)
     {
-        ch = *p++; 
-        *len = con->top - head; 
-        switch(ch)
+        ch = *p++; 
+        *len = con->top - head; 
+        switch(ch)
+        {
+            case '\"':
+                /*  pop 函数使 con->stack 指回初入栈时的位置，实现弹栈
+                    同时这个位置是写入到 stack 的字符串的首地址
+                    通过后面的 lept_set_string() 将 stack 的字符串写入到 val->u.s.str 中 */
+                *str = (char*)lept_context_pop(con, *len);
+                if((con->opts & LEPT_OPT_VALIDATE_UTF8) && !lept_utf8_valid(*str, *len))
+                    return LEPT_PARSE_INVALID_UTF8;
+                con->json = p;
+                LEPT_STAT_ADD(con, string_bytes, *len);
+                return LEPT_PARSE_OK;
+            case '\\':
+                LEPT_STAT_ADD(con, escapes, 1);
+                switch (*p++) 
+                {
+                    case '\"': PUTC(con, '\"'); break;
+                    case '\\': PUTC(con, '\\'); break;
+                    case '/':  PUTC(con, '/' ); break;
+                    case 'b':  PUTC(con, '\b'); break;
+                    case 'f':  PUTC(con, '\f'); break;
+                    case 'n':  PUTC(con, '\n'); break;
+                    case 'r':  PUTC(con, '\r'); break;
+                    case 't':  PUTC(con, '\t'); break;
+                    case 'u':
+                        if(!(p = lept_parse_hex4(p, &u)))
+                            STRING_ERROR(LEPT_PARSE_INVALID_UNICODE_HEX);                            
+                        if((u >= 0xD800) && (u <= 0xDBFF)) 
+                        { /* surrogate pair */
+                            if (*p++ != '\\')
+                                STRING_ERROR(LEPT_PARSE_INVALID_UNICODE_SURROGATE);
+                            if (*p++ != 'u')
+                                STRING_ERROR(LEPT_PARSE_INVALID_UNICODE_SURROGATE);
+                            if (!(p = lept_parse_hex4(p, &u2)))
+                                STRING_ERROR(LEPT_PARSE_INVALID_UNICODE_HEX);
+                            if (u2 < 0xDC00 || u2 > 0xDFFF)
+                                STRING_ERROR(LEPT_PARSE_INVALID_UNICODE_SURROGATE);
+                            u = (((u - 0xD800) << 10) | (u2 - 0xDC00)) + 0x10000;
+                        }
+                        lept_encode_utf8(con, u);
+                        break;
+                    default:
+                        /*  无效转义字符部分 */
+                        STRING_ERROR(LEPT_PARSE_INVALID_STRING_ESCAPE);
+                }
+                break;
+            case '\0':
+                STRING_ERROR(LEPT_PARSE_MISS_QUOTATION_MARK);
+            default:
+                /*  不合法字符串部分 */
+                if ((unsigned char)ch < 0x20) 
+                        STRING_ERROR(LEPT_PARSE_INVALID_STRING_CHAR);
+                PUTC(con, ch); /*   每入栈一次，top 大小 +1 */
+        }
+    }
+
+}
+
+
+int lept_parse_string(lept_context* con, lept_value* val) 
+{
+    int ret, escaped = 0;
+    char* sta;
+    const char* str = NULL;
+    size_t len;
+    if(con->opts & LEPT_OPT_LAZY_STRINGS)
+        ret = lept_parse_string_lazy(con, &str, &len, &escaped);
+    else if ((ret = lept_parse_string_raw(con, &sta, &len)) == LEPT_PARSE_OK)
+        str = sta;
+    if (ret == LEPT_PARSE_OK)
+    {
+        lept_set_string(val, str, len);
+        if(escaped)
+            val->flags |= LEPT_FLAG_ESCAPED;
+        LEPT_STAT_ADD(con, values[LEPT_STRING], 1);
+        LEPT_STAT_ADD(con, mallocs, 1);
+        LEPT_STAT_ADD(con, malloc_bytes, len + 1);
+    }
+    return ret;
+}
+
+
+/*  只校验字符串，不解码也不使用栈，str 指向输入中的文本
+    没有转义时是引号之间的内容；有转义时 *escaped 为 1，str 包括两边的引号，供以后 lept_string_decode 解码 */
+int lept_parse_string_lazy(lept_context* con, const char** str, size_t* len, int* escaped)
+{
+    const char* p = con->json + 1;
+    unsigned char ch;
+    unsigned u;
+    assert('"' == *con->json);
+    while('"' != (ch = (unsigned char)*p++))
+    {
+        if('\\' == ch)
+        {
+            *escaped = 1;
+            switch(*p++)
+            {
+                case '\"': case '\\': case '/': case 'b': case 'f': case 'n': case 'r': case 't':
+                    break;
+                case 'u':
+                    if(!(p = lept_parse_hex4(p, &u)))
+                        return LEPT_PARSE_INVALID_UNICODE_HEX;
+                    if(u >= 0xD800 && u <= 0xDBFF)
+                    {
+                        if('\\' != p[0] || 'u' != p[1])
+                            return LEPT_PARSE_INVALID_UNICODE_SURROGATE;
+                        if(!(p = lept_parse_hex4(p + 2, &u)))
+                            return LEPT_PARSE_INVALID_UNICODE_HEX;
+                        if(u < 0xDC00 || u > 0xDFFF)
+                            return LEPT_PARSE_INVALID_UNICODE_SURROGATE;
+                    }
+                    /*  单独的低代理项解码后是代理项的编码，不是有效的 UTF-8 */
+                    else if(u >= 0xDC00 && u <= 0xDFFF && (con->opts & LEPT_OPT_VALIDATE_UTF8))
+                        return LEPT_PARSE_INVALID_UTF8;
+                    break;
+                default:
+                    return LEPT_PARSE_INVALID_STRING_ESCAPE;
+            }
+        }
+        else if('\0' == ch)
+            return LEPT_PARSE_MISS_QUOTATION_MARK;
+        else if(ch < 0x20)
+            return LEPT_PARSE_INVALID_STRING_CHAR;
+    }
+    *str = *escaped ? con->json : con->json + 1;
+    *len = *escaped ? (size_t)(p - con->json) : (size_t)(p - con->json - 2);
+    /*  转义本身都是 ASCII，\u 的码点已在上面检查，校验原文即可 */
+    if((con->opts & LEPT_OPT_VALIDATE_UTF8) && !lept_utf8_valid(*str, *len))
+        return LEPT_PARSE_INVALID_UTF8;
+    LEPT_STAT_ADD(con, string_bytes, *len);
+    con->json = p;
+    return LEPT_PARSE_OK;
+}
+
+
+/*  惰性字符串第一次读取时解码，结果不会比原文长，直接写回原来的存储 */
+void lept_string_decode(const lept_value* val)
+{
+    lept_value* v = (lept_value*)val;
+    lept_context con;
+    char* str;
+    size_t len;
+    if(LEPT_STRING != val->type || !(val->flags & LEPT_FLAG_ESCAPED))
+        return;
+    lept_stream_init(&con, val->u.s.str);
+    if(LEPT_PARSE_OK == lept_parse_string_raw(&con, &str, &len))
+    {
+        memcpy(v->u.s.str, str, len);
+        v->u.s.str[len] = '\0';
+        v->u.s.len = len;
+    }
+    v->flags &= ~LEPT_FLAG_ESCAPED;
+    LEPT_FREE(con.stack);
+}
+
+
+/*  s 开头的 ASCII 字节数（可能少算最后不足一组的几个字节，由调用者逐字节处理）
+    SSE2 每次检查 32 字节，否则每次检查一个 size_t */
+size_t lept_utf8_ascii_prefix(const unsigned char* s, size_t len)
+{
+    size_t i = 0;
+#ifdef LEPT_SSE2
+    for(; i + 32 <= len; i += 32)
+    {
+        __m128i a = _mm_loadu_si128((const __m128i*)(s + i));
+        __m128i b = _mm_loadu_si128((const __m128i*)(s + i + 16));
+        if(0 != _mm_movemask_epi8(_mm_or_si128(a, b)))
+            break;
+    }
+#else
+    const size_t high = ((size_t)-1 / 0xFF) * 0x80;   /*  每个字节的最高位 */
+    size_t w;
+    for(; i + sizeof(size_t) <= len; i += sizeof(size_t))
+    {
+        memcpy(&w, s + i, sizeof(size_t));
+        if(0 != (w & high))
+            break;
+    }
+#endif
+    return i;
+}
+
+
+/*  按 Unicode 标准表 3-7 校验 UTF-8：连续的 ASCII 成组跳过，多字节序列逐个检查
+    第二个字节的范围由首字节决定，以拒绝过长编码（C0、C1、E0 80..9F、F0 80..8F）、
+    代理项（ED A0..BF）和超过 U+10FFFF 的码点（F4 90.. 及 F5..FF） */
+int lept_utf8_valid(const char* str, size_t len)
+{
+    const unsigned char* s = (const unsigned char*)str;
+    const unsigned char* end = s + len;
+    unsigned char c, lo, hi;
+    size_t n;
+    while(s < end)
+    {
+        s += lept_utf8_ascii_prefix(s, (size_t)(end - s));
+        while(s < end && *s < 0x80)
+            s++;
+        if(s == end)
+            break;
+        c = *s++;
+        lo = 0x80;
+        hi = 0xBF;
+        if(c >= 0xC2 && c <= 0xDF)
+            n = 1;
+        else if(c >= 0xE0 && c <= 0xEF)
+        {
+            n = 2;
+            if(0xE0 == c)
+                lo = 0xA0;
+            else if(0xED == c)
+                hi = 0x9F;
+        }
+        else if(c >= 0xF0 && c <= 0xF4)
+        {
+            n = 3;
+            if(0xF0 == c)
+                lo = 0x90;
+            else if(0xF4 == c)
+                hi = 0x8F;
+        }
+        else
+            return 0;
+        if((size_t)(end - s) < n || *s < lo || *s > hi)
+            return 0;
+        for(s++; --n > 0; s++)
+            if((*s & 0xC0) != 0x80)
+                return 0;
+    }
+    return 1;
+}
+
+
+/*  读取字符串中的十六进制字符段并分析成数值 */
+char* lept_parse_hex4(const char *p, unsigned* u)
+{
+    /*  使用 stdlib 函数 strtol() 把字符串转换为数值 
+        long int strtol(const char *str, char **endptr, int base)
+        把参数 str 所指向的字符串根据给定的 base 转换为一个 long int 型数
+        base 为进制数 */
+    char* end;
+    /*  strtol() 会跳过开始的空白，接受 "\u 123" 这种不合法的 JSON
+        所以用 ctype.h 函数 isspace() 首先判断 \u 后面是不是空字符
+        如果是控制符，则返回 true，否则 false */
+    int iss = isspace(*p);
+    if(iss)
+        return NULL;
+    *u = (unsigned)strtol(p, &end, 16);
+    return end == p + 4 ? end : NULL;
+}
+
+
+/*  编码 unicode */
+void lept_encode_utf8(lept_context* con, unsigned u) 
+{
+    if(u <= 0x7F) 
+        PUTC(con, u & 0xFF);
+    else if(u <= 0x7FF) 
+    {
+        PUTC(con, 0xC0 | ((u >> 6) & 0xFF));
+        PUTC(con, 0x80 | ( u       & 0x3F));
+    }
+    else if(u <= 0xFFFF) 
+    {
+        PUTC(con, 0xE0 | ((u >> 12) & 0xFF));
+        PUTC(con, 0x80 | ((u >>  6) & 0x3F));
+        PUTC(con, 0x80 | ( u        & 0x3F));
+    }
+    else
+    {
+        assert(u <= 0x10FFFF);
+        PUTC(con, 0xF0 | ((u >> 18) & 0xFF));
+        PUTC(con, 0x80 | ((u >> 12) & 0x3F));
+        PUTC(con, 0x80 | ((u >>  6) & 0x3F));
+        PUTC(con, 0x80 | ( u        & 0x3F));
+    }
+}
+
+
+/*  解析数组 */
+int lept_parse_array(lept_context* con, lept_value* val)
+{
+
+    size_t size = 0;
+    int i = 0;
+    int ret = 0;
+    EXPECT(con, '[');
+    LEPT_STAT_ENTER(con);
+    lept_parse_whitespace(con);    
+    while(1)
+    {
+        lept_value e;
+        lept_init(&e);
+
+        if(']' == *con->json)
+        {
+            con->json++;
+            val->type = LEPT_ARRAY;
+            val->u.a.size = val->u.a.capacity = size;
+            /*  数组中没有元素 */
+            if(0 == size)
+                val->u.a.e = NULL;
+            /*  有元素 */
+            else if(con->opts & LEPT_OPT_PACK_NUMBERS)
+                lept_array_pack(con, val, size);
+            else 
+            {
+                size *= sizeof(lept_value);
+                memcpy(val->u.a.e = (lept_value*)LEPT_MALLOC(size), lept_context_pop(con, size), size);
+                LEPT_STAT_ADD(con, mallocs, 1);
+                LEPT_STAT_ADD(con, malloc_bytes, size);
+            }
+            LEPT_STAT_ADD(con, values[LEPT_ARRAY], 1);
+            LEPT_STAT_LEAVE(con);
+            return LEPT_PARSE_OK;
+        }
+
+        /*  调用了 lept_parse_value，进行数组当中的其他元素的解析 */
+        if(LEPT_PARSE_OK != (ret = lept_parse_value(con, &e)) )
+            break;
+            
+        /*  入栈申请内存 
+            根据这个元素的类型申请不同长度的内存 
+            然后使用 memcpy 把这个元素复制到这段内存中，完成入栈 */
+        memcpy(lept_context_push(con, sizeof(lept_value)), &e, sizeof(lept_value));
+        size++;
+        lept_parse_whitespace(con);
+        if((',' != *con->json) && (']' != *con->json))
+        {
+            ret = LEPT_PARSE_MISS_COMMA_OR_SQUARE_BRACKET;
+            break;
+        }
+
+        if(',' == *con->json)
+        {
+            con->json++;            
+            lept_parse_whitespace(con);
+        }        
+    }
+
+    for (i = 0; i < size; i++)
+        lept_free((lept_value*)lept_context_pop(con, sizeof(lept_value)));
+
+    LEPT_STAT_LEAVE(con);
+    return ret;
+}
+
+
+/*  解析对象 */
+int lept_parse_object(lept_context* con, lept_value* val)
+{
+    size_t size = 0;
+    int i = 0;
+    int ret = 0;
+    lept_member m;
+    m.k = NULL;
+    EXPECT(con, '{');
+    LEPT_STAT_ENTER(con);
+    lept_parse_whitespace(con);    
+    while(1)
+    {
+        char* str;
+        lept_init(&m.val);
+
+        if('}' == *con->json)
+        {
+            con->json++;
+            val->type = LEPT_OBJECT;
+            val->u.o.size = val->u.o.capacity = size;
+            /*  数组中没有元素 */
+            if(0 == size)
+                val->u.o.m = NULL;
+            /*  有元素 */
+            else 
+            {
+                size *= sizeof(lept_member);
+                memcpy(val->u.o.m = (lept_member*)LEPT_MALLOC(size), lept_context_pop(con, size), size);
+                LEPT_STAT_ADD(con, mallocs, 1);
+                LEPT_STAT_ADD(con, malloc_bytes, size);
+            }
+            LEPT_STAT_ADD(con, values[LEPT_OBJECT], 1);
+            LEPT_STAT_LEAVE(con);
+            return LEPT_PARSE_OK;
+        }
+
+        /*  解析 object，object 是用引号扩着的一串字符串
+            把解析的字符串存到 str 指针指向的区域 */
+        if('"' != *con->json)
+        {
+            ret = LEPT_PARSE_MISS_KEY;
+            break;
+        }
+        if(LEPT_PARSE_OK != (ret = lept_parse_string_raw(con, &str, &m.klen)) )
+            break;
+        /*  复制到 m.k 中，最后放一个 '\0' 表示字符串结束 */
+        memcpy(m.k = (char*)LEPT_MALLOC(m.klen + 1), str, m.klen);
+        m.k[m.klen] = '\0'; 
+        LEPT_STAT_ADD(con, mallocs, 1);
+        LEPT_STAT_ADD(con, malloc_bytes, m.klen + 1);
+        m.khash = lept_hash_key(m.k, m.klen);
+        lept_parse_whitespace(con);
+
+        /*  object 后面必须接着冒号 */
+        if(':' != *con->json)
+        {
+            ret = LEPT_PARSE_MISS_COLON;
+            break;
+        }    
+        con->json++;
+        lept_parse_whitespace(con);
+
+        /*  解析里面的元素 */
+        if(LEPT_PARSE_OK != (ret = lept_parse_value(con, &m.val)) )
+            break;
+        /*  入栈申请内存 
+            根据这个元素的类型申请不同长度的内存 
+            然后使用 memcpy 把这个元素复制到这段内存中，完成入栈 */
+        memcpy(lept_context_push(con, sizeof(lept_member)), &m, sizeof(lept_member));
+        size++;
+        m.k = NULL;
+        lept_parse_whitespace(con);
+        if((',' != *con->json) && ('}' != *con->json))
+        {
+            ret = LEPT_PARSE_MISS_COMMA_OR_CURLY_BRACKET;
+            break;
+        }
+
+        if(',' == *con->json)
+        {
+            con->json++;            
+            lept_parse_whitespace(con);
+        }
+        
+    }
+    LEPT_FREE(m.k);
+    /*  栈中存放的是 lept_member，键和值都要释放 */
+    for (i = 0; i < size; i++)
+    {
+        lept_member* pm = (lept_member*)lept_context_pop(con, sizeof(lept_member));
+        LEPT_FREE(pm->k);
+        lept_free(&pm->val);
+    }
+
+    LEPT_STAT_LEAVE(con);
+    return ret;
+}
+
+
+
+/*  获取 JSON 的数据类型 */
+lept_type lept_get_type(const lept_value* val) 
+{
+    assert(val != NULL);
+    return val->type;
+}
+
+
+/*  boolean part */
+int lept_get_boolean(const lept_value* val)
+{
+    assert((NULL != val) && ((LEPT_TRUE == val->type) || (LEPT_FALSE == val->type)) );
+    /*  判断 LEPT_TRUE ?== val->type 返回 0(false) 还是 1(true) */
+    return (LEPT_TRUE == val->type);
+}
+
+
+void lept_set_boolean(lept_value* val, int boo)
+{
+    assert(NULL != val);
+    lept_free(val);
+    if(boo) val->type = LEPT_TRUE;
+    else val->type = LEPT_FALSE;
+}
+
+
+/*  number part */
+/*  传入 JSON 值的类型，保证类型为 LEPT_NUMBER，才能获取数值 */
+double lept_get_number(const lept_value* val) 
+{
+    assert((NULL != val) && (LEPT_NUMBER == val->type));
+    /*  惰性数值第一次读取时转换，结果缓存在 num 中，原文保留给 lept_stringify */
+    if(val->u.n.len & LEPT_NUMBER_PENDING)
+    {
+        lept_value* v = (lept_value*)val;
+        char buf[sizeof(val->u.n.raw) + 1];
+        size_t len = val->u.n.len & LEPT_NUMBER_LEN_MASK;
+        memcpy(buf, val->u.n.raw, len);
+        buf[len] = '\0';
+        v->u.n.num = strtod(buf, NULL);
+        v->u.n.len = (unsigned char)len;
+    }
+    return val->u.n.num;
+}
+
+
+void lept_set_number(lept_value* val, double num)
+{
+    assert(NULL != val);
+    lept_free(val);
+    val->u.n.num = num;
+    val->u.n.len = 0;
+    val->type = LEPT_NUMBER;
+}
+
+
+/*  string part */
+const char* lept_get_string(const lept_value* val)
+{
+    assert((NULL != val) && (LEPT_STRING == val->type));
+    lept_string_decode(val);
+    return val->u.s.str;
+}
+
+
+size_t lept_get_string_length(const lept_value* val)
+{
+    assert((NULL != val) && (LEPT_STRING == val->type));
+    lept_string_decode(val);
+    return val->u.s.len;
+}
+
+
+/*  设置一个值为字符串，把 str 传入到 val->u.s.str 中 */
+void lept_set_string(lept_value* val, const char* str, size_t len)
+{
+    assert((NULL != val) && ((NULL != str) || (len == 0)) );
+    lept_free(val);
+    val->u.s.str = (char*)LEPT_MALLOC(len + 1);
+    /*  把长度为 len 的字符串 str 复制到 val->u.s.str 中 */
+    if(len > 0)
+        memcpy(val->u.s.str, str, len);
+    val->u.s.len = len;
+    /*  设置最后一位为 '\0' */
+    val->u.s.str[len] = '\0';
+    val->type = LEPT_STRING;
+}
+
+
+/*  array part */
+/*  获取数组中第 index 个元素，紧凑数组没有 lept_value，要先 lept_unshare */
+lept_value* lept_get_array_element(const lept_value* val, size_t index)
+{
+    assert((NULL != val) && (LEPT_ARRAY == val->type));
+    assert(index < val->u.a.size && !(val->flags & LEPT_FLAG_PACKED));
+    return &val->u.a.e[index];
+}
+
+
+/*  只读地获取第 index 个元素，紧凑数组的元素在 tmp 中构造，不修改 val */
+const lept_value* lept_get_array_element_tmp(const lept_value* val, size_t index, lept_value* tmp)
+{
+    assert((NULL != val) && (LEPT_ARRAY == val->type) && (NULL != tmp));
+    assert(index < val->u.a.size);
+    return lept_array_at(val, index, tmp);
+}
+
+
+/*  获取数组中元素的长度 */
+size_t lept_get_array_size(const lept_value* val)
+{
+    assert((NULL != val) && (LEPT_ARRAY == val->type));
+    return val->u.a.size;
+}
+
+
+/*  设置为容量为 capacity 的空数组 */
+void lept_set_array(lept_value* val, size_t capacity)
+{
+    assert(NULL != val);
+    lept_free(val);
+    val->type = LEPT_ARRAY;
+    val->u.a.size = 0;
+    val->u.a.capacity = capacity;
+    val->u.a.e = capacity > 0 ? (lept_value*)LEPT_MALLOC(capacity * sizeof(lept_value)) : NULL;
+}
+
+
+size_t lept_get_array_capacity(const lept_value* val)
+{
+    assert((NULL != val) && (LEPT_ARRAY == val->type));
+    return val->u.a.capacity;
+}
+
+
+/*  容量只增不减，缩小容量使用 lept_shrink_array */
+void lept_reserve_array(lept_value* val, size_t capacity)
+{
+    assert((NULL != val) && (LEPT_ARRAY == val->type));
+    lept_array_unpack(val);
+    if(val->u.a.capacity < capacity)
+    {
+        lept_unpool(val);
+        lept_unshare(val);
+        val->u.a.capacity = capacity;
+        val->u.a.e = (lept_value*)lept_data_realloc(val, val->u.a.e, capacity * sizeof(lept_value));
+    }
+}
+
+
+void lept_shrink_array(lept_value* val)
+{
+    assert((NULL != val) && (LEPT_ARRAY == val->type));
+    lept_array_unpack(val);
+    if(val->u.a.capacity > val->u.a.size)
+    {
+        lept_unshare(val);
+        val->u.a.capacity = val->u.a.size;
+        /*  整块内存中的存储不能单独缩小，只调整容量 */
+        if(val->flags & (LEPT_FLAG_POOLED | LEPT_FLAG_BLOCK))
+            return;
+        if(0 == val->u.a.size)
+        {
+            lept_data_free(val, val->u.a.e);
+            val->u.a.e = NULL;
+            val->flags = 0;
+        }
+        else
+            val->u.a.e = (lept_value*)lept_data_realloc(val, val->u.a.e, val->u.a.size * sizeof(lept_value));
+    }
+}
+
+
+/*  清空元素，不改变容量 */
+void lept_clear_array(lept_value* val)
+{
+    assert((NULL != val) && (LEPT_ARRAY == val->type));
+    lept_erase_array_element(val, 0, val->u.a.size);
+}
+
+
+/*  与解析栈一样按 1.5 倍扩容，保证 pushback 均摊 O(1) */
+size_t lept_grow_capacity(size_t capacity)
+{
+    return capacity < 4 ? 4 : capacity + (capacity >> 1);
+}
+
+
+lept_value* lept_pushback_array_element(lept_value* val)
+{
+    assert((NULL != val) && (LEPT_ARRAY == val->type));
+    lept_array_unpack(val);
+    lept_unshare(val);
+    if(val->u.a.size == val->u.a.capacity)
+        lept_reserve_array(val, lept_grow_capacity(val->u.a.capacity));
+    lept_init(&val->u.a.e[val->u.a.size]);
+    return &val->u.a.e[val->u.a.size++];
+}
+
+
+void lept_popback_array_element(lept_value* val)
+{
+    assert((NULL != val) && (LEPT_ARRAY == val->type) && (val->u.a.size > 0));
+    lept_array_unpack(val);
+    lept_unshare(val);
+    lept_free(&val->u.a.e[--val->u.a.size]);
+}
+
+
+/*  在 index 处插入一个 null 元素，之后的元素整体后移 */
+lept_value* lept_insert_array_element(lept_value* val, size_t index)
+{
+    assert((NULL != val) && (LEPT_ARRAY == val->type) && (index <= val->u.a.size));
+    lept_array_unpack(val);
+    lept_unshare(val);
+    if(val->u.a.size == val->u.a.capacity)
+        lept_reserve_array(val, lept_grow_capacity(val->u.a.capacity));
+    memmove(&val->u.a.e[index + 1], &val->u.a.e[index], (val->u.a.size - index) * sizeof(lept_value));
+    val->u.a.size++;
+    lept_init(&val->u.a.e[index]);
+    return &val->u.a.e[index];
+}
+
+
+void lept_erase_array_element(lept_value* val, size_t index, size_t count)
+{
+    size_t i = 0;
+    assert((NULL != val) && (LEPT_ARRAY == val->type) && (index + count <= val->u.a.size));
+    if(0 == count)
+        return;
+    lept_array_unpack(val);
+    lept_unshare(val);
+    for(i = index; i < index + count; i++)
+        lept_free(&val->u.a.e[i]);
+    memmove(&val->u.a.e[index], &val->u.a.e[index + count], (val->u.a.size - index - count) * sizeof(lept_value));
+    val->u.a.size -= count;
+}
+
+
+/*  紧凑数组 */
+size_t lept_packed_bytes(const lept_value* val)
+{
+    return val->u.a.size * ((val->flags & LEPT_FLAG_PACKED_INT64) ? sizeof(int64_t) : sizeof(double));
+}
+
+
+/*  栈顶的 size 个元素都是数值时，把它们写入紧凑的存储，否则按普通数组出栈
+    数值元素没有单独分配的存储，出栈后不需要释放 */
+void lept_array_pack(lept_context* con, lept_value* val, size_t size)
+{
+    lept_value* e = (lept_value*)(con->stack + con->top - size * sizeof(lept_value));
+    size_t i;
+    int integral = 1;
+    double num;
+    for(i = 0; i < size; i++)
+    {
+        if(LEPT_NUMBER != e[i].type)
+        {
+            size *= sizeof(lept_value);
+            memcpy(val->u.a.e = (lept_value*)LEPT_MALLOC(size), lept_context_pop(con, size), size);
+            LEPT_STAT_ADD(con, mallocs, 1);
+            LEPT_STAT_ADD(con, malloc_bytes, size);
+            return;
+        }
+        num = lept_get_number(&e[i]);
+        if(integral && !lept_is_integer(num))
+            integral = 0;
+    }
+    if(integral)
+    {
+        int64_t* p = (int64_t*)LEPT_MALLOC(size * sizeof(int64_t));
+        for(i = 0; i < size; i++)
+            p[i] = (int64_t)e[i].u.n.num;
+        val->u.a.e = (lept_value*)p;
+        val->flags = LEPT_FLAG_PACKED | LEPT_FLAG_PACKED_INT64;
+    }
+    else
+    {
+        double* p = (double*)LEPT_MALLOC(size * sizeof(double));
+        for(i = 0; i < size; i++)
+            p[i] = e[i].u.n.num;
+        val->u.a.e = (lept_value*)p;
+        val->flags = LEPT_FLAG_PACKED;
+    }
+    lept_context_pop(con, size * sizeof(lept_value));
+    LEPT_STAT_ADD(con, mallocs, 1);
+    LEPT_STAT_ADD(con, malloc_bytes, lept_packed_bytes(val));
+}
+
+
+/*  紧凑数组转换回普通数组，释放（或减少引用）原来的存储，其他值不受影响 */
+void lept_array_unpack(lept_value* val)
+{
+    lept_value* v = val;
+    lept_value old = *val;
+    size_t i;
+    if(LEPT_ARRAY != val->type || !(val->flags & LEPT_FLAG_PACKED))
+        return;
+    v->u.a.e = (lept_value*)LEPT_MALLOC(old.u.a.size * sizeof(lept_value));
+    v->u.a.capacity = old.u.a.size;
+    v->flags = 0;
+    for(i = 0; i < old.u.a.size; i++)
+        lept_array_at(&old, i, &v->u.a.e[i]);
+    if(old.flags & LEPT_FLAG_SHARED)
+    {
+        if(lept_shared_release(old.u.a.e))
+            lept_shared_dealloc(old.u.a.e);
+    }
+    else if(!(old.flags & LEPT_FLAG_POOLED))
+        lept_data_free(&old, old.u.a.e);
+}
+
+
+/*  数组的第 index 个元素；紧凑数组没有 lept_value，在 tmp 中构造这个数值 */
+const lept_value* lept_array_at(const lept_value* val, size_t index, lept_value* tmp)
+{
+    if(!(val->flags & LEPT_FLAG_PACKED))
+        return &val->u.a.e[index];
+    tmp->type = LEPT_NUMBER;
+    tmp->flags = 0;
+    tmp->u.n.num = (val->flags & LEPT_FLAG_PACKED_INT64) ? (double)((const int64_t*)val->u.a.e)[index]
+                                                         : ((const double*)val->u.a.e)[index];
+    tmp->u.n.len = 0;
+    return tmp;
+}
+
+
+int lept_get_array_packing(const lept_value* val)
+{
+    assert((NULL != val) && (LEPT_ARRAY == val->type));
+    if(!(val->flags & LEPT_FLAG_PACKED))
+        return LEPT_PACKED_NONE;
+    return (val->flags & LEPT_FLAG_PACKED_INT64) ? LEPT_PACKED_INT64 : LEPT_PACKED_DOUBLE;
+}
+
+
+const double* lept_get_array_numbers(const lept_value* val, size_t* count)
+{
+    assert(NULL != count);
+    if(LEPT_PACKED_DOUBLE != lept_get_array_packing(val))
+        return NULL;
+    *count = val->u.a.size;
+    return (const double*)val->u.a.e;
+}
+
+
+const int64_t* lept_get_array_int64(const lept_value* val, size_t* count)
+{
+    assert(NULL != count);
+    if(LEPT_PACKED_INT64 != lept_get_array_packing(val))
+        return NULL;
+    *count = val->u.a.size;
+    return (const int64_t*)val->u.a.e;
+}
+
+
+/*  object part */
+/*  获取第 index 个 member 的值 */
+lept_value* lept_get_object_value(const lept_value* val, size_t index)
+{
+    assert((NULL != val) && (LEPT_OBJECT == val->type));
+    assert(index < val->u.o.size);
+    return &val->u.o.m[index].val;
+}
+
+/*  得到第 index 个 member 的标题 */
+const char* lept_get_object_key(const lept_value* val, size_t index)
+{
+    assert((NULL != val) && (LEPT_OBJECT == val->type));
+    assert(index < val->u.o.size);
+    return val->u.o.m[index].k;
+}
+
+/*  返回第 index 个 member 的长度 */
+size_t lept_get_object_key_length(const lept_value* val, size_t index)
+{
+    assert((NULL != val) && (LEPT_OBJECT == val->type));
+    assert(index < val->u.o.size);
+    return val->u.o.m[index].klen;
+}
+
+/*  返回 object 的整体长度 */
+size_t lept_get_object_size(const lept_value* val)
+{
+    assert((NULL != val) && (LEPT_OBJECT == val->type));
+    return val->u.o.size;
+}
+
+
+void lept_set_object(lept_value* val, size_t capacity)
+{
+    assert(NULL != val);
+    lept_free(val);
+    val->type = LEPT_OBJECT;
+    val->u.o.size = 0;
+    val->u.o.capacity = capacity;
+    val->u.o.m = capacity > 0 ? (lept_member*)LEPT_MALLOC(capacity * sizeof(lept_member)) : NULL;
+}
+
+
+size_t lept_get_object_capacity(const lept_value* val)
+{
+    assert((NULL != val) && (LEPT_OBJECT == val->type));
+    return val->u.o.capacity;
+}
+
+
+void lept_reserve_object(lept_value* val, size_t capacity)
+{
+    assert((NULL != val) && (LEPT_OBJECT == val->type));
+    if(val->u.o.capacity < capacity)
+    {
+        lept_unpool(val);
+        lept_unshare(val);
+        val->u.o.capacity = capacity;
+        val->u.o.m = (lept_member*)lept_data_realloc(val, val->u.o.m, capacity * sizeof(lept_member));
+    }
+}
+
+
+void lept_shrink_object(lept_value* val)
+{
+    assert((NULL != val) && (LEPT_OBJECT == val->type));
+    if(val->u.o.capacity > val->u.o.size)
+    {
+        lept_unshare(val);
+        val->u.o.capacity = val->u.o.size;
+        if(val->flags & (LEPT_FLAG_POOLED | LEPT_FLAG_BLOCK))
+            return;
+        if(0 == val->u.o.size)
+        {
+            lept_data_free(val, val->u.o.m);
+            val->u.o.m = NULL;
+            val->flags = 0;
+        }
+        else
+            val->u.o.m = (lept_member*)lept_data_realloc(val, val->u.o.m, val->u.o.size * sizeof(lept_member));
+    }
+}
+
+
+void lept_clear_object(lept_value* val)
+{
+    size_t i = 0;
+    assert((NULL != val) && (LEPT_OBJECT == val->type));
+    lept_unshare(val);
+    for(i = 0; i < val->u.o.size; i++)
+    {
+        lept_key_free(val, val->u.o.m[i].k);
+        lept_free(&val->u.o.m[i].val);
+    }
+    val->u.o.size = 0;
+}
+
+
+/*  键的哈希：FNV-1a */
+unsigned lept_hash_key(const char* key, size_t klen)
+{
+    unsigned h = 2166136261u;
+    size_t i = 0;
+    for(i = 0; i < klen; i++)
+    {
+        h ^= (unsigned char)key[i];
+        h *= 16777619u;
+    }
+    return h & 0xFFFFFFFFu;
+}
+
+
+/*  线性查找键，先比较缓存的哈希值，相同时才 memcmp */
+size_t lept_find_member(const lept_value* val, const char* key, size_t klen, unsigned khash)
+{
+    size_t i = 0;
+    const lept_member* m = val->u.o.m;
+    for(i = 0; i < val->u.o.size; i++)
+        if(m[i].khash == khash && m[i].klen == klen && 0 == memcmp(m[i].k, key, klen))
+            return i;
+    return LEPT_KEY_NOT_EXIST;
+}
+
+
+/*  找不到返回 LEPT_KEY_NOT_EXIST */
+size_t lept_find_object_index(const lept_value* val, const char* key, size_t klen)
+{
+    assert((NULL != val) && (LEPT_OBJECT == val->type) && (NULL != key));
+    return lept_find_member(val, key, klen, lept_hash_key(key, klen));
+}
+
+
+lept_value* lept_find_object_value(const lept_value* val, const char* key, size_t klen)
+{
+    size_t index = lept_find_object_index(val, key, klen);
+    return index != LEPT_KEY_NOT_EXIST ? &val->u.o.m[index].val : NULL;
+}
+
+
+lept_value* lept_set_object_value(lept_value* val, const char* key, size_t klen)
+{
+    size_t index = 0;
+    unsigned khash;
+    lept_member* m;
+    assert((NULL != val) && (LEPT_OBJECT == val->type) && (NULL != key));
+    /*  返回的值可以直接写入，所以共享的对象也要先复制这一层 */
+    lept_unshare(val);
+    khash = lept_hash_key(key, klen);
+    if(LEPT_KEY_NOT_EXIST != (index = lept_find_member(val, key, klen, khash)))
+        return &val->u.o.m[index].val;
+    /*  整块内存中的对象的键不能单独释放，新增键之前先复制出来 */
+    lept_unpool(val);
+    if(val->u.o.size == val->u.o.capacity)
+        lept_reserve_object(val, lept_grow_capacity(val->u.o.capacity));
+    m = &val->u.o.m[val->u.o.size++];
+    memcpy(m->k = lept_key_alloc(val, klen), key, klen);
+    m->k[klen] = '\0';
+    m->klen = klen;
+    m->khash = khash;
+    lept_init(&m->val);
+    return &m->val;
+}
+
+
+/*  删除第 index 个成员，之后的成员整体前移，保持原有顺序 */
+void lept_remove_object_value(lept_value* val, size_t index)
+{
+    assert((NULL != val) && (LEPT_OBJECT == val->type) && (index < val->u.o.size));
+    lept_unshare(val);
+    lept_key_free(val, val->u.o.m[index].k);
+    lept_free(&val->u.o.m[index].val);
+    memmove(&val->u.o.m[index], &val->u.o.m[index + 1], (val->u.o.size - index - 1) * sizeof(lept_member));
+    val->u.o.size--;
+}
+
+
+/*  比较 */
+int lept_is_equal(const lept_value* lhs, const lept_value* rhs)
+{
+    lept_context con;
+    int ret;
+    assert((NULL != lhs) && (NULL != rhs));
+    lept_stream_init(&con, NULL);
+    ret = lept_is_equal_with(&con, lhs, rhs);
+    lept_stream_free(&con);
+    return ret;
+}
+
+
+/*  比较对象时的临时数据放在 con 的栈中，不占用 C 栈 */
+int lept_is_equal_with(lept_context* con, const lept_value* lhs, const lept_value* rhs)
+{
+    size_t i = 0;
+    lept_value ta, tb;
+    if(lhs == rhs)
+        return 1;
+    if(lhs->type != rhs->type)
+        return 0;
+    /*  共享同一存储的值一定相等 */
+    if((lhs->flags & rhs->flags & LEPT_FLAG_SHARED) && lept_storage(lhs) == lept_storage(rhs))
+        return 1;
+    switch(lhs->type)
+    {
+        case LEPT_STRING:
+            lept_string_decode(lhs);
+            lept_string_decode(rhs);
+            return lhs->u.s.len == rhs->u.s.len &&
+                0 == memcmp(lhs->u.s.str, rhs->u.s.str, lhs->u.s.len);
+        case LEPT_NUMBER:
+            return lept_get_number(lhs) == lept_get_number(rhs);
+        case LEPT_ARRAY:
+            if(lhs->u.a.size != rhs->u.a.size)
+                return 0;
+            for(i = 0; i < lhs->u.a.size; i++)
+                if(!lept_is_equal_with(con, lept_array_at(lhs, i, &ta), lept_array_at(rhs, i, &tb)))
+                    return 0;
+            return 1;
+        case LEPT_OBJECT:
+            if(lhs->u.o.size != rhs->u.o.size)
+                return 0;
+            return lept_is_equal_object(con, lhs, rhs);
+        default:
+            return 1;
+    }
+}
+
+
+/*  两个对象大小相同，逐个在 rhs 中找一个没有用过的、键和值都相等的成员，所以有重复的键时也是对称的
+    多数对象成员顺序相同，先试同一位置；第一次不同时才开始记录用过的成员，
+    小对象线性查找，大对象建立哈希索引；used、slots 是 con 栈中的偏移，递归比较可能让栈重新分配 */
+int lept_is_equal_object(lept_context* con, const lept_value* lhs, const lept_value* rhs)
+{
+    size_t n = rhs->u.o.size, head = con->top, slots = 0, used = 0, mask = 0, i, j, h, skip;
+    int ret = 1, tracking = 0;
+    const lept_member *a, *b;
+#define LEPT_EQUAL_SLOT(h) (((size_t*)(con->stack + slots))[h])
+#define LEPT_EQUAL_USED(j) ((con->stack + used)[j])
+    for(i = 0; i < lhs->u.o.size && ret; i++)
+    {
+        a = &lhs->u.o.m[i];
+        b = &rhs->u.o.m[i];
+        skip = LEPT_KEY_NOT_EXIST;
+        if(a->khash == b->khash && a->klen == b->klen && 0 == memcmp(a->k, b->k, a->klen) &&
+           (!tracking || !LEPT_EQUAL_USED(i)))
+        {
+            if(lept_is_equal_with(con, &a->val, &b->val))
+            {
+                if(tracking)
+                    LEPT_EQUAL_USED(i) = 1;
+                continue;
+            }
+            skip = i;
+        }
+        if(!tracking)
+        {
+            /*  之前的成员都是按位置匹配的 */
+            tracking = 1;
+            if(n > LEPT_EQUAL_INDEX_THRESHOLD)
+            {
+                /*  槽数取不小于成员数两倍的 2 的幂，存放 rhs 成员下标 + 1，0 表示空槽 */
+                for(mask = 1; mask < n * 2; mask <<= 1);
+                slots = con->top;
+                memset(lept_context_push(con, mask * sizeof(size_t)), 0, mask * sizeof(size_t));
+                mask--;
+                for(j = 0; j < n; j++)
+                {
+                    for(h = rhs->u.o.m[j].khash & mask; LEPT_EQUAL_SLOT(h); h = (h + 1) & mask);
+                    LEPT_EQUAL_SLOT(h) = j + 1;
+                }
+            }
+            /*  补齐到 size_t 的倍数，嵌套的对象的 slots 仍然是对齐的 */
+            used = con->top;
+            h = (n + sizeof(size_t) - 1) / sizeof(size_t) * sizeof(size_t);
+            memset(lept_context_push(con, h), 0, h);
+            memset(con->stack + used, 1, i);
+        }
+        ret = 0;
+        if(0 == mask)
+        {
+            for(j = 0; j < n && !ret; j++)
+            {
+                b = &rhs->u.o.m[j];
+                ret = j != skip && !LEPT_EQUAL_USED(j) && a->khash == b->khash && a->klen == b->klen &&
+                      0 == memcmp(a->k, b->k, a->klen) && lept_is_equal_with(con, &a->val, &b->val);
+            }
+        }
+        else
+        {
+            for(h = a->khash & mask; LEPT_EQUAL_SLOT(h) && !ret; h = (h + 1) & mask)
+            {
+                j = LEPT_EQUAL_SLOT(h);
+                b = &rhs->u.o.m[j - 1];
+                ret = j - 1 != skip && !LEPT_EQUAL_USED(j - 1) && a->khash == b->khash && a->klen == b->klen &&
+                      0 == memcmp(a->k, b->k, a->klen) && lept_is_equal_with(con, &a->val, &b->val);
+            }
+        }
+        if(ret)
+            LEPT_EQUAL_USED(j - 1) = 1;
+    }
+#undef LEPT_EQUAL_SLOT
+#undef LEPT_EQUAL_USED
+    con->top = head;
+    return ret;
+}
+
+
+/*  与 boost::hash_combine 相同的混合方式 */
+size_t lept_hash_combine(size_t seed, size_t h)
+{
+    return seed ^ (h + (size_t)0x9e3779b9u + (seed << 6) + (seed >> 2));
+}
+
+
+size_t lept_hash(const lept_value* val)
+{
+    size_t i = 0, h = 0;
+    double num;
+    lept_value tmp;
+    assert(NULL != val);
+    switch(val->type)
+    {
+        case LEPT_NUMBER:
+            /*  -0 == 0，哈希前统一为 0 */
+            num = lept_get_number(val);
+            num = num == 0.0 ? 0.0 : num;
+            return lept_hash_combine(LEPT_NUMBER, lept_hash_key((const char*)&num, sizeof(num)));
+        case LEPT_STRING:
+            lept_string_decode(val);
+            return lept_hash_combine(LEPT_STRING, lept_hash_key(val->u.s.str, val->u.s.len));
+        case LEPT_ARRAY:
+            h = lept_hash_combine(LEPT_ARRAY, val->u.a.size);
+            for(i = 0; i < val->u.a.size; i++)
+                h = lept_hash_combine(h, lept_hash(lept_array_at(val, i, &tmp)));
+            return h;
+        case LEPT_OBJECT:
+            /*  成员哈希相加，与顺序无关 */
+            for(i = 0; i < val->u.o.size; i++)
+                h += lept_hash_combine(val->u.o.m[i].khash, lept_hash(&val->u.o.m[i].val));
+            return lept_hash_combine(lept_hash_combine(LEPT_OBJECT, val->u.o.size), h);
+        default:
+            return lept_hash_combine(val->type, 0);
+    }
+}
+
+
+/*  生成器 */
+/*  把生成的树值写道 *json */
+char* lept_stringify(const lept_value* val, size_t* length)
+{
+    lept_context con;
+    assert(NULL != val);
+    lept_stream_init(&con, NULL);
+    con.size = LEPT_PARSE_STRINGIFY_INIT_SIZE;
+    con.stack = (char*)LEPT_MALLOC(con.size);
+    lept_stringify_value(&con, val);
+    if(length)
+        *length = con.top;
+    /*  在生成的值后面添加空白符作为结尾 */
+    PUTC(&con, '\0');
+    return con.stack;
+}
+
+
+#ifdef LEPT_ENABLE_STATS
+char* lept_stringify_stats(const lept_value* val, size_t* length, lept_stats* stats)
+{
+    lept_context con;
+    double start = lept_now();
+    assert(NULL != val && NULL != stats);
+    lept_stream_init(&con, NULL);
+    con.stats = stats;
+    con.size = LEPT_PARSE_STRINGIFY_INIT_SIZE;
+    con.stack = (char*)LEPT_MALLOC(con.size);
+    lept_stringify_value(&con, val);
+    if(length)
+        *length = con.top;
+    PUTC(&con, '\0');
+    stats->stringify_ns += lept_now() - start;
+    return con.stack;
+}
+#endif
+
+
+void lept_stringify_value(lept_context*con, const lept_value* val)
+{
+    LEPT_STAT_ADD(con, values[val->type], 1);
+    switch(val->type)
+    {
+        case LEPT_NULL:
+            PUTS(con, "null", 4);
+            break;
+        case LEPT_TRUE:
+            PUTS(con, "true", 4);
+            break;
+        case LEPT_FALSE:
+            PUTS(con, "false", 5);
+            break;    
+        case LEPT_NUMBER:
+            /*  stdio.h 函数 sprintf，将 val->u.num 格式化输出到 buf (con.stack)
+                如果成功，则返回写入的字符总数 */
+            /*  惰性数值原样输出原文 */
+            if(val->u.n.len & LEPT_NUMBER_LEN_MASK)
+                PUTS(con, val->u.n.raw, val->u.n.len & LEPT_NUMBER_LEN_MASK);
+            else
+                lept_stream_put_number(con, val->u.n.num);
+            break;
+        case LEPT_STRING:
+            /*  未解码的惰性字符串本身就是合法的 JSON 字符串，原样输出 */
+            if(val->flags & LEPT_FLAG_ESCAPED)
+                PUTS(con, val->u.s.str, val->u.s.len);
+            else
+                lept_stringify_string(con, val->u.s.str, val->u.s.len);
+            break;      
+        case LEPT_ARRAY:
+            lept_stringify_array(con, val);
+            break;
+        case LEPT_OBJECT:
+            lept_stringify_object(con, val);
+            break;
+        default:
+            assert(0 && "invalid type");
+            break;
+    }
+}
+
+#if 0
+/*  代替多次使用 PUTS 的版本，优化性能 */
+void lept_stringify_string(lept_context* con, const char* s, size_t len)
+{
+    size_t i = 0;
+    unsigned char ch;
+    assert(NULL != s);
+    PUTC(con, '"');
+    for(i = 0; i < len; i++)
+    {
+        ch = (unsigned char)s[i];
+        switch(ch)
+        {
+            case '\"': PUTS(con, "\\\"", 2); break;
+            case '\\': PUTS(con, "\\\\", 2); break;
+            case '\b': PUTS(con, "\\b",  2); break;
+            case '\f': PUTS(con, "\\f",  2); break;
+            case '\n': PUTS(con, "\\n",  2); break;
+            case '\r': PUTS(con, "\\r",  2); break;
+            case '\t': PUTS(con, "\\t",  2); break;
+            default:
+                if (ch < 0x20) {
+                    char buf[7];
+                    sprintf(buf, "\\u%04X", ch);
+                    PUTS(con, buf, 6);
+                }
+                else
+                    PUTC(con, s[i]);
+        }
+    }
+    PUTC(con, '"');
+}
+
+#else
+void lept_stringify_string(lept_context* con, const char* s, size_t len)
+{
+    static const char hex_digits[] = 
+        { '0', '1', '2', '3', '4', '5', '6', '7', '8', '9', 'A', 'B', 'C', 'D', 'E', 'F' };
+    size_t i = 0, size = 0;
+    char *p, *head;
+    unsigned char ch;
+    assert(NULL != s);
+    /*  每个字符可生成最长的形式是 \u00XX，占 6 个字符
+        再加上前后两个双引号，也就是共 len * 6 + 2 个输出字符 */
+    p = head = lept_context_push(con, size = len * 6 + 2);
+    LEPT_STAT_ADD(con, string_bytes, len);
+    *p++ = '"';
+    for(i = 0; i < len; i++)
+    {
+        ch = (unsigned char)s[i];
+        if(ch < 0x20 || '"' == ch || '\\' == ch)
+            LEPT_STAT_ADD(con, escapes, 1);
+        switch(ch)
+        {
+            case '\"': *p++ = '\\'; *p++ = '\"'; break;
+            case '\\': *p++ = '\\'; *p++ = '\\'; break;
+            case '\b': *p++ = '\\'; *p++ = 'b';  break;
+            case '\f': *p++ = '\\'; *p++ = 'f';  break;
+            case '\n': *p++ = '\\'; *p++ = 'n';  break;
+            case '\r': *p++ = '\\'; *p++ = 'r';  break;
+            case '\t': *p++ = '\\'; *p++ = 't';  break;
+            default:
+                if (ch < 0x20) {
+                    *p++ = '\\'; *p++ = 'u'; *p++ = '0'; *p++ = '0';
+                    *p++ = hex_digits[ch >> 4];
+                    *p++ = hex_digits[ch & 15];
+                }
+                else
+                    *p++ = s[i];
+        }
+    }
+    *p++ = '"';
+    con->top -= size - (p - head); 
+
+}
+#endif
+
+
+void lept_stringify_array(lept_context* con, const lept_value* val)
+{
+    assert(NULL != val);
+    LEPT_STAT_ENTER(con);
+    PUTC(con, '[');
+    lept_stringify_range(con, val, 0, val->u.a.size);
+    PUTC(con, ']');
+    LEPT_STAT_LEAVE(con);
+
+}
+
+
+void lept_stringify_object(lept_context* con, const lept_value* val)
+{
+    assert(NULL != val);
+    LEPT_STAT_ENTER(con);
+    PUTC(con, '{');
+    lept_stringify_range(con, val, 0, val->u.o.size);
+    PUTC(con, '}');
+    LEPT_STAT_LEAVE(con);
+
+}
+
+
+/*  生成数组的第 [first, last) 个元素或对象的第 [first, last) 个成员，不含括号
+    first > 0 时以逗号开头，所以相邻的几段直接拼接就是完整的内容 */
+void lept_stringify_range(lept_context* con, const lept_value* val, size_t first, size_t last)
+{
+    size_t i;
+    lept_value tmp;
+    for(i = first; i < last; i++)
+    {
+        if(i > 0) PUTC(con, ',');
+        if(LEPT_ARRAY == val->type)
+            lept_stringify_value(con, lept_array_at(val, i, &tmp));
+        else
+        {
+            lept_stringify_string(con, val->u.o.m[i].k, val->u.o.m[i].klen);
+            PUTC(con, ':');
+            lept_stringify_value(con, &val->u.o.m[i].val);
+        }
+    }
+}
+
+
+/*  lept_stream */
+void lept_stream_init(lept_stream* s, const char* json)
+{
+    assert(NULL != s);
+    s->json = json;
+    s->stack = NULL;
+    s->size = s->top = 0;
+    s->opts = 0;
+    s->stats = NULL;
+    s->depth = 0;
+}
+
+
+void lept_stream_free(lept_stream* s)
+{
+    assert(NULL != s);
+    LEPT_FREE(s->stack);
+    s->stack = NULL;
+    s->size = s->top = 0;
+}
+
+
+void lept_stream_whitespace(lept_stream* s)
+{
+    lept_parse_whitespace(s);
+}
+
+
+/*  下一个字符是另一种类型的值的开头 */
+int lept_stream_mismatch(const lept_stream* s)
+{
+    return NULL != strchr("\"[{tfn-0123456789", s->json[0]) && '\0' != s->json[0];
+}
+
+
+int lept_stream_number(lept_stream* s, double* num)
+{
+    lept_value v;
+    int ret;
+    assert((NULL != s) && (NULL != num));
+    if('-' != s->json[0] && !ISDIGIT(s->json[0]))
+        return lept_stream_mismatch(s) ? LEPT_PARSE_SCHEMA_MISMATCH : LEPT_PARSE_INVALID_VALUE;
+    lept_init(&v);
+    if(LEPT_PARSE_OK == (ret = lept_parse_number(s, &v)))
+        *num = lept_get_number(&v);
+    return ret;
+}
+
+
+int lept_stream_boolean(lept_stream* s, int* b)
+{
+    lept_value v;
+    int ret;
+    assert((NULL != s) && (NULL != b));
+    if('t' != s->json[0] && 'f' != s->json[0])
+        return lept_stream_mismatch(s) ? LEPT_PARSE_SCHEMA_MISMATCH : LEPT_PARSE_INVALID_VALUE;
+    lept_init(&v);
+    if(LEPT_PARSE_OK == (ret = lept_parse_literal(s, &v, 't' == s->json[0] ? "true" : "false",
+                                                  't' == s->json[0] ? LEPT_TRUE : LEPT_FALSE)))
+        *b = LEPT_TRUE == v.type;
+    return ret;
+}
+
+
+int lept_stream_string(lept_stream* s, const char** str, size_t* len)
+{
+    char* p;
+    int ret;
+    assert((NULL != s) && (NULL != str) && (NULL != len));
+    if('"' != s->json[0])
+        return lept_stream_mismatch(s) ? LEPT_PARSE_SCHEMA_MISMATCH : LEPT_PARSE_INVALID_VALUE;
+    if(LEPT_PARSE_OK == (ret = lept_parse_string_raw(s, &p, len)))
+        *str = p;
+    return ret;
+}
+
+
+/*  与 lept_parse_array/lept_parse_object 的语法相同，但元素不入栈，字符串只校验不解码 */
+int lept_stream_skip(lept_stream* s)
+{
+    lept_value v;
+    const char* str;
+    size_t len = 0;
+    int ret, escaped = 0;
+    char close;
+    assert(NULL != s);
+    if('[' != s->json[0] && '{' != s->json[0])
+    {
+        if('"' == s->json[0])
+            return lept_parse_string_lazy(s, &str, &len, &escaped);
+        lept_init(&v);
+        ret = lept_parse_value(s, &v);
+        assert(LEPT_STRING != v.type && LEPT_ARRAY != v.type && LEPT_OBJECT != v.type);
+        return ret;
+    }
+    close = '[' == s->json[0] ? ']' : '}';
+    s->json++;
+    lept_parse_whitespace(s);
+    if(close == s->json[0])
+    {
+        s->json++;
+        return LEPT_PARSE_OK;
+    }
+    for(;;)
+    {
+        if('}' == close)
+        {
+            if('"' != s->json[0])
+                return LEPT_PARSE_MISS_KEY;
+            if(LEPT_PARSE_OK != (ret = lept_parse_string_lazy(s, &str, &len, &escaped)))
+                return ret;
+            lept_parse_whitespace(s);
+            if(':' != s->json[0])
+                return LEPT_PARSE_MISS_COLON;
+            s->json++;
+            lept_parse_whitespace(s);
+        }
+        if(LEPT_PARSE_OK != (ret = lept_stream_skip(s)))
+            return ret;
+        lept_parse_whitespace(s);
+        if(',' == s->json[0])
+        {
+            s->json++;
+            lept_parse_whitespace(s);
+        }
+        else if(close == s->json[0])
+        {
+            s->json++;
+            return LEPT_PARSE_OK;
+        }
+        else
+            return ']' == close ? LEPT_PARSE_MISS_COMMA_OR_SQUARE_BRACKET : LEPT_PARSE_MISS_COMMA_OR_CURLY_BRACKET;
+    }
+}
+
+
+void lept_stream_put(lept_stream* s, const char* str, size_t len)
+{
+    assert(NULL != s);
+    if(len > 0)
+        PUTS(s, str, len);
+}
+
+
+void lept_stream_put_number(lept_stream* s, double num)
+{
+    char* buf = lept_context_push(s, 32);
+    int length = sprintf(buf, "%.17g", num);
+    s->top -= 32 - length;
+}
+
+
+void lept_stream_put_string(lept_stream* s, const char* str, size_t len)
+{
+    lept_stringify_string(s, str, len);
+}
+
+
+char* lept_stream_finish(lept_stream* s, size_t* length)
+{
+    char* ret;
+    assert(NULL != s);
+    if(length)
+        *length = s->top;
+    PUTC(s, '\0');
+    ret = s->stack;
+    s->stack = NULL;
+    s->size = s->top = 0;
+    return ret;
+}
+
+
+/*  lept_cursor */
+void lept_cursor_init(lept_cursor* c, const char* json)
+{
+    assert(NULL != c && NULL != json);
+    lept_stream_init(&c->s, json);
+    c->ret = LEPT_PARSE_OK;
+    c->consumed = 0;
+    c->depth = c->klen = 0;
+    lept_parse_whitespace(&c->s);
+    if('\0' == c->s.json[0])
+        c->ret = LEPT_PARSE_EXPECT_VALUE;
+}
+
+
+void lept_cursor_free(lept_cursor* c)
+{
+    assert(NULL != c);
+    lept_stream_free(&c->s);
+}
+
+
+/*  记录第一个错误 */
+int lept_cursor_fail(lept_cursor* c, int ret)
+{
+    if(LEPT_PARSE_OK == c->ret)
+        c->ret = ret;
+    return c->ret;
+}
+
+
+lept_type lept_cursor_type(const lept_cursor* c)
+{
+    assert(NULL != c);
+    switch(c->s.json[0])
+    {
+        case 'n': return LEPT_NULL;
+        case 't': return LEPT_TRUE;
+        case 'f': return LEPT_FALSE;
+        case '"': return LEPT_STRING;
+        case '[': return LEPT_ARRAY;
+        case '{': return LEPT_OBJECT;
+        default:  return LEPT_NUMBER;
+    }
+}
+
+
+/*  读取成员的键和冒号，键放在暂存区的开头，之后解码的字符串放在它后面 */
+int lept_cursor_read_key(lept_cursor* c)
+{
+    char* str;
+    int ret;
+    c->s.top = 0;
+    if('"' != c->s.json[0])
+        return lept_cursor_fail(c, LEPT_PARSE_MISS_KEY);
+    if(LEPT_PARSE_OK != (ret = lept_parse_string_raw(&c->s, &str, &c->klen)))
+        return lept_cursor_fail(c, ret);
+    /*  lept_parse_string_raw 已经把键弹出，重新压入保留它 */
+    if(c->klen > 0)
+        lept_context_push(&c->s, c->klen);
+    lept_parse_whitespace(&c->s);
+    if(':' != c->s.json[0])
+        return lept_cursor_fail(c, LEPT_PARSE_MISS_COLON);
+    c->s.json++;
+    lept_parse_whitespace(&c->s);
+    return LEPT_PARSE_OK;
+}
+
+
+/*  进入当前的数组或对象，返回 1 表示停在第一个元素上，0 表示容器为空或出错 */
+int lept_cursor_enter(lept_cursor* c)
+{
+    char close = '[' == c->s.json[0] ? ']' : '}';
+    if(LEPT_CURSOR_MAX_DEPTH == c->depth)
+    {
+        lept_cursor_fail(c, LEPT_PARSE_TOO_DEEP);
+        return 0;
+    }
+    c->s.json++;
+    lept_parse_whitespace(&c->s);
+    if(close == c->s.json[0])
+    {
+        c->s.json++;
+        c->consumed = 1;
+        return 0;
+    }
+    c->close[c->depth++] = close;
+    c->consumed = 0;
+    return '}' == close ? LEPT_PARSE_OK == lept_cursor_read_key(c) : 1;
+}
+
+
+/*  当前值已经读取，读取逗号或结束符，返回 1 表示停在下一个元素上 */
+int lept_cursor_advance(lept_cursor* c)
+{
+    char close;
+    lept_parse_whitespace(&c->s);
+    c->s.top = 0;
+    c->klen = 0;
+    if(0 == c->depth)
+    {
+        if('\0' != c->s.json[0])
+            lept_cursor_fail(c, LEPT_PARSE_ROOT_NOT_SINGULAR);
+        return 0;
+    }
+    close = c->close[c->depth - 1];
+    if(',' == c->s.json[0])
+    {
+        c->s.json++;
+        lept_parse_whitespace(&c->s);
+        c->consumed = 0;
+        return '}' == close ? LEPT_PARSE_OK == lept_cursor_read_key(c) : 1;
+    }
+    if(close == c->s.json[0])
+    {
+        c->s.json++;
+        c->depth--;
+        c->consumed = 1;
+        return 0;
+    }
+    lept_cursor_fail(c, ']' == close ? LEPT_PARSE_MISS_COMMA_OR_SQUARE_BRACKET : LEPT_PARSE_MISS_COMMA_OR_CURLY_BRACKET);
+    return 0;
+}
+
+
+int lept_cursor_next(lept_cursor* c)
+{
+    assert(NULL != c);
+    if(LEPT_PARSE_OK != c->ret)
+        return 0;
+    if(!c->consumed)
+    {
+        if('[' == c->s.json[0] || '{' == c->s.json[0])
+            return lept_cursor_enter(c);
+        if(LEPT_PARSE_OK != lept_cursor_skip(c))
+            return 0;
+    }
+    return lept_cursor_advance(c);
+}
+
+
+int lept_cursor_get_number(lept_cursor* c, double* num)
+{
+    int ret;
+    assert(NULL != c && NULL != num && !c->consumed);
+    if(LEPT_PARSE_OK != c->ret)
+        return c->ret;
+    if(LEPT_PARSE_SCHEMA_MISMATCH == (ret = lept_stream_number(&c->s, num)))
+        return ret;
+    if(LEPT_PARSE_OK != ret)
+        return lept_cursor_fail(c, ret);
+    c->consumed = 1;
+    return LEPT_PARSE_OK;
+}
+
+
+int lept_cursor_get_string(lept_cursor* c, const char** str, size_t* len)
+{
+    int ret;
+    assert(NULL != c && NULL != str && NULL != len && !c->consumed);
+    if(LEPT_PARSE_OK != c->ret)
+        return c->ret;
+    if(LEPT_PARSE_SCHEMA_MISMATCH == (ret = lept_stream_string(&c->s, str, len)))
+        return ret;
+    if(LEPT_PARSE_OK != ret)
+        return lept_cursor_fail(c, ret);
+    c->consumed = 1;
+    return LEPT_PARSE_OK;
+}
+
+
+int lept_cursor_skip(lept_cursor* c)
+{
+    int ret;
+    assert(NULL != c);
+    if(LEPT_PARSE_OK != c->ret)
+        return c->ret;
+    if(c->consumed)
+    {
+        /*  跳过所在容器剩下的元素，直到它的结束符 */
+        if(0 == c->depth)
+            return LEPT_PARSE_OK;
+        while(lept_cursor_advance(c))
+            if(LEPT_PARSE_OK != (ret = lept_stream_skip(&c->s)))
+                return lept_cursor_fail(c, ret);
+        return c->ret;
+    }
+    if(LEPT_PARSE_OK != (ret = lept_stream_skip(&c->s)))
+        return lept_cursor_fail(c, ret);
+    c->consumed = 1;
+    return LEPT_PARSE_OK;
+}
+
+
+int lept_cursor_find_field(lept_cursor* c, const char* key, size_t klen)
+{
+    assert(NULL != c && (NULL != key || 0 == klen));
+    if(LEPT_PARSE_OK != c->ret)
+        return 0;
+    if(!c->consumed && '{' == c->s.json[0])
+    {
+        if(!lept_cursor_enter(c))
+            return 0;
+    }
+    else
+    {
+        /*  在对象的成员中：跳过当前成员，从下一个开始 */
+        if(0 == c->depth || '}' != c->close[c->depth - 1])
+            return 0;
+        if((!c->consumed && LEPT_PARSE_OK != lept_cursor_skip(c)) || !lept_cursor_advance(c))
+            return 0;
+    }
+    while(c->klen != klen || (klen > 0 && 0 != memcmp(c->s.stack, key, klen)))
+    {
+        if(LEPT_PARSE_OK != lept_cursor_skip(c) || !lept_cursor_advance(c))
+            return 0;
+    }
+    return 1;
+}
+
+
+const char* lept_cursor_key(const lept_cursor* c, size_t* klen)
+{
+    assert(NULL != c && NULL != klen);
+    *klen = c->klen;
+    return c->klen > 0 ? c->s.stack : "";
+}
+
+
+/*  按列抽取 */
+void lept_column_init(lept_column* col, int type)
+{
+    assert(NULL != col && type >= LEPT_COLUMN_NUMBER && type <= LEPT_COLUMN_STRING);
+    memset(col, 0, sizeof(lept_column));
+    col->type = type;
+}
+
+
+void lept_column_free(lept_column* col)
+{
+    assert(NULL != col);
+    LEPT_FREE(col->valid);
+    if(LEPT_COLUMN_STRING == col->type)
+    {
+        LEPT_FREE(col->u.s.offsets);
+        LEPT_FREE(col->u.s.pool);
+    }
+    else
+        LEPT_FREE(col->u.num);
+    lept_column_init(col, col->type);
+}
+
+
+/*  准备第 row 行：需要时扩容，先设为空值，提交（rows++）由调用者在整个文档成功后进行 */
+void lept_column_begin_row(lept_column* col, size_t row)
+{
+    size_t old = col->capacity, width;
+    if(row == col->capacity)
+    {
+        col->capacity = lept_grow_capacity(col->capacity);
+        col->valid = (unsigned char*)LEPT_REALLOC(col->valid, (col->capacity + 7) / 8);
+        memset(col->valid + (old + 7) / 8, 0, (col->capacity + 7) / 8 - (old + 7) / 8);
+        if(LEPT_COLUMN_STRING == col->type)
+        {
+            col->u.s.offsets = (size_t*)LEPT_REALLOC(col->u.s.offsets, (col->capacity + 1) * sizeof(size_t));
+            if(0 == old)
+                col->u.s.offsets[0] = 0;
+        }
+        else
+        {
+            width = LEPT_COLUMN_BOOLEAN == col->type ? 1 : LEPT_COLUMN_INT64 == col->type ? sizeof(int64_t) : sizeof(double);
+            col->u.num = (double*)LEPT_REALLOC(col->u.num, col->capacity * width);
+        }
+    }
+    col->valid[row / 8] &= (unsigned char)~(1u << (row % 8));
+    switch(col->type)
+    {
+        case LEPT_COLUMN_NUMBER:  col->u.num[row] = 0.0; break;
+        case LEPT_COLUMN_INT64:   col->u.i64[row] = 0; break;
+        case LEPT_COLUMN_BOOLEAN: col->u.b[row] = 0; break;
+        default:                  col->u.s.offsets[row + 1] = col->u.s.offsets[row]; break;
+    }
+}
+
+
+/*  把一个标量写入第 k 列的当前行，已经有值（重复的键）时忽略 */
+int lept_columns_store(lept_columns* x, size_t k, lept_type type, double num, const char* str, size_t len)
+{
+    lept_column* col = &x->cols[k];
+    size_t row = x->row, end;
+    if(LEPT_NULL == type || (col->valid[row / 8] & (1u << (row % 8))))
+        return LEPT_PARSE_OK;
+    switch(col->type)
+    {
+        case LEPT_COLUMN_NUMBER:
+            if(LEPT_NUMBER != type)
+                return LEPT_PARSE_SCHEMA_MISMATCH;
+            col->u.num[row] = num;
+            break;
+        case LEPT_COLUMN_INT64:
+            if(LEPT_NUMBER != type || !lept_is_integer(num))
+                return LEPT_PARSE_SCHEMA_MISMATCH;
+            col->u.i64[row] = (int64_t)num;
+            break;
+        case LEPT_COLUMN_BOOLEAN:
+            if(LEPT_TRUE != type && LEPT_FALSE != type)
+                return LEPT_PARSE_SCHEMA_MISMATCH;
+            col->u.b[row] = LEPT_TRUE == type;
+            break;
+        default:
+            if(LEPT_STRING != type)
+                return LEPT_PARSE_SCHEMA_MISMATCH;
+            end = col->u.s.offsets[row] + len;
+            if(end > col->u.s.capacity)
+            {
+                col->u.s.capacity = end + (end >> 1);
+                col->u.s.pool = (char*)LEPT_REALLOC(col->u.s.pool, col->u.s.capacity);
+            }
+            if(len > 0)
+                memcpy(col->u.s.pool + col->u.s.offsets[row], str, len);
+            col->u.s.offsets[row + 1] = end;
+            break;
+    }
+    col->valid[row / 8] |= (unsigned char)(1u << (row % 8));
+    return LEPT_PARSE_OK;
+}
+
+
+/*  处理游标当前所在的值（深度为 depth），alive 中是到这里为止都匹配的路径
+    路径在这里结束时读取标量写入列；否则进入容器，只对匹配下一个标记的成员（元素）递归，其余跳过；
+    匹配过的路径从 alive 中去掉，都匹配过之后跳过容器剩下的部分 */
+int lept_columns_walk(lept_columns* x, lept_cursor* c, size_t depth, size_t* alive, size_t nalive)
+{
+    size_t i, k, n, klen, index = 0;
+    size_t* sub = x->alive + (depth + 1) * x->npaths;
+    lept_type type = lept_cursor_type(c);
+    const lept_column_token* t;
+    const char* key;
+    const char* str = NULL;
+    double num = 0.0;
+    int ret = LEPT_PARSE_OK, target = 0;
+    for(i = 0; i < nalive && !target; i++)
+        target = x->first[alive[i] + 1] - x->first[alive[i]] == depth;
+    if(target)
+    {
+        if(LEPT_NUMBER == type)
+            ret = lept_cursor_get_number(c, &num);
+        else if(LEPT_STRING == type)
+            ret = lept_cursor_get_string(c, &str, &klen);
+        else
+            ret = lept_cursor_skip(c);
+        if(LEPT_PARSE_OK != ret)
+            return c->ret;
+        for(i = 0; i < nalive; i++)
+        {
+            /*  容器不能写入列，路径更长的在标量中不存在 */
+            if(x->first[alive[i] + 1] - x->first[alive[i]] != depth)
+                continue;
+            if(LEPT_ARRAY == type || LEPT_OBJECT == type)
+                return LEPT_PARSE_SCHEMA_MISMATCH;
+            if(LEPT_PARSE_OK != (ret = lept_columns_store(x, alive[i], type, num, str, klen)))
+                return ret;
+        }
+        return LEPT_PARSE_OK;
+    }
+    if((LEPT_ARRAY != type && LEPT_OBJECT != type) || 0 == nalive)
+        return lept_cursor_skip(c);
+    if(!lept_cursor_next(c))
+        return c->ret;
+    do
+    {
+        key = LEPT_OBJECT == type ? lept_cursor_key(c, &klen) : NULL;
+        for(i = n = 0; i < nalive; )
+        {
+            k = alive[i];
+            t = &x->tok[x->first[k] + depth];
+            if(NULL != key ? (t->len == klen && 0 == memcmp(x->keys + t->off, key, klen)) : t->index == index)
+            {
+                sub[n++] = k;
+                alive[i] = alive[--nalive];
+            }
+            else
+                i++;
+        }
+        if(n > 0)
+            ret = lept_columns_walk(x, c, depth + 1, sub, n);
+        else
+            ret = lept_cursor_skip(c);
+        if(LEPT_PARSE_OK != ret)
+            return ret;
+        index++;
+        if(0 == nalive)
+            return lept_cursor_skip(c);
+    } while(lept_cursor_next(c));
+    return c->ret;
+}
+
+
+int lept_extract_columns(const char* const* docs, size_t ndocs, const char* const* paths, size_t npaths,
+                         lept_column* cols, size_t* done)
+{
+    lept_columns x;
+    lept_context keys;
+    lept_cursor c;
+    const char *p, *end, *tok;
+    size_t i, j, ntok = 0, cap = 0, len, depth = 0;
+    char* stack = NULL;
+    size_t size = 0;
+    int ret = LEPT_PARSE_OK;
+    assert((NULL != docs || 0 == ndocs) && (NULL != paths || 0 == npaths) && (NULL != cols || 0 == npaths));
+    if(NULL != done)
+        *done = 0;
+    memset(&x, 0, sizeof(x));
+    x.cols = cols;
+    x.npaths = npaths;
+    x.first = (size_t*)LEPT_MALLOC((npaths + 1) * sizeof(size_t));
+    /*  拆分所有路径，标记的文本都留在 keys 的栈中 */
+    lept_stream_init(&keys, NULL);
+    for(i = 0; i < npaths && LEPT_PARSE_OK == ret; i++)
+    {
+        x.first[i] = ntok;
+        for(p = paths[i], end = p + strlen(p); p < end; ntok++)
+        {
+            if('/' != *p || NULL == (p = lept_pointer_token(&keys, p, end, &tok, &len)))
+            {
+                ret = LEPT_PARSE_INVALID_VALUE;
+                break;
+            }
+            if(ntok == cap)
+            {
+                cap = lept_grow_capacity(cap);
+                x.tok = (lept_column_token*)LEPT_REALLOC(x.tok, cap * sizeof(lept_column_token));
+            }
+            x.tok[ntok].off = keys.top;
+            x.tok[ntok].len = len;
+            x.tok[ntok].index = lept_pointer_index(tok, len, LEPT_KEY_NOT_EXIST);
+            if(len > 0)
+                lept_context_push(&keys, len);
+        }
+        if(ntok - x.first[i] > depth)
+            depth = ntok - x.first[i];
+    }
+    x.first[npaths] = ntok;
+    x.keys = keys.stack;
+    x.alive = (size_t*)LEPT_MALLOC((depth + 2) * (npaths + 1) * sizeof(size_t));
+    for(i = 0; i < ndocs && LEPT_PARSE_OK == ret; i++)
+    {
+        /*  每个文档重新初始化游标，复用它的暂存区 */
+        lept_cursor_init(&c, docs[i]);
+        c.s.stack = stack;
+        c.s.size = size;
+        x.row = npaths > 0 ? cols[0].rows : 0;
+        for(j = 0; j < npaths; j++)
+        {
+            assert(cols[j].rows == x.row);
+            lept_column_begin_row(&cols[j], x.row);
+            x.alive[j] = j;
+        }
+        if(LEPT_PARSE_OK == (ret = c.ret) && LEPT_PARSE_OK == (ret = lept_columns_walk(&x, &c, 0, x.alive, npaths)))
+        {
+            /*  检查文档之后只有空白 */
+            lept_cursor_next(&c);
+            ret = c.ret;
+        }
+        stack = c.s.stack;
+        size = c.s.size;
+        if(LEPT_PARSE_OK != ret)
+            break;
+        for(j = 0; j < npaths; j++)
+            cols[j].rows++;
+        if(NULL != done)
+            (*done)++;
+    }
+    LEPT_FREE(stack);
+    lept_stream_free(&keys);
+    LEPT_FREE(x.tok);
+    LEPT_FREE(x.first);
+    LEPT_FREE(x.alive);
+    return ret;
+}
+
+
+/*  CBOR/MessagePack 的公共部分 */
+int lept_is_negative_zero(double num)
+{
+    double nz = -0.0;
+    return 0.0 == num && 0 == memcmp(&num, &nz, sizeof(double));
+}
+
+
+/*  可以无损编码为整数的数值 */
+int lept_is_integer(double num)
+{
+    return num == floor(num) && fabs(num) <= 9007199254740992.0 && !lept_is_negative_zero(num);
+}
+
+
+int lept_is_float32(double num)
+{
+    return fabs(num) <= FLT_MAX && (double)(float)num == num;
+}
+
+
+/*  把不大于 2^64 - 1 的非负整数 n 按大端序写成 bytes（1、2、4、8）个字节 */
+void lept_put_uint(lept_context* con, double n, int bytes)
+{
+    unsigned long hi = 0, lo = 0;
+    unsigned char* p;
+    int i;
+    if(8 == bytes)
+    {
+        hi = (unsigned long)floor(n / 4294967296.0);
+        lo = (unsigned long)(n - (double)hi * 4294967296.0);
+    }
+    else
+        lo = (unsigned long)n;
+    p = (unsigned char*)lept_context_push(con, bytes);
+    for(i = bytes - 1; i >= 0; i--)
+    {
+        p[i] = (unsigned char)(lo & 0xff);
+        lo >>= 8;
+        if(4 == i)
+            lo = hi;
+    }
+}
+
+
+/*  类型字节 op 之后跟 bytes 个字节的整数 n */
+void lept_put_op(lept_context* con, int op, double n, int bytes)
+{
+    PUTC(con, (char)op);
+    lept_put_uint(con, n, bytes);
+}
+
+
+/*  类型字节 op 之后按 IEEE 754 单精度（bytes 为 4）或双精度（bytes 为 8）写出 num
+    用 frexp 拆分，不依赖本机的浮点内存布局 */
+void lept_put_float(lept_context* con, int op, double num, int bytes)
+{
+    unsigned long sign = (num < 0 || lept_is_negative_zero(num)) ? 1 : 0, hi = 0;
+    int e = 0, bias = 4 == bytes ? 127 : 1023, digits = 4 == bytes ? 24 : 53;
+    double m = frexp(fabs(num), &e), mant, biased = e - 1 + bias;
+    if(0.0 == num)
+        biased = mant = 0;
+    else if(biased >= 1)
+        mant = ldexp(m, digits) - ldexp(1.0, digits - 1);
+    else
+    {
+        biased = 0;
+        mant = ldexp(fabs(num), bias + digits - 2);
+    }
+    PUTC(con, (char)op);
+    if(4 == bytes)
+        lept_put_uint(con, (double)(sign << 31) + ldexp(biased, 23) + mant, 4);
+    else
+    {
+        hi = (sign << 31) | ((unsigned long)biased << 20) | (unsigned long)floor(mant / 4294967296.0);
+        lept_put_uint(con, (double)hi, 4);
+        lept_put_uint(con, mant - floor(mant / 4294967296.0) * 4294967296.0, 4);
+    }
+}
+
+
+/*  读取 bytes 个字节的大端序无符号整数，超过 2^53 时取最接近的 double */
+double lept_get_uint(const unsigned char* p, int bytes)
+{
+    double n = 0;
+    unsigned long hi = 0, lo = 0;
+    int i;
+    for(i = 0; i < bytes; i++)
+    {
+        if(4 == i)
+        {
+            hi = lo;
+            lo = 0;
+        }
+        lo = (lo << 8) | p[i];
+    }
+    n = (double)hi * 4294967296.0 + (double)lo;
+    return n;
+}
+
+
+/*  读取 IEEE 754 半精度、单精度、双精度（bytes 为 2、4、8），JSON 不能表示无穷和 NaN */
+int lept_get_float(const unsigned char* p, int bytes, double* num)
+{
+    int ebits = 2 == bytes ? 5 : (4 == bytes ? 8 : 11), digits = 2 == bytes ? 11 : (4 == bytes ? 24 : 53);
+    int bias = (1 << (ebits - 1)) - 1, biased = 0;
+    unsigned long hi = (unsigned long)lept_get_uint(p, bytes < 4 ? bytes : 4);
+    double mant;
+    if(8 == bytes)
+        mant = (double)(hi & 0xfffffUL) * 4294967296.0 + lept_get_uint(p + 4, 4);
+    else
+        mant = (double)(hi & ((1UL << (digits - 1)) - 1));
+    biased = (int)((hi >> (bytes * 8 - 1 - ebits - (8 == bytes ? 32 : 0))) & ((1UL << ebits) - 1));
+    if(biased == (1 << ebits) - 1)
+        return LEPT_PARSE_BINARY_UNSUPPORTED;
+    if(0 == biased)
+        *num = ldexp(mant, 2 - bias - digits);
+    else
+        *num = ldexp(mant + ldexp(1.0, digits - 1), biased - bias - digits + 1);
+    if(hi >> (8 == bytes ? 31 : bytes * 8 - 1))
+        *num = -*num;
+    return LEPT_PARSE_OK;
+}
+
+
+/*  在新建的对象 obj 末尾加入成员，直接取得 key 中字符串的所有权
+    与 lept_parse 相同，不检查重复的键 */
+lept_value* lept_bin_member(lept_value* obj, lept_value* key)
+{
+    lept_member* m;
+    assert(LEPT_STRING == key->type && 0 == (obj->flags & (LEPT_FLAG_SHARED | LEPT_FLAG_POOLED | LEPT_FLAG_BLOCK)));
+    if(obj->u.o.size == obj->u.o.capacity)
+        lept_reserve_object(obj, lept_grow_capacity(obj->u.o.capacity));
+    m = &obj->u.o.m[obj->u.o.size++];
+    m->k = key->u.s.str;
+    m->klen = key->u.s.len;
+    m->khash = lept_hash_key(m->k, m->klen);
+    lept_init(&m->val);
+    lept_init(key);
+    return &m->val;
+}
+
+
+/*  CBOR */
+/*  写出主类型 major 和参数 n，n 用最短的形式 */
+void lept_cbor_head(lept_context* con, int major, double n)
+{
+    if(n < 24)
+        PUTC(con, (char)(major << 5 | (int)n));
+    else if(n <= 0xff)
+        lept_put_op(con, (char)(major << 5 | 24), n, 1);
+    else if(n <= 0xffff)
+        lept_put_op(con, (char)(major << 5 | 25), n, 2);
+    else if(n <= 4294967295.0)
+        lept_put_op(con, (char)(major << 5 | 26), n, 4);
+    else
+        lept_put_op(con, (char)(major << 5 | 27), n, 8);
+}
+
+
+void lept_cbor_value(lept_context* con, const lept_value* val)
+{
+    size_t i = 0;
+    double num;
+    lept_value tmp;
+    switch(val->type)
+    {
+        case LEPT_NULL:   PUTC(con, (char)0xf6); break;
+        case LEPT_FALSE:  PUTC(con, (char)0xf4); break;
+        case LEPT_TRUE:   PUTC(con, (char)0xf5); break;
+        case LEPT_NUMBER:
+            num = lept_get_number(val);
+            if(lept_is_integer(num))
+                lept_cbor_head(con, num < 0 ? 1 : 0, num < 0 ? -1.0 - num : num);
+            else if(lept_is_float32(num))
+                lept_put_float(con, 0xfa, num, 4);
+            else
+                lept_put_float(con, 0xfb, num, 8);
+            break;
+        case LEPT_STRING:
+            lept_string_decode(val);
+            lept_cbor_head(con, 3, (double)val->u.s.len);
+            if(val->u.s.len > 0)
+                PUTS(con, val->u.s.str, val->u.s.len);
+            break;
+        case LEPT_ARRAY:
+            lept_cbor_head(con, 4, (double)val->u.a.size);
+            for(i = 0; i < val->u.a.size; i++)
+                lept_cbor_value(con, lept_array_at(val, i, &tmp));
+            break;
+        case LEPT_OBJECT:
+            lept_cbor_head(con, 5, (double)val->u.o.size);
+            for(i = 0; i < val->u.o.size; i++)
+            {
+                lept_cbor_head(con, 3, (double)val->u.o.m[i].klen);
+                if(val->u.o.m[i].klen > 0)
+                    PUTS(con, val->u.o.m[i].k, val->u.o.m[i].klen);
+                lept_cbor_value(con, &val->u.o.m[i].val);
+            }
+            break;
+        default: assert(0 && "invalid type");
+    }
+}
+
+
+char* lept_to_cbor(const lept_value* val, size_t* length)
+{
+    lept_context con;
+    assert(NULL != val);
+    lept_stream_init(&con, NULL);
+    con.size = LEPT_PARSE_STRINGIFY_INIT_SIZE;
+    con.stack = (char*)LEPT_MALLOC(con.size);
+    lept_cbor_value(&con, val);
+    if(length)
+        *length = con.top;
+    return con.stack;
+}
+
+
+/*  读取附加信息 info 对应的参数 */
+int lept_cbor_parse_arg(lept_reader* r, int info, double* n)
+{
+    int bytes = 0;
+    if(info < 24)
+    {
+        *n = info;
+        return LEPT_PARSE_OK;
+    }
+    if(info > 27)
+        return LEPT_PARSE_BINARY_UNSUPPORTED;
+    bytes = 1 << (info - 24);
+    if(r->end - r->p < bytes)
+        return LEPT_PARSE_BINARY_TRUNCATED;
+    *n = lept_get_uint(r->p, bytes);
+    r->p += bytes;
+    return LEPT_PARSE_OK;
+}
+
+
+/*  文本串，info 为 31 时是以 0xff 结尾的分段文本串，各段拼接到栈中 */
+int lept_cbor_parse_string(lept_reader* r, lept_value* val, int info)
+{
+    size_t head = r->con.top, len = 0;
+    double n = 0;
+    int ret;
+    if(31 != info)
+    {
+        if(LEPT_PARSE_OK != (ret = lept_cbor_parse_arg(r, info, &n)))
+            return ret;
+        if(n > (double)(r->end - r->p))
+            return LEPT_PARSE_BINARY_TRUNCATED;
+        lept_set_string(val, (const char*)r->p, (size_t)n);
+        r->p += (size_t)n;
+        return LEPT_PARSE_OK;
+    }
+    for(;;)
+    {
+        if(r->p >= r->end)
+            ret = LEPT_PARSE_BINARY_TRUNCATED;
+        else if(0xff == *r->p)
+            break;
+        else if(3 != *r->p >> 5 || 31 == (*r->p & 31))
+            ret = LEPT_PARSE_BINARY_UNSUPPORTED;
+        else
+        {
+            info = *r->p++ & 31;
+            if(LEPT_PARSE_OK == (ret = lept_cbor_parse_arg(r, info, &n)) && n > (double)(r->end - r->p))
+                ret = LEPT_PARSE_BINARY_TRUNCATED;
+            if(LEPT_PARSE_OK == ret && n > 0)
+            {
+                PUTS(&r->con, r->p, (size_t)n);
+                r->p += (size_t)n;
+            }
+        }
+        if(LEPT_PARSE_OK != ret)
+        {
+            r->con.top = head;
+            return ret;
+        }
+    }
+    r->p++;
+    len = r->con.top - head;
+    lept_set_string(val, len > 0 ? (const char*)lept_context_pop(&r->con, len) : "", len);
+    return LEPT_PARSE_OK;
+}
+
+
+int lept_cbor_parse_value(lept_reader* r, lept_value* val)
+{
+    int major = 0, info = 0, ret = LEPT_PARSE_OK, indefinite = 0;
+    double n = 0;
+    size_t i = 0;
+    lept_value key;
+    if(r->p >= r->end)
+        return LEPT_PARSE_BINARY_TRUNCATED;
+    major = *r->p >> 5;
+    info = *r->p++ & 31;
+    if(3 == major)
+        return lept_cbor_parse_string(r, val, info);
+    if(7 == major)
+    {
+        switch(info)
+        {
+            case 20: lept_set_boolean(val, 0); return LEPT_PARSE_OK;
+            case 21: lept_set_boolean(val, 1); return LEPT_PARSE_OK;
+            case 22: lept_set_null(val); return LEPT_PARSE_OK;
+            case 25: case 26: case 27:
+                if(r->end - r->p < (1 << (info - 24)))
+                    return LEPT_PARSE_BINARY_TRUNCATED;
+                if(LEPT_PARSE_OK != (ret = lept_get_float(r->p, 1 << (info - 24), &n)))
+                    return ret;
+                r->p += 1 << (info - 24);
+                lept_set_number(val, n);
+                return LEPT_PARSE_OK;
+            default: return LEPT_PARSE_BINARY_UNSUPPORTED;
+        }
+    }
+    if(31 == info && (4 == major || 5 == major))
+        indefinite = 1;
+    else if(LEPT_PARSE_OK != (ret = lept_cbor_parse_arg(r, info, &n)))
+        return ret;
+    switch(major)
+    {
+        case 0: lept_set_number(val, n); return LEPT_PARSE_OK;
+        case 1: lept_set_number(val, -1.0 - n); return LEPT_PARSE_OK;
+        case 6: return lept_cbor_parse_value(r, val);     /*  忽略标签，只取被标记的值 */
+        case 4:
+            /*  每个元素至少一个字节，不会按伪造的长度预先分配过多内存 */
+            if(n > (double)(r->end - r->p))
+                return LEPT_PARSE_BINARY_TRUNCATED;
+            lept_set_array(val, (size_t)n);
+            for(i = 0; indefinite || i < (size_t)n; i++)
+            {
+                if(indefinite && r->p < r->end && 0xff == *r->p)
+                {
+                    r->p++;
+                    break;
+                }
+                if(LEPT_PARSE_OK != (ret = lept_cbor_parse_value(r, lept_pushback_array_element(val))))
+                    return ret;
+            }
+            return LEPT_PARSE_OK;
+        case 5:
+            if(n > (double)(r->end - r->p) / 2)
+                return LEPT_PARSE_BINARY_TRUNCATED;
+            lept_set_object(val, (size_t)n);
+            lept_init(&key);
+            for(i = 0; indefinite || i < (size_t)n; i++)
+            {
+                if(indefinite && r->p < r->end && 0xff == *r->p)
+                {
+                    r->p++;
+                    break;
+                }
+                if(r->p < r->end && 3 != *r->p >> 5)
+                    return LEPT_PARSE_BINARY_UNSUPPORTED;
+                if(LEPT_PARSE_OK != (ret = lept_cbor_parse_value(r, &key)))
+                    return ret;
+                if(LEPT_PARSE_OK != (ret = lept_cbor_parse_value(r, lept_bin_member(val, &key))))
+                    return ret;
+            }
+            return LEPT_PARSE_OK;
+        default: return LEPT_PARSE_BINARY_UNSUPPORTED;
+    }
+}
+
+
+int lept_from_cbor(lept_value* val, const char* data, size_t length)
+{
+    lept_reader r;
+    int ret;
+    assert((NULL != val) && ((NULL != data) || (0 == length)));
+    r.p = (const unsigned char*)data;
+    r.end = r.p + length;
+    lept_stream_init(&r.con, NULL);
+    lept_init(val);
+    if(LEPT_PARSE_OK == (ret = lept_cbor_parse_value(&r, val)) && r.p != r.end)
+        ret = LEPT_PARSE_ROOT_NOT_SINGULAR;
+    if(LEPT_PARSE_OK != ret)
+        lept_free(val);
+    LEPT_FREE(r.con.stack);
+    return ret;
+}
+
+
+/*  MessagePack */
+/*  写出字符串、数组、对象的长度：fix 形式，或 op16/op16+1（32 位）形式
+    字符串额外有 8 位长度的形式 0xd9 */
+void lept_msgpack_head(lept_context* con, unsigned char fix, size_t fixmax, unsigned char op16, size_t n)
+{
+    assert(n <= 0xffffffffUL);
+    if(n <= fixmax)
+        PUTC(con, (char)(fix | n));
+    else if(0xda == op16 && n <= 0xff)
+        lept_put_op(con, (char)0xd9, (double)n, 1);
+    else if(n <= 0xffff)
+        lept_put_op(con, (char)op16, (double)n, 2);
+    else
+        lept_put_op(con, (char)(op16 + 1), (double)n, 4);
+}
+
+
+void lept_msgpack_value(lept_context* con, const lept_value* val)
+{
+    size_t i = 0;
+    double num;
+    lept_value tmp;
+    switch(val->type)
+    {
+        case LEPT_NULL:   PUTC(con, (char)0xc0); break;
+        case LEPT_FALSE:  PUTC(con, (char)0xc2); break;
+        case LEPT_TRUE:   PUTC(con, (char)0xc3); break;
+        case LEPT_NUMBER:
+            num = lept_get_number(val);
+            if(lept_is_integer(num) && num >= 0)
+            {
+                if(num < 128)
+                    PUTC(con, (char)num);
+                else if(num <= 0xff)
+                    lept_put_op(con, (char)0xcc, num, 1);
+                else if(num <= 0xffff)
+                    lept_put_op(con, (char)0xcd, num, 2);
+                else if(num <= 4294967295.0)
+                    lept_put_op(con, (char)0xce, num, 4);
+                else
+                    lept_put_op(con, (char)0xcf, num, 8);
+            }
+            /*  负整数用补码，即加上 2^bits */
+            else if(lept_is_integer(num))
+            {
+                if(num >= -32)
+                    PUTC(con, (char)(0x100 + (int)num));
+                else if(num >= -128)
+                    lept_put_op(con, (char)0xd0, num + 256.0, 1);
+                else if(num >= -32768)
+                    lept_put_op(con, (char)0xd1, num + 65536.0, 2);
+                else if(num >= -2147483648.0)
+                    lept_put_op(con, (char)0xd2, num + 4294967296.0, 4);
+                else
+                {
+                    /*  2^64 + num 不能精确表示为 double，高低 32 位分别写 */
+                    lept_put_op(con, 0xd3, 4294967296.0 + floor(num / 4294967296.0), 4);
+                    lept_put_uint(con, num - floor(num / 4294967296.0) * 4294967296.0, 4);
+                }
+            }
+            else if(lept_is_float32(num))
+                lept_put_float(con, 0xca, num, 4);
+            else
+                lept_put_float(con, 0xcb, num, 8);
+            break;
+        case LEPT_STRING:
+            lept_string_decode(val);
+            lept_msgpack_head(con, 0xa0, 31, 0xda, val->u.s.len);
+            if(val->u.s.len > 0)
+                PUTS(con, val->u.s.str, val->u.s.len);
+            break;
+        case LEPT_ARRAY:
+            lept_msgpack_head(con, 0x90, 15, 0xdc, val->u.a.size);
+            for(i = 0; i < val->u.a.size; i++)
+                lept_msgpack_value(con, lept_array_at(val, i, &tmp));
+            break;
+        case LEPT_OBJECT:
+            lept_msgpack_head(con, 0x80, 15, 0xde, val->u.o.size);
+            for(i = 0; i < val->u.o.size; i++)
+            {
+                lept_msgpack_head(con, 0xa0, 31, 0xda, val->u.o.m[i].klen);
+                if(val->u.o.m[i].klen > 0)
+                    PUTS(con, val->u.o.m[i].k, val->u.o.m[i].klen);
+                lept_msgpack_value(con, &val->u.o.m[i].val);
+            }
+            break;
+        default: assert(0 && "invalid type");
+    }
+}
+
+
+char* lept_to_msgpack(const lept_value* val, size_t* length)
+{
+    lept_context con;
+    assert(NULL != val);
+    lept_stream_init(&con, NULL);
+    con.size = LEPT_PARSE_STRINGIFY_INIT_SIZE;
+    con.stack = (char*)LEPT_MALLOC(con.size);
+    lept_msgpack_value(&con, val);
+    if(length)
+        *length = con.top;
+    return con.stack;
+}
+
+
+int lept_msgpack_parse_value(lept_reader* r, lept_value* val)
+{
+    unsigned char op;
+    int bytes = 0, ret = LEPT_PARSE_OK;
+    unsigned long hi = 0, lo = 0;
+    double n = 0;
+    size_t i = 0;
+    lept_value key;
+    if(r->p >= r->end)
+        return LEPT_PARSE_BINARY_TRUNCATED;
+    op = *r->p++;
+    /*  fix 形式：长度在类型字节中 */
+    if(op < 0x80 || op >= 0xe0)
+    {
+        lept_set_number(val, op < 0x80 ? (double)op : (double)op - 256.0);
+        return LEPT_PARSE_OK;
+    }
+    if(op < 0xc0)
+        n = op & (op >= 0xa0 ? 31 : 15);
+    else
+    {
+        switch(op)
+        {
+            case 0xc0: lept_set_null(val); return LEPT_PARSE_OK;
+            case 0xc2: lept_set_boolean(val, 0); return LEPT_PARSE_OK;
+            case 0xc3: lept_set_boolean(val, 1); return LEPT_PARSE_OK;
+            case 0xca: bytes = 4; break;
+            case 0xcb: bytes = 8; break;
+            case 0xcc: case 0xd0: case 0xd9: bytes = 1; break;
+            case 0xcd: case 0xd1: case 0xda: case 0xdc: case 0xde: bytes = 2; break;
+            case 0xce: case 0xd2: case 0xdb: case 0xdd: case 0xdf: bytes = 4; break;
+            case 0xcf: case 0xd3: bytes = 8; break;
+            default: return LEPT_PARSE_BINARY_UNSUPPORTED;     /*  bin、ext 等 */
+        }
+        if(r->end - r->p < bytes)
+            return LEPT_PARSE_BINARY_TRUNCATED;
+        if(0xca == op || 0xcb == op)
+        {
+            if(LEPT_PARSE_OK != (ret = lept_get_float(r->p, bytes, &n)))
+                return ret;
+            r->p += bytes;
+            lept_set_number(val, n);
+            return LEPT_PARSE_OK;
+        }
+        n = lept_get_uint(r->p, bytes);
+        r->p += bytes;
+        if(op >= 0xd0 && op <= 0xd3)
+        {
+            /*  补码：最高位为 1 时减去 2^bits */
+            if(8 == bytes && (r->p[-8] & 0x80))
+            {
+                /*  n - 2^64 会丢失精度，改为 -(~n + 1) */
+                hi = (unsigned long)lept_get_uint(r->p - 8, 4) ^ 0xffffffffUL;
+                lo = (unsigned long)lept_get_uint(r->p - 4, 4) ^ 0xffffffffUL;
+                n = -((double)hi * 4294967296.0 + (double)lo) - 1.0;
+            }
+            else if(r->p[-bytes] & 0x80)
+                n -= ldexp(1.0, bytes * 8);
+            lept_set_number(val, n);
+            return LEPT_PARSE_OK;
+        }
+        if(op <= 0xcf)
+        {
+            lept_set_number(val, n);
+            return LEPT_PARSE_OK;
+        }
+    }
+    /*  字符串、数组、对象 */
+    if((op >= 0xa0 && op < 0xc0) || (op >= 0xd9 && op <= 0xdb))
+    {
+        if(n > (double)(r->end - r->p))
+            return LEPT_PARSE_BINARY_TRUNCATED;
+        lept_set_string(val, (const char*)r->p, (size_t)n);
+        r->p += (size_t)n;
+    }
+    else if((op >= 0x90 && op < 0xa0) || 0xdc == op || 0xdd == op)
+    {
+        if(n > (double)(r->end - r->p))
+            return LEPT_PARSE_BINARY_TRUNCATED;
+        lept_set_array(val, (size_t)n);
+        for(i = 0; i < (size_t)n; i++)
+            if(LEPT_PARSE_OK != (ret = lept_msgpack_parse_value(r, lept_pushback_array_element(val))))
+                return ret;
+    }
+    else
+    {
+        if(n > (double)(r->end - r->p) / 2)
+            return LEPT_PARSE_BINARY_TRUNCATED;
+        lept_set_object(val, (size_t)n);
+        lept_init(&key);
+        for(i = 0; i < (size_t)n; i++)
+        {
+            if(r->p < r->end && !((*r->p >= 0xa0 && *r->p < 0xc0) || (*r->p >= 0xd9 && *r->p <= 0xdb)))
+                return LEPT_PARSE_BINARY_UNSUPPORTED;
+            if(LEPT_PARSE_OK != (ret = lept_msgpack_parse_value(r, &key)))
+                return ret;
+            if(LEPT_PARSE_OK != (ret = lept_msgpack_parse_value(r, lept_bin_member(val, &key))))
+                return ret;
+        }
+    }
+    return LEPT_PARSE_OK;
+}
+
+
+int lept_from_msgpack(lept_value* val, const char* data, size_t length)
+{
+    lept_reader r;
+    int ret;
+    assert((NULL != val) && ((NULL != data) || (0 == length)));
+    r.p = (const unsigned char*)data;
+    r.end = r.p + length;
+    lept_stream_init(&r.con, NULL);
+    lept_init(val);
+    if(LEPT_PARSE_OK == (ret = lept_msgpack_parse_value(&r, val)) && r.p != r.end)
+        ret = LEPT_PARSE_ROOT_NOT_SINGULAR;
+    if(LEPT_PARSE_OK != ret)
+        lept_free(val);
+    LEPT_FREE(r.con.stack);
+    return ret;
+}
+
+
+/*  快照 */
+/*  在映像末尾预留 size 个字节（补齐到 8 字节）并清零，返回其偏移 */
+size_t lept_snap_reserve(lept_context* img, size_t size)
+{
+    size_t off = img->top;
+    size = (size + 7) & ~(size_t)7;
+    if(size > 0)
+        memset(lept_context_push(img, size), 0, size);
+    return off;
+}
+
+
+/*  把 val 写入映像中偏移 node 处已预留的节点，子节点和字符串追加在末尾
+    映像可能在追加时 realloc，所以节点只能用偏移定位 */
+void lept_snap_fill(lept_context* img, size_t node, const lept_value* val)
+{
+    size_t i = 0, off = 0, koff = 0, len = 0;
+    lept_snap_value n;
+    lept_value tmp;
+    lept_snap_member* m;
+    memset(&n, 0, sizeof(n));
+    n.type = (uint32_t)val->type;
+    switch(val->type)
+    {
+        case LEPT_NUMBER:
+            n.u.num = lept_get_number(val);
+            break;
+        case LEPT_STRING:
+            lept_string_decode(val);
+            off = lept_snap_reserve(img, val->u.s.len + 1);
+            if(val->u.s.len > 0)
+                memcpy(img->stack + off, val->u.s.str, val->u.s.len);
+            n.u.r.off = off - node;
+            n.u.r.n = val->u.s.len;
+            break;
+        case LEPT_ARRAY:
+            off = lept_snap_reserve(img, val->u.a.size * sizeof(lept_snap_value));
+            n.u.r.off = off - node;
+            n.u.r.n = val->u.a.size;
+            for(i = 0; i < val->u.a.size; i++)
+                lept_snap_fill(img, off + i * sizeof(lept_snap_value), lept_array_at(val, i, &tmp));
+            break;
+        case LEPT_OBJECT:
+            off = lept_snap_reserve(img, val->u.o.size * sizeof(lept_snap_member));
+            n.u.r.off = off - node;
+            n.u.r.n = val->u.o.size;
+            for(i = 0; i < val->u.o.size; i++)
+            {
+                len = val->u.o.m[i].klen;
+                koff = lept_snap_reserve(img, len + 1);
+                if(len > 0)
+                    memcpy(img->stack + koff, val->u.o.m[i].k, len);
+                m = (lept_snap_member*)(img->stack + off) + i;
+                m->koff = koff - (off + i * sizeof(lept_snap_member));
+                m->klen = len;
+                m->khash = val->u.o.m[i].khash;
+                lept_snap_fill(img, off + i * sizeof(lept_snap_member) + offsetof(lept_snap_member, val),
+                               &val->u.o.m[i].val);
+            }
+            break;
+        default:
+            break;
+    }
+    memcpy(img->stack + node, &n, sizeof(n));
+}
+
+
+int lept_snapshot_write(const lept_value* val, const char* path)
+{
+    lept_context img;
+    lept_snap_header h;
+    int ret = LEPT_SNAPSHOT_OK;
+    assert((NULL != val) && (NULL != path));
+    lept_stream_init(&img, NULL);
+    lept_snap_reserve(&img, sizeof(lept_snap_header));
+    lept_snap_fill(&img, offsetof(lept_snap_header, root), val);
+    memcpy(&h, img.stack, sizeof(h));
+    memcpy(h.magic, LEPT_SNAPSHOT_MAGIC, sizeof(h.magic));
+    h.version = LEPT_SNAPSHOT_VERSION;
+    h.endian = LEPT_SNAPSHOT_ENDIAN;
+    h.size = img.top;
+    memcpy(img.stack, &h, sizeof(h));
+    ret = lept_snap_write_file(path, img.stack, img.top);
+    LEPT_FREE(img.stack);
+    return ret;
+}
+
+
+/*  不能原地截断重写：其他进程可能正映射着旧文件，会读到写了一半的映像或收到 SIGBUS
+    先写入同一目录中的临时文件并落盘，再改名覆盖 path，改名是原子的，已映射的旧文件保持不变 */
+int lept_snap_write_file(const char* path, const void* data, size_t size)
+{
+    char* tmp = (char*)LEPT_MALLOC(strlen(path) + 32);
+    FILE* fp = NULL;
+    int ok;
+#ifdef LEPT_SNAPSHOT_MMAP
+    int fd = -1;
+    unsigned i;
+    for(i = 0; i < 100 && -1 == fd; i++)
+    {
+        sprintf(tmp, "%s.%ld.%u.tmp", path, (long)getpid(), i);
+        if(-1 == (fd = open(tmp, O_WRONLY | O_CREAT | O_EXCL, 0666)) && EEXIST != errno)
+            break;
+    }
+    if(-1 != fd && NULL == (fp = fdopen(fd, "wb")))
+    {
+        close(fd);
+        remove(tmp);
+    }
+#else
+    sprintf(tmp, "%s.tmp", path);
+    fp = fopen(tmp, "wb");
+#endif
+    if(NULL == fp)
+    {
+        LEPT_FREE(tmp);
+        return LEPT_SNAPSHOT_IO_ERROR;
+    }
+    ok = fwrite(data, 1, size, fp) == size && 0 == fflush(fp);
+#ifdef LEPT_SNAPSHOT_MMAP
+    ok = ok && 0 == fsync(fileno(fp));
+#endif
+    ok = 0 == fclose(fp) && ok;
+    if(ok && 0 != rename(tmp, path))
+    {
+#ifdef LEPT_SNAPSHOT_MMAP
+        ok = 0;
+#else
+        /*  有的平台不能改名覆盖已有的文件 */
+        ok = 0 == remove(path) && 0 == rename(tmp, path);
+#endif
+    }
+    if(!ok)
+        remove(tmp);
+    LEPT_FREE(tmp);
+    return ok ? LEPT_SNAPSHOT_OK : LEPT_SNAPSHOT_IO_ERROR;
+}
+
+
+int lept_snapshot_open(lept_snapshot** snap, const char* path)
+{
+    lept_snapshot s;
+    const lept_snap_header* h;
+#ifdef LEPT_SNAPSHOT_MMAP
+    struct stat st;
+    int fd;
+    assert((NULL != snap) && (NULL != path));
+    *snap = NULL;
+    if(-1 == (fd = open(path, O_RDONLY)))
+        return LEPT_SNAPSHOT_IO_ERROR;
+    if(0 != fstat(fd, &st))
+    {
+        close(fd);
+        return LEPT_SNAPSHOT_IO_ERROR;
+    }
+    if(st.st_size < (off_t)sizeof(lept_snap_header))
+    {
+        close(fd);
+        return LEPT_SNAPSHOT_INVALID_FORMAT;
+    }
+    s.size = (size_t)st.st_size;
+    s.base = mmap(NULL, s.size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if(MAP_FAILED == s.base)
+        return LEPT_SNAPSHOT_IO_ERROR;
+#else
+    /*  没有 mmap 的平台整个读入内存，同样不需要反序列化 */
+    FILE* fp;
+    long size;
+    int ok;
+    assert((NULL != snap) && (NULL != path));
+    *snap = NULL;
+    if(NULL == (fp = fopen(path, "rb")))
+        return LEPT_SNAPSHOT_IO_ERROR;
+    if(0 != fseek(fp, 0, SEEK_END) || (size = ftell(fp)) < 0 || 0 != fseek(fp, 0, SEEK_SET))
+    {
+        fclose(fp);
+        return LEPT_SNAPSHOT_IO_ERROR;
+    }
+    if(size < (long)sizeof(lept_snap_header))
+    {
+        fclose(fp);
+        return LEPT_SNAPSHOT_INVALID_FORMAT;
+    }
+    s.size = (size_t)size;
+    s.base = LEPT_MALLOC(s.size);
+    ok = fread(s.base, 1, s.size, fp) == s.size;
+    fclose(fp);
+    if(!ok)
+    {
+        LEPT_FREE(s.base);
+        return LEPT_SNAPSHOT_IO_ERROR;
+    }
+#endif
+    h = (const lept_snap_header*)s.base;
+    if(0 != memcmp(h->magic, LEPT_SNAPSHOT_MAGIC, sizeof(h->magic)) || LEPT_SNAPSHOT_VERSION != h->version
+       || LEPT_SNAPSHOT_ENDIAN != h->endian || h->size != s.size)
+    {
+        lept_snapshot_unmap(&s);
+        return LEPT_SNAPSHOT_INVALID_FORMAT;
+    }
+    *snap = (lept_snapshot*)LEPT_MALLOC(sizeof(lept_snapshot));
+    **snap = s;
+    return LEPT_SNAPSHOT_OK;
+}
+
+
+void lept_snapshot_unmap(const lept_snapshot* snap)
+{
+#ifdef LEPT_SNAPSHOT_MMAP
+    munmap(snap->base, snap->size);
+#else
+    LEPT_FREE(snap->base);
+#endif
+}
+
+
+void lept_snapshot_close(lept_snapshot* snap)
+{
+    if(NULL == snap)
+        return;
+    lept_snapshot_unmap(snap);
+    LEPT_FREE(snap);
+}
+
+
+const lept_snap_value* lept_snapshot_root(const lept_snapshot* snap)
+{
+    assert(NULL != snap);
+    return &((const lept_snap_header*)snap->base)->root;
+}
+
+
+lept_type lept_snap_get_type(const lept_snap_value* val)
+{
+    assert(NULL != val);
+    return (lept_type)val->type;
+}
+
+
+int lept_snap_get_boolean(const lept_snap_value* val)
+{
+    assert((NULL != val) && ((LEPT_TRUE == val->type) || (LEPT_FALSE == val->type)));
+    return LEPT_TRUE == val->type;
+}
+
+
+double lept_snap_get_number(const lept_snap_value* val)
+{
+    assert((NULL != val) && (LEPT_NUMBER == val->type));
+    return val->u.num;
+}
+
+
+const char* lept_snap_get_string(const lept_snap_value* val)
+{
+    assert((NULL != val) && (LEPT_STRING == val->type));
+    return (const char*)val + val->u.r.off;
+}
+
+
+size_t lept_snap_get_string_length(const lept_snap_value* val)
+{
+    assert((NULL != val) && (LEPT_STRING == val->type));
+    return (size_t)val->u.r.n;
+}
+
+
+size_t lept_snap_get_array_size(const lept_snap_value* val)
+{
+    assert((NULL != val) && (LEPT_ARRAY == val->type));
+    return (size_t)val->u.r.n;
+}
+
+
+const lept_snap_value* lept_snap_get_array_element(const lept_snap_value* val, size_t index)
+{
+    assert((NULL != val) && (LEPT_ARRAY == val->type) && (index < val->u.r.n));
+    return (const lept_snap_value*)((const char*)val + val->u.r.off) + index;
+}
+
+
+size_t lept_snap_get_object_size(const lept_snap_value* val)
+{
+    assert((NULL != val) && (LEPT_OBJECT == val->type));
+    return (size_t)val->u.r.n;
+}
+
+
+const char* lept_snap_get_object_key(const lept_snap_value* val, size_t index)
+{
+    const lept_snap_member* m;
+    assert((NULL != val) && (LEPT_OBJECT == val->type) && (index < val->u.r.n));
+    m = (const lept_snap_member*)((const char*)val + val->u.r.off) + index;
+    return (const char*)m + m->koff;
+}
+
+
+size_t lept_snap_get_object_key_length(const lept_snap_value* val, size_t index)
+{
+    assert((NULL != val) && (LEPT_OBJECT == val->type) && (index < val->u.r.n));
+    return (size_t)((const lept_snap_member*)((const char*)val + val->u.r.off))[index].klen;
+}
+
+
+const lept_snap_value* lept_snap_get_object_value(const lept_snap_value* val, size_t index)
+{
+    assert((NULL != val) && (LEPT_OBJECT == val->type) && (index < val->u.r.n));
+    return &((const lept_snap_member*)((const char*)val + val->u.r.off))[index].val;
+}
+
+
+/*  与 lept_find_member 相同，先比较键的哈希值 */
+size_t lept_snap_find_object_index(const lept_snap_value* val, const char* key, size_t klen)
+{
+    const lept_snap_member* m;
+    unsigned khash;
+    size_t i = 0;
+    assert((NULL != val) && (LEPT_OBJECT == val->type) && (NULL != key));
+    khash = lept_hash_key(key, klen);
+    m = (const lept_snap_member*)((const char*)val + val->u.r.off);
+    for(i = 0; i < val->u.r.n; i++)
+        if(m[i].khash == khash && m[i].klen == klen && 0 == memcmp((const char*)&m[i] + m[i].koff, key, klen))
+            return i;
+    return LEPT_KEY_NOT_EXIST;
+}
+
+
+const lept_snap_value* lept_snap_find_object_value(const lept_snap_value* val, const char* key, size_t klen)
+{
+    size_t index = lept_snap_find_object_index(val, key, klen);
+    return LEPT_KEY_NOT_EXIST != index ? lept_snap_get_object_value(val, index) : NULL;
+}
+
+
+/*  JSON Pointer */
+/*  取出 p（指向 '/'）之后的一个引用标记，把 ~0、~1 还原为 ~、/ 后放在 con 的栈顶之上
+    tok 在下一次压栈之前有效，返回标记结束的位置，格式错误返回 NULL */
+const char* lept_pointer_token(lept_context* con, const char* p, const char* end, const char** tok, size_t* len)
+{
+    size_t head = con->top;
+    assert('/' == *p);
+    for(p++; p < end && '/' != *p; p++)
+    {
+        if('~' != *p)
+            PUTC(con, *p);
+        else if(p + 1 < end && ('0' == p[1] || '1' == p[1]))
         {
-            case '\"':
-                /*  pop 函数使 con->stack 指回初入栈时的位置，实现弹栈
-                    同时这个位置是写入到 stack 的字符串的首地址
-                    通过后面的 lept_set_string() 将 stack 的字符串写入到 val->u.s.str 中 */
-                *str = (char*)lept_context_pop(con, *len);
-                con->json = p;
-                return LEPT_PARSE_OK;
-            case '\\':
-                switch (*p++) 
-                {
-                    case '\"': PUTC(con, '\"'); break;
-                    case '\\': PUTC(con, '\\'); break;
-                    case '/':  PUTC(con, '/' ); break;
-                    case 'b':  PUTC(con, '\b'); break;
-                    case 'f':  PUTC(con, '\f'); break;
-                    case 'n':  PUTC(con, '\n'); break;
-                    case 'r':  PUTC(con, '\r'); break;
-                    case 't':  PUTC(con, '\t'); break;
-                    case 'u':
-                        if(!(p = lept_parse_hex4(p, &u)))
-                            STRING_ERROR(LEPT_PARSE_INVALID_UNICODE_HEX);                            
-                        if((u >= 0xD800) && (u <= 0xDBFF)) 
-                        { /* surrogate pair */
-                            if (*p++ != '\\')
-                                STRING_ERROR(LEPT_PARSE_INVALID_UNICODE_SURROGATE);
-                            if (*p++ != 'u')
-                                STRING_ERROR(LEPT_PARSE_INVALID_UNICODE_SURROGATE);
-                            if (!(p = lept_parse_hex4(p, &u2)))
-                                STRING_ERROR(LEPT_PARSE_INVALID_UNICODE_HEX);
-                            if (u2 < 0xDC00 || u2 > 0xDFFF)
-                                STRING_ERROR(LEPT_PARSE_INVALID_UNICODE_SURROGATE);
-                            u = (((u - 0xD800) << 10) | (u2 - 0xDC00)) + 0x10000;
-                        }
-                        lept_encode_utf8(con, u);
-                        break;
-                    default:
-                        /*  无效转义字符部分 */
-                        STRING_ERROR(LEPT_PARSE_INVALID_STRING_ESCAPE);
+            PUTC(con, '0' == p[1] ? '~' : '/');
+            p++;
+        }
+        else
+        {
+            con->top = head;
+            return NULL;
+        }
+    }
+    *len = con->top - head;
+    *tok = *len > 0 ? (const char*)lept_context_pop(con, *len) : "";
+    return p;
+}
+
+
+/*  数组下标不能有前导 0，"-" 表示最后一个元素之后，格式错误返回 LEPT_KEY_NOT_EXIST */
+size_t lept_pointer_index(const char* s, size_t len, size_t size)
+{
+    size_t i = 0, index = 0;
+    if(1 == len && '-' == s[0])
+        return size;
+    if(0 == len || (len > 1 && '0' == s[0]))
+        return LEPT_KEY_NOT_EXIST;
+    for(i = 0; i < len; i++)
+    {
+        if(!ISDIGIT(s[i]) || index > ((size_t)-1 - 9) / 10)
+            return LEPT_KEY_NOT_EXIST;
+        index = index * 10 + (s[i] - '0');
+    }
+    return index;
+}
+
+
+/*  沿 [p, end) 的 JSON Pointer 向下查找，找不到返回 NULL
+    tmp 为 NULL 时是写入：进入每个容器之前先 lept_unshare，紧凑数组转换回普通数组，使返回的节点可以写入；
+    否则只读，不修改任何节点，紧凑数组的元素在 tmp 中构造 */
+lept_value* lept_pointer_walk(lept_value* val, const char* p, const char* end, lept_value* tmp, lept_context* con)
+{
+    size_t len = 0, index = 0;
+    const char* tok;
+    while(p < end)
+    {
+        if('/' != *p)
+            return NULL;
+        if(NULL == tmp)
+            lept_unshare(val);
+        if(NULL == (p = lept_pointer_token(con, p, end, &tok, &len)))
+            return NULL;
+        if(LEPT_OBJECT == val->type)
+        {
+            if(LEPT_KEY_NOT_EXIST == (index = lept_find_object_index(val, tok, len)))
+                return NULL;
+            val = &val->u.o.m[index].val;
+        }
+        else if(LEPT_ARRAY == val->type)
+        {
+            if((index = lept_pointer_index(tok, len, val->u.a.size)) >= val->u.a.size)
+                return NULL;
+            /*  写入时上面的 lept_unshare 已经把紧凑数组转换回普通数组 */
+            val = (lept_value*)(NULL != tmp ? lept_array_at(val, index, tmp) : &val->u.a.e[index]);
+        }
+        else
+            return NULL;
+    }
+    return val;
+}
+
+
+/*  最后一个引用标记的起始位置（'/'），没有返回 NULL */
+const char* lept_pointer_last(const char* p, const char* end)
+{
+    while(end > p)
+        if('/' == *--end)
+            return end;
+    return NULL;
+}
+
+
+const lept_value* lept_find_pointer_value(const lept_value* val, const char* pointer, size_t len, lept_value* tmp)
+{
+    lept_context con;
+    const lept_value* ret;
+    assert((NULL != val) && ((NULL != pointer) || (0 == len)) && (NULL != tmp));
+    lept_stream_init(&con, NULL);
+    ret = lept_pointer_walk((lept_value*)val, pointer, pointer + len, tmp, &con);
+    LEPT_FREE(con.stack);
+    return ret;
+}
+
+
+/*  JSON Merge Patch */
+void lept_merge_patch(lept_value* target, const lept_value* patch)
+{
+    size_t i = 0, index = 0;
+    const lept_member* m;
+    assert((NULL != target) && (NULL != patch));
+    if(LEPT_OBJECT != patch->type)
+    {
+        lept_copy(target, patch);
+        return;
+    }
+    if(LEPT_OBJECT != target->type)
+        lept_set_object(target, patch->u.o.size);
+    for(i = 0; i < patch->u.o.size; i++)
+    {
+        m = &patch->u.o.m[i];
+        if(LEPT_NULL == m->val.type)
+        {
+            if(LEPT_KEY_NOT_EXIST != (index = lept_find_object_index(target, m->k, m->klen)))
+                lept_remove_object_value(target, index);
+        }
+        else
+            lept_merge_patch(lept_set_object_value(target, m->k, m->klen), &m->val);
+    }
+}
+
+
+/*  JSON Patch */
+/*  把 v 移动到 path 指向的位置：对象设置成员，数组在下标处插入 */
+int lept_patch_add(lept_value* doc, const char* path, size_t plen, lept_value* v, lept_context* con)
+{
+    const char *last, *tok;
+    lept_value* parent;
+    size_t len = 0, index = 0;
+    if(0 == plen)
+    {
+        lept_move(doc, v);
+        return LEPT_PATCH_OK;
+    }
+    if(NULL == (last = lept_pointer_last(path, path + plen)))
+        return LEPT_PATCH_INVALID_POINTER;
+    if(NULL == (parent = lept_pointer_walk(doc, path, last, NULL, con)))
+        return LEPT_PATCH_PATH_NOT_FOUND;
+    if(NULL == lept_pointer_token(con, last, path + plen, &tok, &len))
+        return LEPT_PATCH_INVALID_POINTER;
+    if(LEPT_OBJECT == parent->type)
+        lept_move(lept_set_object_value(parent, tok, len), v);
+    else if(LEPT_ARRAY == parent->type)
+    {
+        if((index = lept_pointer_index(tok, len, parent->u.a.size)) > parent->u.a.size)
+            return LEPT_PATCH_PATH_NOT_FOUND;
+        lept_move(lept_insert_array_element(parent, index), v);
+    }
+    else
+        return LEPT_PATCH_PATH_NOT_FOUND;
+    return LEPT_PATCH_OK;
+}
+
+
+/*  删除 path 指向的值，out 不为 NULL 时把被删除的值移动到 out 中 */
+int lept_patch_remove(lept_value* doc, const char* path, size_t plen, lept_value* out, lept_context* con)
+{
+    const char *last, *tok;
+    lept_value* parent;
+    size_t len = 0, index = 0;
+    if(NULL == (last = lept_pointer_last(path, path + plen)))
+        return LEPT_PATCH_INVALID_POINTER;
+    if(NULL == (parent = lept_pointer_walk(doc, path, last, NULL, con)))
+        return LEPT_PATCH_PATH_NOT_FOUND;
+    if(NULL == lept_pointer_token(con, last, path + plen, &tok, &len))
+        return LEPT_PATCH_INVALID_POINTER;
+    lept_unshare(parent);
+    if(LEPT_OBJECT == parent->type)
+    {
+        if(LEPT_KEY_NOT_EXIST == (index = lept_find_object_index(parent, tok, len)))
+            return LEPT_PATCH_PATH_NOT_FOUND;
+        if(NULL != out)
+            lept_move(out, &parent->u.o.m[index].val);
+        lept_remove_object_value(parent, index);
+    }
+    else if(LEPT_ARRAY == parent->type)
+    {
+        if((index = lept_pointer_index(tok, len, parent->u.a.size)) >= parent->u.a.size)
+            return LEPT_PATCH_PATH_NOT_FOUND;
+        if(NULL != out)
+            lept_move(out, lept_get_array_element(parent, index));
+        lept_erase_array_element(parent, index, 1);
+    }
+    else
+        return LEPT_PATCH_PATH_NOT_FOUND;
+    return LEPT_PATCH_OK;
+}
+
+
+int lept_patch_op(lept_value* doc, const lept_value* op, lept_context* con)
+{
+    const lept_value *name, *path, *from = NULL, *value = NULL;
+    const char *p, *f = NULL;
+    size_t plen = 0, flen = 0;
+    lept_value tmp, num, *target;
+    int ret;
+    if(LEPT_OBJECT != op->type)
+        return LEPT_PATCH_INVALID_PATCH;
+    name = lept_find_object_value(op, "op", 2);
+    path = lept_find_object_value(op, "path", 4);
+    if(NULL == name || LEPT_STRING != name->type || NULL == path || LEPT_STRING != path->type)
+        return LEPT_PATCH_INVALID_PATCH;
+    p = lept_get_string(path);
+    plen = lept_get_string_length(path);
+    lept_string_decode(name);
+#define LEPT_PATCH_IS(lit) (name->u.s.len == sizeof(lit) - 1 && 0 == memcmp(name->u.s.str, lit, sizeof(lit) - 1))
+    if(LEPT_PATCH_IS("add") || LEPT_PATCH_IS("replace") || LEPT_PATCH_IS("test"))
+    {
+        if(NULL == (value = lept_find_object_value(op, "value", 5)))
+            return LEPT_PATCH_INVALID_PATCH;
+    }
+    else if(LEPT_PATCH_IS("move") || LEPT_PATCH_IS("copy"))
+    {
+        if(NULL == (from = lept_find_object_value(op, "from", 4)) || LEPT_STRING != from->type)
+            return LEPT_PATCH_INVALID_PATCH;
+        f = lept_get_string(from);
+        flen = lept_get_string_length(from);
+    }
+    else if(!LEPT_PATCH_IS("remove"))
+        return LEPT_PATCH_INVALID_PATCH;
+
+    if(0 != plen && '/' != p[0])
+        return LEPT_PATCH_INVALID_POINTER;
+    lept_init(&tmp);
+    switch(name->u.s.str[0])
+    {
+        case 'a':   /*  add */
+            lept_copy(&tmp, value);
+            break;
+        case 'r':
+            if('m' == name->u.s.str[2])     /*  remove */
+                return lept_patch_remove(doc, p, plen, NULL, con);
+            /*  replace：目标必须存在，直接覆盖 */
+            if(NULL == (target = lept_pointer_walk(doc, p, p + plen, NULL, con)))
+                return LEPT_PATCH_PATH_NOT_FOUND;
+            lept_copy(target, value);
+            return LEPT_PATCH_OK;
+        case 't':   /*  test */
+            if(NULL == (target = lept_pointer_walk(doc, p, p + plen, &num, con)))
+                return LEPT_PATCH_PATH_NOT_FOUND;
+            return lept_is_equal(target, value) ? LEPT_PATCH_OK : LEPT_PATCH_TEST_FAILED;
+        case 'm':   /*  move：from 不能是 path 的祖先 */
+            if(flen == plen && 0 == memcmp(f, p, plen))
+                return lept_pointer_walk(doc, f, f + flen, &num, con) ? LEPT_PATCH_OK : LEPT_PATCH_PATH_NOT_FOUND;
+            if(flen < plen && 0 == memcmp(f, p, flen) && '/' == p[flen])
+                return LEPT_PATCH_INVALID_PATCH;
+            if(0 == flen)
+                return LEPT_PATCH_INVALID_PATCH;
+            if(LEPT_PATCH_OK != (ret = lept_patch_remove(doc, f, flen, &tmp, con)))
+                return ret;
+            break;
+        case 'c':   /*  copy */
+            if(NULL == (target = lept_pointer_walk(doc, f, f + flen, &num, con)))
+                return LEPT_PATCH_PATH_NOT_FOUND;
+            lept_copy(&tmp, target);
+            break;
+    }
+#undef LEPT_PATCH_IS
+    if(LEPT_PATCH_OK != (ret = lept_patch_add(doc, p, plen, &tmp, con)))
+        lept_free(&tmp);
+    return ret;
+}
+
+
+int lept_apply_patch(lept_value* doc, const lept_value* patch)
+{
+    lept_context con;
+    lept_value tmp;
+    size_t i = 0;
+    int ret = LEPT_PATCH_OK;
+    assert((NULL != doc) && (NULL != patch));
+    if(LEPT_ARRAY != patch->type)
+        return LEPT_PATCH_INVALID_PATCH;
+    lept_stream_init(&con, NULL);
+    for(i = 0; i < patch->u.a.size && LEPT_PATCH_OK == ret; i++)
+    {
+        ret = lept_patch_op(doc, lept_array_at(patch, i, &tmp), &con);
+        con.top = 0;
+    }
+    LEPT_FREE(con.stack);
+    return ret;
+}
+
+
+/*  diff */
+/*  在 path 末尾加上 "/key"，转义 ~ 和 / */
+void lept_diff_push_key(lept_context* path, const char* k, size_t klen)
+{
+    size_t i = 0;
+    PUTC(path, '/');
+    for(i = 0; i < klen; i++)
+    {
+        if('~' == k[i])
+            PUTS(path, "~0", 2);
+        else if('/' == k[i])
+            PUTS(path, "~1", 2);
+        else
+            PUTC(path, k[i]);
+    }
+}
+
+
+void lept_diff_emit(lept_value* patch, const char* op, const lept_context* path, const lept_value* value)
+{
+    lept_value* o = lept_pushback_array_element(patch);
+    lept_set_object(o, 3);
+    lept_set_string(lept_set_object_value(o, "op", 2), op, strlen(op));
+    lept_set_string(lept_set_object_value(o, "path", 4), path->stack, path->top);
+    if(NULL != value)
+        lept_copy(lept_set_object_value(o, "value", 5), value);
+}
+
+
+void lept_diff_value(lept_value* patch, lept_context* path, const lept_value* from, const lept_value* to)
+{
+    size_t i = 0, n = 0, head = path->top;
+    char buf[32];
+    const lept_member* m;
+    lept_value ta, tb;
+    if(from->type != to->type)
+    {
+        lept_diff_emit(patch, "replace", path, to);
+        return;
+    }
+    if(LEPT_OBJECT == from->type)
+    {
+        for(i = 0; i < from->u.o.size; i++)
+        {
+            m = &from->u.o.m[i];
+            if(LEPT_KEY_NOT_EXIST == lept_find_member(to, m->k, m->klen, m->khash))
+            {
+                lept_diff_push_key(path, m->k, m->klen);
+                lept_diff_emit(patch, "remove", path, NULL);
+                path->top = head;
+            }
+        }
+        for(i = 0; i < to->u.o.size; i++)
+        {
+            m = &to->u.o.m[i];
+            n = lept_find_member(from, m->k, m->klen, m->khash);
+            lept_diff_push_key(path, m->k, m->klen);
+            if(LEPT_KEY_NOT_EXIST == n)
+                lept_diff_emit(patch, "add", path, &m->val);
+            else
+                lept_diff_value(patch, path, &from->u.o.m[n].val, &m->val);
+            path->top = head;
+        }
+    }
+    else if(LEPT_ARRAY == from->type)
+    {
+        n = from->u.a.size < to->u.a.size ? from->u.a.size : to->u.a.size;
+        for(i = 0; i < to->u.a.size; i++)
+        {
+            sprintf(buf, "/%lu", (unsigned long)i);
+            PUTS(path, buf, strlen(buf));
+            if(i < n)
+                lept_diff_value(patch, path, lept_array_at(from, i, &ta), lept_array_at(to, i, &tb));
+            else
+                lept_diff_emit(patch, "add", path, lept_array_at(to, i, &tb));
+            path->top = head;
+        }
+        /*  从后往前删除多余的元素，前面的下标不受影响 */
+        for(i = from->u.a.size; i > n; i--)
+        {
+            sprintf(buf, "/%lu", (unsigned long)(i - 1));
+            PUTS(path, buf, strlen(buf));
+            lept_diff_emit(patch, "remove", path, NULL);
+            path->top = head;
+        }
+    }
+    else if(!lept_is_equal(from, to))
+        lept_diff_emit(patch, "replace", path, to);
+}
+
+
+void lept_diff(const lept_value* from, const lept_value* to, lept_value* patch)
+{
+    lept_context path;
+    assert((NULL != from) && (NULL != to) && (NULL != patch));
+    lept_stream_init(&path, NULL);
+    lept_set_array(patch, 0);
+    lept_diff_value(patch, &path, from, to);
+    LEPT_FREE(path.stack);
+}
+
+
+/*  并行 */
+/*  nthreads < 1 时取 CPU 核数，不支持线程时为 1 */
+int lept_thread_count(int nthreads)
+{
+#ifdef LEPT_THREADS
+    if(nthreads < 1)
+        nthreads = (int)sysconf(_SC_NPROCESSORS_ONLN);
+#else
+    nthreads = 1;
+#endif
+    return nthreads < 1 ? 1 : nthreads;
+}
+
+
+/*  对 args 中的 n 个参数（每个 size 字节）并行调用 fn，第一个在调用线程中执行；
+    创建线程失败时在调用线程中依次执行 */
+void lept_run_parallel(void* (*fn)(void*), void* args, size_t size, size_t n)
+{
+    size_t i;
+#ifdef LEPT_THREADS
+    pthread_t* tid = (pthread_t*)LEPT_MALLOC(n * sizeof(pthread_t));
+    unsigned char* created = (unsigned char*)lept_calloc(n, 1);
+    for(i = 1; i < n; i++)
+        created[i] = 0 == pthread_create(&tid[i], NULL, fn, (char*)args + i * size);
+    fn(args);
+    for(i = 1; i < n; i++)
+    {
+        if(created[i])
+            pthread_join(tid[i], NULL);
+        else
+            fn((char*)args + i * size);
+    }
+    LEPT_FREE(created);
+    LEPT_FREE(tid);
+#else
+    for(i = 0; i < n; i++)
+        fn((char*)args + i * size);
+#endif
+}
+
+
+/*  预扫描顶层数组，把各元素的起始位置压入 starts，识别字符串和转义，不检查其他语法
+    不是非空数组或结构不完整时返回 0，交给 lept_parse 报告错误 */
+int lept_parallel_scan(lept_parallel_array* pa, lept_context* starts)
+{
+    const char* json = pa->json;
+    const char* p = json;
+    size_t depth = 0, pos;
+    while(' ' == *p || '\t' == *p || '\n' == *p || '\r' == *p)
+        p++;
+    if('[' != *p++)
+        return 0;
+    while(' ' == *p || '\t' == *p || '\n' == *p || '\r' == *p)
+        p++;
+    if(']' == *p)
+        return 0;
+    pos = (size_t)(p - json);
+    memcpy(lept_context_push(starts, sizeof(size_t)), &pos, sizeof(size_t));
+    for(;; p++)
+    {
+        switch(*p)
+        {
+            case '"':
+                for(p++; '"' != *p; p++)
+                {
+                    if('\0' == *p || ('\\' == *p && '\0' == *++p))
+                        return 0;
+                }
+                break;
+            case '[':
+            case '{':
+                depth++;
+                break;
+            case ']':
+            case '}':
+                if(0 == depth)
+                {
+                    if(']' != *p)
+                        return 0;
+                    pa->end = (size_t)(p - json);
+                    for(p++; ' ' == *p || '\t' == *p || '\n' == *p || '\r' == *p; p++)
+                        ;
+                    return '\0' == *p;
+                }
+                depth--;
+                break;
+            case ',':
+                if(0 == depth)
+                {
+                    pos = (size_t)(p + 1 - json);
+                    memcpy(lept_context_push(starts, sizeof(size_t)), &pos, sizeof(size_t));
                 }
                 break;
             case '\0':
-                STRING_ERROR(LEPT_PARSE_MISS_QUOTATION_MARK);
+                return 0;
             default:
-                /*  不合法字符串部分 */
-                if ((unsigned char)ch < 0x20) 
-                        STRING_ERROR(LEPT_PARSE_INVALID_STRING_CHAR);
-                PUTC(con, ch); /*   每入栈一次，top 大小 +1 */
+                break;
         }
     }
-
 }
 
 
-int lept_parse_string(lept_context* con, lept_value* val) 
+/*  依次领取一段连续的元素解析，元素必须恰好结束在预扫描得到的逗号或 ']' 处 */
+void* lept_parallel_array_work(void* arg)
 {
+    lept_parallel_array_worker* w = (lept_parallel_array_worker*)arg;
+    lept_parallel_array* pa = w->pa;
+    size_t t, i, last, end;
     int ret;
-    char* sta;
-    size_t len;
-    if ((ret = lept_parse_string_raw(con, &sta, &len)) == LEPT_PARSE_OK)
-        lept_set_string(val, sta, len);
-    return ret;
+    while(!LEPT_ATOMIC_LOAD(&pa->failed) && (t = LEPT_ATOMIC_INC(&pa->next) - 1) < pa->ntasks)
+    {
+        last = pa->n * (t + 1) / pa->ntasks;
+        for(i = pa->n * t / pa->ntasks; i < last; i++)
+        {
+            end = i + 1 < pa->n ? pa->start[i + 1] - 1 : pa->end;
+            w->con.json = pa->json + pa->start[i];
+            lept_parse_whitespace(&w->con);
+            if(LEPT_PARSE_OK == (ret = lept_parse_value(&w->con, &pa->e[i])))
+                lept_parse_whitespace(&w->con);
+            if(LEPT_PARSE_OK != ret || w->con.json != pa->json + end)
+            {
+                LEPT_ATOMIC_INC(&pa->failed);
+                return NULL;
+            }
+        }
+    }
+    return NULL;
 }
 
 
-/*  读取字符串中的十六进制字符段并分析成数值 */
-char* lept_parse_hex4(const char *p, unsigned* u)
+int lept_parse_parallel(lept_value* val, const char* json, int nthreads)
 {
-    /*  使用 stdlib 函数 strtol() 把字符串转换为数值 
-        long int strtol(const char *str, char **endptr, int base)
-        把参数 str 所指向的字符串根据给定的 base 转换为一个 long int 型数
-        base 为进制数 */
-    char* end;
-    /*  strtol() 会跳过开始的空白，接受 "\u 123" 这种不合法的 JSON
-        所以用 ctype.h 函数 isspace() 首先判断 \u 后面是不是空字符
-        如果是控制符，则返回 true，否则 false */
-    int iss = isspace(*p);
-    if(iss)
-        return NULL;
-    *u = (unsigned)strtol(p, &end, 16);
-    return end == p + 4 ? end : NULL;
+    lept_parallel_array pa;
+    lept_parallel_array_worker* w;
+    lept_context starts;
+    size_t i;
+    assert((NULL != val) && (NULL != json));
+    nthreads = lept_thread_count(nthreads);
+    if(1 == nthreads || strlen(json) < LEPT_PARALLEL_PARSE_THRESHOLD)
+        return lept_parse(val, json);
+    lept_init(val);
+    pa.json = json;
+    lept_stream_init(&starts, NULL);
+    if(!lept_parallel_scan(&pa, &starts))
+    {
+        LEPT_FREE(starts.stack);
+        return lept_parse(val, json);
+    }
+    pa.start = (size_t*)starts.stack;
+    pa.n = starts.top / sizeof(size_t);
+    if(pa.n < (size_t)nthreads)
+        nthreads = (int)pa.n;
+    /*  每个线程平均领取 4 段，使各线程的工作量接近 */
+    pa.ntasks = pa.n < 4 * (size_t)nthreads ? pa.n : 4 * (size_t)nthreads;
+    pa.next = 0;
+    pa.failed = 0;
+    /*  calloc 使未解析的元素都是 null，出错时可以统一释放 */
+    pa.e = (lept_value*)lept_calloc(pa.n, sizeof(lept_value));
+    w = (lept_parallel_array_worker*)lept_calloc((size_t)nthreads, sizeof(lept_parallel_array_worker));
+    for(i = 0; i < (size_t)nthreads; i++)
+        w[i].pa = &pa;
+    lept_run_parallel(lept_parallel_array_work, w, sizeof(lept_parallel_array_worker), (size_t)nthreads);
+    for(i = 0; i < (size_t)nthreads; i++)
+        LEPT_FREE(w[i].con.stack);
+    LEPT_FREE(w);
+    LEPT_FREE(starts.stack);
+    if(pa.failed)
+    {
+        /*  由 lept_parse 重新解析，得到与串行解析相同的错误码 */
+        for(i = 0; i < pa.n; i++)
+            lept_free(&pa.e[i]);
+        LEPT_FREE(pa.e);
+        return lept_parse(val, json);
+    }
+    val->type = LEPT_ARRAY;
+    val->u.a.e = pa.e;
+    val->u.a.size = val->u.a.capacity = pa.n;
+    return LEPT_PARSE_OK;
 }
 
 
-/*  编码 unicode */
-void lept_encode_utf8(lept_context* con, unsigned u) 
+/*  依次领取一段元素生成到该段自己的缓冲区 */
+void* lept_parallel_stringify_work(void* arg)
 {
-    if(u <= 0x7F) 
-        PUTC(con, u & 0xFF);
-    else if(u <= 0x7FF) 
-    {
-        PUTC(con, 0xC0 | ((u >> 6) & 0xFF));
-        PUTC(con, 0x80 | ( u       & 0x3F));
-    }
-    else if(u <= 0xFFFF) 
+    lept_parallel_stringify* ps = *(lept_parallel_stringify**)arg;
+    size_t t;
+    while((t = LEPT_ATOMIC_INC(&ps->next) - 1) < ps->ntasks)
     {
-        PUTC(con, 0xE0 | ((u >> 12) & 0xFF));
-        PUTC(con, 0x80 | ((u >>  6) & 0x3F));
-        PUTC(con, 0x80 | ( u        & 0x3F));
+        ps->out[t].size = LEPT_PARSE_STRINGIFY_INIT_SIZE;
+        ps->out[t].stack = (char*)LEPT_MALLOC(ps->out[t].size);
+        lept_stringify_range(&ps->out[t], ps->val, ps->n * t / ps->ntasks, ps->n * (t + 1) / ps->ntasks);
     }
-    else
+    return NULL;
+}
+
+
+char* lept_stringify_parallel(const lept_value* val, size_t* length, int nthreads)
+{
+    lept_parallel_stringify ps;
+    lept_parallel_stringify** args;
+    char *json, *p;
+    size_t t, total;
+    assert(NULL != val);
+    nthreads = lept_thread_count(nthreads);
+    ps.n = LEPT_ARRAY == val->type ? val->u.a.size : LEPT_OBJECT == val->type ? val->u.o.size : 0;
+    if(1 == nthreads || ps.n < LEPT_PARALLEL_STRINGIFY_THRESHOLD)
+        return lept_stringify(val, length);
+    ps.val = val;
+    ps.ntasks = 4 * (size_t)nthreads;
+    ps.next = 0;
+    ps.out = (lept_context*)lept_calloc(ps.ntasks, sizeof(lept_context));
+    args = (lept_parallel_stringify**)LEPT_MALLOC((size_t)nthreads * sizeof(lept_parallel_stringify*));
+    for(t = 0; t < (size_t)nthreads; t++)
+        args[t] = &ps;
+    lept_run_parallel(lept_parallel_stringify_work, args, sizeof(lept_parallel_stringify*), (size_t)nthreads);
+    LEPT_FREE(args);
+    /*  各段依次拷贝到最终的缓冲区，加上括号和结尾的 '\0' */
+    for(total = 2, t = 0; t < ps.ntasks; t++)
+        total += ps.out[t].top;
+    p = json = (char*)LEPT_MALLOC(total + 1);
+    *p++ = LEPT_ARRAY == val->type ? '[' : '{';
+    for(t = 0; t < ps.ntasks; t++)
     {
-        assert(u <= 0x10FFFF);
-        PUTC(con, 0xF0 | ((u >> 18) & 0xFF));
-        PUTC(con, 0x80 | ((u >> 12) & 0x3F));
-        PUTC(con, 0x80 | ((u >>  6) & 0x3F));
-        PUTC(con, 0x80 | ( u        & 0x3F));
+        if(ps.out[t].top > 0)
+            memcpy(p, ps.out[t].stack, ps.out[t].top);
+        p += ps.out[t].top;
+        LEPT_FREE(ps.out[t].stack);
     }
+    *p++ = LEPT_ARRAY == val->type ? ']' : '}';
+    *p = '\0';
+    LEPT_FREE(ps.out);
+    if(length)
+        *length = total;
+    return json;
 }
 
 
-/*  解析数组 */
-int lept_parse_array(lept_context* con, lept_value* val)
+/*  流水线 */
+void lept_mpmc_init(lept_mpmc* q, size_t capacity)
 {
+    size_t i, n = 2;
+    while(n < capacity)
+        n <<= 1;
+    q->cells = (lept_mpmc_cell*)LEPT_MALLOC(n * sizeof(lept_mpmc_cell));
+    for(i = 0; i < n; i++)
+        q->cells[i].seq = i;
+    q->mask = n - 1;
+    q->enq = q->deq = 0;
+}
 
-    size_t size = 0;
-    int i = 0;
-    int ret = 0;
-    EXPECT(con, '[');
-    lept_parse_whitespace(con);    
-    while(1)
-    {
-        lept_value e;
-        lept_init(&e);
 
-        if(']' == *con->json)
+/*  队列满时返回 0 */
+int lept_mpmc_push(lept_mpmc* q, void* data)
+{
+    lept_mpmc_cell* cell;
+    size_t pos = LEPT_ATOMIC_LOAD_ACQ(&q->enq);
+    ptrdiff_t dif;
+    for(;;)
+    {
+        cell = &q->cells[pos & q->mask];
+        dif = (ptrdiff_t)(LEPT_ATOMIC_LOAD_ACQ(&cell->seq) - pos);
+        if(0 == dif)
         {
-            con->json++;
-            val->type = LEPT_ARRAY;
-            val->u.a.size = size;
-            /*  数组中没有元素 */
-            if(0 == size)
-                val->u.a.e = NULL;
-            /*  有元素 */
-            else 
-            {
-                size *= sizeof(lept_value);
-                memcpy(val->u.a.e = (lept_value*)malloc(size), lept_context_pop(con, size), size);
-            }
-            return LEPT_PARSE_OK;
+            if(LEPT_ATOMIC_CAS(&q->enq, pos, pos + 1))
+                break;
+            pos = LEPT_ATOMIC_LOAD_ACQ(&q->enq);
         }
+        else if(dif < 0)
+            return 0;
+        else
+            pos = LEPT_ATOMIC_LOAD_ACQ(&q->enq);
+    }
+    cell->data = data;
+    LEPT_ATOMIC_STORE_REL(&cell->seq, pos + 1);
+    return 1;
+}
 
-        /*  调用了 lept_parse_value，进行数组当中的其他元素的解析 */
-        if(LEPT_PARSE_OK != (ret = lept_parse_value(con, &e)) )
-            break;
-            
-        /*  入栈申请内存 
-            根据这个元素的类型申请不同长度的内存 
-            然后使用 memcpy 把这个元素复制到这段内存中，完成入栈 */
-        memcpy(lept_context_push(con, sizeof(lept_value)), &e, sizeof(lept_value));
-        size++;
-        lept_parse_whitespace(con);
-        if((',' != *con->json) && (']' != *con->json))
+
+/*  批量出队：先数出从 deq 开始连续可出队的格子（最多 max 个），再用一次 CAS 全部认领
+    被认领之前这些格子不会被别人取走，所以认领之后可以放心读取；返回取出的个数 */
+size_t lept_mpmc_pop(lept_mpmc* q, void** data, size_t max)
+{
+    size_t pos = LEPT_ATOMIC_LOAD_ACQ(&q->deq), n, i;
+    ptrdiff_t dif = -1;
+    for(;;)
+    {
+        for(n = 0; n < max; n++)
         {
-            ret = LEPT_PARSE_MISS_COMMA_OR_SQUARE_BRACKET;
-            break;
+            dif = (ptrdiff_t)(LEPT_ATOMIC_LOAD_ACQ(&q->cells[(pos + n) & q->mask].seq) - (pos + n + 1));
+            if(0 != dif)
+                break;
         }
-
-        if(',' == *con->json)
+        if(0 == n)
         {
-            con->json++;            
-            lept_parse_whitespace(con);
-        }        
+            if(dif < 0)
+                return 0;
+            pos = LEPT_ATOMIC_LOAD_ACQ(&q->deq);
+        }
+        else if(LEPT_ATOMIC_CAS(&q->deq, pos, pos + n))
+            break;
+        else
+            pos = LEPT_ATOMIC_LOAD_ACQ(&q->deq);
+    }
+    for(i = 0; i < n; i++)
+    {
+        lept_mpmc_cell* cell = &q->cells[(pos + i) & q->mask];
+        data[i] = cell->data;
+        LEPT_ATOMIC_STORE_REL(&cell->seq, pos + i + q->mask + 1);
     }
+    return n;
+}
 
-    for (i = 0; i < size; i++)
-        lept_free((lept_value*)lept_context_pop(con, sizeof(lept_value)));
 
-    return ret;
+/*  单调时钟，单位纳秒 */
+double lept_now(void)
+{
+#if defined(__unix__) || defined(__APPLE__)
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec * 1e9 + (double)ts.tv_nsec;
+#else
+    return (double)clock() * (1e9 / CLOCKS_PER_SEC);
+#endif
 }
 
 
-/*  解析对象 */
-int lept_parse_object(lept_context* con, lept_value* val)
+/*  第 i 个桶记录 [2^i, 2^(i+1)) 纳秒，最后一个桶包括更长的时间 */
+void lept_hist_add(size_t* hist, double ns)
 {
-    size_t size = 0;
-    int i = 0;
-    int ret = 0;
-    lept_member m;
-    m.k = NULL;
-    EXPECT(con, '{');
-    lept_parse_whitespace(con);    
-    while(1)
+    size_t i = 0;
+    while(i + 1 < LEPT_PIPELINE_HIST_SIZE && ns >= 2.0)
     {
-        char* str;
-        lept_init(&m.val);
+        ns *= 0.5;
+        i++;
+    }
+    LEPT_ATOMIC_INC(&hist[i]);
+}
 
-        if('}' == *con->json)
+
+/*  解析一批消息，每条消息只取一次时间，上一条的结束时间就是下一条的开始时间 */
+void lept_pipeline_parse(lept_pipeline_worker* w, lept_pipeline_item** items, size_t n)
+{
+    size_t i;
+    double t = lept_now(), end;
+    for(i = 0; i < n; i++)
+    {
+        lept_hist_add(w->queue_wait, t - items[i]->t);
+        items[i]->ret = lept_parse_with(&w->con, &items[i]->val, items[i]->json);
+        end = lept_now();
+        lept_hist_add(w->parse, end - t);
+        items[i]->t = t = end;
+    }
+}
+
+
+#ifdef LEPT_THREADS
+/*  队列空或满时的等待：先自旋，再让出 CPU，最后短暂睡眠 */
+void lept_backoff(unsigned* spins)
+{
+    (*spins)++;
+    if(*spins > 64 && *spins <= 128)
+        sched_yield();
+    else if(*spins > 128)
+    {
+        struct timespec ts;
+        ts.tv_sec = 0;
+        ts.tv_nsec = 50000;
+        nanosleep(&ts, NULL);
+    }
+}
+
+
+void* lept_pipeline_work(void* arg)
+{
+    lept_pipeline_worker* w = (lept_pipeline_worker*)arg;
+    lept_pipeline_item* items[LEPT_PIPELINE_BATCH];
+    size_t n, i;
+    unsigned spins = 0;
+    int closed;
+    for(;;)
+    {
+        /*  先读 closed 再出队：关闭之前提交的消息一定能被取到 */
+        closed = LEPT_ATOMIC_LOAD_ACQ(&w->p->closed);
+        n = lept_mpmc_pop(&w->p->in, (void**)items, LEPT_PIPELINE_BATCH);
+        if(0 == n)
         {
-            con->json++;
-            val->type = LEPT_OBJECT;
-            val->u.o.size = size;
-            /*  数组中没有元素 */
-            if(0 == size)
-                val->u.o.m = NULL;
-            /*  有元素 */
-            else 
+            if(closed)
+                break;
+            lept_backoff(&spins);
+            continue;
+        }
+        spins = 0;
+        lept_pipeline_parse(w, items, n);
+        for(i = 0; i < n; i++)
+        {
+            /*  输出队列满时等待消费者取走，压力由此传回输入队列；销毁时直接释放 */
+            for(spins = 0; !lept_mpmc_push(&w->p->out, items[i]); lept_backoff(&spins))
             {
-                size *= sizeof(lept_member);
-                memcpy(val->u.o.m = (lept_member*)malloc(size), lept_context_pop(con, size), size);
+                if(LEPT_ATOMIC_LOAD_ACQ(&w->p->destroying))
+                {
+                    lept_free(&items[i]->val);
+                    lept_mpmc_push(&w->p->free, items[i]);
+                    break;
+                }
+                if(0 == spins)
+                    LEPT_ATOMIC_INC(&w->stalls);
             }
-            return LEPT_PARSE_OK;
         }
+        spins = 0;
+    }
+    return NULL;
+}
+#endif
 
-        /*  解析 object，object 是用引号扩着的一串字符串
-            把解析的字符串存到 str 指针指向的区域 */
-        if('"' != *con->json)
-        {
-            ret = LEPT_PARSE_MISS_KEY;
-            break;
-        }
-        if(LEPT_PARSE_OK != (ret = lept_parse_string_raw(con, &str, &m.klen)) )
-            break;
-        /*  复制到 m.k 中，最后放一个 '\0' 表示字符串结束 */
-        memcpy(m.k = (char*)malloc(m.klen + 1), str, m.klen);
-        m.k[m.klen] = '\0'; 
-        lept_parse_whitespace(con);
 
-        /*  object 后面必须接着冒号 */
-        if(':' != *con->json)
-        {
-            ret = LEPT_PARSE_MISS_COLON;
+lept_pipeline* lept_pipeline_create(size_t capacity, int nworkers)
+{
+    lept_pipeline* p = (lept_pipeline*)lept_calloc(1, sizeof(lept_pipeline));
+    size_t i;
+    assert(capacity > 0);
+    nworkers = lept_thread_count(nworkers);
+#ifndef LEPT_THREADS
+    nworkers = 0;
+#endif
+    p->nworkers = (size_t)nworkers;
+    lept_mpmc_init(&p->in, capacity);
+    lept_mpmc_init(&p->out, capacity);
+    /*  消息总数：两个队列都满，且每个解析线程手上还有一批 */
+    p->nitems = p->in.mask + 1 + p->out.mask + 1 + p->nworkers * LEPT_PIPELINE_BATCH;
+    lept_mpmc_init(&p->free, p->nitems);
+    p->items = (lept_pipeline_item*)lept_calloc(p->nitems, sizeof(lept_pipeline_item));
+    for(i = 0; i < p->nitems; i++)
+        lept_mpmc_push(&p->free, &p->items[i]);
+    p->workers = (lept_pipeline_worker*)lept_calloc(p->nworkers + 1, sizeof(lept_pipeline_worker));
+    for(i = 0; i <= p->nworkers; i++)
+        p->workers[i].p = p;
+#ifdef LEPT_THREADS
+    p->tid = (pthread_t*)LEPT_MALLOC((p->nworkers + 1) * sizeof(pthread_t));
+    for(i = 0; i < p->nworkers; i++)
+        if(0 != pthread_create(&p->tid[i], NULL, lept_pipeline_work, &p->workers[i]))
             break;
-        }    
-        con->json++;
-        lept_parse_whitespace(con);
+    p->nworkers = i;
+#endif
+    return p;
+}
 
-        /*  解析里面的元素 */
-        if(LEPT_PARSE_OK != (ret = lept_parse_value(con, &m.val)) )
-            break;
-        /*  入栈申请内存 
-            根据这个元素的类型申请不同长度的内存 
-            然后使用 memcpy 把这个元素复制到这段内存中，完成入栈 */
-        memcpy(lept_context_push(con, sizeof(lept_member)), &m, sizeof(lept_member));
-        size++;
-        m.k = NULL;
-        lept_parse_whitespace(con);
-        if((',' != *con->json) && ('}' != *con->json))
-        {
-            ret = LEPT_PARSE_MISS_COMMA_OR_CURLY_BRACKET;
-            break;
-        }
 
-        if(',' == *con->json)
+int lept_pipeline_submit(lept_pipeline* p, const char* json, void* user)
+{
+    lept_pipeline_item* item;
+    assert((NULL != p) && (NULL != json));
+    if(LEPT_ATOMIC_LOAD_ACQ(&p->closed))
+        return LEPT_PIPELINE_CLOSED;
+    /*  空闲消息用完说明两个队列都已积压，拒绝提交 */
+    if(0 == lept_mpmc_pop(&p->free, (void**)&item, 1))
+    {
+        LEPT_ATOMIC_INC(&p->rejected);
+        return LEPT_PIPELINE_FULL;
+    }
+    item->json = json;
+    item->user = user;
+    item->t = lept_now();
+    if(0 == p->nworkers)
+    {
+        /*  没有解析线程（不支持线程或创建失败）时在提交的线程中解析，workers[nworkers] 是它的上下文 */
+        lept_pipeline_parse(&p->workers[p->nworkers], &item, 1);
+        if(lept_mpmc_push(&p->out, item))
+            return LEPT_PIPELINE_OK;
+        lept_free(&item->val);
+        lept_mpmc_push(&p->free, item);
+        LEPT_ATOMIC_INC(&p->rejected);
+        return LEPT_PIPELINE_FULL;
+    }
+    if(!lept_mpmc_push(&p->in, item))
+    {
+        lept_mpmc_push(&p->free, item);
+        LEPT_ATOMIC_INC(&p->rejected);
+        return LEPT_PIPELINE_FULL;
+    }
+    return LEPT_PIPELINE_OK;
+}
+
+
+size_t lept_pipeline_poll(lept_pipeline* p, lept_pipeline_result* out, size_t max)
+{
+    lept_pipeline_item* items[LEPT_PIPELINE_BATCH];
+    size_t n, i, total = 0;
+    double t;
+    assert((NULL != p) && (NULL != out || 0 == max));
+    while(total < max)
+    {
+        n = lept_mpmc_pop(&p->out, (void**)items, max - total < LEPT_PIPELINE_BATCH ? max - total : LEPT_PIPELINE_BATCH);
+        if(0 == n)
+            break;
+        t = lept_now();
+        for(i = 0; i < n; i++, total++)
         {
-            con->json++;            
-            lept_parse_whitespace(con);
+            lept_hist_add(p->result_wait, t - items[i]->t);
+            out[total].json = items[i]->json;
+            out[total].user = items[i]->user;
+            out[total].ret = items[i]->ret;
+            out[total].val = items[i]->val;
+            lept_mpmc_push(&p->free, items[i]);
         }
-        
     }
-    free(m.k);
-    for (i = 0; i < size; i++)
-        lept_free((lept_value*)lept_context_pop(con, sizeof(lept_value)));
-
-    return ret;
+    return total;
 }
 
 
+void lept_pipeline_close(lept_pipeline* p)
+{
+    assert(NULL != p);
+    LEPT_ATOMIC_STORE_REL(&p->closed, 1);
+}
+
 
-/*  获取 JSON 的数据类型 */
-lept_type lept_get_type(const lept_value* val) 
+/*  关闭之后，所有消息都已被取走（都回到了空闲队列）时返回 1 */
+int lept_pipeline_done(lept_pipeline* p)
 {
-    assert(val != NULL);
-    return val->type;
+    size_t deq;
+    assert(NULL != p);
+    if(!LEPT_ATOMIC_LOAD_ACQ(&p->closed))
+        return 0;
+    deq = LEPT_ATOMIC_LOAD_ACQ(&p->free.deq);
+    return LEPT_ATOMIC_LOAD_ACQ(&p->free.enq) - deq == p->nitems;
 }
 
 
-/*  boolean part */
-int lept_get_boolean(const lept_value* val)
+void lept_pipeline_get_stats(lept_pipeline* p, lept_pipeline_stats* stats)
 {
-    assert((NULL != val) && ((LEPT_TRUE == val->type) || (LEPT_FALSE == val->type)) );
-    /*  判断 LEPT_TRUE ?== val->type 返回 0(false) 还是 1(true) */
-    return (LEPT_TRUE == val->type);
+    size_t i, k;
+    assert((NULL != p) && (NULL != stats));
+    memset(stats, 0, sizeof(*stats));
+    /*  入队、出队的位置就是累计的次数 */
+    stats->submitted = LEPT_ATOMIC_LOAD_ACQ(&p->in.enq);
+    stats->parsed = LEPT_ATOMIC_LOAD_ACQ(&p->out.enq);
+    stats->polled = LEPT_ATOMIC_LOAD_ACQ(&p->out.deq);
+    stats->rejected = LEPT_ATOMIC_LOAD(&p->rejected);
+    for(k = 0; k < LEPT_PIPELINE_HIST_SIZE; k++)
+        stats->result_wait[k] = LEPT_ATOMIC_LOAD(&p->result_wait[k]);
+    for(i = 0; i <= p->nworkers; i++)
+    {
+        stats->stalls += LEPT_ATOMIC_LOAD(&p->workers[i].stalls);
+        for(k = 0; k < LEPT_PIPELINE_HIST_SIZE; k++)
+        {
+            stats->queue_wait[k] += LEPT_ATOMIC_LOAD(&p->workers[i].queue_wait[k]);
+            stats->parse[k] += LEPT_ATOMIC_LOAD(&p->workers[i].parse[k]);
+        }
+    }
+    /*  没有解析线程时消息不经过输入队列 */
+    if(0 == p->nworkers)
+        stats->submitted = stats->parsed;
 }
 
 
-void lept_set_boolean(lept_value* val, int boo)
+void lept_pipeline_destroy(lept_pipeline* p)
 {
-    assert(NULL != val);
-    lept_init(val);
-    if(boo) val->type = LEPT_TRUE;
-    else val->type = LEPT_FALSE;
+    lept_pipeline_item* item;
+    size_t i;
+    if(NULL == p)
+        return;
+    LEPT_ATOMIC_STORE_REL(&p->destroying, 1);
+    lept_pipeline_close(p);
+#ifdef LEPT_THREADS
+    for(i = 0; i < p->nworkers; i++)
+        pthread_join(p->tid[i], NULL);
+    LEPT_FREE(p->tid);
+#endif
+    /*  没有被取走的结果 */
+    while(lept_mpmc_pop(&p->out, (void**)&item, 1))
+        lept_free(&item->val);
+    for(i = 0; i <= p->nworkers; i++)
+        LEPT_FREE(p->workers[i].con.stack);
+    LEPT_FREE(p->workers);
+    LEPT_FREE(p->items);
+    LEPT_FREE(p->in.cells);
+    LEPT_FREE(p->out.cells);
+    LEPT_FREE(p->free.cells);
+    LEPT_FREE(p);
 }
 
 
-/*  number part */
-/*  传入 JSON 值的类型，保证类型为 LEPT_NUMBER，才能获取数值 */
-double lept_get_number(const lept_value* val) 
+/*  NDJSON */
+/*  解析第 k 段中的各行：行首位于 [k * C, (k + 1) * C) 的行属于第 k 段，最后一行可以越过段尾
+    按序交付时结果存入 chunks[k]，否则直接回调；回调要求停止时返回它的返回值 */
+int lept_ndjson_chunk_run(lept_ndjson_worker* w, size_t k)
 {
-    assert((NULL != val) && (LEPT_NUMBER == val->type));
-    return val->u.num;
+    lept_ndjson* nd = w->nd;
+    lept_ndjson_chunk* c = &nd->chunks[k];
+    const char* buf = nd->buf;
+    const char* p = buf + k * LEPT_NDJSON_CHUNK_SIZE;
+    const char* limit = (k + 1) * LEPT_NDJSON_CHUNK_SIZE < nd->len ? buf + (k + 1) * LEPT_NDJSON_CHUNK_SIZE : buf + nd->len;
+    const char* end = buf + nd->len;
+    const char *q, *nl;
+    lept_value v;
+    int ret, stop;
+    if(p > buf && '\n' != p[-1])
+    {
+        p = (const char*)memchr(p, '\n', (size_t)(end - p));
+        p = NULL == p ? end : p + 1;
+    }
+    while(p < limit)
+    {
+        nl = (const char*)memchr(p, '\n', (size_t)(end - p));
+        if(NULL == nl)
+            nl = end;
+        /*  跳过空白行 */
+        for(q = p; q < nl && (' ' == *q || '\t' == *q || '\r' == *q); q++)
+            ;
+        if(q < nl)
+        {
+            /*  复制到以 '\0' 结尾的行缓冲区，避免解析越过行尾 */
+            if((size_t)(nl - p) + 1 > w->cap)
+            {
+                w->cap = (size_t)(nl - p) + 1 + (w->cap >> 1);
+                w->line = (char*)LEPT_REALLOC(w->line, w->cap);
+            }
+            memcpy(w->line, p, (size_t)(nl - p));
+            w->line[nl - p] = '\0';
+            ret = lept_parse_with(&w->con, &v, w->line);
+            if(nd->flags & LEPT_NDJSON_UNORDERED)
+            {
+                if(0 != (stop = nd->cb(nd->user, (size_t)(p - buf), ret, &v)))
+                    return stop;
+            }
+            else
+            {
+                if(c->n == c->cap)
+                {
+                    c->cap = c->cap < 16 ? 16 : c->cap + (c->cap >> 1);
+                    c->r = (lept_ndjson_result*)LEPT_REALLOC(c->r, c->cap * sizeof(lept_ndjson_result));
+                }
+                c->r[c->n].offset = (size_t)(p - buf);
+                c->r[c->n].ret = ret;
+                c->r[c->n++].val = v;
+            }
+        }
+        p = nl + 1;
+    }
+    return 0;
 }
 
 
-void lept_set_number(lept_value* val, double num)
+#ifdef LEPT_THREADS
+/*  取下一个任务：按序交付时最多领先已交付的任务 window 个，以限制暂存结果占用的内存
+    没有任务或已停止时返回 0 */
+int lept_ndjson_grab(lept_ndjson* nd, size_t* k)
 {
-    assert(NULL != val);
-    lept_init(val);
-    val->u.num = num;
-    val->type = LEPT_NUMBER;
+    int ok;
+    pthread_mutex_lock(&nd->lock);
+    while(!nd->stop && nd->next < nd->nchunks && !(nd->flags & LEPT_NDJSON_UNORDERED)
+          && nd->next >= nd->delivered + nd->window)
+        pthread_cond_wait(&nd->cond, &nd->lock);
+    ok = !nd->stop && nd->next < nd->nchunks;
+    if(ok)
+        *k = nd->next++;
+    pthread_mutex_unlock(&nd->lock);
+    return ok;
 }
 
 
-/*  string part */
-const char* lept_get_string(const lept_value* val)
+void* lept_ndjson_work(void* arg)
 {
-    assert((NULL != val) && (LEPT_STRING == val->type));
-    return val->u.s.str;
+    lept_ndjson_worker* w = (lept_ndjson_worker*)arg;
+    lept_ndjson* nd = w->nd;
+    size_t k;
+    int stop;
+    while(lept_ndjson_grab(nd, &k))
+    {
+        stop = lept_ndjson_chunk_run(w, k);
+        pthread_mutex_lock(&nd->lock);
+        if(0 != stop && 0 == nd->stop)
+            nd->stop = stop;
+        nd->chunks[k].done = 1;
+        pthread_cond_broadcast(&nd->cond);
+        pthread_mutex_unlock(&nd->lock);
+    }
+    return NULL;
 }
+#endif
 
 
-size_t lept_get_string_length(const lept_value* val)
+int lept_parse_ndjson(const char* buf, size_t len, int nthreads, int flags, lept_ndjson_callback cb, void* user)
 {
-    assert((NULL != val) && (LEPT_STRING == val->type));
-    return val->u.s.len;
-}
+    lept_ndjson nd;
+    lept_ndjson_worker* w;
+    lept_ndjson_chunk* c;
+    size_t k, i, nworkers;
+    int stop = 0;
+#ifdef LEPT_THREADS
+    pthread_t* tid;
+    size_t started = 0;
+#endif
+    assert((NULL != buf || 0 == len) && (NULL != cb));
+    nd.buf = buf;
+    nd.len = len;
+    nd.nchunks = (len + LEPT_NDJSON_CHUNK_SIZE - 1) / LEPT_NDJSON_CHUNK_SIZE;
+    nd.next = nd.delivered = 0;
+    nd.flags = flags;
+    nd.stop = 0;
+    nd.cb = cb;
+    nd.user = user;
+    nd.chunks = (lept_ndjson_chunk*)lept_calloc(nd.nchunks + 1, sizeof(lept_ndjson_chunk));
+    nthreads = lept_thread_count(nthreads);
+    if((size_t)nthreads > nd.nchunks)
+        nthreads = nd.nchunks > 1 ? (int)nd.nchunks : 1;
+    /*  无序交付时调用线程也参与解析；按序交付时调用线程负责交付 */
+    nworkers = (size_t)nthreads;
+    nd.window = 4 * nworkers;
+    w = (lept_ndjson_worker*)lept_calloc(nworkers, sizeof(lept_ndjson_worker));
+    for(i = 0; i < nworkers; i++)
+        w[i].nd = &nd;
 
+    if(1 == nworkers)
+    {
+        /*  单线程：逐段解析，按序交付即是顺序 */
+        nd.flags |= LEPT_NDJSON_UNORDERED;
+        for(k = 0; k < nd.nchunks && 0 == stop; k++)
+            stop = lept_ndjson_chunk_run(&w[0], k);
+    }
+#ifdef LEPT_THREADS
+    else
+    {
+        pthread_mutex_init(&nd.lock, NULL);
+        pthread_cond_init(&nd.cond, NULL);
+        tid = (pthread_t*)LEPT_MALLOC(nworkers * sizeof(pthread_t));
+        for(i = (flags & LEPT_NDJSON_UNORDERED) ? 1 : 0; i < nworkers; i++)
+            if(0 == pthread_create(&tid[started], NULL, lept_ndjson_work, &w[i]))
+                started++;
+        if(flags & LEPT_NDJSON_UNORDERED)
+            lept_ndjson_work(&w[0]);
+        else
+        {
+            /*  创建线程全部失败时由调用线程自己解析 */
+            if(0 == started)
+            {
+                nd.window = nd.nchunks;
+                lept_ndjson_work(&w[0]);
+            }
+            for(k = 0; k < nd.nchunks; k++)
+            {
+                c = &nd.chunks[k];
+                pthread_mutex_lock(&nd.lock);
+                while(!c->done && !nd.stop)
+                    pthread_cond_wait(&nd.cond, &nd.lock);
+                stop = nd.stop;
+                pthread_mutex_unlock(&nd.lock);
+                if(0 != stop)
+                    break;
+                for(i = 0; i < c->n && 0 == stop; i++)
+                    stop = cb(user, c->r[i].offset, c->r[i].ret, &c->r[i].val);
+                /*  停止后未交付的值在下面统一释放 */
+                for(; i < c->n; i++)
+                    lept_free(&c->r[i].val);
+                c->n = 0;
+                pthread_mutex_lock(&nd.lock);
+                if(0 != stop)
+                    nd.stop = stop;
+                nd.delivered = k + 1;
+                pthread_cond_broadcast(&nd.cond);
+                pthread_mutex_unlock(&nd.lock);
+                if(0 != stop)
+                    break;
+            }
+        }
+        for(i = 0; i < started; i++)
+            pthread_join(tid[i], NULL);
+        LEPT_FREE(tid);
+        stop = nd.stop;
+        pthread_cond_destroy(&nd.cond);
+        pthread_mutex_destroy(&nd.lock);
+    }
+#endif
 
-/*  设置一个值为字符串，把 str 传入到 val->u.s.str 中 */
-void lept_set_string(lept_value* val, const char* str, size_t len)
-{
-    assert((NULL != val) && ((NULL != str) || (len == 0)) );
-    lept_free(val);
-    val->u.s.str = (char*)malloc(len + 1);
-    /*  把长度为 len 的字符串 str 复制到 val->u.s.str 中 */
-    memcpy(val->u.s.str, str, len);
-    val->u.s.len = len;
-    /*  设置最后一位为 '\0' */
-    val->u.s.str[len] = '\0';
-    val->type = LEPT_STRING;
+    for(k = 0; k < nd.nchunks; k++)
+    {
+        c = &nd.chunks[k];
+        for(i = 0; i < c->n; i++)
+            lept_free(&c->r[i].val);
+        LEPT_FREE(c->r);
+    }
+    for(i = 0; i < nworkers; i++)
+    {
+        LEPT_FREE(w[i].con.stack);
+        LEPT_FREE(w[i].line);
+    }
+    LEPT_FREE(w);
+    LEPT_FREE(nd.chunks);
+    return stop;
 }
 
 
-/*  array part */
-/*  获取数组中第 index 个元素 */
-lept_value* lept_get_array_element(const lept_value* val, size_t index)
+/*  从 p 开始的一个文本在 [p, end) 中的范围：容器和字符串找配对的结束符（识别字符串和转义），
+    其他值到下一个分隔符为止；返回结束的位置
+    *safe 为 1 表示原地解析不会读到 end 之后：值在 end 之前结束，解析器最晚在结束符处停下（或更早出错） */
+const char* lept_many_extent(const char* p, const char* end, int* safe)
 {
-    assert((NULL != val) && (LEPT_ARRAY == val->type));
-    assert(index < val->u.a.size);
-    return &val->u.a.e[index];
+    size_t depth = 0;
+    int in_string = 0, escape = 0;
+    const char* q = p;
+    if('[' != *p && '{' != *p && '"' != *p)
+    {
+        while(q < end && '\0' != *q && NULL == strchr(" \t\n\r[]{},\"", *q))
+            q++;
+        *safe = q < end;
+        return q;
+    }
+    for(; q < end; q++)
+    {
+        if(in_string)
+        {
+            if(escape)
+                escape = 0;
+            else if('\\' == *q)
+                escape = 1;
+            else if('"' == *q)
+            {
+                in_string = 0;
+                if(0 == depth)
+                    break;
+            }
+        }
+        else if('"' == *q)
+            in_string = 1;
+        else if('[' == *q || '{' == *q)
+            depth++;
+        else if((']' == *q || '}' == *q) && 0 == --depth)
+            break;
+    }
+    *safe = q < end;
+    return q < end ? q + 1 : end;
 }
 
 
-/*  获取数组中元素的长度 */
-size_t lept_get_array_size(const lept_value* val)
+/*  首尾相接的多个文本 */
+int lept_parse_many(const char* buf, size_t len, lept_many_callback cb, void* user)
 {
-    assert((NULL != val) && (LEPT_ARRAY == val->type));
-    return val->u.a.size;
+    lept_context con;
+    lept_value v;
+    const char *start, *end = buf + len;
+    char* tail = NULL;
+    size_t length;
+    int ret, safe, stop = 0;
+    assert((NULL != buf || 0 == len) && NULL != cb);
+    lept_stream_init(&con, NULL);
+    for(start = buf; ; start += length)
+    {
+        while(start < end && (' ' == *start || '\t' == *start || '\n' == *start || '\r' == *start))
+            start++;
+        if(start >= end)
+            break;
+        lept_many_extent(start, end, &safe);
+        if(safe)
+            con.json = start;
+        else
+        {
+            /*  值一直延伸到 end（只可能是最后一个文本）：复制到以 '\0' 结尾的缓冲区中解析 */
+            length = (size_t)(end - start);
+            memcpy(tail = (char*)LEPT_MALLOC(length + 1), start, length);
+            tail[length] = '\0';
+            con.json = tail;
+        }
+        lept_init(&v);
+        ret = lept_parse_value(&con, &v);
+        assert(0 == con.top);
+        length = (size_t)(con.json - (safe ? start : tail));
+        LEPT_FREE(tail);
+        tail = NULL;
+        if(0 != (stop = cb(user, (size_t)(start - buf), length, ret, &v)) || LEPT_PARSE_OK != ret)
+            break;
+    }
+    LEPT_FREE(con.stack);
+    return stop;
 }
 
 
-/*  object part */
-/*  获取第 index 个 member 的值 */
-lept_value* lept_get_object_value(const lept_value* val, size_t index)
+/*  顶层数组迭代 */
+lept_array_iter* lept_array_iter_open(lept_read_callback read, void* user)
 {
-    assert((NULL != val) && (LEPT_OBJECT == val->type));
-    assert(index < val->u.o.size);
-    return &val->u.o.m[index].val;
+    lept_array_iter* it;
+    assert(NULL != read);
+    it = (lept_array_iter*)lept_calloc(1, sizeof(lept_array_iter));
+    it->read = read;
+    it->user = user;
+    it->ret = LEPT_PARSE_OK;
+    lept_stream_init(&it->con, NULL);
+    return it;
 }
 
-/*  得到第 index 个 member 的标题 */
-const char* lept_get_object_key(const lept_value* val, size_t index)
+
+#if defined(__unix__) || defined(__APPLE__)
+int lept_array_iter_read_fd(void* user, char* buf, size_t size, size_t* nread)
 {
-    assert((NULL != val) && (LEPT_OBJECT == val->type));
-    assert(index < val->u.o.size);
-    return val->u.o.m[index].k;
+    ssize_t n;
+    do
+        n = read(*(int*)user, buf, size);
+    while(n < 0 && EINTR == errno);
+    if(n < 0)
+        return -1;
+    *nread = (size_t)n;
+    return 0;
 }
 
-/*  返回第 index 个 member 的长度 */
-size_t lept_get_object_key_length(const lept_value* val, size_t index)
+
+lept_array_iter* lept_array_iter_open_fd(int fd)
 {
-    assert((NULL != val) && (LEPT_OBJECT == val->type));
-    assert(index < val->u.o.size);
-    return val->u.o.m[index].klen;
+    lept_array_iter* it = lept_array_iter_open(lept_array_iter_read_fd, NULL);
+    it->fd = fd;
+    it->user = &it->fd;
+    return it;
 }
+#endif
 
-/*  返回 object 的整体长度 */
-size_t lept_get_object_size(const lept_value* val)
+
+int lept_array_iter_fail(lept_array_iter* it, int ret)
 {
-    assert((NULL != val) && (LEPT_OBJECT == val->type));
-    return val->u.a.size;
+    it->ret = ret;
+    it->done = 1;
+    return 0;
 }
 
 
-/*  生成器 */
-/*  把生成的树值写道 *json */
-char* lept_stringify(const lept_value* val, size_t* length)
+/*  丢弃已经处理的输入，再读入一块，返回 0 表示输入已经结束或读取出错 */
+int lept_array_iter_fill(lept_array_iter* it)
 {
-    lept_context con;
-    assert(NULL != val);
-    con.size = LEPT_PARSE_STRINGIFY_INIT_SIZE;
-    con.stack = (char*)malloc(con.size);
-    con.top = 0;
-    lept_stringify_value(&con, val);
-    if(length)
-        *length = con.top;
-    /*  在生成的值后面添加空白符作为结尾 */
-    PUTC(&con, '\0');
-    return con.stack;
+    size_t n = 0;
+    if(it->eof)
+        return 0;
+    if(it->pos > 0)
+    {
+        memmove(it->buf, it->buf + it->pos, it->len - it->pos);
+        it->len -= it->pos;
+        it->scan -= it->pos;
+        it->pos = 0;
+    }
+    /*  留一个字节给解析时临时放置的 '\0' */
+    if(it->size - it->len < LEPT_ARRAY_ITER_CHUNK_SIZE + 1)
+    {
+        it->size = it->len + LEPT_ARRAY_ITER_CHUNK_SIZE + 1 + (it->size >> 1);
+        it->buf = (char*)LEPT_REALLOC(it->buf, it->size);
+    }
+    if(0 != it->read(it->user, it->buf + it->len, LEPT_ARRAY_ITER_CHUNK_SIZE, &n))
+    {
+        it->eof = 1;
+        it->ret = LEPT_ARRAY_ITER_READ_ERROR;
+        return 0;
+    }
+    if(0 == n)
+        it->eof = 1;
+    it->len += n;
+    return n > 0;
 }
 
 
-void lept_stringify_value(lept_context*con, const lept_value* val)
+/*  跳过空白，返回 0 表示输入结束（或读取出错） */
+int lept_array_iter_skip_ws(lept_array_iter* it)
 {
-    char* buf;
-    int length;
-    switch(val->type)
+    for(;;)
     {
-        case LEPT_NULL:
-            PUTS(con, "null", 4);
-            break;
-        case LEPT_TRUE:
-            PUTS(con, "true", 4);
-            break;
-        case LEPT_FALSE:
-            PUTS(con, "false", 5);
-            break;    
-        case LEPT_NUMBER:
-            /*  stdio.h 函数 sprintf，将 val->u.num 格式化输出到 buf (con.stack)
-                如果成功，则返回写入的字符总数 */
-            buf = lept_context_push(con, 32);
-            length = sprintf(buf, "%.17g", val->u.num);
-            con->top -= 32 - length;
-            break;         
-        case LEPT_STRING:
-            lept_stringify_string(con, val->u.s.str, val->u.s.len);
-            break;      
-        case LEPT_ARRAY:
-            lept_stringify_array(con, val);
-            break;
-        case LEPT_OBJECT:
-            lept_stringify_object(con, val);
-            break;
-        default:
-            assert(0 && "invalid type");
-            break;
+        while(it->pos < it->len && (' ' == it->buf[it->pos] || '\t' == it->buf[it->pos]
+                                    || '\n' == it->buf[it->pos] || '\r' == it->buf[it->pos]))
+            it->pos++;
+        if(it->pos < it->len)
+            return 1;
+        if(!lept_array_iter_fill(it))
+            return 0;
     }
 }
 
-#if 0
-/*  代替多次使用 PUTS 的版本，优化性能 */
-void lept_stringify_string(lept_context* con, const char* s, size_t len)
+
+/*  解析从 pos 开始、以 '\0' 结尾的一个元素；元素之后还有其他字符（如 [1 2]）与 lept_parse 一样
+    是缺少 ',' 或 ']'，而不是 LEPT_PARSE_ROOT_NOT_SINGULAR */
+int lept_array_iter_parse(lept_array_iter* it, lept_value* out)
 {
-    size_t i = 0;
-    unsigned char ch;
-    assert(NULL != s);
-    PUTC(con, '"');
-    for(i = 0; i < len; i++)
+    int ret = lept_parse_with(&it->con, out, it->buf + it->pos);
+    return LEPT_PARSE_ROOT_NOT_SINGULAR == ret ? LEPT_PARSE_MISS_COMMA_OR_SQUARE_BRACKET : ret;
+}
+
+
+/*  扫描出下一个元素的边界（深度为 0 的 ',' 或 ']'，识别字符串和转义），
+    临时在边界处放一个 '\0'，用 lept_parse_with 解析这一段 */
+int lept_array_iter_next(lept_array_iter* it, lept_value* out)
+{
+    char ch, sep;
+    int got = 0;
+    assert(NULL != it && NULL != out);
+    lept_init(out);
+    if(it->done)
+        return 0;
+    if(!it->started)
     {
-        ch = (unsigned char)s[i];
-        switch(ch)
+        if(!lept_array_iter_skip_ws(it))
+            return lept_array_iter_fail(it, LEPT_PARSE_OK == it->ret ? LEPT_PARSE_EXPECT_VALUE : it->ret);
+        if('[' != it->buf[it->pos])
+            return lept_array_iter_fail(it, LEPT_PARSE_NOT_ARRAY);
+        it->pos++;
+        it->started = 1;
+        if(!lept_array_iter_skip_ws(it))
+            return lept_array_iter_fail(it, LEPT_PARSE_OK == it->ret ? LEPT_PARSE_MISS_COMMA_OR_SQUARE_BRACKET : it->ret);
+        if(']' == it->buf[it->pos])
         {
-            case '\"': PUTS(con, "\\\"", 2); break;
-            case '\\': PUTS(con, "\\\\", 2); break;
-            case '\b': PUTS(con, "\\b",  2); break;
-            case '\f': PUTS(con, "\\f",  2); break;
-            case '\n': PUTS(con, "\\n",  2); break;
-            case '\r': PUTS(con, "\\r",  2); break;
-            case '\t': PUTS(con, "\\t",  2); break;
-            default:
-                if (ch < 0x20) {
-                    char buf[7];
-                    sprintf(buf, "\\u%04X", ch);
-                    PUTS(con, buf, 6);
-                }
-                else
-                    PUTC(con, s[i]);
+            it->pos++;
+            goto end;
         }
     }
-    PUTC(con, '"');
-}
+    else if(!lept_array_iter_skip_ws(it))
+        return lept_array_iter_fail(it, LEPT_PARSE_OK == it->ret ? LEPT_PARSE_EXPECT_VALUE : it->ret);
 
-#else
-void lept_stringify_string(lept_context* con, const char* s, size_t len)
-{
-    static const char hex_digits[] = 
-        { '0', '1', '2', '3', '4', '5', '6', '7', '8', '9', 'A', 'B', 'C', 'D', 'E', 'F' };
-    size_t i = 0, size = 0;
-    char *p, *head;
-    unsigned char ch;
-    assert(NULL != s);
-    /*  每个字符可生成最长的形式是 \u00XX，占 6 个字符
-        再加上前后两个双引号，也就是共 len * 6 + 2 个输出字符 */
-    p = head = lept_context_push(con, size = len * 6 + 2);
-    *p++ = '"';
-    for(i = 0; i < len; i++)
+    it->scan = it->pos;
+    it->depth = it->in_string = it->escape = 0;
+    for(;;)
     {
-        ch = (unsigned char)s[i];
-        switch(ch)
+        if(it->scan == it->len && !lept_array_iter_fill(it))
         {
-            case '\"': *p++ = '\\'; *p++ = '\"'; break;
-            case '\\': *p++ = '\\'; *p++ = '\\'; break;
-            case '\b': *p++ = '\\'; *p++ = 'b';  break;
-            case '\f': *p++ = '\\'; *p++ = 'f';  break;
-            case '\n': *p++ = '\\'; *p++ = 'n';  break;
-            case '\r': *p++ = '\\'; *p++ = 'r';  break;
-            case '\t': *p++ = '\\'; *p++ = 't';  break;
-            default:
-                if (ch < 0x20) {
-                    *p++ = '\\'; *p++ = 'u'; *p++ = '0'; *p++ = '0';
-                    *p++ = hex_digits[ch >> 4];
-                    *p++ = hex_digits[ch & 15];
-                }
-                else
-                    *p++ = s[i];
+            if(LEPT_PARSE_OK != it->ret)
+                return lept_array_iter_fail(it, it->ret);
+            /*  输入在元素中间结束：元素本身不完整时报告它的错误，否则缺少 ']' */
+            it->buf[it->len] = '\0';
+            it->ret = lept_array_iter_parse(it, out);
+            lept_free(out);
+            return lept_array_iter_fail(it, LEPT_PARSE_OK == it->ret ? LEPT_PARSE_MISS_COMMA_OR_SQUARE_BRACKET : it->ret);
         }
+        ch = it->buf[it->scan];
+        if(it->in_string)
+        {
+            if(it->escape)
+                it->escape = 0;
+            else if('\\' == ch)
+                it->escape = 1;
+            else if('"' == ch)
+                it->in_string = 0;
+        }
+        else if('"' == ch)
+            it->in_string = 1;
+        else if('[' == ch || '{' == ch)
+            it->depth++;
+        else if(0 == it->depth && (',' == ch || ']' == ch))
+            break;
+        else if((']' == ch || '}' == ch) && it->depth > 0)
+            it->depth--;
+        it->scan++;
     }
-    *p++ = '"';
-    con->top -= size - (p - head); 
-
+    sep = it->buf[it->scan];
+    it->buf[it->scan] = '\0';
+    if(LEPT_PARSE_OK != (it->ret = lept_array_iter_parse(it, out)))
+        return lept_array_iter_fail(it, it->ret);
+    it->buf[it->scan] = sep;
+    it->pos = it->scan + 1;
+    got = 1;
+    if(',' == sep)
+        return 1;
+end:
+    /*  数组结束：之后只能有空白 */
+    it->done = 1;
+    if(lept_array_iter_skip_ws(it))
+        it->ret = LEPT_PARSE_ROOT_NOT_SINGULAR;
+    if(LEPT_PARSE_OK != it->ret)
+    {
+        lept_free(out);
+        return 0;
+    }
+    return got;
 }
-#endif
 
 
-void lept_stringify_array(lept_context* con, const lept_value* val)
+int lept_array_iter_error(const lept_array_iter* it)
 {
-    size_t i = 0;
-    assert(NULL != val);
-    PUTC(con, '[');
-    for(i = 0; i < val->u.a.size; i++)
-    {
-        if(i > 0) PUTC(con, ',');
-        lept_stringify_value(con, &val->u.a.e[i]);
-    }
-    PUTC(con, ']');
-
+    assert(NULL != it);
+    return it->ret;
 }
 
 
-void lept_stringify_object(lept_context* con, const lept_value* val)
+void lept_array_iter_close(lept_array_iter* it)
 {
-    size_t i = 0;
-    assert(NULL != val);
-    PUTC(con, '{');
-    for(i = 0; i < val->u.o.size; i++)
-    {
-        if(i > 0) PUTC(con, ',');
-        lept_stringify_string(con, val->u.o.m[i].k, val->u.o.m[i].klen);
-        PUTC(con, ':');
-        lept_stringify_value(con, &val->u.o.m[i].val);
-    }
-    PUTC(con, '}');
-
+    if(NULL == it)
+        return;
+    LEPT_FREE(it->buf);
+    LEPT_FREE(it->con.stack);
+    LEPT_FREE(it);
 }
 
 
@@ -8,6 +8,11 @@
 #define LEPTJSON_H__
 #include <stddef.h> /* size_t */
 #include <stdlib.h>
+#include <stdint.h> /* int64_t */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
 
 /*  JSON 中有 6 种数据类型，如果把 true 和 false 当作两个类型就是 7 种
     我们为此声明一个枚举类型（enumeration type）  
@@ -30,18 +35,24 @@ typedef struct lept_value lept_value;
 typedef struct lept_member lept_member;
 struct lept_value {
     lept_type type;
+    unsigned flags;  /*  内部使用的存储标记（如是否位于 lept_copy 的整块内存中），不要直接修改 */
     /*  一个值只能是数值或只能是字符串，所以用 union 节省内存 */
     union {
         double num; /*  由于没有限制数字的范围和精度，因此使用 double 来存储 JSON 数字较好 */
+        /*  惰性数值（LEPT_OPT_LAZY_NUMBERS）：len 的低 7 位不为 0 时 raw 保存原文，
+            最高位表示 num 还没有从原文转换；len 为 0 是普通数值，与 num 相同 */
+        struct { double num; char raw[15]; unsigned char len; } n;
         struct { char* str; size_t len; } s;
-        struct { lept_value* e; size_t size; } a;
-        struct { lept_member* m; size_t size; } o;
+        /*  capacity 是已分配的元素个数；紧凑数组（LEPT_OPT_PACK_NUMBERS）的 e 实际是 double[] 或 int64_t[] */
+        struct { lept_value* e; size_t size, capacity; } a;
+        struct { lept_member* m; size_t size, capacity; } o;
     } u;   
 };
 /*  Object 成员结构体 */
 struct lept_member {
     char *k;
     size_t klen;
+    unsigned khash; /*  键的哈希值，查找和比较时先比较它 */
     lept_value val;
 };
 
@@ -63,7 +74,13 @@ enum {
     LEPT_PARSE_MISS_COMMA_OR_SQUARE_BRACKET,
     LEPT_PARSE_MISS_KEY,
     LEPT_PARSE_MISS_COLON,
-    LEPT_PARSE_MISS_COMMA_OR_CURLY_BRACKET
+    LEPT_PARSE_MISS_COMMA_OR_CURLY_BRACKET,
+    LEPT_PARSE_BINARY_TRUNCATED,    /*  CBOR/MessagePack 数据不完整 */
+    LEPT_PARSE_BINARY_UNSUPPORTED,  /*  CBOR/MessagePack 中没有对应 JSON 的类型，如字节串、非字符串的键、NaN */
+    LEPT_PARSE_SCHEMA_MISMATCH,     /*  值的类型与 schema 不符，或缺少必需的成员（leptjson_gen 生成的代码） */
+    LEPT_PARSE_TOO_DEEP,            /*  嵌套超过 LEPT_CURSOR_MAX_DEPTH 层（lept_cursor） */
+    LEPT_PARSE_INVALID_UTF8,        /*  字符串不是合法的 UTF-8（LEPT_OPT_VALIDATE_UTF8） */
+    LEPT_PARSE_NOT_ARRAY            /*  根不是数组（lept_array_iter） */
 
 };
 
@@ -71,11 +88,48 @@ enum {
 #define lept_init(val) \
     do { \
         (val)->type = LEPT_NULL; \
+        (val)->flags = 0; \
     } while(0)
 
 
+/*  释放 val 占用的内存并设为 null，使用显式栈迭代释放，深层嵌套不会栈溢出 */
 void lept_free(lept_value* val);
 
+/*  延迟释放：把 val 的所有权放入全局待释放队列，val 变为 null，不遍历子树
+    之后由任意线程（例如后台线程）调用 lept_reclaim 批量释放，返回释放的值的个数
+    代价：每次调用为队列节点 malloc 一次（lept_reclaim 时释放），入队是一次 CAS；
+    val 的所有权用 lept_move 转移，位于 lept_copy 整块内存中的子节点要先复制出它这一层（见 lept_move）；
+    没有存储的值（null、布尔、数值、没有分配容量的空容器）直接置为 null，不分配
+    用 GCC/clang 编译时两个函数都可以被多个线程同时调用；其他编译器没有原子操作，只能在一个线程中使用 */
+void lept_free_deferred(lept_value* val);
+size_t lept_reclaim(void);
+
+/*  深拷贝：先统计整棵子树的大小，再把拷贝放在一整块内存中，只调用一次 malloc
+    拷贝出来的值可以照常修改，需要扩容的节点在修改时只把自身这一层（对象还有它的键）移出这块内存，
+    子节点留在原处；这块内存带引用计数，所有节点都释放或移出之后才释放 */
+void lept_copy(lept_value* dst, const lept_value* src);
+/*  把 src 的所有权转移给 dst，src 变为 null
+    一般为 O(1)；若 src 是某个 lept_copy 整块内存中的子节点，则需要先把它这一层复制出来 */
+void lept_move(lept_value* dst, lept_value* src);
+void lept_swap(lept_value* lhs, lept_value* rhs);
+
+/*  共享子树（引用计数，写时复制）
+    lept_share 使 dst 与 src 共享同一棵子树：首次共享时把 src 整棵子树转为带引用计数的存储，
+    之后再共享同一子树只需 O(1) 增加引用计数。lept_free 只减少引用计数，最后一个引用才真正释放。
+    数组、对象的修改函数（pushback、set_object_value 等）会自动只复制被修改的这一层，
+    子节点继续共享，所以沿路径逐层修改只会复制根到被修改节点的路径。
+    通过 lept_get_array_element 等取得的指针只能读，要直接写入共享容器中的元素，
+    先从根开始沿路径逐层对容器调用 lept_unshare（紧凑数组同时转换回普通数组）。
+    用 GCC/clang 编译时引用计数的增减是原子操作，多个线程可以同时读取、共享和释放同一棵共享子树；
+    其他编译器退化为普通的读改写，共享子树只能在一个线程中使用。 */
+void lept_share(lept_value* dst, lept_value* src);
+void lept_unshare(lept_value* val);
+
+/*  深比较，对象成员的顺序不影响结果，数值按 == 比较 */
+int lept_is_equal(const lept_value* lhs, const lept_value* rhs);
+/*  结构哈希，与 lept_is_equal 一致：相等的值哈希值相同，对象成员的顺序不影响结果 */
+size_t lept_hash(const lept_value* val);
+
 /*  解析 JSON 的函数，传入只读文本 json 和 JSON 值的指针
     一般用法是：
     lept_value v;
@@ -83,6 +137,44 @@ void lept_free(lept_value* val);
     int ret = lept_parse(&v, json); */
 int lept_parse(lept_value* val, const char* json);
 
+/*  解析选项，可以组合使用
+    LEPT_OPT_LAZY_NUMBERS：只校验数值的语法并保存原文（不超过 15 个字符、指数不超过 2 位的数值），
+    第一次 lept_get_number 时才转换为 double；lept_stringify 原样输出原文。
+    LEPT_OPT_LAZY_STRINGS：只校验字符串（不含键），含有转义的字符串保存带引号的原文，
+    第一次 lept_get_string/lept_get_string_length 时才解码；解码前 lept_stringify 原样输出原文。
+    第一次读取会写入缓存，所以多个线程同时读取同一棵树之前，要先在一个线程中读取过这些值
+    LEPT_OPT_VALIDATE_UTF8：字符串和键必须是合法的 UTF-8（拒绝过长编码、代理项和超过 U+10FFFF 的码点），
+    否则返回 LEPT_PARSE_INVALID_UTF8；默认只拒绝小于 0x20 的字节
+    LEPT_OPT_PACK_NUMBERS：元素全是数值的非空数组紧凑存储为 double[]，都是 ±2^53 以内的整数（不含 -0）时为 int64_t[]，
+    见 lept_get_array_numbers；与 LEPT_OPT_LAZY_NUMBERS 同时使用时，这些数组中的数值立即转换，不保留原文 */
+#define LEPT_OPT_LAZY_NUMBERS 0x1u
+#define LEPT_OPT_LAZY_STRINGS 0x2u
+#define LEPT_OPT_VALIDATE_UTF8 0x4u
+#define LEPT_OPT_PACK_NUMBERS 0x8u
+int lept_parse_opts(lept_value* val, const char* json, unsigned opts);
+
+/*  运行时统计，编译库时定义 LEPT_ENABLE_STATS 才有 lept_parse_stats 等函数，否则不产生任何统计代码
+    每次调用把数据累加到 stats 中，调用前清零即得到单次的统计；不清零则持续累加
+    也可以在 lept_stream_init 之后设置 s.stats，统计 leptjson_gen 生成的代码
+    lept_stats 和 lept_stream 中的统计字段总是存在，定义与不定义 LEPT_ENABLE_STATS 编译的代码结构布局相同 */
+typedef struct lept_stats {
+    size_t values[7];       /*  按 lept_type 计数的值的个数 */
+    size_t string_bytes;    /*  字符串（含键）解码后的字节数 */
+    size_t escapes;         /*  解析时解码、生成时写出的转义序列个数 */
+    size_t max_depth;       /*  数组、对象嵌套的最大深度 */
+    size_t stack_high;      /*  暂存栈（lept_context）使用的最大字节数 */
+    size_t stack_reallocs;  /*  暂存栈的扩容次数，可据此调整 LEPT_PARSE_STACK_INIT_SIZE */
+    size_t mallocs;         /*  为结果分配内存的次数和字节数（不含暂存栈） */
+    size_t malloc_bytes;
+    double parse_ns;        /*  各阶段的耗时（纳秒） */
+    double stringify_ns;
+} lept_stats;
+
+#ifdef LEPT_ENABLE_STATS
+int lept_parse_stats(lept_value* val, const char* json, lept_stats* stats);
+char* lept_stringify_stats(const lept_value* val, size_t* length, lept_stats* stats);
+#endif
+
 /*  访问结果的函数，获取 JSON 的数据类型 */
 lept_type lept_get_type(const lept_value* val);
 
@@ -100,18 +192,337 @@ const char* lept_get_string(const lept_value* val);
 size_t lept_get_string_length(const lept_value* val);
 void lept_set_string(lept_value* val, const char* str, size_t len);
 
+/*  动态数组：size 为元素个数，capacity 为已分配的容量
+    容量不足时按 1.5 倍扩容，pushback 均摊 O(1)
+    注意：扩容、插入、删除后，之前取得的元素指针可能失效 */
+void lept_set_array(lept_value* val, size_t capacity);
 lept_value* lept_get_array_element(const lept_value* val, size_t index);
+/*  只读访问，也适用于紧凑数组：元素是紧凑存储的数值时在 tmp 中构造并返回 tmp */
+const lept_value* lept_get_array_element_tmp(const lept_value* val, size_t index, lept_value* tmp);
 size_t lept_get_array_size(const lept_value* val);
+size_t lept_get_array_capacity(const lept_value* val);
+void lept_reserve_array(lept_value* val, size_t capacity);
+void lept_shrink_array(lept_value* val);
+void lept_clear_array(lept_value* val);
+/*  返回新元素的指针，新元素为 null */
+lept_value* lept_pushback_array_element(lept_value* val);
+void lept_popback_array_element(lept_value* val);
+lept_value* lept_insert_array_element(lept_value* val, size_t index);
+/*  删除从 index 开始的 count 个元素 */
+void lept_erase_array_element(lept_value* val, size_t index, size_t count);
 
+/*  紧凑数组直接访问数据，不复制：lept_get_array_packing 返回 LEPT_PACKED_*，
+    lept_get_array_numbers/lept_get_array_int64 在存储是对应类型时返回数据并把元素个数写入 *count，否则返回 NULL
+    只读的操作（生成、比较、哈希、复制、共享、二进制格式、快照、lept_find_pointer_value、
+    lept_get_array_element_tmp）保持紧凑存储，不修改数组，多个线程可以同时读取；
+    紧凑数组没有 lept_value 元素，不能用 lept_get_array_element，
+    lept_unshare 和修改数组的函数会先把它转换回普通数组（之后返回的数据指针失效） */
+enum {
+    LEPT_PACKED_NONE = 0,
+    LEPT_PACKED_DOUBLE,
+    LEPT_PACKED_INT64
+};
+int lept_get_array_packing(const lept_value* val);
+const double* lept_get_array_numbers(const lept_value* val, size_t* count);
+const int64_t* lept_get_array_int64(const lept_value* val, size_t* count);
+
+/*  找不到键时 lept_find_object_index 返回 LEPT_KEY_NOT_EXIST */
+#define LEPT_KEY_NOT_EXIST ((size_t)-1)
+
+void lept_set_object(lept_value* val, size_t capacity);
 lept_value* lept_get_object_value(const lept_value* val, size_t index);
 const char* lept_get_object_key(const lept_value* val, size_t index);
 size_t lept_get_object_key_length(const lept_value* val, size_t index);
 size_t lept_get_object_size(const lept_value* val);
+size_t lept_get_object_capacity(const lept_value* val);
+void lept_reserve_object(lept_value* val, size_t capacity);
+void lept_shrink_object(lept_value* val);
+void lept_clear_object(lept_value* val);
+size_t lept_find_object_index(const lept_value* val, const char* key, size_t klen);
+lept_value* lept_find_object_value(const lept_value* val, const char* key, size_t klen);
+/*  键已存在时返回原来的值，否则在末尾加入新成员（值为 null）并返回它 */
+lept_value* lept_set_object_value(lept_value* val, const char* key, size_t klen);
+void lept_remove_object_value(lept_value* val, size_t index);
 
 
+/*  返回的缓冲区需要 free（编译库时用 LEPT_MALLOC 等替换了分配器的，用对应的释放函数） */
 char* lept_stringify(const lept_value* val, size_t* length);
 
+/*  CBOR（RFC 8949）和 MessagePack 二进制格式，与 lept_stringify/lept_parse 用法相同，
+    返回的缓冲区需要 free，from 函数的返回值是 LEPT_PARSE_* 错误码
+    数值：±2^53 以内的整数（-0 除外）编码为整数，能精确表示为 float32 的编码为 float32，其余为 float64，
+    解码后与原来的 double 逐位相同；超过 2^53 的外部整数取最接近的 double */
+char* lept_to_cbor(const lept_value* val, size_t* length);
+int lept_from_cbor(lept_value* val, const char* data, size_t length);
+char* lept_to_msgpack(const lept_value* val, size_t* length);
+int lept_from_msgpack(lept_value* val, const char* data, size_t length);
+
+
+/*  底层读写接口，不建立 lept_value 树，供 leptjson_gen 根据 schema 生成的代码使用
+    读取时 json 为当前位置，stack 为字符串解码的暂存区；写出时 stack 为输出缓冲区 */
+typedef struct lept_stream {
+    const char* json;
+    char* stack;
+    size_t size, top;
+    unsigned opts;          /*  解析选项 LEPT_OPT_* */
+    lept_stats* stats;      /*  非 NULL 时统计累加到这里（库定义了 LEPT_ENABLE_STATS 时） */
+    size_t depth;
+} lept_stream;
+
+void lept_stream_init(lept_stream* s, const char* json);
+void lept_stream_free(lept_stream* s);
+void lept_stream_whitespace(lept_stream* s);
+/*  下一个值是其他类型时返回 LEPT_PARSE_SCHEMA_MISMATCH */
+int lept_stream_number(lept_stream* s, double* num);
+int lept_stream_boolean(lept_stream* s, int* b);
+/*  str 指向暂存区，下一次读取之前有效，不以 '\0' 结尾 */
+int lept_stream_string(lept_stream* s, const char** str, size_t* len);
+/*  跳过任意一个值，只检查语法，不分配节点 */
+int lept_stream_skip(lept_stream* s);
+void lept_stream_put(lept_stream* s, const char* str, size_t len);
+void lept_stream_put_number(lept_stream* s, double num);
+void lept_stream_put_string(lept_stream* s, const char* str, size_t len);
+/*  在输出末尾加上 '\0'，返回输出缓冲区，需要调用者 free */
+char* lept_stream_finish(lept_stream* s, size_t* length);
+
+
+/*  只进不退的游标：按文档顺序逐个读取值，不建立树，跳过的子树只检查语法
+    内存只有固定大小的结构和一个暂存区（不超过最长的键加最长的字符串），与文档大小无关
+    一般用法是：
+    lept_cursor c;
+    lept_cursor_init(&c, json);
+    if(lept_cursor_find_field(&c, "id", 2))
+        ret = lept_cursor_get_number(&c, &id);
+    lept_cursor_free(&c); */
+#ifndef LEPT_CURSOR_MAX_DEPTH
+#define LEPT_CURSOR_MAX_DEPTH 256
+#endif
+
+typedef struct lept_cursor {
+    lept_stream s;          /*  s.json 是当前位置，s.stack 的开头是当前成员的键 */
+    int ret;                /*  第一个错误，之后所有操作都失败 */
+    int consumed;           /*  当前值已经读取或跳过 */
+    size_t depth, klen;
+    char close[LEPT_CURSOR_MAX_DEPTH];  /*  每层容器的结束符 */
+} lept_cursor;
+
+void lept_cursor_init(lept_cursor* c, const char* json);
+void lept_cursor_free(lept_cursor* c);
+/*  当前值的类型，只看第一个字符；当前值已经读取或出错时没有意义 */
+lept_type lept_cursor_type(const lept_cursor* c);
+/*  当前值是没有进入的数组或对象时进入它，停在第一个元素（成员的值）上；
+    否则跳过当前值，停在同一层的下一个元素上。返回 1 表示停在了一个值上，
+    返回 0 表示所在的容器（或整个文档）结束了，此时 c->ret 不是 LEPT_PARSE_OK 表示出错 */
+int lept_cursor_next(lept_cursor* c);
+/*  读取当前值；类型不符时返回 LEPT_PARSE_SCHEMA_MISMATCH，可以换一种类型再读
+    str 指向暂存区，下一次调用游标的函数之前有效，不以 '\0' 结尾 */
+int lept_cursor_get_number(lept_cursor* c, double* num);
+int lept_cursor_get_string(lept_cursor* c, const char** str, size_t* len);
+/*  跳过当前值；当前值已经读取或跳过时，跳过所在容器剩下的部分 */
+int lept_cursor_skip(lept_cursor* c);
+/*  当前值是没有进入的对象时在其中查找，已经在对象的成员中时从下一个成员开始向后查找
+    找到返回 1，停在成员的值上；没有找到返回 0，整个对象已经跳过 */
+int lept_cursor_find_field(lept_cursor* c, const char* key, size_t klen);
+/*  当前成员的键，进入子对象之后不再有效 */
+const char* lept_cursor_key(const lept_cursor* c, size_t* klen);
+
+
+/*  按列抽取：用游标沿 JSON Pointer 只读取一批文档中需要的字段（不建立树），追加到按类型存放的列中
+    每个文档是一行，paths[i] 的值追加到 cols[i]；路径不存在或值为 null 时这一行为空（valid 中的位为 0，数据为 0）
+    同一个对象中有重复的键时取第一个
+    LEPT_COLUMN_NUMBER 是 double，LEPT_COLUMN_INT64 只接受 ±2^53 以内的整数，LEPT_COLUMN_BOOLEAN 是 0/1，
+    LEPT_COLUMN_STRING 的第 i 行是 pool[offsets[i], offsets[i + 1])，是解码后的字节，不以 '\0' 结尾
+    值的类型与列不符时返回 LEPT_PARSE_SCHEMA_MISMATCH，文档有语法错误时返回对应的错误码，
+    出错时停在这个文档，之前的文档已经追加，*done（可以为 NULL）是追加的文档个数；
+    路径不是合法的 JSON Pointer 时返回 LEPT_PARSE_INVALID_VALUE，不处理任何文档 */
+enum {
+    LEPT_COLUMN_NUMBER,
+    LEPT_COLUMN_INT64,
+    LEPT_COLUMN_BOOLEAN,
+    LEPT_COLUMN_STRING
+};
+
+typedef struct lept_column {
+    int type;               /*  LEPT_COLUMN_* */
+    size_t rows, capacity;
+    unsigned char* valid;   /*  第 i 行对应 valid[i / 8] 的第 i % 8 位，1 表示有值 */
+    union {
+        double* num;
+        int64_t* i64;
+        unsigned char* b;
+        struct { size_t* offsets; char* pool; size_t capacity; } s;  /*  rows > 0 时 offsets 有 rows + 1 个 */
+    } u;
+} lept_column;
+
+void lept_column_init(lept_column* col, int type);
+void lept_column_free(lept_column* col);
+int lept_extract_columns(const char* const* docs, size_t ndocs, const char* const* paths, size_t npaths,
+                         lept_column* cols, size_t* done);
+
+
+/*  二进制快照：把整棵树写成与地址无关的映像（节点之间用相对偏移代替指针），
+    加载时直接 mmap，不需要反序列化，多个进程可以共享同一份页缓存
+    映像使用写入机器的字节序，字节序不同的机器拒绝加载
+    加载时只检查文件头，快照文件应当由 lept_snapshot_write 生成且未被篡改 */
+typedef struct lept_snapshot lept_snapshot;
+typedef struct lept_snap_value lept_snap_value;    /*  快照中的只读节点，指向映射的内存 */
+
+enum {
+    LEPT_SNAPSHOT_OK = 0,
+    LEPT_SNAPSHOT_IO_ERROR,         /*  打开、读写、映射文件失败 */
+    LEPT_SNAPSHOT_INVALID_FORMAT    /*  不是快照文件，或版本、字节序不匹配 */
+};
+
+int lept_snapshot_write(const lept_value* val, const char* path);
+int lept_snapshot_open(lept_snapshot** snap, const char* path);
+/*  关闭后，之前取得的 lept_snap_value 和字符串指针都失效 */
+void lept_snapshot_close(lept_snapshot* snap);
+const lept_snap_value* lept_snapshot_root(const lept_snapshot* snap);
+
+/*  与 lept_get_* 对应的只读访问函数 */
+lept_type lept_snap_get_type(const lept_snap_value* val);
+int lept_snap_get_boolean(const lept_snap_value* val);
+double lept_snap_get_number(const lept_snap_value* val);
+const char* lept_snap_get_string(const lept_snap_value* val);
+size_t lept_snap_get_string_length(const lept_snap_value* val);
+size_t lept_snap_get_array_size(const lept_snap_value* val);
+const lept_snap_value* lept_snap_get_array_element(const lept_snap_value* val, size_t index);
+size_t lept_snap_get_object_size(const lept_snap_value* val);
+const char* lept_snap_get_object_key(const lept_snap_value* val, size_t index);
+size_t lept_snap_get_object_key_length(const lept_snap_value* val, size_t index);
+const lept_snap_value* lept_snap_get_object_value(const lept_snap_value* val, size_t index);
+size_t lept_snap_find_object_index(const lept_snap_value* val, const char* key, size_t klen);
+const lept_snap_value* lept_snap_find_object_value(const lept_snap_value* val, const char* key, size_t klen);
+
+
+/*  JSON Pointer（RFC 6901），如 "/a/0/b"，空串表示 val 自身，找不到或格式错误返回 NULL
+    不修改 val；目标是紧凑数组的元素时在 tmp 中构造这个数值并返回 tmp */
+const lept_value* lept_find_pointer_value(const lept_value* val, const char* pointer, size_t len, lept_value* tmp);
+
+/*  JSON Merge Patch（RFC 7396），直接修改 target，复用已有的节点 */
+void lept_merge_patch(lept_value* target, const lept_value* patch);
+
+/*  JSON Patch（RFC 6902）的返回值 */
+enum {
+    LEPT_PATCH_OK = 0,
+    LEPT_PATCH_INVALID_PATCH,       /*  patch 不是数组，或操作缺少成员、op 未知 */
+    LEPT_PATCH_INVALID_POINTER,     /*  path/from 不是合法的 JSON Pointer */
+    LEPT_PATCH_PATH_NOT_FOUND,      /*  path/from 指向的位置不存在 */
+    LEPT_PATCH_TEST_FAILED          /*  test 操作比较失败 */
+};
+
+/*  按顺序把 patch 中的 add/remove/replace/move/copy/test 操作应用到 doc 上
+    直接修改 doc，move 只转移节点而不复制
+    出错时停止并返回错误，之前的操作已经生效 */
+int lept_apply_patch(lept_value* doc, const lept_value* patch);
+
+/*  生成把 from 变为 to 的 JSON Patch，写入 patch（数组）
+    对象按键比较，数组按下标比较，只在有差别的节点上生成操作 */
+void lept_diff(const lept_value* from, const lept_value* to, lept_value* patch);
+
+
+/*  与 lept_parse 相同，但顶层是大数组时由 nthreads 个线程并行解析各元素（nthreads < 1 时使用 CPU 核数）：
+    先扫描一遍找出顶层元素的边界（识别字符串和转义），再把元素分段并行解析到最终数组的对应位置
+    结果（包括出错时的错误码）与 lept_parse 相同；输入小于 LEPT_PARALLEL_PARSE_THRESHOLD 字节、
+    顶层不是数组或不支持线程时直接调用 lept_parse */
+int lept_parse_parallel(lept_value* val, const char* json, int nthreads);
+
+/*  与 lept_stringify 相同，但根是宽数组（对象）时把元素（成员）分成若干段，由 nthreads 个线程分别生成到各自的缓冲区，
+    再依次拼接；输出与 lept_stringify 逐字节相同。元素个数小于 LEPT_PARALLEL_STRINGIFY_THRESHOLD、
+    根不是容器或不支持线程时直接调用 lept_stringify */
+char* lept_stringify_parallel(const lept_value* val, size_t* length, int nthreads);
 
+/*  解析流水线：生产者线程提交 JSON 文本，内部的解析线程并行解析，消费者线程批量取走结果
+    输入、输出队列都是有界的无锁多生产者多消费者队列，消息结构体预先分配、循环使用，稳定运行时不再分配
+    队列积压时 submit 立即返回 LEPT_PIPELINE_FULL（背压），由调用者决定重试或丢弃
+    不支持线程时 submit 在调用线程中直接解析 */
+typedef struct lept_pipeline lept_pipeline;
+
+typedef struct lept_pipeline_result {
+    const char* json;   /*  提交的文本，所有权一直属于调用者，取得结果之前不能释放 */
+    void* user;
+    int ret;            /*  LEPT_PARSE_* 错误码 */
+    lept_value val;     /*  所有权交给调用者，需要 lept_free */
+} lept_pipeline_result;
+
+/*  延迟直方图：第 i 个桶是 [2^i, 2^(i+1)) 纳秒的消息数，最后一个桶包括更长的时间 */
+#define LEPT_PIPELINE_HIST_SIZE 32
+typedef struct lept_pipeline_stats {
+    size_t submitted, rejected, parsed, polled;
+    size_t stalls;      /*  解析线程因输出队列满而等待的次数 */
+    size_t queue_wait[LEPT_PIPELINE_HIST_SIZE];     /*  提交到开始解析 */
+    size_t parse[LEPT_PIPELINE_HIST_SIZE];          /*  解析 */
+    size_t result_wait[LEPT_PIPELINE_HIST_SIZE];    /*  解析完成到被取走 */
+} lept_pipeline_stats;
+
+enum {
+    LEPT_PIPELINE_OK = 0,
+    LEPT_PIPELINE_FULL,
+    LEPT_PIPELINE_CLOSED
+};
+
+/*  capacity 是每个队列的容量（向上取 2 的幂），nworkers < 1 时使用 CPU 核数 */
+lept_pipeline* lept_pipeline_create(size_t capacity, int nworkers);
+/*  json 以 '\0' 结尾，可以被多个线程同时调用 */
+int lept_pipeline_submit(lept_pipeline* p, const char* json, void* user);
+/*  不等待，最多取出 max 个结果，返回取出的个数，可以被多个线程同时调用 */
+size_t lept_pipeline_poll(lept_pipeline* p, lept_pipeline_result* out, size_t max);
+/*  所有生产者都停止提交之后调用，解析线程处理完已提交的消息后退出 */
+void lept_pipeline_close(lept_pipeline* p);
+/*  已关闭且所有结果都已被取走 */
+int lept_pipeline_done(lept_pipeline* p);
+void lept_pipeline_get_stats(lept_pipeline* p, lept_pipeline_stats* stats);
+/*  关闭、等待解析线程退出，释放没有被取走的结果（包括还在解析线程中、因输出队列满而等待的） */
+void lept_pipeline_destroy(lept_pipeline* p);
+
+/*  并行解析 NDJSON（JSON Lines）：buf 中每个非空白行是一个 JSON 文本，不需要以 '\0' 结尾
+    输入按 LEPT_NDJSON_CHUNK_SIZE 字节分段，由 nthreads 个线程取段解析，每个线程复用自己的解析栈；
+    nthreads < 1 时使用 CPU 核数，不支持线程的平台在调用线程中顺序解析
+    每行调用一次 cb：offset 是行首在 buf 中的位置，ret 是 LEPT_PARSE_* 错误码，
+    cb 取得 val 的所有权（出错时 val 为 null），需要 lept_free 或 lept_move 出去
+    默认在调用线程中按行的顺序回调；LEPT_NDJSON_UNORDERED 时在各工作线程中立即回调，cb 必须线程安全
+    cb 返回非 0 时停止：不再开始新的段（无序时其他线程正在解析的段仍会回调完），
+    lept_parse_ndjson 返回这个值，全部完成返回 0 */
+typedef int (*lept_ndjson_callback)(void* user, size_t offset, int ret, lept_value* val);
+#define LEPT_NDJSON_UNORDERED 0x1
+int lept_parse_ndjson(const char* buf, size_t len, int nthreads, int flags, lept_ndjson_callback cb, void* user);
+
+/*  解析首尾相接的多个 JSON 文本（"{...}{...}\n[...]"），文本之间可以没有分隔，只有空白也可以；
+    相邻的两个数字之间需要空白，否则会被当成一个数字
+    只读取 buf 的前 len 个字节，不需要以 '\0' 结尾（可以是更大的缓冲区中的一段或 mmap 的文件）；
+    先扫描出每个文本的边界再在 buf 上原地解析，所有文本复用同一个解析栈；
+    只有一直延伸到 len 的最后一个文本（如结尾的数字、不完整的文本）复制出来解析
+    每个文本调用一次 cb：[offset, offset + length) 是它在 buf 中的字节范围，ret 是 LEPT_PARSE_* 错误码，
+    cb 取得 val 的所有权（出错时 val 为 null）；出错之后无法确定下一个文本从哪里开始，回调之后即停止
+    cb 返回非 0 时停止，lept_parse_many 返回这个值，否则返回 0 */
+typedef int (*lept_many_callback)(void* user, size_t offset, size_t length, int ret, lept_value* val);
+int lept_parse_many(const char* buf, size_t len, lept_many_callback cb, void* user);
+
+/*  逐个读取顶层数组的元素：分块读入输入，每次只解析一个完整的元素交给调用者，
+    已经交出的元素的文本随即丢弃，内存只与最大的一个元素有关，与整个文档的大小无关
+    读取回调最多读取 size 字节到 buf，*nread 为 0 表示输入结束，返回非 0 表示读取出错 */
+typedef int (*lept_read_callback)(void* user, char* buf, size_t size, size_t* nread);
+typedef struct lept_array_iter lept_array_iter;
+
+enum {
+    LEPT_ARRAY_ITER_READ_ERROR = -1     /*  读取回调出错（lept_array_iter_error） */
+};
+
+lept_array_iter* lept_array_iter_open(lept_read_callback read, void* user);
+#if defined(__unix__) || defined(__APPLE__)
+/*  从文件描述符读取，不会关闭 fd */
+lept_array_iter* lept_array_iter_open_fd(int fd);
+#endif
+/*  返回 1 时 out 是下一个元素，所有权交给调用者；返回 0 表示数组结束或出错，
+    之后 lept_array_iter_error 返回 LEPT_PARSE_* 错误码或 LEPT_ARRAY_ITER_READ_ERROR，正常结束为 LEPT_PARSE_OK
+    根不是数组时为 LEPT_PARSE_NOT_ARRAY，其余错误码与 lept_parse 解析整个数组时相同 */
+int lept_array_iter_next(lept_array_iter* it, lept_value* out);
+int lept_array_iter_error(const lept_array_iter* it);
+void lept_array_iter_close(lept_array_iter* it);
+
+#ifdef __cplusplus
+}
+#endif
 
  #endif /* LEPTJSON_H__ */
 
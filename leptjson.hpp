@@ -0,0 +1,629 @@
+/*
+ *  leptjson 的 C++17 封装，只有头文件，所有函数都是内联的薄封装，不比直接调用 C API 多做事情
+ *  lept::value 拥有一个 lept_value（析构时 lept_free，只能移动不能复制）
+ *  lept::view 是不拥有所有权的只读视图，字符串和键以 std::string_view 返回，不复制
+ */
+
+#ifndef LEPTJSON_HPP__
+#define LEPTJSON_HPP__
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <limits>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <utility>
+#include <vector>
+#include "leptjson.h"
+
+namespace lept {
+
+class view;
+template <typename It>
+struct range;
+
+namespace detail {
+
+/*  view 和 value 共用的只读访问函数，Derived 提供 c_ptr() 返回底层 lept_value */
+template <typename Derived>
+class reader {
+public:
+    lept_type type() const { return lept_get_type(ptr()); }
+    bool is_null() const { return LEPT_NULL == type(); }
+    bool is_boolean() const { return LEPT_TRUE == type() || LEPT_FALSE == type(); }
+    bool is_number() const { return LEPT_NUMBER == type(); }
+    bool is_string() const { return LEPT_STRING == type(); }
+    bool is_array() const { return LEPT_ARRAY == type(); }
+    bool is_object() const { return LEPT_OBJECT == type(); }
+
+    bool get_boolean() const { return 0 != lept_get_boolean(ptr()); }
+    double get_number() const { return lept_get_number(ptr()); }
+    std::string_view get_string() const
+    {
+        return std::string_view(lept_get_string(ptr()), lept_get_string_length(ptr()));
+    }
+
+    /*  数组的元素个数或对象的成员个数 */
+    std::size_t size() const
+    {
+        return is_array() ? lept_get_array_size(ptr()) : lept_get_object_size(ptr());
+    }
+
+    inline view operator[](std::size_t index) const;
+    /*  紧凑数组（LEPT_OPT_PACK_NUMBERS）的数据，不复制；存储不是对应的类型时为空范围 */
+    inline range<const double*> numbers() const;
+    inline range<const std::int64_t*> int64s() const;
+    /*  用 lept_find_object_value 查找（先比较键的哈希值），不存在时返回空的 view */
+    inline view operator[](std::string_view key) const;
+    bool contains(std::string_view key) const
+    {
+        return LEPT_KEY_NOT_EXIST != lept_find_object_index(ptr(), key.data(), key.size());
+    }
+
+    inline std::string stringify() const;
+    /*  与 lept_is_equal 相同，对象成员的顺序不影响结果 */
+    template <typename Other>
+    bool operator==(const reader<Other>& rhs) const { return 0 != lept_is_equal(ptr(), rhs.ptr()); }
+    template <typename Other>
+    bool operator!=(const reader<Other>& rhs) const { return !(*this == rhs); }
+
+    const lept_value* ptr() const { return static_cast<const Derived*>(this)->c_ptr(); }
+};
+
+}  // namespace detail
+
+/*  对象成员，range-for 遍历对象时的元素类型 */
+struct member;
+
+/*  数组元素的迭代器，按下标调用 lept_get_array_element_tmp，不修改数组 */
+class array_iterator {
+public:
+    using iterator_category = std::forward_iterator_tag;
+    using value_type = view;
+    using difference_type = std::ptrdiff_t;
+    using pointer = void;
+    using reference = view;
+
+    array_iterator(const lept_value* v, std::size_t i) : v_(v), i_(i) {}
+    inline view operator*() const;
+    array_iterator& operator++() { ++i_; return *this; }
+    array_iterator operator++(int) { array_iterator t = *this; ++i_; return t; }
+    bool operator==(const array_iterator& rhs) const { return i_ == rhs.i_; }
+    bool operator!=(const array_iterator& rhs) const { return i_ != rhs.i_; }
+private:
+    const lept_value* v_;
+    std::size_t i_;
+};
+
+/*  对象成员的迭代器 */
+class object_iterator {
+public:
+    using iterator_category = std::forward_iterator_tag;
+    using value_type = member;
+    using difference_type = std::ptrdiff_t;
+    using pointer = void;
+    using reference = member;
+
+    object_iterator(const lept_value* v, std::size_t i) : v_(v), i_(i) {}
+    inline member operator*() const;
+    object_iterator& operator++() { ++i_; return *this; }
+    object_iterator operator++(int) { object_iterator t = *this; ++i_; return t; }
+    bool operator==(const object_iterator& rhs) const { return i_ == rhs.i_; }
+    bool operator!=(const object_iterator& rhs) const { return i_ != rhs.i_; }
+private:
+    const lept_value* v_;
+    std::size_t i_;
+};
+
+template <typename It>
+struct range {
+    It first, last;
+    It begin() const { return first; }
+    It end() const { return last; }
+};
+
+/*  不拥有所有权的只读视图，保存一个指针，可以随意复制
+    紧凑数组（LEPT_OPT_PACK_NUMBERS）的元素没有 lept_value，视图按值保存这个数值，复制时一起复制
+    被查看的值修改或释放之后视图失效；查找不到的键得到空视图，先用 if(v) 判断 */
+class view : public detail::reader<view> {
+public:
+    view() : v_(nullptr) {}
+    view(const lept_value* v) : v_(v) {}
+    /*  数组 a 的第 index 个元素 */
+    view(const lept_value* a, std::size_t index) : v_(lept_get_array_element_tmp(a, index, &tmp_)) {}
+    view(const view& rhs) : tmp_(rhs.tmp_), v_(rhs.v_ == &rhs.tmp_ ? &tmp_ : rhs.v_) {}
+    view& operator=(const view& rhs)
+    {
+        tmp_ = rhs.tmp_;
+        v_ = rhs.v_ == &rhs.tmp_ ? &tmp_ : rhs.v_;
+        return *this;
+    }
+    explicit operator bool() const { return nullptr != v_; }
+    const lept_value* c_ptr() const { return v_; }
+
+    range<array_iterator> elements() const
+    {
+        return { array_iterator(v_, 0), array_iterator(v_, lept_get_array_size(v_)) };
+    }
+    range<object_iterator> members() const
+    {
+        return { object_iterator(v_, 0), object_iterator(v_, lept_get_object_size(v_)) };
+    }
+    /*  range-for 直接遍历数组元素 */
+    array_iterator begin() const { return array_iterator(v_, 0); }
+    array_iterator end() const { return array_iterator(v_, lept_get_array_size(v_)); }
+private:
+    lept_value tmp_{};
+    const lept_value* v_;
+};
+
+struct member {
+    std::string_view key;
+    lept::view value;
+};
+
+inline view array_iterator::operator*() const
+{
+    return view(v_, i_);
+}
+
+inline member object_iterator::operator*() const
+{
+    return member{ std::string_view(lept_get_object_key(v_, i_), lept_get_object_key_length(v_, i_)),
+                   view(lept_get_object_value(v_, i_)) };
+}
+
+template <typename Derived>
+inline view detail::reader<Derived>::operator[](std::size_t index) const
+{
+    return view(ptr(), index);
+}
+
+template <typename Derived>
+inline range<const double*> detail::reader<Derived>::numbers() const
+{
+    std::size_t n = 0;
+    const double* p = lept_get_array_numbers(ptr(), &n);
+    return { p, p + n };
+}
+
+template <typename Derived>
+inline range<const std::int64_t*> detail::reader<Derived>::int64s() const
+{
+    std::size_t n = 0;
+    const std::int64_t* p = lept_get_array_int64(ptr(), &n);
+    return { p, p + n };
+}
+
+template <typename Derived>
+inline view detail::reader<Derived>::operator[](std::string_view key) const
+{
+    return view(lept_find_object_value(ptr(), key.data(), key.size()));
+}
+
+template <typename Derived>
+inline std::string detail::reader<Derived>::stringify() const
+{
+    std::size_t length;
+    char* json = lept_stringify(ptr(), &length);
+    std::string s(json, length);
+    free(json);
+    return s;
+}
+
+/*  拥有一个 lept_value，析构时调用 lept_free
+    复制需要显式调用 clone()（lept_copy）或 share()（lept_share），移动使用 lept_move */
+class value : public detail::reader<value> {
+public:
+    value() { lept_init(&v_); }
+    ~value() { lept_free(&v_); }
+    value(const value&) = delete;
+    value& operator=(const value&) = delete;
+    value(value&& rhs) noexcept
+    {
+        lept_init(&v_);
+        lept_move(&v_, &rhs.v_);
+    }
+    value& operator=(value&& rhs) noexcept
+    {
+        if (this != &rhs)
+            lept_move(&v_, &rhs.v_);
+        return *this;
+    }
+
+    /*  接管一个已经初始化的 lept_value 的所有权，src 变为 null */
+    static value adopt(lept_value* src)
+    {
+        value v;
+        lept_move(&v.v_, src);
+        return v;
+    }
+
+    /*  先释放原来的值，返回 LEPT_PARSE_* 错误码，失败时值为 null；opts 为 LEPT_OPT_* */
+    int parse(const char* json, unsigned opts = 0)
+    {
+        lept_free(&v_);
+        return lept_parse_opts(&v_, json, opts);
+    }
+    int parse(const std::string& json, unsigned opts = 0) { return parse(json.c_str(), opts); }
+
+    value clone() const
+    {
+        value v;
+        lept_copy(&v.v_, &v_);
+        return v;
+    }
+    /*  与本值共享同一棵子树（引用计数，写时复制） */
+    value share()
+    {
+        value v;
+        lept_share(&v.v_, &v_);
+        return v;
+    }
+    void swap(value& rhs) { lept_swap(&v_, &rhs.v_); }
+
+    void set_null() { lept_free(&v_); }
+    void set_boolean(bool b) { lept_set_boolean(&v_, b ? 1 : 0); }
+    void set_number(double n) { lept_set_number(&v_, n); }
+    void set_string(std::string_view s) { lept_set_string(&v_, s.data(), s.size()); }
+    void set_array(std::size_t capacity = 0) { lept_set_array(&v_, capacity); }
+    void set_object(std::size_t capacity = 0) { lept_set_object(&v_, capacity); }
+
+    /*  把 v 移动到数组末尾 */
+    void push_back(value&& v) { lept_move(lept_pushback_array_element(&v_), &v.v_); }
+    /*  把 v 移动为成员 key 的值，已存在的键会被替换 */
+    void set(std::string_view key, value&& v)
+    {
+        lept_move(lept_set_object_value(&v_, key.data(), key.size()), &v.v_);
+    }
+
+    view get_view() const { return view(&v_); }
+    operator view() const { return view(&v_); }
+    range<array_iterator> elements() const { return get_view().elements(); }
+    range<object_iterator> members() const { return get_view().members(); }
+    array_iterator begin() const { return get_view().begin(); }
+    array_iterator end() const { return get_view().end(); }
+
+    /*  直接调用 C API 时使用 */
+    const lept_value* c_ptr() const { return &v_; }
+    lept_value* c_ptr() { return &v_; }
+private:
+    lept_value v_;
+};
+
+inline void swap(value& lhs, value& rhs) { lhs.swap(rhs); }
+
+}  // namespace lept
+
+/*
+ *  编译期反射：在结构体所在的命名空间中写 LEPT_REFLECT(Type, field1, field2, ...)，
+ *  就可以使用 lept::decode(json, obj) 和 lept::encode(obj)
+ *  解码直接在 lept_stream 上进行，不建立 lept_value 树；成员名的哈希值在编译期计算，
+ *  按哈希值 switch 分派后再比较一次名字（同一结构体中两个成员的哈希值相同会编译失败）
+ *  支持的成员类型：bool、整数、浮点数、std::string、std::vector<T>、std::optional<T>、
+ *  以及同样用 LEPT_REFLECT 声明的结构体
+ *  与 leptjson_gen 一致：未知的键被跳过，null 视为不存在，缺少的成员保持原值，
+ *  类型不符或整数超出范围返回 LEPT_PARSE_SCHEMA_MISMATCH，重复的键以最后一个为准
+ */
+
+namespace lept {
+
+namespace detail {
+
+/*  32 位 FNV-1a，与 leptjson_gen 生成代码中的哈希相同（seed 为 0） */
+constexpr std::uint32_t hash_key(const char* s, std::size_t len)
+{
+    std::uint32_t h = 2166136261u;
+    for (std::size_t i = 0; i < len; i++)
+        h = (h ^ static_cast<unsigned char>(s[i])) * 16777619u;
+    return h;
+}
+
+template <typename T>
+using is_reflected = decltype(lept_reflect_read_field(static_cast<lept_stream*>(nullptr),
+                                                      std::declval<T&>(), std::string_view()));
+
+/*  下一个值不是期望的类型：合法的值返回 LEPT_PARSE_SCHEMA_MISMATCH，否则返回语法错误 */
+inline int mismatch(lept_stream* s)
+{
+    int ret = lept_stream_skip(s);
+    return LEPT_PARSE_OK == ret ? LEPT_PARSE_SCHEMA_MISMATCH : ret;
+}
+
+/*  先声明所有重载，使 vector<optional<T>> 这类嵌套类型可以互相找到 */
+inline int read(lept_stream* s, bool& b);
+inline int read(lept_stream* s, std::string& str);
+template <typename T>
+std::enable_if_t<std::is_arithmetic_v<T> && !std::is_same_v<T, bool>, int> read(lept_stream* s, T& n);
+template <typename T>
+int read(lept_stream* s, std::vector<T>& v);
+template <typename T>
+int read(lept_stream* s, std::optional<T>& o);
+template <typename T, typename = is_reflected<T>>
+int read(lept_stream* s, T& obj);
+
+inline void write(lept_stream* s, bool b);
+inline void write(lept_stream* s, const std::string& str);
+template <typename T>
+std::enable_if_t<std::is_arithmetic_v<T> && !std::is_same_v<T, bool>> write(lept_stream* s, T n);
+template <typename T>
+void write(lept_stream* s, const std::vector<T>& v);
+template <typename T>
+void write(lept_stream* s, const std::optional<T>& o);
+template <typename T, typename = is_reflected<T>>
+void write(lept_stream* s, const T& obj);
+
+inline int read(lept_stream* s, bool& b)
+{
+    int i, ret;
+    if (LEPT_PARSE_OK == (ret = lept_stream_boolean(s, &i)))
+        b = 0 != i;
+    return ret;
+}
+
+inline int read(lept_stream* s, std::string& str)
+{
+    const char* p;
+    std::size_t len;
+    int ret;
+    if (LEPT_PARSE_OK == (ret = lept_stream_string(s, &p, &len)))
+        str.assign(p, len);
+    return ret;
+}
+
+template <typename T>
+std::enable_if_t<std::is_arithmetic_v<T> && !std::is_same_v<T, bool>, int> read(lept_stream* s, T& n)
+{
+    double d;
+    int ret;
+    if (LEPT_PARSE_OK != (ret = lept_stream_number(s, &d)))
+        return ret;
+    if constexpr (std::is_integral_v<T>) {
+        /*  max 转为 double 时可能进位到 2 的幂，加 1 后作为开区间的上界仍然正确 */
+        if (!(d >= static_cast<double>(std::numeric_limits<T>::min())
+              && d < static_cast<double>(std::numeric_limits<T>::max()) + 1.0)
+            || static_cast<double>(static_cast<T>(d)) != d)
+            return LEPT_PARSE_SCHEMA_MISMATCH;
+    }
+    n = static_cast<T>(d);
+    return LEPT_PARSE_OK;
+}
+
+template <typename T>
+int read(lept_stream* s, std::vector<T>& v)
+{
+    int ret;
+    v.clear();
+    if ('[' != s->json[0])
+        return mismatch(s);
+    s->json++;
+    lept_stream_whitespace(s);
+    if (']' == s->json[0]) {
+        s->json++;
+        return LEPT_PARSE_OK;
+    }
+    for (;;) {
+        v.emplace_back();
+        if (LEPT_PARSE_OK != (ret = read(s, v.back())))
+            return ret;
+        lept_stream_whitespace(s);
+        if (']' == s->json[0]) {
+            s->json++;
+            return LEPT_PARSE_OK;
+        }
+        if (',' != s->json[0])
+            return LEPT_PARSE_MISS_COMMA_OR_SQUARE_BRACKET;
+        s->json++;
+        lept_stream_whitespace(s);
+    }
+}
+
+template <typename T>
+int read(lept_stream* s, std::optional<T>& o)
+{
+    /*  与 write 对应：null 读作 nullopt */
+    if ('n' == s->json[0]) {
+        o.reset();
+        return lept_stream_skip(s);
+    }
+    o.emplace();
+    return read(s, *o);
+}
+
+/*  对象：逐个读取键，交给 LEPT_REFLECT 生成的 lept_reflect_read_field 分派 */
+template <typename T, typename>
+int read(lept_stream* s, T& obj)
+{
+    const char* key;
+    std::size_t len;
+    int ret;
+    if ('{' != s->json[0])
+        return mismatch(s);
+    s->json++;
+    lept_stream_whitespace(s);
+    if ('}' == s->json[0]) {
+        s->json++;
+        return LEPT_PARSE_OK;
+    }
+    for (;;) {
+        if ('"' != s->json[0])
+            return LEPT_PARSE_MISS_KEY;
+        if (LEPT_PARSE_OK != (ret = lept_stream_string(s, &key, &len)))
+            return ret;
+        lept_stream_whitespace(s);
+        if (':' != s->json[0])
+            return LEPT_PARSE_MISS_COLON;
+        s->json++;
+        lept_stream_whitespace(s);
+        /*  key 指向暂存区，在读取值之前比较完毕；null 视为不存在 */
+        if ('n' == s->json[0])
+            ret = lept_stream_skip(s);
+        else
+            ret = lept_reflect_read_field(s, obj, std::string_view(key, len));
+        if (LEPT_PARSE_OK != ret)
+            return ret;
+        lept_stream_whitespace(s);
+        if ('}' == s->json[0]) {
+            s->json++;
+            return LEPT_PARSE_OK;
+        }
+        if (',' != s->json[0])
+            return LEPT_PARSE_MISS_COMMA_OR_CURLY_BRACKET;
+        s->json++;
+        lept_stream_whitespace(s);
+    }
+}
+
+inline void write(lept_stream* s, bool b)
+{
+    if (b)
+        lept_stream_put(s, "true", 4);
+    else
+        lept_stream_put(s, "false", 5);
+}
+
+inline void write(lept_stream* s, const std::string& str)
+{
+    lept_stream_put_string(s, str.data(), str.size());
+}
+
+template <typename T>
+std::enable_if_t<std::is_arithmetic_v<T> && !std::is_same_v<T, bool>> write(lept_stream* s, T n)
+{
+    lept_stream_put_number(s, static_cast<double>(n));
+}
+
+template <typename T>
+void write(lept_stream* s, const std::vector<T>& v)
+{
+    lept_stream_put(s, "[", 1);
+    for (std::size_t i = 0; i < v.size(); i++) {
+        if (i > 0)
+            lept_stream_put(s, ",", 1);
+        write(s, static_cast<const T&>(v[i]));
+    }
+    lept_stream_put(s, "]", 1);
+}
+
+template <typename T>
+void write(lept_stream* s, const std::optional<T>& o)
+{
+    if (o)
+        write(s, *o);
+    else
+        lept_stream_put(s, "null", 4);
+}
+
+/*  每个成员都以 ",\"name\":" 开头，最后把第一个 ',' 改为 '{'，省去逐个判断 */
+template <typename T, typename>
+void write(lept_stream* s, const T& obj)
+{
+    std::size_t start = s->top;
+    lept_reflect_write_fields(s, obj);
+    if (s->top == start)
+        lept_stream_put(s, "{", 1);
+    else
+        s->stack[start] = '{';
+    lept_stream_put(s, "}", 1);
+}
+
+}  // namespace detail
+
+/*  解码到 obj，返回 LEPT_PARSE_* 错误码；出错时 obj 可能已被部分修改 */
+template <typename T>
+int decode(const char* json, T& obj)
+{
+    lept_stream s;
+    int ret;
+    lept_stream_init(&s, json);
+    lept_stream_whitespace(&s);
+    if (LEPT_PARSE_OK == (ret = detail::read(&s, obj))) {
+        lept_stream_whitespace(&s);
+        if ('\0' != s.json[0])
+            ret = LEPT_PARSE_ROOT_NOT_SINGULAR;
+    }
+    lept_stream_free(&s);
+    return ret;
+}
+
+template <typename T>
+std::string encode(const T& obj)
+{
+    lept_stream s;
+    std::size_t length;
+    lept_stream_init(&s, nullptr);
+    detail::write(&s, obj);
+    char* json = lept_stream_finish(&s, &length);
+    std::string str(json, length);
+    free(json);
+    return str;
+}
+
+}  // namespace lept
+
+#define LEPT_REFLECT_EXPAND(x) x
+#define LEPT_REFLECT_CAT_(a, b) a##b
+#define LEPT_REFLECT_CAT(a, b) LEPT_REFLECT_CAT_(a, b)
+#define LEPT_REFLECT_NARG(...) LEPT_REFLECT_EXPAND(LEPT_REFLECT_NARG_(__VA_ARGS__, 32, 31, 30, 29, 28, 27, 26, 25, 24, 23, 22, 21, 20, 19, 18, 17, 16, 15, 14, 13, 12, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1, 0))
+#define LEPT_REFLECT_NARG_(_1, _2, _3, _4, _5, _6, _7, _8, _9, _10, _11, _12, _13, _14, _15, _16, _17, _18, _19, _20, _21, _22, _23, _24, _25, _26, _27, _28, _29, _30, _31, _32, N, ...) N
+#define LEPT_REFLECT_EACH_1(m, x) m(x)
+#define LEPT_REFLECT_EACH_2(m, x, ...) m(x) LEPT_REFLECT_EXPAND(LEPT_REFLECT_EACH_1(m, __VA_ARGS__))
+#define LEPT_REFLECT_EACH_3(m, x, ...) m(x) LEPT_REFLECT_EXPAND(LEPT_REFLECT_EACH_2(m, __VA_ARGS__))
+#define LEPT_REFLECT_EACH_4(m, x, ...) m(x) LEPT_REFLECT_EXPAND(LEPT_REFLECT_EACH_3(m, __VA_ARGS__))
+#define LEPT_REFLECT_EACH_5(m, x, ...) m(x) LEPT_REFLECT_EXPAND(LEPT_REFLECT_EACH_4(m, __VA_ARGS__))
+#define LEPT_REFLECT_EACH_6(m, x, ...) m(x) LEPT_REFLECT_EXPAND(LEPT_REFLECT_EACH_5(m, __VA_ARGS__))
+#define LEPT_REFLECT_EACH_7(m, x, ...) m(x) LEPT_REFLECT_EXPAND(LEPT_REFLECT_EACH_6(m, __VA_ARGS__))
+#define LEPT_REFLECT_EACH_8(m, x, ...) m(x) LEPT_REFLECT_EXPAND(LEPT_REFLECT_EACH_7(m, __VA_ARGS__))
+#define LEPT_REFLECT_EACH_9(m, x, ...) m(x) LEPT_REFLECT_EXPAND(LEPT_REFLECT_EACH_8(m, __VA_ARGS__))
+#define LEPT_REFLECT_EACH_10(m, x, ...) m(x) LEPT_REFLECT_EXPAND(LEPT_REFLECT_EACH_9(m, __VA_ARGS__))
+#define LEPT_REFLECT_EACH_11(m, x, ...) m(x) LEPT_REFLECT_EXPAND(LEPT_REFLECT_EACH_10(m, __VA_ARGS__))
+#define LEPT_REFLECT_EACH_12(m, x, ...) m(x) LEPT_REFLECT_EXPAND(LEPT_REFLECT_EACH_11(m, __VA_ARGS__))
+#define LEPT_REFLECT_EACH_13(m, x, ...) m(x) LEPT_REFLECT_EXPAND(LEPT_REFLECT_EACH_12(m, __VA_ARGS__))
+#define LEPT_REFLECT_EACH_14(m, x, ...) m(x) LEPT_REFLECT_EXPAND(LEPT_REFLECT_EACH_13(m, __VA_ARGS__))
+#define LEPT_REFLECT_EACH_15(m, x, ...) m(x) LEPT_REFLECT_EXPAND(LEPT_REFLECT_EACH_14(m, __VA_ARGS__))
+#define LEPT_REFLECT_EACH_16(m, x, ...) m(x) LEPT_REFLECT_EXPAND(LEPT_REFLECT_EACH_15(m, __VA_ARGS__))
+#define LEPT_REFLECT_EACH_17(m, x, ...) m(x) LEPT_REFLECT_EXPAND(LEPT_REFLECT_EACH_16(m, __VA_ARGS__))
+#define LEPT_REFLECT_EACH_18(m, x, ...) m(x) LEPT_REFLECT_EXPAND(LEPT_REFLECT_EACH_17(m, __VA_ARGS__))
+#define LEPT_REFLECT_EACH_19(m, x, ...) m(x) LEPT_REFLECT_EXPAND(LEPT_REFLECT_EACH_18(m, __VA_ARGS__))
+#define LEPT_REFLECT_EACH_20(m, x, ...) m(x) LEPT_REFLECT_EXPAND(LEPT_REFLECT_EACH_19(m, __VA_ARGS__))
+#define LEPT_REFLECT_EACH_21(m, x, ...) m(x) LEPT_REFLECT_EXPAND(LEPT_REFLECT_EACH_20(m, __VA_ARGS__))
+#define LEPT_REFLECT_EACH_22(m, x, ...) m(x) LEPT_REFLECT_EXPAND(LEPT_REFLECT_EACH_21(m, __VA_ARGS__))
+#define LEPT_REFLECT_EACH_23(m, x, ...) m(x) LEPT_REFLECT_EXPAND(LEPT_REFLECT_EACH_22(m, __VA_ARGS__))
+#define LEPT_REFLECT_EACH_24(m, x, ...) m(x) LEPT_REFLECT_EXPAND(LEPT_REFLECT_EACH_23(m, __VA_ARGS__))
+#define LEPT_REFLECT_EACH_25(m, x, ...) m(x) LEPT_REFLECT_EXPAND(LEPT_REFLECT_EACH_24(m, __VA_ARGS__))
+#define LEPT_REFLECT_EACH_26(m, x, ...) m(x) LEPT_REFLECT_EXPAND(LEPT_REFLECT_EACH_25(m, __VA_ARGS__))
+#define LEPT_REFLECT_EACH_27(m, x, ...) m(x) LEPT_REFLECT_EXPAND(LEPT_REFLECT_EACH_26(m, __VA_ARGS__))
+#define LEPT_REFLECT_EACH_28(m, x, ...) m(x) LEPT_REFLECT_EXPAND(LEPT_REFLECT_EACH_27(m, __VA_ARGS__))
+#define LEPT_REFLECT_EACH_29(m, x, ...) m(x) LEPT_REFLECT_EXPAND(LEPT_REFLECT_EACH_28(m, __VA_ARGS__))
+#define LEPT_REFLECT_EACH_30(m, x, ...) m(x) LEPT_REFLECT_EXPAND(LEPT_REFLECT_EACH_29(m, __VA_ARGS__))
+#define LEPT_REFLECT_EACH_31(m, x, ...) m(x) LEPT_REFLECT_EXPAND(LEPT_REFLECT_EACH_30(m, __VA_ARGS__))
+#define LEPT_REFLECT_EACH_32(m, x, ...) m(x) LEPT_REFLECT_EXPAND(LEPT_REFLECT_EACH_31(m, __VA_ARGS__))
+#define LEPT_REFLECT_EACH(m, ...) \
+    LEPT_REFLECT_EXPAND(LEPT_REFLECT_CAT(LEPT_REFLECT_EACH_, LEPT_REFLECT_NARG(__VA_ARGS__))(m, __VA_ARGS__))
+
+#define LEPT_REFLECT_CASE(f) \
+    case lept::detail::hash_key(#f, sizeof(#f) - 1): \
+        if (key == std::string_view(#f, sizeof(#f) - 1)) \
+            return lept::detail::read(s, obj.f); \
+        break;
+#define LEPT_REFLECT_PUT(f) \
+    lept_stream_put(s, ",\"" #f "\":", sizeof(#f) + 3); \
+    lept::detail::write(s, obj.f);
+
+/*  至少 1 个、最多 32 个成员，生成的两个函数通过 ADL 找到 */
+#define LEPT_REFLECT(Type, ...) \
+    inline int lept_reflect_read_field(lept_stream* s, Type& obj, std::string_view key) \
+    { \
+        switch (lept::detail::hash_key(key.data(), key.size())) { \
+            LEPT_REFLECT_EACH(LEPT_REFLECT_CASE, __VA_ARGS__) \
+        } \
+        return lept_stream_skip(s); \
+    } \
+    inline void lept_reflect_write_fields(lept_stream* s, const Type& obj) \
+    { \
+        LEPT_REFLECT_EACH(LEPT_REFLECT_PUT, __VA_ARGS__) \
+    }
+
+#endif /* LEPTJSON_HPP__ */
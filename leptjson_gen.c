@@ -0,0 +1,753 @@
+/*
+ *  leptjson_gen：根据 JSON Schema 的一个子集生成 C 结构体，以及直接读写这些结构体的专用函数，
+ *  解析时不建立 lept_value 树，键用完美哈希分派，未知的键直接跳过。
+ *  用法：leptjson_gen schema.json out  生成 out.h 和 out.c
+ *
+ *  支持的 schema：
+ *      "type": "number" / "integer" / "boolean" / "string" / "array" / "object"
+ *      array 用 "items" 给出元素的 schema
+ *      object 用 "properties" 给出成员，"required" 给出必需的成员，"title" 给出结构体名
+ *      （根必须有 "title"，嵌套的对象没有时用 父结构体名_成员名）
+ *  对于每个对象 T 生成：
+ *      int T_parse(T* val, const char* json);
+ *      char* T_stringify(const T* val, size_t* length);
+ *      void T_free(T* val);
+ *  值为 null 的成员视为不存在，不存在的成员为 0 或 NULL。
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include "leptjson.h"
+
+/*  完美哈希的种子最多尝试这么多次 */
+#define GEN_MAX_SEED 1000000ul
+
+typedef struct GEN_STRUCT {
+    const lept_value* schema;
+    char* name;
+} gen_struct;
+
+static gen_struct* gen_structs = NULL;
+static size_t gen_count = 0;
+
+static void gen_error(const char* msg, const char* detail);
+static char* gen_read_file(const char* path);
+static const char* gen_type(const lept_value* schema);
+static char* gen_concat(const char* a, const char* b, const char* c);
+static char* gen_ident(const char* s, size_t len);
+static const char* gen_struct_name(const lept_value* schema);
+static void gen_collect(const lept_value* schema, const char* name);
+static int gen_is_required(const lept_value* schema, const char* key, size_t klen);
+static unsigned long gen_hash(const char* s, size_t len, unsigned long seed);
+static void gen_literal(FILE* fp, const char* s, size_t len);
+static void gen_ctype(FILE* fp, const lept_value* schema);
+static int gen_need_free(const lept_value* schema);
+static void gen_indent(FILE* fp, int indent);
+static void gen_parse(FILE* fp, const lept_value* schema, const char* lv, int depth, int indent);
+static void gen_free(FILE* fp, const lept_value* schema, const char* lv, int depth, int indent);
+static void gen_write(FILE* fp, const lept_value* schema, const char* lv, int depth, int indent);
+static void gen_header(FILE* fp, const char* guard);
+static void gen_source(FILE* fp, const char* header);
+static void gen_object(FILE* fp, const gen_struct* st);
+
+int main(int argc, char** argv)
+{
+    lept_value schema;
+    char *json, *path, *guard;
+    const char *p, *base;
+    FILE* fp;
+    size_t i = 0;
+    int ret;
+    if(3 != argc)
+    {
+        fprintf(stderr, "usage: %s schema.json out\n", argv[0]);
+        return 1;
+    }
+    json = gen_read_file(argv[1]);
+    lept_init(&schema);
+    if(LEPT_PARSE_OK != (ret = lept_parse(&schema, json)))
+    {
+        fprintf(stderr, "leptjson_gen: %s: invalid JSON (error %d)\n", argv[1], ret);
+        return 1;
+    }
+    if(LEPT_OBJECT != schema.type || NULL == lept_find_object_value(&schema, "title", 5))
+        gen_error("the root schema must be an object with a \"title\"", argv[1]);
+    gen_collect(&schema, NULL);
+
+    /*  生成的 .c 用不含目录的文件名包含头文件 */
+    for(p = base = argv[2]; *p; p++)
+        if('/' == *p || '\\' == *p)
+            base = p + 1;
+
+    guard = gen_concat(base, "_H__", "");
+    for(i = 0; guard[i]; i++)
+        guard[i] = isalnum((unsigned char)guard[i]) ? (char)toupper((unsigned char)guard[i]) : '_';
+    path = gen_concat(argv[2], ".h", "");
+    if(NULL == (fp = fopen(path, "w")))
+        gen_error("cannot write", path);
+    gen_header(fp, guard);
+    fclose(fp);
+    free(path);
+    free(guard);
+
+    guard = gen_concat(base, ".h", "");
+    path = gen_concat(argv[2], ".c", "");
+    if(NULL == (fp = fopen(path, "w")))
+        gen_error("cannot write", path);
+    gen_source(fp, guard);
+    fclose(fp);
+    free(path);
+    free(guard);
+
+    for(i = 0; i < gen_count; i++)
+        free(gen_structs[i].name);
+    free(gen_structs);
+    lept_free(&schema);
+    free(json);
+    return 0;
+}
+
+
+void gen_error(const char* msg, const char* detail)
+{
+    fprintf(stderr, "leptjson_gen: %s: %s\n", msg, detail);
+    exit(1);
+}
+
+
+char* gen_read_file(const char* path)
+{
+    FILE* fp;
+    char* buf;
+    long size;
+    if(NULL == (fp = fopen(path, "rb")))
+        gen_error("cannot read", path);
+    fseek(fp, 0, SEEK_END);
+    size = ftell(fp);
+    fseek(fp, 0, SEEK_SET);
+    buf = (char*)malloc((size_t)size + 1);
+    if(fread(buf, 1, (size_t)size, fp) != (size_t)size)
+        gen_error("cannot read", path);
+    buf[size] = '\0';
+    fclose(fp);
+    return buf;
+}
+
+
+const char* gen_type(const lept_value* schema)
+{
+    static const char* types[] = { "number", "integer", "boolean", "string", "array", "object" };
+    const lept_value* t;
+    size_t i = 0;
+    if(LEPT_OBJECT != schema->type || NULL == (t = lept_find_object_value(schema, "type", 4)) || LEPT_STRING != t->type)
+        gen_error("unsupported schema", "each schema must be an object with a string \"type\"");
+    for(i = 0; i < sizeof(types) / sizeof(types[0]); i++)
+        if(0 == strcmp(types[i], lept_get_string(t)))
+            return types[i];
+    gen_error("unsupported type", lept_get_string(t));
+    return NULL;
+}
+
+
+char* gen_concat(const char* a, const char* b, const char* c)
+{
+    char* ret = (char*)malloc(strlen(a) + strlen(b) + strlen(c) + 1);
+    strcat(strcat(strcpy(ret, a), b), c);
+    return ret;
+}
+
+
+/*  把任意的键变为合法的 C 标识符 */
+char* gen_ident(const char* s, size_t len)
+{
+    char *ret = (char*)malloc(len + 2), *p = ret;
+    size_t i = 0;
+    if(0 == len || isdigit((unsigned char)s[0]))
+        *p++ = '_';
+    for(i = 0; i < len; i++)
+        *p++ = isalnum((unsigned char)s[i]) ? s[i] : '_';
+    *p = '\0';
+    return ret;
+}
+
+
+const char* gen_struct_name(const lept_value* schema)
+{
+    size_t i = 0;
+    for(i = 0; i < gen_count; i++)
+        if(gen_structs[i].schema == schema)
+            return gen_structs[i].name;
+    gen_error("internal error", "struct not collected");
+    return NULL;
+}
+
+
+/*  按后序收集所有对象的 schema，使嵌套的结构体先于使用它的结构体定义 */
+void gen_collect(const lept_value* schema, const char* name)
+{
+    const char* type = gen_type(schema);
+    const lept_value *title, *props, *items, *req;
+    char *ident, *child;
+    size_t i = 0, j = 0;
+    if(0 == strcmp(type, "array"))
+    {
+        if(NULL == (items = lept_find_object_value(schema, "items", 5)))
+            gen_error("array without \"items\"", name);
+        child = gen_concat(name, "_item", "");
+        gen_collect(items, child);
+        free(child);
+        return;
+    }
+    if(0 != strcmp(type, "object"))
+        return;
+    if(NULL != (title = lept_find_object_value(schema, "title", 5)))
+    {
+        if(LEPT_STRING != title->type)
+            gen_error("\"title\" must be a string", name ? name : "root");
+        ident = gen_ident(lept_get_string(title), lept_get_string_length(title));
+    }
+    else
+        ident = gen_ident(name, strlen(name));
+    for(i = 0; i < gen_count; i++)
+        if(0 == strcmp(gen_structs[i].name, ident))
+            gen_error("duplicate struct name", ident);
+    if(NULL != (props = lept_find_object_value(schema, "properties", 10)))
+    {
+        if(LEPT_OBJECT != props->type)
+            gen_error("\"properties\" must be an object", ident);
+        for(i = 0; i < lept_get_object_size(props); i++)
+        {
+            for(j = 0; j < i; j++)
+                if(lept_get_object_key_length(props, i) == lept_get_object_key_length(props, j)
+                   && 0 == memcmp(lept_get_object_key(props, i), lept_get_object_key(props, j), lept_get_object_key_length(props, i)))
+                    gen_error("duplicate property", lept_get_object_key(props, i));
+            child = gen_ident(lept_get_object_key(props, i), lept_get_object_key_length(props, i));
+            name = gen_concat(ident, "_", child);
+            gen_collect(lept_get_object_value(props, i), name);
+            free((char*)name);
+            free(child);
+        }
+    }
+    if(NULL != (req = lept_find_object_value(schema, "required", 8)))
+    {
+        if(LEPT_ARRAY != req->type)
+            gen_error("\"required\" must be an array", ident);
+        for(i = 0; i < lept_get_array_size(req); i++)
+            if(LEPT_STRING != lept_get_type(lept_get_array_element(req, i)))
+                gen_error("\"required\" must contain strings", ident);
+    }
+    gen_structs = (gen_struct*)realloc(gen_structs, (gen_count + 1) * sizeof(gen_struct));
+    gen_structs[gen_count].schema = schema;
+    gen_structs[gen_count++].name = ident;
+}
+
+
+int gen_is_required(const lept_value* schema, const char* key, size_t klen)
+{
+    const lept_value* req = lept_find_object_value(schema, "required", 8);
+    size_t i = 0;
+    for(i = 0; NULL != req && i < lept_get_array_size(req); i++)
+        if(klen == lept_get_string_length(lept_get_array_element(req, i))
+           && 0 == memcmp(key, lept_get_string(lept_get_array_element(req, i)), klen))
+            return 1;
+    return 0;
+}
+
+
+/*  带种子的 FNV-1a，生成的代码中有相同的函数 */
+unsigned long gen_hash(const char* s, size_t len, unsigned long seed)
+{
+    unsigned long h = (2166136261ul ^ seed) & 0xfffffffful;
+    size_t i = 0;
+    for(i = 0; i < len; i++)
+        h = ((h ^ (unsigned char)s[i]) * 16777619ul) & 0xfffffffful;
+    return h;
+}
+
+
+/*  输出 C 字符串字面量，非打印字符、引号、反斜杠和 ? 用八进制转义 */
+void gen_literal(FILE* fp, const char* s, size_t len)
+{
+    size_t i = 0;
+    unsigned char ch;
+    fputc('"', fp);
+    for(i = 0; i < len; i++)
+    {
+        ch = (unsigned char)s[i];
+        if(ch >= 0x20 && ch < 0x7f && '"' != ch && '\\' != ch && '?' != ch)
+            fputc(ch, fp);
+        else
+            fprintf(fp, "\\%03o", ch);
+    }
+    fputc('"', fp);
+}
+
+
+void gen_ctype(FILE* fp, const lept_value* schema)
+{
+    const char* type = gen_type(schema);
+    if(0 == strcmp(type, "number"))
+        fputs("double", fp);
+    else if(0 == strcmp(type, "integer"))
+        fputs("long", fp);
+    else if(0 == strcmp(type, "boolean"))
+        fputs("int", fp);
+    else if(0 == strcmp(type, "string"))
+        fputs("lept_gen_string", fp);
+    else if(0 == strcmp(type, "object"))
+        fputs(gen_struct_name(schema), fp);
+    else
+    {
+        fputs("struct { ", fp);
+        gen_ctype(fp, lept_find_object_value(schema, "items", 5));
+        fputs("* e; size_t size; }", fp);
+    }
+}
+
+
+int gen_need_free(const lept_value* schema)
+{
+    const char* type = gen_type(schema);
+    return 0 == strcmp(type, "string") || 0 == strcmp(type, "array") || 0 == strcmp(type, "object");
+}
+
+
+void gen_indent(FILE* fp, int indent)
+{
+    while(indent-- > 0)
+        fputs("    ", fp);
+}
+
+
+/*  生成把下一个值解析到左值 lv 的语句，结果放在 ret 中；lv 事先为 0 */
+void gen_parse(FILE* fp, const lept_value* schema, const char* lv, int depth, int indent)
+{
+    const char* type = gen_type(schema);
+    char* elem;
+    gen_indent(fp, indent);
+    if(0 == strcmp(type, "number"))
+        fprintf(fp, "ret = lept_stream_number(s, &%s);\n", lv);
+    else if(0 == strcmp(type, "integer"))
+    {
+        fprintf(fp, "if(LEPT_PARSE_OK == (ret = lept_stream_number(s, &d)))\n");
+        gen_indent(fp, indent);
+        fprintf(fp, "    ret = lept_gen_integer(d, &%s);\n", lv);
+    }
+    else if(0 == strcmp(type, "boolean"))
+        fprintf(fp, "ret = lept_stream_boolean(s, &%s);\n", lv);
+    else if(0 == strcmp(type, "string"))
+    {
+        fprintf(fp, "if(LEPT_PARSE_OK == (ret = lept_stream_string(s, &str, &len)))\n");
+        gen_indent(fp, indent);
+        fprintf(fp, "    lept_gen_set_string(&%s, str, len);\n", lv);
+    }
+    else if(0 == strcmp(type, "object"))
+        fprintf(fp, "ret = %s_parse_value(s, &%s);\n", gen_struct_name(schema), lv);
+    else
+    {
+        /*  新元素先计入 size 再解析，出错时也会被释放 */
+        elem = gen_concat(lv, ".e[", "");
+        elem = (char*)realloc(elem, strlen(elem) + strlen(lv) + 16);
+        strcat(strcat(elem, lv), ".size - 1]");
+        fprintf(fp, "if(LEPT_PARSE_OK == (ret = lept_gen_array_begin(s)) && ']' != s->json[0])\n");
+        gen_indent(fp, indent);
+        fprintf(fp, "{\n");
+        gen_indent(fp, indent + 1);
+        fprintf(fp, "size_t cap%d = 0;\n", depth);
+        gen_indent(fp, indent + 1);
+        fprintf(fp, "do {\n");
+        gen_indent(fp, indent + 2);
+        fprintf(fp, "if(%s.size == cap%d)\n", lv, depth);
+        gen_indent(fp, indent + 3);
+        fprintf(fp, "%s.e = lept_gen_grow(%s.e, &cap%d, sizeof(*%s.e));\n", lv, lv, depth, lv);
+        gen_indent(fp, indent + 2);
+        fprintf(fp, "memset(&%s.e[%s.size++], 0, sizeof(*%s.e));\n", lv, lv, lv);
+        gen_parse(fp, lept_find_object_value(schema, "items", 5), elem, depth + 1, indent + 2);
+        gen_indent(fp, indent + 1);
+        fprintf(fp, "} while(LEPT_PARSE_OK == ret && LEPT_PARSE_OK == (ret = lept_gen_array_next(s)) && ']' != s->json[0]);\n");
+        gen_indent(fp, indent);
+        fprintf(fp, "}\n");
+        gen_indent(fp, indent);
+        fprintf(fp, "if(LEPT_PARSE_OK == ret && ']' == s->json[0])\n");
+        gen_indent(fp, indent + 1);
+        fprintf(fp, "s->json++;\n");
+        free(elem);
+    }
+}
+
+
+/*  生成释放左值 lv 的语句 */
+void gen_free(FILE* fp, const lept_value* schema, const char* lv, int depth, int indent)
+{
+    const char* type = gen_type(schema);
+    const lept_value* items;
+    char* elem;
+    char idx[32];
+    if(0 == strcmp(type, "string"))
+    {
+        gen_indent(fp, indent);
+        fprintf(fp, "free(%s.s);\n", lv);
+    }
+    else if(0 == strcmp(type, "object"))
+    {
+        gen_indent(fp, indent);
+        fprintf(fp, "%s_free_value(&%s);\n", gen_struct_name(schema), lv);
+    }
+    else if(0 == strcmp(type, "array"))
+    {
+        items = lept_find_object_value(schema, "items", 5);
+        if(gen_need_free(items))
+        {
+            sprintf(idx, "[i%d]", depth);
+            elem = gen_concat(lv, ".e", idx);
+            gen_indent(fp, indent);
+            fprintf(fp, "{\n");
+            gen_indent(fp, indent + 1);
+            fprintf(fp, "size_t i%d;\n", depth);
+            gen_indent(fp, indent + 1);
+            fprintf(fp, "for(i%d = 0; i%d < %s.size; i%d++)\n", depth, depth, lv, depth);
+            gen_indent(fp, indent + 1);
+            fprintf(fp, "{\n");
+            gen_free(fp, items, elem, depth + 1, indent + 2);
+            gen_indent(fp, indent + 1);
+            fprintf(fp, "}\n");
+            gen_indent(fp, indent);
+            fprintf(fp, "}\n");
+            free(elem);
+        }
+        gen_indent(fp, indent);
+        fprintf(fp, "free(%s.e);\n", lv);
+    }
+}
+
+
+/*  生成写出左值 lv 的语句 */
+void gen_write(FILE* fp, const lept_value* schema, const char* lv, int depth, int indent)
+{
+    const char* type = gen_type(schema);
+    char* elem;
+    char idx[32];
+    if(0 == strcmp(type, "number"))
+    {
+        gen_indent(fp, indent);
+        fprintf(fp, "lept_stream_put_number(s, %s);\n", lv);
+    }
+    else if(0 == strcmp(type, "integer"))
+    {
+        gen_indent(fp, indent);
+        fprintf(fp, "lept_stream_put_number(s, (double)%s);\n", lv);
+    }
+    else if(0 == strcmp(type, "boolean"))
+    {
+        gen_indent(fp, indent);
+        fprintf(fp, "lept_stream_put(s, %s ? \"true\" : \"false\", %s ? 4 : 5);\n", lv, lv);
+    }
+    else if(0 == strcmp(type, "string"))
+    {
+        gen_indent(fp, indent);
+        fprintf(fp, "lept_stream_put_string(s, %s.s ? %s.s : \"\", %s.len);\n", lv, lv, lv);
+    }
+    else if(0 == strcmp(type, "object"))
+    {
+        gen_indent(fp, indent);
+        fprintf(fp, "%s_write(s, &%s);\n", gen_struct_name(schema), lv);
+    }
+    else
+    {
+        sprintf(idx, "[i%d]", depth);
+        elem = gen_concat(lv, ".e", idx);
+        gen_indent(fp, indent);
+        fprintf(fp, "{\n");
+        gen_indent(fp, indent + 1);
+        fprintf(fp, "size_t i%d;\n", depth);
+        gen_indent(fp, indent + 1);
+        fprintf(fp, "lept_stream_put(s, \"[\", 1);\n");
+        gen_indent(fp, indent + 1);
+        fprintf(fp, "for(i%d = 0; i%d < %s.size; i%d++)\n", depth, depth, lv, depth);
+        gen_indent(fp, indent + 1);
+        fprintf(fp, "{\n");
+        gen_indent(fp, indent + 2);
+        fprintf(fp, "if(i%d > 0)\n", depth);
+        gen_indent(fp, indent + 3);
+        fprintf(fp, "lept_stream_put(s, \",\", 1);\n");
+        gen_write(fp, lept_find_object_value(schema, "items", 5), elem, depth + 1, indent + 2);
+        gen_indent(fp, indent + 1);
+        fprintf(fp, "}\n");
+        gen_indent(fp, indent + 1);
+        fprintf(fp, "lept_stream_put(s, \"]\", 1);\n");
+        gen_indent(fp, indent);
+        fprintf(fp, "}\n");
+        free(elem);
+    }
+}
+
+
+void gen_header(FILE* fp, const char* guard)
+{
+    const lept_value* props;
+    size_t i = 0, j = 0;
+    char* ident;
+    fprintf(fp, "/*  由 leptjson_gen 生成，不要手工修改 */\n");
+    fprintf(fp, "#ifndef %s\n#define %s\n#include <stddef.h>\n\n", guard, guard);
+    fprintf(fp, "#ifndef LEPT_GEN_STRING_DEFINED\n#define LEPT_GEN_STRING_DEFINED\n");
+    fprintf(fp, "/*  s 以 '\\0' 结尾，len 不含结尾的 '\\0' */\n");
+    fprintf(fp, "typedef struct lept_gen_string { char* s; size_t len; } lept_gen_string;\n#endif\n\n");
+    for(i = 0; i < gen_count; i++)
+    {
+        fprintf(fp, "typedef struct %s {\n", gen_structs[i].name);
+        props = lept_find_object_value(gen_structs[i].schema, "properties", 10);
+        for(j = 0; NULL != props && j < lept_get_object_size(props); j++)
+        {
+            ident = gen_ident(lept_get_object_key(props, j), lept_get_object_key_length(props, j));
+            fputs("    ", fp);
+            gen_ctype(fp, lept_get_object_value(props, j));
+            fprintf(fp, " %s;\n", ident);
+            free(ident);
+        }
+        /*  C89 不允许空的结构体 */
+        if(NULL == props || 0 == lept_get_object_size(props))
+            fputs("    char unused;\n", fp);
+        fprintf(fp, "} %s;\n\n", gen_structs[i].name);
+    }
+    for(i = 0; i < gen_count; i++)
+    {
+        fprintf(fp, "int %s_parse(%s* val, const char* json);\n", gen_structs[i].name, gen_structs[i].name);
+        fprintf(fp, "char* %s_stringify(const %s* val, size_t* length);\n", gen_structs[i].name, gen_structs[i].name);
+        fprintf(fp, "void %s_free(%s* val);\n\n", gen_structs[i].name, gen_structs[i].name);
+    }
+    fprintf(fp, "#endif /* %s */\n", guard);
+}
+
+
+void gen_source(FILE* fp, const char* header)
+{
+    size_t i = 0;
+    fprintf(fp, "/*  由 leptjson_gen 生成，不要手工修改 */\n");
+    fprintf(fp, "#include <stdlib.h>\n#include <string.h>\n#include <limits.h>\n#include \"leptjson.h\"\n#include \"%s\"\n\n", header);
+    fputs(
+        "static unsigned long lept_gen_hash(const char* s, size_t len, unsigned long seed)\n"
+        "{\n"
+        "    unsigned long h = (2166136261ul ^ seed) & 0xfffffffful;\n"
+        "    size_t i;\n"
+        "    for(i = 0; i < len; i++)\n"
+        "        h = ((h ^ (unsigned char)s[i]) * 16777619ul) & 0xfffffffful;\n"
+        "    return h;\n"
+        "}\n\n", fp);
+    fputs(
+        "static void lept_gen_set_string(lept_gen_string* str, const char* s, size_t len)\n"
+        "{\n"
+        "    str->s = (char*)malloc(len + 1);\n"
+        "    if(len > 0)\n"
+        "        memcpy(str->s, s, len);\n"
+        "    str->s[len] = '\\0';\n"
+        "    str->len = len;\n"
+        "}\n\n", fp);
+    fputs(
+        "/*  (double)LONG_MAX 会进位到 2 的幂，用 -(double)LONG_MIN 作为开区间的上界 */\n"
+        "static int lept_gen_integer(double d, long* l)\n"
+        "{\n"
+        "    if(!(d >= (double)LONG_MIN && d < -(double)LONG_MIN) || (double)(long)d != d)\n"
+        "        return LEPT_PARSE_SCHEMA_MISMATCH;\n"
+        "    *l = (long)d;\n"
+        "    return LEPT_PARSE_OK;\n"
+        "}\n\n", fp);
+    fputs(
+        "static void* lept_gen_grow(void* e, size_t* cap, size_t size)\n"
+        "{\n"
+        "    *cap = *cap < 4 ? 4 : *cap + (*cap >> 1);\n"
+        "    return realloc(e, *cap * size);\n"
+        "}\n\n", fp);
+    fputs(
+        "static int lept_gen_array_begin(lept_stream* s)\n"
+        "{\n"
+        "    if('[' != s->json[0])\n"
+        "        return LEPT_PARSE_SCHEMA_MISMATCH;\n"
+        "    s->json++;\n"
+        "    lept_stream_whitespace(s);\n"
+        "    return LEPT_PARSE_OK;\n"
+        "}\n\n", fp);
+    fputs(
+        "/*  返回 OK 且 s->json 指向 ']' 时数组结束 */\n"
+        "static int lept_gen_array_next(lept_stream* s)\n"
+        "{\n"
+        "    lept_stream_whitespace(s);\n"
+        "    if(']' == s->json[0])\n"
+        "        return LEPT_PARSE_OK;\n"
+        "    if(',' != s->json[0])\n"
+        "        return LEPT_PARSE_MISS_COMMA_OR_SQUARE_BRACKET;\n"
+        "    s->json++;\n"
+        "    lept_stream_whitespace(s);\n"
+        "    return ']' == s->json[0] ? LEPT_PARSE_INVALID_VALUE : LEPT_PARSE_OK;\n"
+        "}\n\n", fp);
+    for(i = 0; i < gen_count; i++)
+    {
+        fprintf(fp, "static int %s_parse_value(lept_stream* s, %s* val);\n", gen_structs[i].name, gen_structs[i].name);
+        fprintf(fp, "static void %s_free_value(%s* val);\n", gen_structs[i].name, gen_structs[i].name);
+        fprintf(fp, "static void %s_write(lept_stream* s, const %s* val);\n", gen_structs[i].name, gen_structs[i].name);
+    }
+    for(i = 0; i < gen_count; i++)
+        gen_object(fp, &gen_structs[i]);
+}
+
+
+void gen_object(FILE* fp, const gen_struct* st)
+{
+    const lept_value* props = lept_find_object_value(st->schema, "properties", 10);
+    const char* name = st->name;
+    size_t n = NULL != props ? lept_get_object_size(props) : 0, m = 1, i = 0, j = 0, len = 0;
+    unsigned long seed = 0;
+    int* slots;
+    char *ident, *lv, *json;
+    lept_value key;
+
+    /*  完美哈希：表长取不小于 2n 的 2 的幂，找到一个使所有键落在不同槽中的种子 */
+    while(m < 2 * n)
+        m <<= 1;
+    slots = (int*)malloc(m * sizeof(int));
+    for(seed = 0; seed < GEN_MAX_SEED; seed++)
+    {
+        for(i = 0; i < m; i++)
+            slots[i] = -1;
+        for(i = 0; i < n; i++)
+        {
+            j = gen_hash(lept_get_object_key(props, i), lept_get_object_key_length(props, i), seed) & (m - 1);
+            if(slots[j] >= 0)
+                break;
+            slots[j] = (int)i;
+        }
+        if(i == n)
+            break;
+    }
+    if(GEN_MAX_SEED == seed)
+        gen_error("cannot find a perfect hash", name);
+
+    fprintf(fp, "\n\nstatic const char* const %s_keys[] = {", name);
+    for(i = 0; i < n; i++)
+    {
+        fputs(i > 0 ? ", " : " ", fp);
+        gen_literal(fp, lept_get_object_key(props, i), lept_get_object_key_length(props, i));
+    }
+    fprintf(fp, "%s};\n", n > 0 ? " " : " 0 ");
+    fprintf(fp, "static const size_t %s_klens[] = {", name);
+    for(i = 0; i < n; i++)
+        fprintf(fp, "%s%lu", i > 0 ? ", " : " ", (unsigned long)lept_get_object_key_length(props, i));
+    fprintf(fp, "%s};\n", n > 0 ? " " : " 0 ");
+    fprintf(fp, "static const short %s_slots[%lu] = {", name, (unsigned long)m);
+    for(i = 0; i < m; i++)
+        fprintf(fp, "%s%d", i > 0 ? ", " : " ", slots[i]);
+    fprintf(fp, " };\n\n");
+    free(slots);
+
+    /*  解析 */
+    fprintf(fp, "int %s_parse_value(lept_stream* s, %s* val)\n{\n", name, name);
+    fprintf(fp, "    unsigned char seen[%lu];\n", (unsigned long)(n > 0 ? n : 1));
+    fprintf(fp, "    const char* str;\n    size_t len;\n    double d;\n    int ret = LEPT_PARSE_OK, i;\n");
+    fprintf(fp, "    (void)d;\n");
+    if(0 == n)
+        fprintf(fp, "    (void)val;\n");
+    fprintf(fp, "    memset(seen, 0, sizeof(seen));\n");
+    fprintf(fp, "    if('{' != s->json[0])\n        return LEPT_PARSE_SCHEMA_MISMATCH;\n");
+    fprintf(fp, "    s->json++;\n    lept_stream_whitespace(s);\n");
+    fprintf(fp, "    if('}' == s->json[0])\n        s->json++;\n");
+    fprintf(fp, "    else for(;;)\n    {\n");
+    fprintf(fp, "        if('\"' != s->json[0])\n            return LEPT_PARSE_MISS_KEY;\n");
+    fprintf(fp, "        if(LEPT_PARSE_OK != (ret = lept_stream_string(s, &str, &len)))\n            return ret;\n");
+    fprintf(fp, "        i = %s_slots[lept_gen_hash(str, len, %luul) & %luu];\n", name, seed, (unsigned long)(m - 1));
+    fprintf(fp, "        if(i >= 0 && (len != %s_klens[i] || 0 != memcmp(str, %s_keys[i], len)))\n            i = -1;\n", name, name);
+    fprintf(fp, "        lept_stream_whitespace(s);\n");
+    fprintf(fp, "        if(':' != s->json[0])\n            return LEPT_PARSE_MISS_COLON;\n");
+    fprintf(fp, "        s->json++;\n        lept_stream_whitespace(s);\n");
+    fprintf(fp, "        /*  null 视为不存在 */\n");
+    fprintf(fp, "        if('n' == s->json[0])\n            i = -1;\n");
+    fprintf(fp, "        switch(i)\n        {\n");
+    for(i = 0; i < n; i++)
+    {
+        ident = gen_ident(lept_get_object_key(props, i), lept_get_object_key_length(props, i));
+        lv = gen_concat("val->", ident, "");
+        fprintf(fp, "            case %lu:\n", (unsigned long)i);
+        /*  重复的键以最后一个为准 */
+        if(gen_need_free(lept_get_object_value(props, i)))
+        {
+            gen_free(fp, lept_get_object_value(props, i), lv, 0, 4);
+            fprintf(fp, "                memset(&%s, 0, sizeof(%s));\n", lv, lv);
+        }
+        gen_parse(fp, lept_get_object_value(props, i), lv, 0, 4);
+        fprintf(fp, "                break;\n");
+        free(lv);
+        free(ident);
+    }
+    fprintf(fp, "            default:\n                ret = lept_stream_skip(s);\n        }\n");
+    fprintf(fp, "        if(LEPT_PARSE_OK != ret)\n            return ret;\n");
+    fprintf(fp, "        if(i >= 0)\n            seen[i] = 1;\n");
+    fprintf(fp, "        lept_stream_whitespace(s);\n");
+    fprintf(fp, "        if(',' == s->json[0])\n        {\n            s->json++;\n            lept_stream_whitespace(s);\n        }\n");
+    fprintf(fp, "        else if('}' == s->json[0])\n        {\n            s->json++;\n            break;\n        }\n");
+    fprintf(fp, "        else\n            return LEPT_PARSE_MISS_COMMA_OR_CURLY_BRACKET;\n    }\n");
+    for(i = 0; i < n; i++)
+        if(gen_is_required(st->schema, lept_get_object_key(props, i), lept_get_object_key_length(props, i)))
+            fprintf(fp, "    if(!seen[%lu])\n        return LEPT_PARSE_SCHEMA_MISMATCH;\n", (unsigned long)i);
+    fprintf(fp, "    return LEPT_PARSE_OK;\n}\n\n\n");
+
+    /*  释放 */
+    fprintf(fp, "void %s_free_value(%s* val)\n{\n", name, name);
+    if(0 == n)
+        fprintf(fp, "    (void)val;\n");
+    for(i = 0; i < n; i++)
+    {
+        ident = gen_ident(lept_get_object_key(props, i), lept_get_object_key_length(props, i));
+        lv = gen_concat("val->", ident, "");
+        gen_free(fp, lept_get_object_value(props, i), lv, 0, 1);
+        free(lv);
+        free(ident);
+    }
+    fprintf(fp, "}\n\n\n");
+
+    /*  生成：键连同引号、冒号预先转义好 */
+    fprintf(fp, "void %s_write(lept_stream* s, const %s* val)\n{\n", name, name);
+    if(0 == n)
+        fprintf(fp, "    (void)val;\n");
+    fprintf(fp, "    lept_stream_put(s, \"{\", 1);\n");
+    lept_init(&key);
+    for(i = 0; i < n; i++)
+    {
+        lept_set_string(&key, lept_get_object_key(props, i), lept_get_object_key_length(props, i));
+        json = lept_stringify(&key, &len);
+        json = (char*)realloc(json, len + 3);
+        if(i > 0)
+        {
+            memmove(json + 1, json, len);
+            json[0] = ',';
+            len++;
+        }
+        json[len++] = ':';
+        fputs("    lept_stream_put(s, ", fp);
+        gen_literal(fp, json, len);
+        fprintf(fp, ", %lu);\n", (unsigned long)len);
+        free(json);
+        ident = gen_ident(lept_get_object_key(props, i), lept_get_object_key_length(props, i));
+        lv = gen_concat("val->", ident, "");
+        gen_write(fp, lept_get_object_value(props, i), lv, 0, 1);
+        free(lv);
+        free(ident);
+    }
+    lept_free(&key);
+    fprintf(fp, "    lept_stream_put(s, \"}\", 1);\n}\n\n\n");
+
+    /*  对外的函数 */
+    fprintf(fp, "int %s_parse(%s* val, const char* json)\n{\n", name, name);
+    fprintf(fp, "    lept_stream s;\n    int ret;\n");
+    fprintf(fp, "    memset(val, 0, sizeof(*val));\n");
+    fprintf(fp, "    lept_stream_init(&s, json);\n    lept_stream_whitespace(&s);\n");
+    fprintf(fp, "    if(LEPT_PARSE_OK == (ret = %s_parse_value(&s, val)))\n    {\n", name);
+    fprintf(fp, "        lept_stream_whitespace(&s);\n");
+    fprintf(fp, "        if('\\0' != s.json[0])\n            ret = LEPT_PARSE_ROOT_NOT_SINGULAR;\n    }\n");
+    fprintf(fp, "    lept_stream_free(&s);\n");
+    fprintf(fp, "    if(LEPT_PARSE_OK != ret)\n        %s_free(val);\n", name);
+    fprintf(fp, "    return ret;\n}\n\n\n");
+    fprintf(fp, "char* %s_stringify(const %s* val, size_t* length)\n{\n", name, name);
+    fprintf(fp, "    lept_stream s;\n    lept_stream_init(&s, NULL);\n    %s_write(&s, val);\n", name);
+    fprintf(fp, "    return lept_stream_finish(&s, length);\n}\n\n\n");
+    fprintf(fp, "void %s_free(%s* val)\n{\n", name, name);
+    fprintf(fp, "    %s_free_value(val);\n    memset(val, 0, sizeof(*val));\n}\n", name);
+}
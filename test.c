@@ -7,6 +7,7 @@
 #include <stdlib.h>
 #include <string.h>
 #include "leptjson.h" 
+#include "test_schema.h"   /*  由 leptjson_gen 根据 test_schema.json 生成 */
 
 /*  传入预期值 expect 和实际值 actual
     eqequality 为 (expect) == (actual)
@@ -91,6 +92,141 @@
     } while(0)
 
 
+/*  比较两个值生成的 JSON 文本是否一致 */
+#define EXPECT_EQ_JSON(expect, actual) \
+    do { \
+        char *j1, *j2; \
+        size_t l1, l2; \
+        j1 = lept_stringify(expect, &l1); \
+        j2 = lept_stringify(actual, &l2); \
+        EXPECT_EQ_BASE(l1 == l2 && memcmp(j1, j2, l1) == 0, j1, j2, "%s"); \
+        free(j1); \
+        free(j2); \
+    } while(0)
+
+
+#define TEST_EQUAL(json1, json2, equality) \
+    do { \
+        lept_value v1, v2; \
+        lept_init(&v1); \
+        lept_init(&v2); \
+        EXPECT_EQ_INT(LEPT_PARSE_OK, lept_parse(&v1, json1)); \
+        EXPECT_EQ_INT(LEPT_PARSE_OK, lept_parse(&v2, json2)); \
+        EXPECT_EQ_INT(equality, lept_is_equal(&v1, &v2)); \
+        EXPECT_EQ_INT(equality, lept_is_equal(&v2, &v1)); \
+        if (equality) \
+            EXPECT_EQ_INT(1, lept_hash(&v1) == lept_hash(&v2)); \
+        lept_free(&v1); \
+        lept_free(&v2); \
+    } while(0)
+
+
+#define TEST_MERGE_PATCH(json, patch, result) \
+    do { \
+        lept_value v, p, r; \
+        lept_init(&v); \
+        lept_init(&p); \
+        lept_init(&r); \
+        EXPECT_EQ_INT(LEPT_PARSE_OK, lept_parse(&v, json)); \
+        EXPECT_EQ_INT(LEPT_PARSE_OK, lept_parse(&p, patch)); \
+        EXPECT_EQ_INT(LEPT_PARSE_OK, lept_parse(&r, result)); \
+        lept_merge_patch(&v, &p); \
+        EXPECT_EQ_JSON(&r, &v); \
+        lept_free(&v); \
+        lept_free(&p); \
+        lept_free(&r); \
+    } while(0)
+
+
+/*  出错时 doc 保留之前的操作的结果 */
+#define TEST_APPLY_PATCH(json, patch, ret, result) \
+    do { \
+        lept_value v, p, r; \
+        lept_init(&v); \
+        lept_init(&p); \
+        lept_init(&r); \
+        EXPECT_EQ_INT(LEPT_PARSE_OK, lept_parse(&v, json)); \
+        EXPECT_EQ_INT(LEPT_PARSE_OK, lept_parse(&p, patch)); \
+        EXPECT_EQ_INT(LEPT_PARSE_OK, lept_parse(&r, result)); \
+        EXPECT_EQ_INT(ret, lept_apply_patch(&v, &p)); \
+        EXPECT_EQ_JSON(&r, &v); \
+        lept_free(&v); \
+        lept_free(&p); \
+        lept_free(&r); \
+    } while(0)
+
+
+/*  把 diff 的结果应用到 from 上应得到 to */
+#define TEST_DIFF(from, to, count) \
+    do { \
+        lept_value a, b, p; \
+        lept_init(&a); \
+        lept_init(&b); \
+        lept_init(&p); \
+        EXPECT_EQ_INT(LEPT_PARSE_OK, lept_parse(&a, from)); \
+        EXPECT_EQ_INT(LEPT_PARSE_OK, lept_parse(&b, to)); \
+        lept_diff(&a, &b, &p); \
+        EXPECT_EQ_SIZE_T(count, lept_get_array_size(&p)); \
+        EXPECT_EQ_INT(LEPT_PATCH_OK, lept_apply_patch(&a, &p)); \
+        EXPECT_EQ_INT(1, lept_is_equal(&a, &b)); \
+        lept_free(&a); \
+        lept_free(&b); \
+        lept_free(&p); \
+    } while(0)
+
+
+/*  json 编码后应与 bin 逐字节相同，bin 解码后应与 json 相同 */
+#define TEST_BINARY(to, from, json, bin) \
+    do { \
+        lept_value v, r; \
+        char* b; \
+        size_t len; \
+        lept_init(&v); \
+        lept_init(&r); \
+        EXPECT_EQ_INT(LEPT_PARSE_OK, lept_parse(&v, json)); \
+        b = to(&v, &len); \
+        EXPECT_EQ_SIZE_T(sizeof(bin) - 1, len); \
+        EXPECT_EQ_INT(0, memcmp(bin, b, sizeof(bin) - 1)); \
+        free(b); \
+        EXPECT_EQ_INT(LEPT_PARSE_OK, from(&r, bin, sizeof(bin) - 1)); \
+        EXPECT_EQ_JSON(&v, &r); \
+        lept_free(&v); \
+        lept_free(&r); \
+    } while(0)
+
+
+/*  只测试解码，用于编码时不会生成的形式 */
+#define TEST_BINARY_DECODE(from, json, bin) \
+    do { \
+        lept_value v, r; \
+        lept_init(&v); \
+        lept_init(&r); \
+        EXPECT_EQ_INT(LEPT_PARSE_OK, lept_parse(&v, json)); \
+        EXPECT_EQ_INT(LEPT_PARSE_OK, from(&r, bin, sizeof(bin) - 1)); \
+        EXPECT_EQ_JSON(&v, &r); \
+        lept_free(&v); \
+        lept_free(&r); \
+    } while(0)
+
+
+#define TEST_BINARY_ERROR(from, error, bin) \
+    do { \
+        lept_value v; \
+        lept_init(&v); \
+        EXPECT_EQ_INT(error, from(&v, bin, sizeof(bin) - 1)); \
+        EXPECT_EQ_INT(LEPT_NULL, lept_get_type(&v)); \
+        lept_free(&v); \
+    } while(0)
+
+
+#define TEST_CODEGEN_ERROR(error, json) \
+    do { \
+        test_order o; \
+        EXPECT_EQ_INT(error, test_order_parse(&o, json)); \
+        EXPECT_EQ_INT(1, NULL == o.customer.s && NULL == o.tags.e && NULL == o.lines.e); \
+    } while(0)
+
+
 /*  仅对集中无效部分的代码进行宏定义替换重构
     由于有小部分的测试将来要有所添加
     无效值类型都是 null */
@@ -119,6 +255,10 @@ static void test_parse_array();
 static void test_parse_object();
 
 static void test_stringify();
+static void test_parse_lazy_number();
+static void test_parse_lazy_string();
+static void test_parse_invalid_utf8();
+static void test_parse_pack_numbers();
 
 static void test_parse_expect_value();
 static void test_parse_invalid_value();
@@ -138,6 +278,42 @@ static void test_access_null();
 static void test_access_boolean();
 static void test_access_number();
 static void test_access_string();
+static void test_access_array();
+static void test_access_object();
+
+static void test_copy();
+static void test_move();
+static void test_swap();
+static void test_equal();
+static void test_hash();
+static void test_share();
+static void test_free();
+
+static void test_pointer();
+static void test_merge_patch();
+static void test_apply_patch();
+static void test_diff();
+
+static void test_cbor();
+static void test_msgpack();
+static void test_binary_number();
+
+static void test_snapshot();
+
+static void test_codegen();
+static void test_cursor();
+static void test_array_iter();
+static void test_extract_columns();
+
+static void test_ndjson();
+static void test_parse_many();
+static void test_parse_parallel();
+static void test_stringify_parallel();
+static void test_pipeline();
+
+#ifdef LEPT_ENABLE_STATS
+static void test_stats();
+#endif
 
 int main(int argc, char **argv)
 {
@@ -159,6 +335,10 @@ void test_parse()
     test_parse_object();
 
     test_stringify();    
+    test_parse_lazy_number();
+    test_parse_lazy_string();
+    test_parse_invalid_utf8();
+    test_parse_pack_numbers();
 
     test_parse_expect_value();
     test_parse_invalid_value();
@@ -176,6 +356,42 @@ void test_parse()
     test_access_boolean();
     test_access_number();
     test_access_string();
+    test_access_array();
+    test_access_object();
+
+    test_copy();
+    test_move();
+    test_swap();
+    test_equal();
+    test_hash();
+    test_share();
+    test_free();
+
+    test_pointer();
+    test_merge_patch();
+    test_apply_patch();
+    test_diff();
+
+    test_cbor();
+    test_msgpack();
+    test_binary_number();
+
+    test_snapshot();
+
+    test_codegen();
+    test_cursor();
+    test_array_iter();
+    test_extract_columns();
+
+    test_ndjson();
+    test_parse_many();
+    test_parse_parallel();
+    test_stringify_parallel();
+    test_pipeline();
+
+#ifdef LEPT_ENABLE_STATS
+    test_stats();
+#endif
 
 }
 
@@ -412,6 +628,293 @@ void test_stringify()
 
 
 
+void test_parse_lazy_number()
+{
+    lept_value v, eager, copy;
+    char* json;
+    size_t len;
+    lept_init(&v);
+    lept_init(&eager);
+    lept_init(&copy);
+    EXPECT_EQ_INT(LEPT_PARSE_OK, lept_parse_opts(&v, "[1.50, -0, 1E2, 1e-99, 12345678901234567890]", LEPT_OPT_LAZY_NUMBERS));
+    /*  原文原样输出；超过 15 个字符的数值照常转换 */
+    json = lept_stringify(&v, &len);
+    EXPECT_EQ_STRING("[1.50,-0,1E2,1e-99,1.2345678901234567e+19]", json, len);
+    free(json);
+    EXPECT_EQ_DOUBLE(1.5, lept_get_number(lept_get_array_element(&v, 0)));
+    EXPECT_EQ_DOUBLE(100.0, lept_get_number(lept_get_array_element(&v, 2)));
+    EXPECT_EQ_DOUBLE(1e-99, lept_get_number(lept_get_array_element(&v, 3)));
+    /*  转换之后仍然输出原文 */
+    json = lept_stringify(&v, &len);
+    EXPECT_EQ_STRING("[1.50,-0,1E2,1e-99,1.2345678901234567e+19]", json, len);
+    free(json);
+
+    lept_copy(&copy, &v);
+    json = lept_stringify(&copy, &len);
+    EXPECT_EQ_STRING("[1.50,-0,1E2,1e-99,1.2345678901234567e+19]", json, len);
+    free(json);
+    EXPECT_EQ_INT(LEPT_PARSE_OK, lept_parse(&eager, "[1.5, 0, 100, 1e-99, 12345678901234567890]"));
+    EXPECT_EQ_INT(1, lept_is_equal(&eager, &copy));
+    EXPECT_EQ_SIZE_T(lept_hash(&eager), lept_hash(&copy));
+    lept_set_number(lept_get_array_element(&copy, 0), 2.0);
+    json = lept_stringify(&copy, &len);
+    EXPECT_EQ_STRING("[2,-0,1E2,1e-99,1.2345678901234567e+19]", json, len);
+    free(json);
+    lept_free(&v);
+    lept_free(&eager);
+    lept_free(&copy);
+
+    /*  指数超过 2 位时照常转换，仍然能检查溢出 */
+    EXPECT_EQ_INT(LEPT_PARSE_NUMBER_TOO_BIG, lept_parse_opts(&v, "1e309", LEPT_OPT_LAZY_NUMBERS));
+    EXPECT_EQ_INT(LEPT_PARSE_INVALID_VALUE, lept_parse_opts(&v, "1.", LEPT_OPT_LAZY_NUMBERS));
+    EXPECT_EQ_INT(LEPT_PARSE_OK, lept_parse_opts(&v, "-1.5e+10", LEPT_OPT_LAZY_NUMBERS));
+    EXPECT_EQ_DOUBLE(-1.5e10, lept_get_number(&v));
+    lept_free(&v);
+}
+
+
+void test_parse_lazy_string()
+{
+    static const char json[] = "{\"k\\n\":[\"plain\",\"a\\nb\",\"\\u00e9\\ud83d\\ude00\",\"\\/\",1.50]}";
+    lept_value v, eager, copy, shared;
+    const lept_value* a;
+    char* out;
+    size_t len;
+    lept_init(&v);
+    lept_init(&eager);
+    lept_init(&copy);
+    lept_init(&shared);
+    EXPECT_EQ_INT(LEPT_PARSE_OK, lept_parse_opts(&v, json, LEPT_OPT_LAZY_STRINGS | LEPT_OPT_LAZY_NUMBERS));
+    /*  解码之前原样输出；键照常解码 */
+    out = lept_stringify(&v, &len);
+    EXPECT_EQ_STRING(json, out, len);
+    free(out);
+    EXPECT_EQ_INT(1, NULL != (a = lept_find_object_value(&v, "k\n", 2)));
+    EXPECT_EQ_STRING("plain", lept_get_string(lept_get_array_element(a, 0)), lept_get_string_length(lept_get_array_element(a, 0)));
+    EXPECT_EQ_SIZE_T(3, lept_get_string_length(lept_get_array_element(a, 1)));
+    EXPECT_EQ_STRING("a\nb", lept_get_string(lept_get_array_element(a, 1)), 3);
+    EXPECT_EQ_STRING("\xC3\xA9\xF0\x9F\x98\x80", lept_get_string(lept_get_array_element(a, 2)), lept_get_string_length(lept_get_array_element(a, 2)));
+    /*  解码之后按普通字符串输出 */
+    out = lept_stringify(&v, &len);
+    EXPECT_EQ_STRING("{\"k\\n\":[\"plain\",\"a\\nb\",\"\xC3\xA9\xF0\x9F\x98\x80\",\"\\/\",1.50]}", out, len);
+    free(out);
+
+    /*  复制、比较、哈希、共享前先解码 */
+    EXPECT_EQ_INT(LEPT_PARSE_OK, lept_parse(&eager, json));
+    lept_free(&v);
+    EXPECT_EQ_INT(LEPT_PARSE_OK, lept_parse_opts(&v, json, LEPT_OPT_LAZY_STRINGS));
+    EXPECT_EQ_SIZE_T(lept_hash(&eager), lept_hash(&v));
+    lept_free(&v);
+    EXPECT_EQ_INT(LEPT_PARSE_OK, lept_parse_opts(&v, json, LEPT_OPT_LAZY_STRINGS));
+    lept_copy(&copy, &v);
+    EXPECT_EQ_INT(1, lept_is_equal(&eager, &copy));
+    lept_free(&v);
+    EXPECT_EQ_INT(LEPT_PARSE_OK, lept_parse_opts(&v, json, LEPT_OPT_LAZY_STRINGS));
+    lept_share(&shared, &v);
+    EXPECT_EQ_INT(1, lept_is_equal(&eager, &shared));
+    EXPECT_EQ_STRING("/", lept_get_string(lept_get_array_element(lept_get_object_value(&v, 0), 3)), 1);
+    lept_free(&v);
+    lept_free(&eager);
+    lept_free(&copy);
+    lept_free(&shared);
+
+    EXPECT_EQ_INT(LEPT_PARSE_INVALID_STRING_ESCAPE, lept_parse_opts(&v, "\"\\v\"", LEPT_OPT_LAZY_STRINGS));
+    EXPECT_EQ_INT(LEPT_PARSE_MISS_QUOTATION_MARK, lept_parse_opts(&v, "[\"abc]", LEPT_OPT_LAZY_STRINGS));
+    EXPECT_EQ_INT(LEPT_PARSE_INVALID_STRING_CHAR, lept_parse_opts(&v, "\"\x1F\"", LEPT_OPT_LAZY_STRINGS));
+    EXPECT_EQ_INT(LEPT_PARSE_INVALID_UNICODE_HEX, lept_parse_opts(&v, "\"\\u01\"", LEPT_OPT_LAZY_STRINGS));
+    EXPECT_EQ_INT(LEPT_PARSE_INVALID_UNICODE_SURROGATE, lept_parse_opts(&v, "\"\\uD800\"", LEPT_OPT_LAZY_STRINGS));
+    EXPECT_EQ_INT(LEPT_PARSE_INVALID_UNICODE_SURROGATE, lept_parse_opts(&v, "\"\\uD800\\uE000\"", LEPT_OPT_LAZY_STRINGS));
+}
+
+
+
+#define TEST_UTF8(expect, json) \
+    do { \
+        lept_value v; \
+        EXPECT_EQ_INT(expect, lept_parse_opts(&v, json, LEPT_OPT_VALIDATE_UTF8)); \
+        lept_free(&v); \
+        EXPECT_EQ_INT(expect, lept_parse_opts(&v, json, LEPT_OPT_VALIDATE_UTF8 | LEPT_OPT_LAZY_STRINGS)); \
+        lept_free(&v); \
+    } while(0)
+
+void test_parse_invalid_utf8()
+{
+    lept_value v;
+    /*  默认不校验 */
+    EXPECT_EQ_INT(LEPT_PARSE_OK, lept_parse(&v, "\"\xFF\""));
+    lept_free(&v);
+
+    TEST_UTF8(LEPT_PARSE_OK, "\"\"");
+    TEST_UTF8(LEPT_PARSE_OK, "\"plain ascii, long enough to take the 32-byte fast path twice over!!\"");
+    TEST_UTF8(LEPT_PARSE_OK, "\"\xC2\x80 \xDF\xBF \xE0\xA0\x80 \xED\x9F\xBF \xEE\x80\x80 \xEF\xBF\xBF \xF0\x90\x80\x80 \xF4\x8F\xBF\xBF\"");
+    TEST_UTF8(LEPT_PARSE_OK, "[\"0123456789abcdef0123456789abcdef\xE4\xB8\xAD\xE6\x96\x87\\n0123456789abcdef0123456789abcdef\"]");
+    TEST_UTF8(LEPT_PARSE_OK, "\"\\uD834\\uDD1E \\u0000\"");
+    TEST_UTF8(LEPT_PARSE_OK, "{\"\xE4\xB8\xAD\":1}");
+
+    TEST_UTF8(LEPT_PARSE_INVALID_UTF8, "\"\x80\"");                 /*  单独的后续字节 */
+    TEST_UTF8(LEPT_PARSE_INVALID_UTF8, "\"\xC0\xAF\"");             /*  过长编码 */
+    TEST_UTF8(LEPT_PARSE_INVALID_UTF8, "\"\xC1\xBF\"");
+    TEST_UTF8(LEPT_PARSE_INVALID_UTF8, "\"\xE0\x9F\xBF\"");
+    TEST_UTF8(LEPT_PARSE_INVALID_UTF8, "\"\xF0\x8F\xBF\xBF\"");
+    TEST_UTF8(LEPT_PARSE_INVALID_UTF8, "\"\xED\xA0\x80\"");         /*  代理项 */
+    TEST_UTF8(LEPT_PARSE_INVALID_UTF8, "\"\\uDC00\"");             /*  单独的低代理项转义 */
+    TEST_UTF8(LEPT_PARSE_INVALID_UTF8, "\"a\\n\\uDFFF\"");
+    TEST_UTF8(LEPT_PARSE_INVALID_UTF8, "[\"\\uD834\\uDD1E\\uDD1E\"]");
+    TEST_UTF8(LEPT_PARSE_INVALID_UTF8, "\"\xF4\x90\x80\x80\"");     /*  超过 U+10FFFF */
+    TEST_UTF8(LEPT_PARSE_INVALID_UTF8, "\"\xF5\x80\x80\x80\"");
+    TEST_UTF8(LEPT_PARSE_INVALID_UTF8, "\"\xFE\"");
+    TEST_UTF8(LEPT_PARSE_INVALID_UTF8, "\"\xE4\xB8\"");             /*  序列不完整 */
+    TEST_UTF8(LEPT_PARSE_INVALID_UTF8, "\"\xE4\x41\xAD\"");
+    TEST_UTF8(LEPT_PARSE_INVALID_UTF8, "\"0123456789abcdef0123456789abcdef0123456789\xF0\x9F\x98\"");
+    TEST_UTF8(LEPT_PARSE_INVALID_UTF8, "[\"ok\",\"\\n\xC3\"]");
+    TEST_UTF8(LEPT_PARSE_INVALID_UTF8, "{\"\xC3\":1}");             /*  键 */
+}
+
+static void test_pack_roundtrip(const char* json)
+{
+    lept_value packed, eager, back, patch;
+    char *s1, *s2, *bin;
+    size_t n1, n2;
+    EXPECT_EQ_INT(LEPT_PARSE_OK, lept_parse_opts(&packed, json, LEPT_OPT_PACK_NUMBERS));
+    EXPECT_EQ_INT(LEPT_PARSE_OK, lept_parse(&eager, json));
+    s1 = lept_stringify(&packed, &n1);
+    s2 = lept_stringify(&eager, &n2);
+    EXPECT_EQ_SIZE_T(n2, n1);
+    EXPECT_EQ_INT(0, memcmp(s1, s2, n1));
+    free(s1);
+    free(s2);
+    EXPECT_EQ_INT(1, lept_is_equal(&packed, &eager));
+    EXPECT_EQ_INT(1, lept_hash(&packed) == lept_hash(&eager));
+    lept_init(&patch);
+    lept_diff(&eager, &packed, &patch);
+    EXPECT_EQ_SIZE_T(0, lept_get_array_size(&patch));
+    lept_free(&patch);
+    bin = lept_to_cbor(&packed, &n1);
+    EXPECT_EQ_INT(LEPT_PARSE_OK, lept_from_cbor(&back, bin, n1));
+    EXPECT_EQ_INT(1, lept_is_equal(&back, &eager));
+    free(bin);
+    lept_free(&back);
+    bin = lept_to_msgpack(&packed, &n1);
+    EXPECT_EQ_INT(LEPT_PARSE_OK, lept_from_msgpack(&back, bin, n1));
+    EXPECT_EQ_INT(1, lept_is_equal(&back, &eager));
+    free(bin);
+    lept_free(&back);
+    lept_free(&packed);
+    lept_free(&eager);
+}
+
+void test_parse_pack_numbers()
+{
+    lept_value v, c, s;
+    const int64_t* ints;
+    const double* nums;
+    size_t n = 0;
+
+    EXPECT_EQ_INT(LEPT_PARSE_OK, lept_parse_opts(&v, "[1, 2, -3, 9007199254740992]", LEPT_OPT_PACK_NUMBERS));
+    EXPECT_EQ_INT(LEPT_PACKED_INT64, lept_get_array_packing(&v));
+    EXPECT_EQ_INT(1, NULL == lept_get_array_numbers(&v, &n));
+    ints = lept_get_array_int64(&v, &n);
+    EXPECT_EQ_SIZE_T(4, n);
+    EXPECT_EQ_SIZE_T(4, lept_get_array_size(&v));
+    EXPECT_EQ_INT(1, 2 == ints[1] && -3 == ints[2]);
+    EXPECT_EQ_INT(1, 9007199254740992.0 == (double)ints[3]);
+
+    /*  复制、共享都保持紧凑存储 */
+    lept_init(&c);
+    lept_copy(&c, &v);
+    EXPECT_EQ_INT(LEPT_PACKED_INT64, lept_get_array_packing(&c));
+    EXPECT_EQ_INT(1, lept_is_equal(&c, &v));
+    lept_init(&s);
+    lept_share(&s, &v);
+    EXPECT_EQ_INT(LEPT_PACKED_INT64, lept_get_array_packing(&s));
+    EXPECT_EQ_INT(1, lept_get_array_int64(&s, &n) == lept_get_array_int64(&v, &n));
+
+    /*  只读的按元素访问不转换，共享同一存储的值仍然指向同一份数据 */
+    {
+        lept_value tmp;
+        EXPECT_EQ_DOUBLE(-3.0, lept_get_number(lept_get_array_element_tmp(&s, 2, &tmp)));
+        EXPECT_EQ_DOUBLE(2.0, lept_get_number(lept_get_array_element_tmp(&v, 1, &tmp)));
+        EXPECT_EQ_INT(LEPT_PACKED_INT64, lept_get_array_packing(&s));
+        EXPECT_EQ_INT(1, lept_get_array_int64(&s, &n) == lept_get_array_int64(&v, &n));
+    }
+
+    /*  修改时转换为普通数组，不影响共享同一存储的其他值 */
+    lept_set_string(lept_pushback_array_element(&s), "x", 1);
+    EXPECT_EQ_INT(LEPT_PACKED_NONE, lept_get_array_packing(&s));
+    EXPECT_EQ_INT(LEPT_PACKED_INT64, lept_get_array_packing(&v));
+    EXPECT_EQ_DOUBLE(-3.0, lept_get_number(lept_get_array_element(&s, 2)));
+    EXPECT_EQ_SIZE_T(5, lept_get_array_size(&s));
+    EXPECT_EQ_SIZE_T(4, lept_get_array_size(&v));
+    /*  直接写入元素之前先 lept_unshare */
+    lept_unshare(&c);
+    EXPECT_EQ_INT(LEPT_PACKED_NONE, lept_get_array_packing(&c));
+    EXPECT_EQ_INT(LEPT_PACKED_INT64, lept_get_array_packing(&v));
+    lept_set_number(lept_get_array_element(&c, 0), 10.0);
+    EXPECT_EQ_DOUBLE(10.0, lept_get_number(lept_get_array_element(&c, 0)));
+    EXPECT_EQ_DOUBLE(2.0, lept_get_number(lept_get_array_element(&c, 1)));
+    lept_free(&c);
+    lept_free(&s);
+    lept_free(&v);
+
+    EXPECT_EQ_INT(LEPT_PARSE_OK, lept_parse_opts(&v, "[0.5,1,-0,1e300]", LEPT_OPT_PACK_NUMBERS | LEPT_OPT_LAZY_NUMBERS));
+    EXPECT_EQ_INT(LEPT_PACKED_DOUBLE, lept_get_array_packing(&v));
+    nums = lept_get_array_numbers(&v, &n);
+    EXPECT_EQ_SIZE_T(4, n);
+    EXPECT_EQ_DOUBLE(0.5, nums[0]);
+    EXPECT_EQ_DOUBLE(1e300, nums[3]);
+    lept_free(&v);
+
+    /*  紧凑存储只保留 double，惰性数值的原文丢失，生成时按 %.17g 输出 */
+    {
+        char* json;
+        size_t len;
+        EXPECT_EQ_INT(LEPT_PARSE_OK, lept_parse_opts(&v, "[0.1]", LEPT_OPT_PACK_NUMBERS | LEPT_OPT_LAZY_NUMBERS));
+        json = lept_stringify(&v, &len);
+        EXPECT_EQ_STRING("[0.10000000000000001]", json, len);
+        free(json);
+        lept_free(&v);
+        EXPECT_EQ_INT(LEPT_PARSE_OK, lept_parse_opts(&v, "[0.1]", LEPT_OPT_LAZY_NUMBERS));
+        json = lept_stringify(&v, &len);
+        EXPECT_EQ_STRING("[0.1]", json, len);
+        free(json);
+        lept_free(&v);
+    }
+
+    EXPECT_EQ_INT(LEPT_PARSE_OK, lept_parse_opts(&v, "{\"a\":[[1,2],[3.5],[]],\"b\":[1,\"x\"],\"c\":[null]}", LEPT_OPT_PACK_NUMBERS));
+    EXPECT_EQ_INT(LEPT_PACKED_NONE, lept_get_array_packing(lept_find_object_value(&v, "a", 1)));
+    EXPECT_EQ_INT(LEPT_PACKED_INT64, lept_get_array_packing(lept_get_array_element(lept_find_object_value(&v, "a", 1), 0)));
+    EXPECT_EQ_INT(LEPT_PACKED_DOUBLE, lept_get_array_packing(lept_get_array_element(lept_find_object_value(&v, "a", 1), 1)));
+    EXPECT_EQ_INT(LEPT_PACKED_NONE, lept_get_array_packing(lept_find_object_value(&v, "b", 1)));
+    EXPECT_EQ_INT(LEPT_PACKED_NONE, lept_get_array_packing(lept_find_object_value(&v, "c", 1)));
+    /*  只读的指针查找和 JSON Patch 的 test 不转换 */
+    {
+        lept_value patch, tmp;
+        const lept_value* a0 = lept_get_array_element(lept_find_object_value(&v, "a", 1), 0);
+        EXPECT_EQ_DOUBLE(2.0, lept_get_number(lept_find_pointer_value(&v, "/a/0/1", 6, &tmp)));
+        EXPECT_EQ_INT(1, &tmp == lept_find_pointer_value(&v, "/a/0/1", 6, &tmp));
+        EXPECT_EQ_INT(1, NULL == lept_find_pointer_value(&v, "/a/0/2", 6, &tmp));
+        EXPECT_EQ_INT(1, NULL == lept_find_pointer_value(&v, "/a/0/1/x", 8, &tmp));
+        EXPECT_EQ_INT(LEPT_PACKED_INT64, lept_get_array_packing(a0));
+        EXPECT_EQ_INT(LEPT_PARSE_OK, lept_parse(&patch, "[{\"op\":\"test\",\"path\":\"/a/1/0\",\"value\":3.5}]"));
+        EXPECT_EQ_INT(LEPT_PATCH_OK, lept_apply_patch(&v, &patch));
+        EXPECT_EQ_INT(LEPT_PACKED_DOUBLE, lept_get_array_packing(lept_get_array_element(lept_find_object_value(&v, "a", 1), 1)));
+        lept_free(&patch);
+    }
+    /*  修改会转换，指针操作也一样 */
+    {
+        lept_value patch;
+        EXPECT_EQ_INT(LEPT_PARSE_OK, lept_parse(&patch, "[{\"op\":\"replace\",\"path\":\"/a/0/1\",\"value\":true},"
+                                                         "{\"op\":\"remove\",\"path\":\"/a/1/0\"}]"));
+        EXPECT_EQ_INT(LEPT_PATCH_OK, lept_apply_patch(&v, &patch));
+        lept_free(&patch);
+    }
+    lept_free(&v);
+
+    test_pack_roundtrip("[1,2,3]");
+    test_pack_roundtrip("[0.1,-2.5e-8,3,-0,1.7976931348623157e308]");
+    test_pack_roundtrip("{\"geo\":[[[1.25,2],[3,4]]],\"ids\":[1,2,3],\"mixed\":[1,null,\"s\",[2]],\"e\":[]}");
+}
+
 /*  只含空白 */
 void test_parse_expect_value()
 {
@@ -570,3 +1073,1713 @@ void test_access_string()
 }
 
 
+void test_access_array()
+{
+    lept_value a, e;
+    size_t i, j;
+
+    lept_init(&a);
+    for (j = 0; j <= 5; j += 5) {
+        lept_set_array(&a, j);
+        EXPECT_EQ_SIZE_T(0, lept_get_array_size(&a));
+        EXPECT_EQ_SIZE_T(j, lept_get_array_capacity(&a));
+        for (i = 0; i < 10; i++) {
+            lept_init(&e);
+            lept_set_number(&e, i);
+            *lept_pushback_array_element(&a) = e;
+        }
+        EXPECT_EQ_SIZE_T(10, lept_get_array_size(&a));
+        for (i = 0; i < 10; i++)
+            EXPECT_EQ_DOUBLE((double)i, lept_get_number(lept_get_array_element(&a, i)));
+    }
+
+    lept_popback_array_element(&a);
+    EXPECT_EQ_SIZE_T(9, lept_get_array_size(&a));
+    for (i = 0; i < 9; i++)
+        EXPECT_EQ_DOUBLE((double)i, lept_get_number(lept_get_array_element(&a, i)));
+
+    lept_erase_array_element(&a, 4, 0);
+    EXPECT_EQ_SIZE_T(9, lept_get_array_size(&a));
+    for (i = 0; i < 9; i++)
+        EXPECT_EQ_DOUBLE((double)i, lept_get_number(lept_get_array_element(&a, i)));
+
+    lept_erase_array_element(&a, 8, 1);
+    EXPECT_EQ_SIZE_T(8, lept_get_array_size(&a));
+    for (i = 0; i < 8; i++)
+        EXPECT_EQ_DOUBLE((double)i, lept_get_number(lept_get_array_element(&a, i)));
+
+    lept_erase_array_element(&a, 0, 2);
+    EXPECT_EQ_SIZE_T(6, lept_get_array_size(&a));
+    for (i = 0; i < 6; i++)
+        EXPECT_EQ_DOUBLE((double)i + 2, lept_get_number(lept_get_array_element(&a, i)));
+
+    for (i = 0; i < 2; i++)
+        lept_set_number(lept_insert_array_element(&a, i), i);
+    EXPECT_EQ_SIZE_T(8, lept_get_array_size(&a));
+    for (i = 0; i < 8; i++)
+        EXPECT_EQ_DOUBLE((double)i, lept_get_number(lept_get_array_element(&a, i)));
+
+    EXPECT_EQ_INT(1, lept_get_array_capacity(&a) > 8);
+    lept_shrink_array(&a);
+    EXPECT_EQ_SIZE_T(8, lept_get_array_capacity(&a));
+    EXPECT_EQ_SIZE_T(8, lept_get_array_size(&a));
+    for (i = 0; i < 8; i++)
+        EXPECT_EQ_DOUBLE((double)i, lept_get_number(lept_get_array_element(&a, i)));
+
+    lept_set_string(&e, "Hello", 5);
+    *lept_pushback_array_element(&a) = e;     /* Test if element is freed */
+    lept_init(&e);
+
+    i = lept_get_array_capacity(&a);
+    lept_clear_array(&a);
+    EXPECT_EQ_SIZE_T(0, lept_get_array_size(&a));
+    EXPECT_EQ_SIZE_T(i, lept_get_array_capacity(&a));   /* capacity remains unchanged */
+    lept_shrink_array(&a);
+    EXPECT_EQ_SIZE_T(0, lept_get_array_capacity(&a));
+
+    lept_free(&a);
+}
+
+
+void test_access_object()
+{
+    lept_value o, v, *pv;
+    size_t i, j, index;
+
+    lept_init(&o);
+
+    for (j = 0; j <= 5; j += 5) {
+        lept_set_object(&o, j);
+        EXPECT_EQ_SIZE_T(0, lept_get_object_size(&o));
+        EXPECT_EQ_SIZE_T(j, lept_get_object_capacity(&o));
+        for (i = 0; i < 10; i++) {
+            char key[2] = "a";
+            key[0] += i;
+            lept_init(&v);
+            lept_set_number(&v, i);
+            *lept_set_object_value(&o, key, 1) = v;
+        }
+        EXPECT_EQ_SIZE_T(10, lept_get_object_size(&o));
+        for (i = 0; i < 10; i++) {
+            char key[] = "a";
+            key[0] += i;
+            index = lept_find_object_index(&o, key, 1);
+            EXPECT_EQ_INT(1, index != LEPT_KEY_NOT_EXIST);
+            pv = lept_get_object_value(&o, index);
+            EXPECT_EQ_DOUBLE((double)i, lept_get_number(pv));
+        }
+    }
+
+    index = lept_find_object_index(&o, "j", 1);
+    EXPECT_EQ_INT(1, index != LEPT_KEY_NOT_EXIST);
+    lept_remove_object_value(&o, index);
+    index = lept_find_object_index(&o, "j", 1);
+    EXPECT_EQ_INT(1, index == LEPT_KEY_NOT_EXIST);
+    EXPECT_EQ_SIZE_T(9, lept_get_object_size(&o));
+
+    index = lept_find_object_index(&o, "a", 1);
+    EXPECT_EQ_INT(1, index != LEPT_KEY_NOT_EXIST);
+    lept_remove_object_value(&o, index);
+    index = lept_find_object_index(&o, "a", 1);
+    EXPECT_EQ_INT(1, index == LEPT_KEY_NOT_EXIST);
+    EXPECT_EQ_SIZE_T(8, lept_get_object_size(&o));
+
+    EXPECT_EQ_INT(1, lept_get_object_capacity(&o) > 8);
+    lept_shrink_object(&o);
+    EXPECT_EQ_SIZE_T(8, lept_get_object_capacity(&o));
+    EXPECT_EQ_SIZE_T(8, lept_get_object_size(&o));
+    for (i = 0; i < 8; i++) {
+        char key[] = "a";
+        key[0] += i + 1;
+        EXPECT_EQ_DOUBLE((double)i + 1, lept_get_number(lept_get_object_value(&o, lept_find_object_index(&o, key, 1))));
+    }
+
+    /*  已存在的键返回原来的值 */
+    pv = lept_set_object_value(&o, "b", 1);
+    EXPECT_EQ_DOUBLE(1.0, lept_get_number(pv));
+    EXPECT_EQ_SIZE_T(8, lept_get_object_size(&o));
+
+    lept_set_string(&v, "Hello", 5);
+    *lept_set_object_value(&o, "World", 5) = v; /* Test if element is freed */
+    lept_init(&v);
+
+    pv = lept_find_object_value(&o, "World", 5);
+    EXPECT_EQ_INT(1, pv != NULL);
+    EXPECT_EQ_STRING("Hello", lept_get_string(pv), lept_get_string_length(pv));
+    EXPECT_EQ_INT(1, lept_find_object_value(&o, "Hello", 5) == NULL);
+
+    i = lept_get_object_capacity(&o);
+    lept_clear_object(&o);
+    EXPECT_EQ_SIZE_T(0, lept_get_object_size(&o));
+    EXPECT_EQ_SIZE_T(i, lept_get_object_capacity(&o)); /* capacity remains unchanged */
+    lept_shrink_object(&o);
+    EXPECT_EQ_SIZE_T(0, lept_get_object_capacity(&o));
+
+    lept_free(&o);
+}
+
+
+void test_copy()
+{
+    lept_value v1, v2, v3, *pv;
+    const char* s;
+    lept_init(&v1);
+    lept_parse(&v1, "{\"t\":true,\"f\":false,\"n\":null,\"d\":1.5,\"a\":[1,2,3],\"o\":{\"s\":\"abc\",\"e\":[]}}");
+    lept_init(&v2);
+    lept_copy(&v2, &v1);
+    EXPECT_EQ_JSON(&v1, &v2);
+    lept_free(&v1);
+
+    /*  修改整块内存中的节点 */
+    lept_set_number(lept_pushback_array_element(lept_find_object_value(&v2, "a", 1)), 4);
+    lept_set_string(lept_set_object_value(lept_find_object_value(&v2, "o", 1), "x", 1), "y", 1);
+    lept_set_boolean(lept_set_object_value(&v2, "b", 1), 1);
+    lept_parse(&v1, "{\"t\":true,\"f\":false,\"n\":null,\"d\":1.5,\"a\":[1,2,3,4],\"o\":{\"s\":\"abc\",\"e\":[],\"x\":\"y\"},\"b\":true}");
+    EXPECT_EQ_JSON(&v1, &v2);
+
+    /*  拷贝子节点到根节点 */
+    lept_init(&v3);
+    lept_copy(&v3, &v2);
+    lept_copy(&v3, lept_find_object_value(&v3, "o", 1));
+    pv = lept_find_object_value(&v3, "s", 1);
+    EXPECT_EQ_STRING("abc", lept_get_string(pv), lept_get_string_length(pv));
+    lept_erase_array_element(lept_find_object_value(&v3, "e", 1), 0, 0);
+    lept_remove_object_value(&v3, lept_find_object_index(&v3, "s", 1));
+    EXPECT_EQ_SIZE_T(2, lept_get_object_size(&v3));
+
+    lept_copy(&v3, lept_find_object_value(&v1, "d", 1));
+    EXPECT_EQ_DOUBLE(1.5, lept_get_number(&v3));
+    lept_free(&v1);
+    lept_free(&v2);
+    lept_free(&v3);
+
+    /*  修改一个容器只复制这一层，子树仍在整块内存中；
+        复制出来的容器各自持有整块内存，释放顺序任意 */
+    lept_parse(&v1, "{\"a\":[1,[2,\"deep\"]],\"o\":{\"k\":{\"s\":\"str\"}}}");
+    lept_copy(&v2, &v1);
+    s = lept_get_string(lept_get_array_element(lept_get_array_element(lept_find_object_value(&v2, "a", 1), 1), 1));
+    lept_set_object_value(&v2, "new", 3);
+    lept_set_number(lept_pushback_array_element(lept_find_object_value(&v2, "a", 1)), 3);
+    EXPECT_EQ_INT(1, s == lept_get_string(lept_get_array_element(lept_get_array_element(lept_find_object_value(&v2, "a", 1), 1), 1)));
+    lept_move(&v3, lept_find_object_value(&v2, "o", 1));
+    s = lept_get_string(lept_find_object_value(lept_find_object_value(&v3, "k", 1), "s", 1));
+    lept_set_object_value(&v3, "x", 1);
+    EXPECT_EQ_INT(1, s == lept_get_string(lept_find_object_value(lept_find_object_value(&v3, "k", 1), "s", 1)));
+    lept_free(&v2);
+    EXPECT_EQ_INT(1, lept_is_equal(lept_find_object_value(&v3, "k", 1), lept_find_object_value(lept_find_object_value(&v1, "o", 1), "k", 1)));
+    lept_share(&v2, &v3);
+    EXPECT_EQ_INT(1, lept_is_equal(&v2, &v3));
+    lept_free(&v3);
+    pv = lept_find_object_value(lept_find_object_value(&v2, "k", 1), "s", 1);
+    EXPECT_EQ_STRING("str", lept_get_string(pv), lept_get_string_length(pv));
+    lept_free(&v1);
+    lept_free(&v2);
+}
+
+
+void test_move()
+{
+    lept_value v1, v2, v3;
+    lept_init(&v1);
+    lept_parse(&v1, "{\"t\":true,\"f\":false,\"n\":null,\"d\":1.5,\"a\":[1,2,3]}");
+    lept_init(&v2);
+    lept_copy(&v2, &v1);
+    lept_init(&v3);
+    lept_move(&v3, &v2);
+    EXPECT_EQ_INT(LEPT_NULL, lept_get_type(&v2));
+    EXPECT_EQ_JSON(&v1, &v3);
+
+    /*  从整块内存中移出子节点，之后释放原来的整块内存 */
+    lept_move(&v2, lept_find_object_value(&v3, "a", 1));
+    EXPECT_EQ_INT(LEPT_NULL, lept_get_type(lept_find_object_value(&v3, "a", 1)));
+    lept_free(&v3);
+    EXPECT_EQ_SIZE_T(3, lept_get_array_size(&v2));
+    EXPECT_EQ_DOUBLE(3.0, lept_get_number(lept_get_array_element(&v2, 2)));
+    lept_free(&v1);
+    lept_free(&v2);
+}
+
+
+void test_swap()
+{
+    lept_value v1, v2, v3;
+    lept_init(&v1);
+    lept_init(&v2);
+    lept_set_string(&v1, "Hello",  5);
+    lept_set_string(&v2, "World!", 6);
+    lept_swap(&v1, &v2);
+    EXPECT_EQ_STRING("World!", lept_get_string(&v1), lept_get_string_length(&v1));
+    EXPECT_EQ_STRING("Hello",  lept_get_string(&v2), lept_get_string_length(&v2));
+
+    lept_init(&v3);
+    lept_free(&v1);
+    lept_parse(&v1, "[\"abc\",[1]]");
+    lept_copy(&v3, &v1);
+    lept_swap(&v2, lept_get_array_element(&v3, 0));
+    lept_free(&v3);
+    EXPECT_EQ_STRING("abc", lept_get_string(&v2), lept_get_string_length(&v2));
+    lept_free(&v1);
+    lept_free(&v2);
+}
+
+
+void test_equal()
+{
+    TEST_EQUAL("true", "true", 1);
+    TEST_EQUAL("true", "false", 0);
+    TEST_EQUAL("false", "false", 1);
+    TEST_EQUAL("null", "null", 1);
+    TEST_EQUAL("null", "0", 0);
+    TEST_EQUAL("123", "123", 1);
+    TEST_EQUAL("123", "456", 0);
+    TEST_EQUAL("0", "-0", 1);
+    TEST_EQUAL("\"abc\"", "\"abc\"", 1);
+    TEST_EQUAL("\"abc\"", "\"abcd\"", 0);
+    TEST_EQUAL("[]", "[]", 1);
+    TEST_EQUAL("[]", "null", 0);
+    TEST_EQUAL("[1,2,3]", "[1,2,3]", 1);
+    TEST_EQUAL("[1,2,3]", "[1,2,3,4]", 0);
+    TEST_EQUAL("[[]]", "[[]]", 1);
+    TEST_EQUAL("{}", "{}", 1);
+    TEST_EQUAL("{}", "null", 0);
+    TEST_EQUAL("{}", "[]", 0);
+    TEST_EQUAL("{\"a\":1,\"b\":2}", "{\"a\":1,\"b\":2}", 1);
+    TEST_EQUAL("{\"a\":1,\"b\":2}", "{\"b\":2,\"a\":1}", 1);
+    TEST_EQUAL("{\"a\":1,\"b\":2}", "{\"a\":1,\"b\":3}", 0);
+    TEST_EQUAL("{\"a\":1,\"b\":2}", "{\"a\":1,\"b\":2,\"c\":3}", 0);
+    TEST_EQUAL("{\"a\":1,\"b\":2}", "{\"a\":1,\"c\":2}", 0);
+    TEST_EQUAL("{\"a\":{\"b\":{\"c\":{}}}}", "{\"a\":{\"b\":{\"c\":{}}}}", 1);
+    TEST_EQUAL("{\"a\":{\"b\":{\"c\":{}}}}", "{\"a\":{\"b\":{\"c\":[]}}}", 0);
+    /*  重复的键：每个成员只能匹配一次 */
+    TEST_EQUAL("{\"a\":1,\"a\":1}", "{\"a\":1,\"b\":1}", 0);
+    TEST_EQUAL("{\"a\":1,\"a\":1}", "{\"a\":1,\"a\":1}", 1);
+    TEST_EQUAL("{\"a\":1,\"a\":2}", "{\"a\":2,\"a\":1}", 1);
+    TEST_EQUAL("{\"a\":1,\"a\":2}", "{\"a\":1,\"a\":1}", 0);
+    TEST_EQUAL("{\"a\":1,\"b\":2,\"a\":3}", "{\"b\":2,\"a\":3,\"a\":1}", 1);
+    TEST_EQUAL("{\"x\":{\"a\":1,\"a\":1},\"y\":[{\"b\":0,\"b\":0}]}", "{\"y\":[{\"b\":0,\"c\":0}],\"x\":{\"a\":1,\"a\":1}}", 0);
+}
+
+
+void test_hash()
+{
+    lept_value v1, v2, v3;
+    size_t i, n;
+    char key[8];
+
+    /*  成员数超过索引阈值的乱序对象 */
+    for (n = 20; n <= 200; n += 180) {
+        lept_init(&v1);
+        lept_init(&v2);
+        lept_set_object(&v1, 0);
+        lept_set_object(&v2, 0);
+        for (i = 0; i < n; i++) {
+            sprintf(key, "k%u", (unsigned)i);
+            lept_set_number(lept_set_object_value(&v1, key, strlen(key)), (double)i);
+            sprintf(key, "k%u", (unsigned)(n - 1 - i));
+            lept_set_number(lept_set_object_value(&v2, key, strlen(key)), (double)(n - 1 - i));
+        }
+        EXPECT_EQ_INT(1, lept_is_equal(&v1, &v2));
+        EXPECT_EQ_INT(1, lept_hash(&v1) == lept_hash(&v2));
+
+        lept_init(&v3);
+        lept_copy(&v3, &v2);
+        EXPECT_EQ_INT(1, lept_is_equal(&v1, &v3));
+        lept_set_number(lept_find_object_value(&v3, "k7", 2), -1.0);
+        EXPECT_EQ_INT(0, lept_is_equal(&v1, &v3));
+        EXPECT_EQ_INT(0, lept_hash(&v1) == lept_hash(&v3));
+        lept_remove_object_value(&v3, lept_find_object_index(&v3, "k7", 2));
+        lept_set_number(lept_set_object_value(&v3, "x", 1), 7.0);
+        EXPECT_EQ_INT(0, lept_is_equal(&v1, &v3));
+
+        lept_free(&v1);
+        lept_free(&v2);
+        lept_free(&v3);
+    }
+
+    /*  有重复键的大对象：k0 出现两次，与多出一个成员的对象两个方向都不相等 */
+    {
+        char json[3][512];
+        char* p[3];
+        p[0] = json[0] + sprintf(json[0], "{\"k0\":0");
+        p[1] = json[1] + sprintf(json[1], "{\"x\":0");
+        p[2] = json[2] + sprintf(json[2], "{\"k0\":0");
+        for (i = 20; i-- > 0; ) {
+            p[0] += sprintf(p[0], ",\"k%u\":0", (unsigned)(19 - i));
+            p[1] += sprintf(p[1], ",\"k%u\":0", (unsigned)i);
+            p[2] += sprintf(p[2], ",\"k%u\":0", (unsigned)i);
+        }
+        strcpy(p[0], "}");
+        strcpy(p[1], "}");
+        strcpy(p[2], "}");
+        TEST_EQUAL(json[0], json[1], 0);
+        TEST_EQUAL(json[0], json[2], 1);
+        lept_init(&v1);
+        lept_init(&v2);
+        lept_parse(&v1, json[0]);
+        lept_parse(&v2, json[1]);
+        EXPECT_EQ_INT(0, lept_hash(&v1) == lept_hash(&v2));
+        lept_free(&v1);
+        lept_free(&v2);
+    }
+
+    /*  数组的顺序影响哈希 */
+    lept_init(&v1);
+    lept_init(&v2);
+    lept_parse(&v1, "[1,2]");
+    lept_parse(&v2, "[2,1]");
+    EXPECT_EQ_INT(0, lept_hash(&v1) == lept_hash(&v2));
+    lept_free(&v1);
+    lept_free(&v2);
+}
+
+
+void test_share()
+{
+    lept_value v1, v2, v3, expect, *pv;
+    lept_init(&v1);
+    lept_init(&v2);
+    lept_init(&v3);
+    lept_init(&expect);
+    EXPECT_EQ_INT(LEPT_PARSE_OK, lept_parse(&v1, "{\"a\":{\"b\":[1,2,{\"c\":\"x\"}],\"d\":\"big\"},\"e\":[true]}"));
+    lept_share(&v2, &v1);
+    lept_share(&v3, &v2);
+    EXPECT_EQ_INT(1, lept_is_equal(&v1, &v2));
+    EXPECT_EQ_INT(1, lept_get_object_value(&v1, 0) == lept_get_object_value(&v3, 0));
+
+    /*  沿路径修改 v2，只复制根到被修改节点的路径 */
+    pv = lept_set_object_value(&v2, "a", 1);
+    pv = lept_set_object_value(pv, "b", 1);
+    lept_set_number(lept_pushback_array_element(pv), 3);
+    lept_set_boolean(lept_set_object_value(&v2, "f", 1), 0);
+
+    EXPECT_EQ_INT(LEPT_PARSE_OK, lept_parse(&expect, "{\"a\":{\"b\":[1,2,{\"c\":\"x\"},3],\"d\":\"big\"},\"e\":[true],\"f\":false}"));
+    EXPECT_EQ_JSON(&expect, &v2);
+    lept_free(&expect);
+    EXPECT_EQ_INT(LEPT_PARSE_OK, lept_parse(&expect, "{\"a\":{\"b\":[1,2,{\"c\":\"x\"}],\"d\":\"big\"},\"e\":[true]}"));
+    EXPECT_EQ_JSON(&expect, &v1);
+    EXPECT_EQ_JSON(&expect, &v3);
+
+    /*  未修改的子树仍然共享 */
+    EXPECT_EQ_INT(1, lept_get_string(lept_find_object_value(lept_find_object_value(&v1, "a", 1), "d", 1))
+                  == lept_get_string(lept_find_object_value(lept_find_object_value(&v2, "a", 1), "d", 1)));
+    EXPECT_EQ_INT(1, lept_get_array_element(lept_find_object_value(&v1, "e", 1), 0)
+                  == lept_get_array_element(lept_find_object_value(&v2, "e", 1), 0));
+    EXPECT_EQ_INT(0, lept_find_object_value(&v1, "a", 1) == lept_find_object_value(&v2, "a", 1));
+
+    /*  直接写入元素前先从根开始逐层 lept_unshare */
+    lept_unshare(&v3);
+    pv = lept_find_object_value(&v3, "e", 1);
+    lept_unshare(pv);
+    lept_set_string(lept_get_array_element(pv, 0), "t", 1);
+    EXPECT_EQ_INT(LEPT_TRUE, lept_get_type(lept_get_array_element(lept_find_object_value(&v1, "e", 1), 0)));
+
+    lept_remove_object_value(&v1, lept_find_object_index(&v1, "a", 1));
+    lept_free(&v1);
+    EXPECT_EQ_INT(1, lept_is_equal(&expect, lept_find_object_value(&v3, "a", 1)) == 0);
+    EXPECT_EQ_INT(1, lept_is_equal(lept_find_object_value(&expect, "a", 1), lept_find_object_value(&v3, "a", 1)));
+    lept_free(&v2);
+    lept_free(&v3);
+    lept_free(&expect);
+
+    /*  共享 lept_copy 得到的整块内存 */
+    lept_parse(&v1, "[\"abc\",[1,2],{\"k\":[]}]");
+    lept_copy(&v2, &v1);
+    lept_share(&v3, &v2);
+    lept_free(&v2);
+    EXPECT_EQ_INT(1, lept_is_equal(&v1, &v3));
+    lept_clear_array(lept_get_array_element(&v1, 1));
+    lept_share(&v2, lept_get_array_element(&v1, 1));
+    lept_shrink_array(&v2);
+    EXPECT_EQ_SIZE_T(0, lept_get_array_capacity(&v2));
+    lept_free(&v1);
+    lept_free(&v2);
+    lept_free(&v3);
+}
+
+
+void test_free()
+{
+    lept_value v, *pv;
+    size_t i;
+
+    /*  深层嵌套，递归释放会栈溢出 */
+    lept_init(&v);
+    lept_set_array(&v, 0);
+    pv = &v;
+    for (i = 0; i < 100000; i++) {
+        pv = lept_pushback_array_element(pv);
+        lept_set_array(pv, 1);
+        lept_set_string(lept_pushback_array_element(pv), "x", 1);
+    }
+    lept_free(&v);
+    EXPECT_EQ_INT(LEPT_NULL, lept_get_type(&v));
+
+    /*  延迟释放 */
+    EXPECT_EQ_SIZE_T(0, lept_reclaim());
+    for (i = 0; i < 3; i++) {
+        EXPECT_EQ_INT(LEPT_PARSE_OK, lept_parse(&v, "{\"a\":[1,\"b\",{\"c\":null}]}"));
+        lept_free_deferred(&v);
+        EXPECT_EQ_INT(LEPT_NULL, lept_get_type(&v));
+    }
+    lept_set_number(&v, 1.0);
+    lept_free_deferred(&v);
+    EXPECT_EQ_SIZE_T(3, lept_reclaim());
+    EXPECT_EQ_SIZE_T(0, lept_reclaim());
+}
+
+
+void test_pointer()
+{
+    lept_value v, tmp;
+    lept_init(&v);
+    /*  RFC 6901 第 5 节的例子 */
+    EXPECT_EQ_INT(LEPT_PARSE_OK, lept_parse(&v, "{\"foo\":[\"bar\",\"baz\"],\"\":0,\"a/b\":1,\"c%d\":2,\"e^f\":3,"
+                                                "\"g|h\":4,\"i\\\\j\":5,\"k\\\"l\":6,\" \":7,\"m~n\":8}"));
+    EXPECT_EQ_INT(1, &v == lept_find_pointer_value(&v, "", 0, &tmp));
+    EXPECT_EQ_INT(1, lept_find_object_value(&v, "foo", 3) == lept_find_pointer_value(&v, "/foo", 4, &tmp));
+    EXPECT_EQ_STRING("baz", lept_get_string(lept_find_pointer_value(&v, "/foo/1", 6, &tmp)), 3);
+    EXPECT_EQ_DOUBLE(0.0, lept_get_number(lept_find_pointer_value(&v, "/", 1, &tmp)));
+    EXPECT_EQ_DOUBLE(1.0, lept_get_number(lept_find_pointer_value(&v, "/a~1b", 5, &tmp)));
+    EXPECT_EQ_DOUBLE(2.0, lept_get_number(lept_find_pointer_value(&v, "/c%d", 4, &tmp)));
+    EXPECT_EQ_DOUBLE(5.0, lept_get_number(lept_find_pointer_value(&v, "/i\\j", 4, &tmp)));
+    EXPECT_EQ_DOUBLE(6.0, lept_get_number(lept_find_pointer_value(&v, "/k\"l", 4, &tmp)));
+    EXPECT_EQ_DOUBLE(7.0, lept_get_number(lept_find_pointer_value(&v, "/ ", 2, &tmp)));
+    EXPECT_EQ_DOUBLE(8.0, lept_get_number(lept_find_pointer_value(&v, "/m~0n", 5, &tmp)));
+
+    EXPECT_EQ_INT(1, NULL == lept_find_pointer_value(&v, "foo", 3, &tmp));
+    EXPECT_EQ_INT(1, NULL == lept_find_pointer_value(&v, "/bar", 4, &tmp));
+    EXPECT_EQ_INT(1, NULL == lept_find_pointer_value(&v, "/foo/2", 6, &tmp));
+    EXPECT_EQ_INT(1, NULL == lept_find_pointer_value(&v, "/foo/-", 6, &tmp));
+    EXPECT_EQ_INT(1, NULL == lept_find_pointer_value(&v, "/foo/01", 7, &tmp));
+    EXPECT_EQ_INT(1, NULL == lept_find_pointer_value(&v, "/foo/0/x", 8, &tmp));
+    EXPECT_EQ_INT(1, NULL == lept_find_pointer_value(&v, "/m~2n", 5, &tmp));
+    lept_free(&v);
+}
+
+
+void test_merge_patch()
+{
+    /*  RFC 7396 第 3 节和附录 A 的例子 */
+    TEST_MERGE_PATCH("{\"title\":\"Goodbye!\",\"author\":{\"givenName\":\"John\",\"familyName\":\"Doe\"},"
+                     "\"tags\":[\"example\",\"sample\"],\"content\":\"This will be unchanged\"}",
+                     "{\"title\":\"Hello!\",\"phoneNumber\":\"+01-123-456-7890\",\"author\":{\"familyName\":null},"
+                     "\"tags\":[\"example\"]}",
+                     "{\"title\":\"Hello!\",\"author\":{\"givenName\":\"John\"},\"tags\":[\"example\"],"
+                     "\"content\":\"This will be unchanged\",\"phoneNumber\":\"+01-123-456-7890\"}");
+    TEST_MERGE_PATCH("{\"a\":\"b\"}", "{\"a\":\"c\"}", "{\"a\":\"c\"}");
+    TEST_MERGE_PATCH("{\"a\":\"b\"}", "{\"b\":\"c\"}", "{\"a\":\"b\",\"b\":\"c\"}");
+    TEST_MERGE_PATCH("{\"a\":\"b\"}", "{\"a\":null}", "{}");
+    TEST_MERGE_PATCH("{\"a\":\"b\",\"b\":\"c\"}", "{\"a\":null}", "{\"b\":\"c\"}");
+    TEST_MERGE_PATCH("{\"a\":[\"b\"]}", "{\"a\":\"c\"}", "{\"a\":\"c\"}");
+    TEST_MERGE_PATCH("{\"a\":\"c\"}", "{\"a\":[\"b\"]}", "{\"a\":[\"b\"]}");
+    TEST_MERGE_PATCH("{\"a\":{\"b\":\"c\"}}", "{\"a\":{\"b\":\"d\",\"c\":null}}", "{\"a\":{\"b\":\"d\"}}");
+    TEST_MERGE_PATCH("{\"a\":[{\"b\":\"c\"}]}", "{\"a\":[1]}", "{\"a\":[1]}");
+    TEST_MERGE_PATCH("[\"a\",\"b\"]", "[\"c\",\"d\"]", "[\"c\",\"d\"]");
+    TEST_MERGE_PATCH("{\"a\":\"b\"}", "[\"c\"]", "[\"c\"]");
+    TEST_MERGE_PATCH("{\"a\":\"foo\"}", "null", "null");
+    TEST_MERGE_PATCH("{\"a\":\"foo\"}", "\"bar\"", "\"bar\"");
+    TEST_MERGE_PATCH("{\"e\":null}", "{\"a\":1}", "{\"e\":null,\"a\":1}");
+    TEST_MERGE_PATCH("[1,2]", "{\"a\":\"b\",\"c\":null}", "{\"a\":\"b\"}");
+    TEST_MERGE_PATCH("{}", "{\"a\":{\"bb\":{\"ccc\":null}}}", "{\"a\":{\"bb\":{}}}");
+}
+
+
+void test_apply_patch()
+{
+    lept_value v1, v2, p;
+
+    /*  RFC 6902 附录 A 的例子 */
+    TEST_APPLY_PATCH("{\"foo\":\"bar\"}", "[{\"op\":\"add\",\"path\":\"/baz\",\"value\":\"qux\"}]",
+                     LEPT_PATCH_OK, "{\"foo\":\"bar\",\"baz\":\"qux\"}");
+    TEST_APPLY_PATCH("{\"foo\":[\"bar\",\"baz\"]}", "[{\"op\":\"add\",\"path\":\"/foo/1\",\"value\":\"qux\"}]",
+                     LEPT_PATCH_OK, "{\"foo\":[\"bar\",\"qux\",\"baz\"]}");
+    TEST_APPLY_PATCH("{\"baz\":\"qux\",\"foo\":\"bar\"}", "[{\"op\":\"remove\",\"path\":\"/baz\"}]",
+                     LEPT_PATCH_OK, "{\"foo\":\"bar\"}");
+    TEST_APPLY_PATCH("{\"foo\":[\"bar\",\"qux\",\"baz\"]}", "[{\"op\":\"remove\",\"path\":\"/foo/1\"}]",
+                     LEPT_PATCH_OK, "{\"foo\":[\"bar\",\"baz\"]}");
+    TEST_APPLY_PATCH("{\"baz\":\"qux\",\"foo\":\"bar\"}", "[{\"op\":\"replace\",\"path\":\"/baz\",\"value\":\"boo\"}]",
+                     LEPT_PATCH_OK, "{\"baz\":\"boo\",\"foo\":\"bar\"}");
+    TEST_APPLY_PATCH("{\"foo\":{\"bar\":\"baz\",\"waldo\":\"fred\"},\"qux\":{\"corge\":\"grault\"}}",
+                     "[{\"op\":\"move\",\"from\":\"/foo/waldo\",\"path\":\"/qux/thud\"}]",
+                     LEPT_PATCH_OK, "{\"foo\":{\"bar\":\"baz\"},\"qux\":{\"corge\":\"grault\",\"thud\":\"fred\"}}");
+    TEST_APPLY_PATCH("{\"foo\":[\"all\",\"grass\",\"cows\",\"eat\"]}",
+                     "[{\"op\":\"move\",\"from\":\"/foo/1\",\"path\":\"/foo/3\"}]",
+                     LEPT_PATCH_OK, "{\"foo\":[\"all\",\"cows\",\"eat\",\"grass\"]}");
+    TEST_APPLY_PATCH("{\"baz\":\"qux\",\"foo\":[\"a\",2,\"c\"]}",
+                     "[{\"op\":\"test\",\"path\":\"/baz\",\"value\":\"qux\"},{\"op\":\"test\",\"path\":\"/foo/1\",\"value\":2}]",
+                     LEPT_PATCH_OK, "{\"baz\":\"qux\",\"foo\":[\"a\",2,\"c\"]}");
+    TEST_APPLY_PATCH("{\"baz\":\"qux\"}", "[{\"op\":\"test\",\"path\":\"/baz\",\"value\":\"bar\"}]",
+                     LEPT_PATCH_TEST_FAILED, "{\"baz\":\"qux\"}");
+    TEST_APPLY_PATCH("{\"foo\":\"bar\"}", "[{\"op\":\"add\",\"path\":\"/child\",\"value\":{\"grandchild\":{}}}]",
+                     LEPT_PATCH_OK, "{\"foo\":\"bar\",\"child\":{\"grandchild\":{}}}");
+    TEST_APPLY_PATCH("{\"foo\":\"bar\"}", "[{\"op\":\"add\",\"path\":\"/baz\",\"value\":\"qux\",\"xyz\":123}]",
+                     LEPT_PATCH_OK, "{\"foo\":\"bar\",\"baz\":\"qux\"}");
+    TEST_APPLY_PATCH("{\"foo\":\"bar\"}", "[{\"op\":\"add\",\"path\":\"/baz/bat\",\"value\":\"qux\"}]",
+                     LEPT_PATCH_PATH_NOT_FOUND, "{\"foo\":\"bar\"}");
+    TEST_APPLY_PATCH("{\"/\":9,\"~1\":10}", "[{\"op\":\"test\",\"path\":\"/~01\",\"value\":10}]",
+                     LEPT_PATCH_OK, "{\"/\":9,\"~1\":10}");
+    TEST_APPLY_PATCH("{\"/\":9,\"~1\":10}", "[{\"op\":\"test\",\"path\":\"/~01\",\"value\":\"10\"}]",
+                     LEPT_PATCH_TEST_FAILED, "{\"/\":9,\"~1\":10}");
+    TEST_APPLY_PATCH("{\"foo\":[\"bar\"]}", "[{\"op\":\"add\",\"path\":\"/foo/-\",\"value\":[\"abc\",\"def\"]}]",
+                     LEPT_PATCH_OK, "{\"foo\":[\"bar\",[\"abc\",\"def\"]]}");
+
+    /*  copy、替换根、move 到自身 */
+    TEST_APPLY_PATCH("{\"a\":[1,{\"b\":2}]}", "[{\"op\":\"copy\",\"from\":\"/a/1\",\"path\":\"/c\"},"
+                     "{\"op\":\"replace\",\"path\":\"/a/1/b\",\"value\":3}]",
+                     LEPT_PATCH_OK, "{\"a\":[1,{\"b\":3}],\"c\":{\"b\":2}}");
+    TEST_APPLY_PATCH("{\"a\":1}", "[{\"op\":\"replace\",\"path\":\"\",\"value\":[1]}]", LEPT_PATCH_OK, "[1]");
+    TEST_APPLY_PATCH("{\"a\":1}", "[{\"op\":\"add\",\"path\":\"\",\"value\":2}]", LEPT_PATCH_OK, "2");
+    TEST_APPLY_PATCH("{\"a\":{\"b\":1}}", "[{\"op\":\"move\",\"from\":\"/a\",\"path\":\"/a\"}]",
+                     LEPT_PATCH_OK, "{\"a\":{\"b\":1}}");
+
+    /*  出错时停止，之前的操作已生效 */
+    TEST_APPLY_PATCH("{\"a\":1}", "[{\"op\":\"remove\",\"path\":\"/a\"},{\"op\":\"remove\",\"path\":\"/a\"}]",
+                     LEPT_PATCH_PATH_NOT_FOUND, "{}");
+    TEST_APPLY_PATCH("[1,2]", "[{\"op\":\"add\",\"path\":\"/3\",\"value\":0}]", LEPT_PATCH_PATH_NOT_FOUND, "[1,2]");
+    TEST_APPLY_PATCH("[1,2]", "[{\"op\":\"add\",\"path\":\"/01\",\"value\":0}]", LEPT_PATCH_PATH_NOT_FOUND, "[1,2]");
+    TEST_APPLY_PATCH("[1,2]", "[{\"op\":\"replace\",\"path\":\"/2\",\"value\":0}]", LEPT_PATCH_PATH_NOT_FOUND, "[1,2]");
+    TEST_APPLY_PATCH("[1,2]", "[{\"op\":\"add\",\"path\":\"0\",\"value\":0}]", LEPT_PATCH_INVALID_POINTER, "[1,2]");
+    TEST_APPLY_PATCH("{\"a\":1}", "[{\"op\":\"add\",\"path\":\"/a~2\",\"value\":0}]", LEPT_PATCH_INVALID_POINTER, "{\"a\":1}");
+    TEST_APPLY_PATCH("{\"a\":1}", "[{\"op\":\"add\",\"path\":\"/b\"}]", LEPT_PATCH_INVALID_PATCH, "{\"a\":1}");
+    TEST_APPLY_PATCH("{\"a\":1}", "[{\"op\":\"nop\",\"path\":\"/a\"}]", LEPT_PATCH_INVALID_PATCH, "{\"a\":1}");
+    TEST_APPLY_PATCH("{\"a\":1}", "[{\"path\":\"/a\"}]", LEPT_PATCH_INVALID_PATCH, "{\"a\":1}");
+    TEST_APPLY_PATCH("{\"a\":1}", "{\"op\":\"remove\",\"path\":\"/a\"}", LEPT_PATCH_INVALID_PATCH, "{\"a\":1}");
+    TEST_APPLY_PATCH("{\"a\":{\"b\":1}}", "[{\"op\":\"move\",\"from\":\"/a\",\"path\":\"/a/c\"}]",
+                     LEPT_PATCH_INVALID_PATCH, "{\"a\":{\"b\":1}}");
+    TEST_APPLY_PATCH("{\"a\":1}", "[{\"op\":\"copy\",\"from\":\"/b\",\"path\":\"/c\"}]",
+                     LEPT_PATCH_PATH_NOT_FOUND, "{\"a\":1}");
+
+    /*  修改共享的文档不影响其他共享者 */
+    lept_init(&v1);
+    lept_init(&v2);
+    lept_init(&p);
+    EXPECT_EQ_INT(LEPT_PARSE_OK, lept_parse(&v1, "{\"a\":{\"b\":[1,2]},\"c\":[3]}"));
+    EXPECT_EQ_INT(LEPT_PARSE_OK, lept_parse(&p, "[{\"op\":\"replace\",\"path\":\"/a/b/0\",\"value\":0},"
+                                                "{\"op\":\"move\",\"from\":\"/c/0\",\"path\":\"/a/b/-\"}]"));
+    lept_share(&v2, &v1);
+    EXPECT_EQ_INT(LEPT_PATCH_OK, lept_apply_patch(&v2, &p));
+    lept_free(&p);
+    EXPECT_EQ_INT(LEPT_PARSE_OK, lept_parse(&p, "{\"a\":{\"b\":[0,2,3]},\"c\":[]}"));
+    EXPECT_EQ_JSON(&p, &v2);
+    lept_free(&p);
+    EXPECT_EQ_INT(LEPT_PARSE_OK, lept_parse(&p, "{\"a\":{\"b\":[1,2]},\"c\":[3]}"));
+    EXPECT_EQ_JSON(&p, &v1);
+    lept_free(&p);
+    lept_free(&v1);
+    lept_free(&v2);
+}
+
+
+void test_diff()
+{
+    TEST_DIFF("null", "null", 0);
+    TEST_DIFF("{\"a\":[1,2,{\"b\":\"c\"}]}", "{\"a\":[1,2,{\"b\":\"c\"}]}", 0);
+    TEST_DIFF("1", "2", 1);
+    TEST_DIFF("[1]", "{\"a\":1}", 1);
+    TEST_DIFF("{\"a\":1,\"b\":2}", "{\"b\":2,\"a\":1}", 0);
+    TEST_DIFF("{\"a\":1,\"b\":2}", "{\"a\":1,\"c\":3}", 2);
+    TEST_DIFF("{\"a\":{\"b\":{\"c\":1,\"d\":2}}}", "{\"a\":{\"b\":{\"c\":1,\"d\":3}}}", 1);
+    TEST_DIFF("[1,2,3,4,5]", "[1,2]", 3);
+    TEST_DIFF("[1,2]", "[1,2,3,4]", 2);
+    TEST_DIFF("[1,[2,3],4]", "[0,[2,5]]", 3);
+    TEST_DIFF("{\"a/b\":1,\"m~n\":[true]}", "{\"a/b\":2,\"m~n\":[false],\"~/\":null}", 3);
+    TEST_DIFF("{\"foo\":\"bar\",\"list\":[{\"x\":1},{\"y\":2}]}",
+              "{\"list\":[{\"x\":1,\"z\":0},{\"y\":\"2\"},[]],\"baz\":\"qux\"}", 5);
+}
+
+
+void test_cbor()
+{
+    /*  RFC 8949 附录 A 的例子 */
+    TEST_BINARY(lept_to_cbor, lept_from_cbor, "0", "\x00");
+    TEST_BINARY(lept_to_cbor, lept_from_cbor, "23", "\x17");
+    TEST_BINARY(lept_to_cbor, lept_from_cbor, "24", "\x18\x18");
+    TEST_BINARY(lept_to_cbor, lept_from_cbor, "100", "\x18\x64");
+    TEST_BINARY(lept_to_cbor, lept_from_cbor, "1000", "\x19\x03\xe8");
+    TEST_BINARY(lept_to_cbor, lept_from_cbor, "1000000", "\x1a\x00\x0f\x42\x40");
+    TEST_BINARY(lept_to_cbor, lept_from_cbor, "1000000000000", "\x1b\x00\x00\x00\xe8\xd4\xa5\x10\x00");
+    TEST_BINARY(lept_to_cbor, lept_from_cbor, "-1", "\x20");
+    TEST_BINARY(lept_to_cbor, lept_from_cbor, "-100", "\x38\x63");
+    TEST_BINARY(lept_to_cbor, lept_from_cbor, "-1000", "\x39\x03\xe7");
+    TEST_BINARY(lept_to_cbor, lept_from_cbor, "1.1", "\xfb\x3f\xf1\x99\x99\x99\x99\x99\x9a");
+    TEST_BINARY(lept_to_cbor, lept_from_cbor, "1.5", "\xfa\x3f\xc0\x00\x00");
+    TEST_BINARY(lept_to_cbor, lept_from_cbor, "3.4028234663852886e+38", "\xfa\x7f\x7f\xff\xff");
+    TEST_BINARY(lept_to_cbor, lept_from_cbor, "1.0e+300", "\xfb\x7e\x37\xe4\x3c\x88\x00\x75\x9c");
+    TEST_BINARY(lept_to_cbor, lept_from_cbor, "-4.1", "\xfb\xc0\x10\x66\x66\x66\x66\x66\x66");
+    TEST_BINARY(lept_to_cbor, lept_from_cbor, "-0", "\xfa\x80\x00\x00\x00");
+    TEST_BINARY(lept_to_cbor, lept_from_cbor, "false", "\xf4");
+    TEST_BINARY(lept_to_cbor, lept_from_cbor, "true", "\xf5");
+    TEST_BINARY(lept_to_cbor, lept_from_cbor, "null", "\xf6");
+    TEST_BINARY(lept_to_cbor, lept_from_cbor, "\"\"", "\x60");
+    TEST_BINARY(lept_to_cbor, lept_from_cbor, "\"IETF\"", "\x64\x49\x45\x54\x46");
+    TEST_BINARY(lept_to_cbor, lept_from_cbor, "\"\\u00fc\"", "\x62\xc3\xbc");
+    TEST_BINARY(lept_to_cbor, lept_from_cbor, "\"a\\u0000\"", "\x62\x61\x00");
+    TEST_BINARY(lept_to_cbor, lept_from_cbor, "[]", "\x80");
+    TEST_BINARY(lept_to_cbor, lept_from_cbor, "[1,[2,3],[4,5]]", "\x83\x01\x82\x02\x03\x82\x04\x05");
+    TEST_BINARY(lept_to_cbor, lept_from_cbor, "{}", "\xa0");
+    TEST_BINARY(lept_to_cbor, lept_from_cbor, "{\"a\":1,\"b\":[2,3]}", "\xa2\x61\x61\x01\x61\x62\x82\x02\x03");
+    TEST_BINARY(lept_to_cbor, lept_from_cbor,
+        "[1,2,3,4,5,6,7,8,9,10,11,12,13,14,15,16,17,18,19,20,21,22,23,24,25]",
+        "\x98\x19\x01\x02\x03\x04\x05\x06\x07\x08\x09\x0a\x0b\x0c\x0d\x0e\x0f\x10\x11\x12\x13\x14\x15\x16\x17\x18\x18\x18\x19");
+
+    TEST_BINARY_DECODE(lept_from_cbor, "5.960464477539063e-08", "\xf9\x00\x01");
+    TEST_BINARY_DECODE(lept_from_cbor, "-0", "\xf9\x80\x00");
+    TEST_BINARY_DECODE(lept_from_cbor, "1", "\xf9\x3c\x00");
+    TEST_BINARY_DECODE(lept_from_cbor, "65504", "\xf9\x7b\xff");
+    TEST_BINARY_DECODE(lept_from_cbor, "-4", "\xf9\xc4\x00");
+    TEST_BINARY_DECODE(lept_from_cbor, "100000", "\xfa\x47\xc3\x50\x00");
+    TEST_BINARY_DECODE(lept_from_cbor, "18446744073709551615", "\x1b\xff\xff\xff\xff\xff\xff\xff\xff");
+    TEST_BINARY_DECODE(lept_from_cbor, "-18446744073709551616", "\x3b\xff\xff\xff\xff\xff\xff\xff\xff");
+    TEST_BINARY_DECODE(lept_from_cbor, "1363896240", "\xc1\x1a\x51\x4b\x67\xb0");
+    TEST_BINARY_DECODE(lept_from_cbor, "\"streaming\"", "\x7f\x65\x73\x74\x72\x65\x61\x64\x6d\x69\x6e\x67\xff");
+    TEST_BINARY_DECODE(lept_from_cbor, "[1,[2,3],[4,5]]", "\x9f\x01\x82\x02\x03\x9f\x04\x05\xff\xff");
+    TEST_BINARY_DECODE(lept_from_cbor, "{\"a\":1,\"b\":[2,3]}", "\xbf\x61\x61\x01\x61\x62\x9f\x02\x03\xff\xff");
+
+    TEST_BINARY_ERROR(lept_from_cbor, LEPT_PARSE_BINARY_TRUNCATED, "");
+    TEST_BINARY_ERROR(lept_from_cbor, LEPT_PARSE_BINARY_TRUNCATED, "\x18");
+    TEST_BINARY_ERROR(lept_from_cbor, LEPT_PARSE_BINARY_TRUNCATED, "\x62\x61");
+    TEST_BINARY_ERROR(lept_from_cbor, LEPT_PARSE_BINARY_TRUNCATED, "\x82\x01");
+    TEST_BINARY_ERROR(lept_from_cbor, LEPT_PARSE_BINARY_TRUNCATED, "\xa1\x61\x61");
+    TEST_BINARY_ERROR(lept_from_cbor, LEPT_PARSE_BINARY_TRUNCATED, "\x9b\xff\xff\xff\xff\xff\xff\xff\xff\x01");
+    TEST_BINARY_ERROR(lept_from_cbor, LEPT_PARSE_BINARY_TRUNCATED, "\x9f\x01");
+    TEST_BINARY_ERROR(lept_from_cbor, LEPT_PARSE_BINARY_TRUNCATED, "\x7f\x61\x61");
+    TEST_BINARY_ERROR(lept_from_cbor, LEPT_PARSE_BINARY_TRUNCATED, "\xfb\x00");
+    TEST_BINARY_ERROR(lept_from_cbor, LEPT_PARSE_BINARY_UNSUPPORTED, "\x44\x01\x02\x03\x04");
+    TEST_BINARY_ERROR(lept_from_cbor, LEPT_PARSE_BINARY_UNSUPPORTED, "\xa1\x01\x02");
+    TEST_BINARY_ERROR(lept_from_cbor, LEPT_PARSE_BINARY_UNSUPPORTED, "\x82\x01\xf7");
+    TEST_BINARY_ERROR(lept_from_cbor, LEPT_PARSE_BINARY_UNSUPPORTED, "\xf9\x7c\x00");
+    TEST_BINARY_ERROR(lept_from_cbor, LEPT_PARSE_BINARY_UNSUPPORTED, "\xfa\x7f\xc0\x00\x00");
+    TEST_BINARY_ERROR(lept_from_cbor, LEPT_PARSE_BINARY_UNSUPPORTED, "\x1c");
+    TEST_BINARY_ERROR(lept_from_cbor, LEPT_PARSE_BINARY_UNSUPPORTED, "\x7f\x41\x61\xff");
+    TEST_BINARY_ERROR(lept_from_cbor, LEPT_PARSE_ROOT_NOT_SINGULAR, "\x01\x02");
+}
+
+
+void test_msgpack()
+{
+    TEST_BINARY(lept_to_msgpack, lept_from_msgpack, "null", "\xc0");
+    TEST_BINARY(lept_to_msgpack, lept_from_msgpack, "false", "\xc2");
+    TEST_BINARY(lept_to_msgpack, lept_from_msgpack, "true", "\xc3");
+    TEST_BINARY(lept_to_msgpack, lept_from_msgpack, "0", "\x00");
+    TEST_BINARY(lept_to_msgpack, lept_from_msgpack, "127", "\x7f");
+    TEST_BINARY(lept_to_msgpack, lept_from_msgpack, "128", "\xcc\x80");
+    TEST_BINARY(lept_to_msgpack, lept_from_msgpack, "256", "\xcd\x01\x00");
+    TEST_BINARY(lept_to_msgpack, lept_from_msgpack, "65536", "\xce\x00\x01\x00\x00");
+    TEST_BINARY(lept_to_msgpack, lept_from_msgpack, "4294967296", "\xcf\x00\x00\x00\x01\x00\x00\x00\x00");
+    TEST_BINARY(lept_to_msgpack, lept_from_msgpack, "9007199254740992", "\xcf\x00\x20\x00\x00\x00\x00\x00\x00");
+    TEST_BINARY(lept_to_msgpack, lept_from_msgpack, "-1", "\xff");
+    TEST_BINARY(lept_to_msgpack, lept_from_msgpack, "-32", "\xe0");
+    TEST_BINARY(lept_to_msgpack, lept_from_msgpack, "-33", "\xd0\xdf");
+    TEST_BINARY(lept_to_msgpack, lept_from_msgpack, "-129", "\xd1\xff\x7f");
+    TEST_BINARY(lept_to_msgpack, lept_from_msgpack, "-32769", "\xd2\xff\xff\x7f\xff");
+    TEST_BINARY(lept_to_msgpack, lept_from_msgpack, "-2147483649", "\xd3\xff\xff\xff\xff\x7f\xff\xff\xff");
+    TEST_BINARY(lept_to_msgpack, lept_from_msgpack, "-9007199254740992", "\xd3\xff\xe0\x00\x00\x00\x00\x00\x00");
+    TEST_BINARY(lept_to_msgpack, lept_from_msgpack, "1.5", "\xca\x3f\xc0\x00\x00");
+    TEST_BINARY(lept_to_msgpack, lept_from_msgpack, "1.1", "\xcb\x3f\xf1\x99\x99\x99\x99\x99\x9a");
+    TEST_BINARY(lept_to_msgpack, lept_from_msgpack, "-0", "\xca\x80\x00\x00\x00");
+    TEST_BINARY(lept_to_msgpack, lept_from_msgpack, "\"\"", "\xa0");
+    TEST_BINARY(lept_to_msgpack, lept_from_msgpack, "\"a\"", "\xa1\x61");
+    TEST_BINARY(lept_to_msgpack, lept_from_msgpack, "\"0123456789abcdef0123456789abcdef\"",
+        "\xd9\x20" "0123456789abcdef0123456789abcdef");
+    TEST_BINARY(lept_to_msgpack, lept_from_msgpack, "[1,2]", "\x92\x01\x02");
+    TEST_BINARY(lept_to_msgpack, lept_from_msgpack, "[[],{}]", "\x92\x90\x80");
+    TEST_BINARY(lept_to_msgpack, lept_from_msgpack, "{\"a\":1,\"b\":[null]}", "\x82\xa1\x61\x01\xa1\x62\x91\xc0");
+    TEST_BINARY(lept_to_msgpack, lept_from_msgpack, "[0,1,2,3,4,5,6,7,8,9,10,11,12,13,14,15]",
+        "\xdc\x00\x10\x00\x01\x02\x03\x04\x05\x06\x07\x08\x09\x0a\x0b\x0c\x0d\x0e\x0f");
+
+    TEST_BINARY_DECODE(lept_from_msgpack, "18446744073709551615", "\xcf\xff\xff\xff\xff\xff\xff\xff\xff");
+    TEST_BINARY_DECODE(lept_from_msgpack, "-9223372036854775808", "\xd3\x80\x00\x00\x00\x00\x00\x00\x00");
+    TEST_BINARY_DECODE(lept_from_msgpack, "-1", "\xd3\xff\xff\xff\xff\xff\xff\xff\xff");
+    TEST_BINARY_DECODE(lept_from_msgpack, "1", "\xd0\x01");
+    TEST_BINARY_DECODE(lept_from_msgpack, "\"ab\"", "\xdb\x00\x00\x00\x02\x61\x62");
+    TEST_BINARY_DECODE(lept_from_msgpack, "{\"a\":true}", "\xdf\x00\x00\x00\x01\xa1\x61\xc3");
+
+    TEST_BINARY_ERROR(lept_from_msgpack, LEPT_PARSE_BINARY_TRUNCATED, "");
+    TEST_BINARY_ERROR(lept_from_msgpack, LEPT_PARSE_BINARY_TRUNCATED, "\xcd\x01");
+    TEST_BINARY_ERROR(lept_from_msgpack, LEPT_PARSE_BINARY_TRUNCATED, "\xa2\x61");
+    TEST_BINARY_ERROR(lept_from_msgpack, LEPT_PARSE_BINARY_TRUNCATED, "\x92\x01");
+    TEST_BINARY_ERROR(lept_from_msgpack, LEPT_PARSE_BINARY_TRUNCATED, "\xdd\xff\xff\xff\xff\x01");
+    TEST_BINARY_ERROR(lept_from_msgpack, LEPT_PARSE_BINARY_TRUNCATED, "\x81\xa1\x61");
+    TEST_BINARY_ERROR(lept_from_msgpack, LEPT_PARSE_BINARY_UNSUPPORTED, "\xc1");
+    TEST_BINARY_ERROR(lept_from_msgpack, LEPT_PARSE_BINARY_UNSUPPORTED, "\xc4\x01\x00");
+    TEST_BINARY_ERROR(lept_from_msgpack, LEPT_PARSE_BINARY_UNSUPPORTED, "\xd4\x01\x00");
+    TEST_BINARY_ERROR(lept_from_msgpack, LEPT_PARSE_BINARY_UNSUPPORTED, "\x81\x01\x01");
+    TEST_BINARY_ERROR(lept_from_msgpack, LEPT_PARSE_BINARY_UNSUPPORTED, "\xcb\x7f\xf8\x00\x00\x00\x00\x00\x00");
+    TEST_BINARY_ERROR(lept_from_msgpack, LEPT_PARSE_ROOT_NOT_SINGULAR, "\xc0\xc0");
+}
+
+
+/*  数值经过 CBOR/MessagePack 往返后逐位相同 */
+void test_binary_number()
+{
+    static const double nums[] = {
+        0.1, -0.0, 1e-310, 4.9406564584124654e-324, 2.2250738585072014e-308, 1.7976931348623157e+308,
+        9007199254740992.0, 9007199254740994.0, -9007199254740994.0, 1e20, 1.401298464324817e-45,
+        1.1754942106924411e-38, 3.141592653589793, -2.5, 65504.0, 0.333333343267440796
+    };
+    lept_value v, r;
+    char* b;
+    size_t i, len;
+    lept_init(&v);
+    lept_init(&r);
+    for (i = 0; i < sizeof(nums) / sizeof(nums[0]); i++) {
+        lept_set_number(&v, nums[i]);
+        b = lept_to_cbor(&v, &len);
+        EXPECT_EQ_INT(LEPT_PARSE_OK, lept_from_cbor(&r, b, len));
+        EXPECT_EQ_INT(0, memcmp(&v.u.num, &r.u.num, sizeof(double)));
+        free(b);
+        b = lept_to_msgpack(&v, &len);
+        EXPECT_EQ_INT(LEPT_PARSE_OK, lept_from_msgpack(&r, b, len));
+        EXPECT_EQ_INT(0, memcmp(&v.u.num, &r.u.num, sizeof(double)));
+        free(b);
+    }
+    lept_free(&v);
+    lept_free(&r);
+}
+
+
+void test_snapshot()
+{
+    const char* path = "leptjson_test_snapshot.bin";
+    lept_value v;
+    lept_snapshot* snap;
+    const lept_snap_value *root, *a, *o;
+    FILE* fp;
+
+    lept_init(&v);
+    EXPECT_EQ_INT(LEPT_PARSE_OK, lept_parse(&v, "{\"n\":null,\"f\":false,\"t\":true,\"num\":-1.5e10,"
+                                                "\"s\":\"Hello\\u0000World\",\"e\":\"\",\"a\":[1,\"x\",[],{}],"
+                                                "\"o\":{\"k\":{\"deep\":[[3]]}},\"\":0}"));
+    EXPECT_EQ_INT(LEPT_SNAPSHOT_OK, lept_snapshot_write(&v, path));
+    lept_free(&v);
+
+    EXPECT_EQ_INT(LEPT_SNAPSHOT_OK, lept_snapshot_open(&snap, path));
+    root = lept_snapshot_root(snap);
+    EXPECT_EQ_INT(LEPT_OBJECT, lept_snap_get_type(root));
+    EXPECT_EQ_SIZE_T(9, lept_snap_get_object_size(root));
+    EXPECT_EQ_STRING("num", lept_snap_get_object_key(root, 3), lept_snap_get_object_key_length(root, 3));
+    EXPECT_EQ_INT(LEPT_NULL, lept_snap_get_type(lept_snap_get_object_value(root, 0)));
+    EXPECT_EQ_INT(0, lept_snap_get_boolean(lept_snap_find_object_value(root, "f", 1)));
+    EXPECT_EQ_INT(1, lept_snap_get_boolean(lept_snap_find_object_value(root, "t", 1)));
+    EXPECT_EQ_DOUBLE(-1.5e10, lept_snap_get_number(lept_snap_find_object_value(root, "num", 3)));
+    EXPECT_EQ_STRING("Hello\0World", lept_snap_get_string(lept_snap_find_object_value(root, "s", 1)),
+                     lept_snap_get_string_length(lept_snap_find_object_value(root, "s", 1)));
+    EXPECT_EQ_STRING("", lept_snap_get_string(lept_snap_find_object_value(root, "e", 1)),
+                     lept_snap_get_string_length(lept_snap_find_object_value(root, "e", 1)));
+    EXPECT_EQ_DOUBLE(0.0, lept_snap_get_number(lept_snap_find_object_value(root, "", 0)));
+    EXPECT_EQ_INT(1, NULL == lept_snap_find_object_value(root, "x", 1));
+
+    a = lept_snap_find_object_value(root, "a", 1);
+    EXPECT_EQ_SIZE_T(4, lept_snap_get_array_size(a));
+    EXPECT_EQ_DOUBLE(1.0, lept_snap_get_number(lept_snap_get_array_element(a, 0)));
+    EXPECT_EQ_STRING("x", lept_snap_get_string(lept_snap_get_array_element(a, 1)), 1);
+    EXPECT_EQ_SIZE_T(0, lept_snap_get_array_size(lept_snap_get_array_element(a, 2)));
+    EXPECT_EQ_SIZE_T(0, lept_snap_get_object_size(lept_snap_get_array_element(a, 3)));
+
+    o = lept_snap_find_object_value(lept_snap_find_object_value(root, "o", 1), "k", 1);
+    o = lept_snap_get_array_element(lept_snap_get_array_element(lept_snap_find_object_value(o, "deep", 4), 0), 0);
+    EXPECT_EQ_DOUBLE(3.0, lept_snap_get_number(o));
+
+    /*  标量作为根；覆盖写入时，已经打开的快照仍然是完整的旧映像 */
+    lept_set_string(&v, "abc", 3);
+    EXPECT_EQ_INT(LEPT_SNAPSHOT_OK, lept_snapshot_write(&v, path));
+    EXPECT_EQ_SIZE_T(9, lept_snap_get_object_size(root));
+    EXPECT_EQ_DOUBLE(-1.5e10, lept_snap_get_number(lept_snap_find_object_value(root, "num", 3)));
+    lept_snapshot_close(snap);
+    EXPECT_EQ_INT(LEPT_SNAPSHOT_IO_ERROR, lept_snapshot_write(&v, "leptjson_no_such_dir/snapshot.bin"));
+    lept_free(&v);
+    EXPECT_EQ_INT(LEPT_SNAPSHOT_OK, lept_snapshot_open(&snap, path));
+    EXPECT_EQ_STRING("abc", lept_snap_get_string(lept_snapshot_root(snap)), lept_snap_get_string_length(lept_snapshot_root(snap)));
+    lept_snapshot_close(snap);
+
+    /*  不是快照文件 */
+    fp = fopen(path, "wb");
+    fputs("{\"this is\":\"not a snapshot, just some json text\"}", fp);
+    fclose(fp);
+    EXPECT_EQ_INT(LEPT_SNAPSHOT_INVALID_FORMAT, lept_snapshot_open(&snap, path));
+    EXPECT_EQ_INT(1, NULL == snap);
+    fp = fopen(path, "wb");
+    fclose(fp);
+    EXPECT_EQ_INT(LEPT_SNAPSHOT_INVALID_FORMAT, lept_snapshot_open(&snap, path));
+    remove(path);
+    EXPECT_EQ_INT(LEPT_SNAPSHOT_IO_ERROR, lept_snapshot_open(&snap, path));
+}
+
+
+void test_codegen()
+{
+    test_order o;
+    test_address a;
+    lept_value v, expect;
+    char* json;
+    size_t len;
+
+    EXPECT_EQ_INT(LEPT_PARSE_OK, test_order_parse(&o,
+        " { \"id\" : 42, \"price\": 9.5, \"paid\": true, \"customer\": \"Al\\u00e9\\n\","
+        "\"unknown\": {\"a\": [1, {\"b\": null}], \"c\": \"\\\"\"}, \"tags\": [\"x\", \"\", \"y\"],"
+        "\"matrix\": [[1, 2], [], [3]], \"address\": {\"zip\": 100, \"city\": \"Paris\", \"more\": []},"
+        "\"lines\": [{\"sku\": \"A1\", \"qty\": 2}, {\"qty\": 1}], \"extra\": {\"ignored\": 1},"
+        "\"odd key/\\\"quoted\\\"\": -0.25, \"customer\": \"Bob\", \"paid\": null } "));
+    EXPECT_EQ_INT(42, (int)o.id);
+    EXPECT_EQ_DOUBLE(9.5, o.price);
+    EXPECT_EQ_INT(1, o.paid);
+    EXPECT_EQ_STRING("Bob", o.customer.s, o.customer.len);
+    EXPECT_EQ_SIZE_T(3, o.tags.size);
+    EXPECT_EQ_STRING("x", o.tags.e[0].s, o.tags.e[0].len);
+    EXPECT_EQ_STRING("", o.tags.e[1].s, o.tags.e[1].len);
+    EXPECT_EQ_SIZE_T(3, o.matrix.size);
+    EXPECT_EQ_SIZE_T(2, o.matrix.e[0].size);
+    EXPECT_EQ_SIZE_T(0, o.matrix.e[1].size);
+    EXPECT_EQ_DOUBLE(3.0, o.matrix.e[2].e[0]);
+    EXPECT_EQ_STRING("Paris", o.address.city.s, o.address.city.len);
+    EXPECT_EQ_INT(100, (int)o.address.zip);
+    EXPECT_EQ_SIZE_T(2, o.lines.size);
+    EXPECT_EQ_STRING("A1", o.lines.e[0].sku.s, o.lines.e[0].sku.len);
+    EXPECT_EQ_INT(1, NULL == o.lines.e[1].sku.s);
+    EXPECT_EQ_DOUBLE(-0.25, o.odd_key__quoted_);
+
+    /*  生成的文本包含所有成员，不存在的成员为 0 或空 */
+    json = test_order_stringify(&o, &len);
+    lept_init(&v);
+    lept_init(&expect);
+    EXPECT_EQ_INT(LEPT_PARSE_OK, lept_parse(&v, json));
+    EXPECT_EQ_INT(LEPT_PARSE_OK, lept_parse(&expect,
+        "{\"id\":42,\"price\":9.5,\"paid\":true,\"customer\":\"Bob\",\"tags\":[\"x\",\"\",\"y\"],"
+        "\"matrix\":[[1,2],[],[3]],\"address\":{\"city\":\"Paris\",\"zip\":100},"
+        "\"lines\":[{\"sku\":\"A1\",\"qty\":2},{\"sku\":\"\",\"qty\":1}],\"extra\":{},\"odd key/\\\"quoted\\\"\":-0.25}"));
+    EXPECT_EQ_JSON(&expect, &v);
+    EXPECT_EQ_SIZE_T(strlen(json), len);
+    free(json);
+    lept_free(&v);
+    lept_free(&expect);
+    test_order_free(&o);
+    EXPECT_EQ_INT(1, NULL == o.tags.e && 0 == o.tags.size);
+
+    EXPECT_EQ_INT(LEPT_PARSE_OK, test_address_parse(&a, "{\"city\":\"\"}"));
+    EXPECT_EQ_INT(0, (int)a.zip);
+    test_address_free(&a);
+
+    TEST_CODEGEN_ERROR(LEPT_PARSE_SCHEMA_MISMATCH, "{\"price\":1}");
+    TEST_CODEGEN_ERROR(LEPT_PARSE_SCHEMA_MISMATCH, "{\"id\":null,\"price\":1}");
+    TEST_CODEGEN_ERROR(LEPT_PARSE_SCHEMA_MISMATCH, "{\"id\":1.5,\"price\":1}");
+    TEST_CODEGEN_ERROR(LEPT_PARSE_SCHEMA_MISMATCH, "{\"id\":9223372036854775808,\"price\":1}");
+    TEST_CODEGEN_ERROR(LEPT_PARSE_SCHEMA_MISMATCH, "{\"id\":-1e19,\"price\":1}");
+    TEST_CODEGEN_ERROR(LEPT_PARSE_SCHEMA_MISMATCH, "{\"id\":\"1\",\"price\":1}");
+    TEST_CODEGEN_ERROR(LEPT_PARSE_SCHEMA_MISMATCH, "{\"id\":1,\"price\":1,\"tags\":[\"a\",1]}");
+    TEST_CODEGEN_ERROR(LEPT_PARSE_SCHEMA_MISMATCH, "{\"id\":1,\"price\":1,\"customer\":\"a\",\"address\":{}}");
+    TEST_CODEGEN_ERROR(LEPT_PARSE_SCHEMA_MISMATCH, "[]");
+    TEST_CODEGEN_ERROR(LEPT_PARSE_MISS_COMMA_OR_SQUARE_BRACKET, "{\"id\":1,\"price\":1,\"customer\":\"a\",\"tags\":[\"a\" \"b\"]}");
+    TEST_CODEGEN_ERROR(LEPT_PARSE_INVALID_VALUE, "{\"id\":1,\"price\":1,\"tags\":[\"a\",]}");
+    TEST_CODEGEN_ERROR(LEPT_PARSE_MISS_COMMA_OR_CURLY_BRACKET, "{\"id\":1,\"price\":1,\"customer\":\"a\" \"x\":1}");
+    TEST_CODEGEN_ERROR(LEPT_PARSE_MISS_COLON, "{\"id\" 1}");
+    TEST_CODEGEN_ERROR(LEPT_PARSE_MISS_KEY, "{\"id\":1,}");
+    TEST_CODEGEN_ERROR(LEPT_PARSE_INVALID_VALUE, "{\"id\":1,\"price\":1,\"unknown\":[tru]}");
+    TEST_CODEGEN_ERROR(LEPT_PARSE_MISS_QUOTATION_MARK, "{\"id\":1,\"price\":1,\"unknown\":{\"a\":\"b}}");
+    TEST_CODEGEN_ERROR(LEPT_PARSE_ROOT_NOT_SINGULAR, "{\"id\":1,\"price\":1,\"customer\":\"a\"} x");
+}
+
+
+/*  每个编号的行在回调中只写自己的位置，无序回调时也没有数据竞争 */
+#define TEST_NDJSON_LINES 30000
+#define TEST_NDJSON_BAD 777
+
+typedef struct {
+    size_t expect[TEST_NDJSON_LINES], got[TEST_NDJSON_LINES];
+    size_t bad_offset, got_bad, count, last, stop_at;
+    int in_order, unordered;
+} test_ndjson_state;
+
+static int test_ndjson_cb(void* user, size_t offset, int ret, lept_value* val)
+{
+    test_ndjson_state* st = (test_ndjson_state*)user;
+    size_t i;
+    if(LEPT_PARSE_OK != ret)
+    {
+        st->got_bad = offset + 1;
+        return 0;
+    }
+    i = (size_t)lept_get_number(lept_find_object_value(val, "i", 1));
+    st->got[i] = offset + 1;
+    lept_free(val);
+    if(!st->unordered)
+    {
+        if(st->count > 0 && offset <= st->last)
+            st->in_order = 0;
+        st->last = offset;
+        st->count++;
+    }
+    return i == st->stop_at ? 7 : 0;
+}
+
+static void test_ndjson_run(test_ndjson_state* st, const char* buf, size_t len, int nthreads, int flags, size_t stop_at)
+{
+    size_t i, ok = 0;
+    memset(st->got, 0, sizeof(st->got));
+    st->got_bad = st->count = st->last = 0;
+    st->in_order = 1;
+    st->unordered = flags & LEPT_NDJSON_UNORDERED;
+    st->stop_at = stop_at;
+    EXPECT_EQ_INT(stop_at < TEST_NDJSON_LINES ? 7 : 0, lept_parse_ndjson(buf, len, nthreads, flags, test_ndjson_cb, st));
+    for(i = 0; i < TEST_NDJSON_LINES && i <= stop_at; i++)
+        ok += st->got[i] == st->expect[i] + 1;
+    EXPECT_EQ_SIZE_T(stop_at < TEST_NDJSON_LINES ? stop_at + 1 : TEST_NDJSON_LINES, ok);
+    EXPECT_EQ_SIZE_T(stop_at > TEST_NDJSON_BAD ? st->bad_offset + 1 : 0, st->got_bad);
+    if(!st->unordered)
+    {
+        EXPECT_EQ_INT(1, st->in_order);
+        EXPECT_EQ_SIZE_T(stop_at < TEST_NDJSON_LINES ? stop_at + 1 : TEST_NDJSON_LINES, st->count);
+    }
+}
+
+void test_ndjson()
+{
+    test_ndjson_state* st = (test_ndjson_state*)malloc(sizeof(test_ndjson_state));
+    char* buf = (char*)malloc(TEST_NDJSON_LINES * 40 + 64);
+    size_t i, len = 0;
+    for(i = 0; i < TEST_NDJSON_LINES; i++)
+    {
+        if(TEST_NDJSON_BAD == i)
+        {
+            st->bad_offset = len;
+            len += sprintf(buf + len, "{\"i\":%lu,\"s\":tru}\n", (unsigned long)i);
+        }
+        if(0 == i % 1000)
+            len += sprintf(buf + len, " \t\r\n\n");
+        st->expect[i] = len;
+        /*  最后一行没有换行符 */
+        len += sprintf(buf + len, "{\"i\":%lu,\"s\":\"\\u0041\"}%s", (unsigned long)i, TEST_NDJSON_LINES - 1 == i ? "" : "\r\n");
+    }
+    test_ndjson_run(st, buf, len, 1, 0, TEST_NDJSON_LINES);
+    test_ndjson_run(st, buf, len, 4, 0, TEST_NDJSON_LINES);
+    test_ndjson_run(st, buf, len, 0, 0, TEST_NDJSON_LINES);
+    test_ndjson_run(st, buf, len, 3, LEPT_NDJSON_UNORDERED, TEST_NDJSON_LINES);
+    test_ndjson_run(st, buf, len, 4, 0, 20000);
+    test_ndjson_run(st, buf, len, 1, 0, 5);
+
+    st->unordered = 0;
+    st->count = 0;
+    EXPECT_EQ_INT(0, lept_parse_ndjson("", 0, 4, 0, test_ndjson_cb, st));
+    EXPECT_EQ_INT(0, lept_parse_ndjson("\n \n", 3, 4, 0, test_ndjson_cb, st));
+    EXPECT_EQ_SIZE_T(0, st->count);
+    free(buf);
+    free(st);
+}
+
+
+typedef struct {
+    size_t count, offset[8], length[8];
+    int ret[8], type[8];
+    size_t stop_after;
+} test_many_state;
+
+static int test_many_cb(void* user, size_t offset, size_t length, int ret, lept_value* val)
+{
+    test_many_state* st = (test_many_state*)user;
+    if(st->count < 8)
+    {
+        st->offset[st->count] = offset;
+        st->length[st->count] = length;
+        st->ret[st->count] = ret;
+        st->type[st->count] = lept_get_type(val);
+    }
+    lept_free(val);
+    return ++st->count == st->stop_after ? 7 : 0;
+}
+
+/*  只取 json 的前 len 个字节，第二个文本的结果是 error */
+#define TEST_MANY_TAIL(error, json, len) \
+    do { \
+        test_many_state st; \
+        memset(&st, 0, sizeof(st)); \
+        EXPECT_EQ_INT(0, lept_parse_many(json, len, test_many_cb, &st)); \
+        EXPECT_EQ_SIZE_T(2, st.count); \
+        EXPECT_EQ_INT(error, st.ret[1]); \
+    } while(0)
+
+void test_parse_many()
+{
+    const char* json = "{\"a\":[1,2]}{\"b\":\"}{\"}\n  [3] 12 -4.5e1true\"s\"null \r\n";
+    test_many_state st;
+    memset(&st, 0, sizeof(st));
+    EXPECT_EQ_INT(0, lept_parse_many(json, strlen(json), test_many_cb, &st));
+    EXPECT_EQ_SIZE_T(8, st.count);
+    EXPECT_EQ_SIZE_T(0, st.offset[0]);
+    EXPECT_EQ_SIZE_T(11, st.length[0]);
+    EXPECT_EQ_INT(LEPT_OBJECT, st.type[0]);
+    EXPECT_EQ_SIZE_T(11, st.offset[1]);
+    EXPECT_EQ_SIZE_T(10, st.length[1]);
+    EXPECT_EQ_SIZE_T(24, st.offset[2]);
+    EXPECT_EQ_SIZE_T(3, st.length[2]);
+    EXPECT_EQ_INT(LEPT_ARRAY, st.type[2]);
+    EXPECT_EQ_INT(LEPT_NUMBER, st.type[3]);
+    EXPECT_EQ_SIZE_T(2, st.length[3]);
+    EXPECT_EQ_INT(LEPT_NUMBER, st.type[4]);
+    EXPECT_EQ_SIZE_T(6, st.length[4]);
+    EXPECT_EQ_INT(LEPT_TRUE, st.type[5]);
+    EXPECT_EQ_INT(LEPT_STRING, st.type[6]);
+    EXPECT_EQ_INT(LEPT_NULL, st.type[7]);
+    EXPECT_EQ_INT(LEPT_PARSE_OK, st.ret[7]);
+
+    /*  回调要求停止 */
+    memset(&st, 0, sizeof(st));
+    st.stop_after = 2;
+    EXPECT_EQ_INT(7, lept_parse_many(json, strlen(json), test_many_cb, &st));
+    EXPECT_EQ_SIZE_T(2, st.count);
+
+    /*  出错的文本回调之后停止 */
+    memset(&st, 0, sizeof(st));
+    json = "[1] {\"a\":tru} [2]";
+    EXPECT_EQ_INT(0, lept_parse_many(json, strlen(json), test_many_cb, &st));
+    EXPECT_EQ_SIZE_T(2, st.count);
+    EXPECT_EQ_INT(LEPT_PARSE_OK, st.ret[0]);
+    EXPECT_EQ_INT(LEPT_PARSE_INVALID_VALUE, st.ret[1]);
+    EXPECT_EQ_INT(LEPT_NULL, st.type[1]);
+    EXPECT_EQ_SIZE_T(4, st.offset[1]);
+
+    /*  空白和空输入没有文本；len 之前的 '\0' 是错误 */
+    memset(&st, 0, sizeof(st));
+    EXPECT_EQ_INT(0, lept_parse_many("", 0, test_many_cb, &st));
+    EXPECT_EQ_INT(0, lept_parse_many(" \n\t", 3, test_many_cb, &st));
+    EXPECT_EQ_SIZE_T(0, st.count);
+    memset(&st, 0, sizeof(st));
+    EXPECT_EQ_INT(0, lept_parse_many("[1]\0[2]", 7, test_many_cb, &st));
+    EXPECT_EQ_SIZE_T(2, st.count);
+    EXPECT_EQ_INT(LEPT_PARSE_EXPECT_VALUE, st.ret[1]);
+
+    /*  只读取前 len 个字节：len 之后的内容不属于输入 */
+    memset(&st, 0, sizeof(st));
+    json = "[1] 123[4,5]";
+    EXPECT_EQ_INT(0, lept_parse_many(json, 6, test_many_cb, &st));
+    EXPECT_EQ_SIZE_T(2, st.count);
+    EXPECT_EQ_SIZE_T(4, st.offset[1]);
+    EXPECT_EQ_SIZE_T(2, st.length[1]);
+    EXPECT_EQ_INT(LEPT_NUMBER, st.type[1]);
+    EXPECT_EQ_INT(LEPT_PARSE_OK, st.ret[1]);
+    TEST_MANY_TAIL(LEPT_PARSE_MISS_COMMA_OR_SQUARE_BRACKET, "[1] [4,5]", 8);
+    TEST_MANY_TAIL(LEPT_PARSE_MISS_QUOTATION_MARK, "[1] \"abc\"", 8);
+    TEST_MANY_TAIL(LEPT_PARSE_MISS_QUOTATION_MARK, "[1] \"a\\\"", 8);
+    TEST_MANY_TAIL(LEPT_PARSE_INVALID_VALUE, "[1] true", 7);
+    TEST_MANY_TAIL(LEPT_PARSE_MISS_COMMA_OR_CURLY_BRACKET, "[1] {\"a\":{}}", 11);
+    TEST_MANY_TAIL(LEPT_PARSE_OK, "[1] {\"a\":\"]}\"}x", 14);
+    {
+        /*  不以 '\0' 结尾的缓冲区 */
+        char raw[4];
+        memcpy(raw, "7 [8", 4);
+        memset(&st, 0, sizeof(st));
+        EXPECT_EQ_INT(0, lept_parse_many(raw, 1, test_many_cb, &st));
+        EXPECT_EQ_SIZE_T(1, st.count);
+        EXPECT_EQ_INT(LEPT_PARSE_OK, st.ret[0]);
+        memset(&st, 0, sizeof(st));
+        EXPECT_EQ_INT(0, lept_parse_many(raw, 4, test_many_cb, &st));
+        EXPECT_EQ_SIZE_T(2, st.count);
+        EXPECT_EQ_INT(LEPT_PARSE_MISS_COMMA_OR_SQUARE_BRACKET, st.ret[1]);
+    }
+}
+
+
+#define TEST_PARALLEL(json, nthreads) \
+    do { \
+        lept_value v1, v2; \
+        int r1 = lept_parse(&v1, json), r2 = lept_parse_parallel(&v2, json, nthreads); \
+        EXPECT_EQ_INT(r1, r2); \
+        EXPECT_EQ_INT(1, lept_is_equal(&v1, &v2)); \
+        lept_free(&v1); \
+        lept_free(&v2); \
+    } while(0)
+
+void test_parse_parallel()
+{
+    /*  元素中的字符串含有逗号、括号和转义的引号，预扫描不能在这里切分 */
+    static const char* const elems[] = {
+        "{\"a\":[1,2,{\"b\":\"x,]\\\"}\"}],\"c\":null}",
+        " \"[,{\\\\\" ",
+        "-1.5e3",
+        "[[],{},[true,false]]",
+        "\"\\u4e2d\\n\""
+    };
+    size_t n = 100000, i, len = 0;
+    char* json = (char*)malloc(n * 40 + 64);
+    char* s;
+    size_t slen;
+    lept_value v;
+    json[len++] = ' ';
+    json[len++] = '[';
+    for(i = 0; i < n; i++)
+    {
+        if(i > 0)
+            json[len++] = ',';
+        if(0 == i % 7)
+            json[len++] = '\n';
+        strcpy(json + len, elems[i % 5]);
+        len += strlen(elems[i % 5]);
+    }
+    strcpy(json + len, " ]\r\n");
+    /*  超过默认的 LEPT_PARALLEL_PARSE_THRESHOLD */
+    EXPECT_EQ_INT(1, strlen(json) >= 1024 * 1024);
+    EXPECT_EQ_INT(LEPT_PARSE_OK, lept_parse_parallel(&v, json, 4));
+    EXPECT_EQ_INT(LEPT_ARRAY, lept_get_type(&v));
+    EXPECT_EQ_SIZE_T(n, lept_get_array_size(&v));
+    s = lept_stringify(&v, &slen);
+    lept_free(&v);
+    EXPECT_EQ_INT(LEPT_PARSE_OK, lept_parse(&v, json));
+    {
+        size_t slen2;
+        char* s2 = lept_stringify(&v, &slen2);
+        EXPECT_EQ_SIZE_T(slen2, slen);
+        EXPECT_EQ_INT(0, memcmp(s, s2, slen));
+        free(s2);
+    }
+    free(s);
+    lept_free(&v);
+    TEST_PARALLEL(json, 0);
+    TEST_PARALLEL(json, 3);
+    TEST_PARALLEL(json, 1);
+
+    /*  出错时与 lept_parse 的错误码相同 */
+    len = strlen(json);
+    json[len / 2] = '}';
+    TEST_PARALLEL(json, 4);
+    memcpy(json + len / 2, "tru", 3);
+    TEST_PARALLEL(json, 4);
+    json[len / 2] = '"';
+    TEST_PARALLEL(json, 4);
+    json[len / 2] = ' ';
+    json[len / 2 + 1] = ']';
+    TEST_PARALLEL(json, 4);
+    json[1] = '{';
+    TEST_PARALLEL(json, 4);
+    free(json);
+
+    TEST_PARALLEL("[1,2,3]", 4);
+    TEST_PARALLEL("[1,2,", 4);
+}
+
+
+#define TEST_STRINGIFY_PARALLEL(v, nthreads) \
+    do { \
+        size_t len1, len2; \
+        char* s1 = lept_stringify(v, &len1); \
+        char* s2 = lept_stringify_parallel(v, &len2, nthreads); \
+        EXPECT_EQ_SIZE_T(len1, len2); \
+        EXPECT_EQ_INT(0, memcmp(s1, s2, len1 + 1)); \
+        free(s1); \
+        free(s2); \
+    } while(0)
+
+void test_stringify_parallel()
+{
+    lept_value a, o;
+    char key[32];
+    size_t i;
+    lept_init(&a);
+    lept_init(&o);
+    lept_set_array(&a, 0);
+    lept_set_object(&o, 0);
+    for(i = 0; i < 5000; i++)
+    {
+        sprintf(key, "k\"%lu", (unsigned long)i);
+        if(0 == i % 3)
+            lept_parse(lept_pushback_array_element(&a), "{\"x\":[1.5,\"\\u0001\",null]}");
+        else
+            lept_set_string(lept_pushback_array_element(&a), key, strlen(key));
+        lept_set_number(lept_set_object_value(&o, key, strlen(key)), (double)i / 7);
+    }
+    TEST_STRINGIFY_PARALLEL(&a, 4);
+    TEST_STRINGIFY_PARALLEL(&a, 0);
+    TEST_STRINGIFY_PARALLEL(&o, 3);
+    TEST_STRINGIFY_PARALLEL(&o, 1);
+    lept_erase_array_element(&a, 10, 4990);
+    TEST_STRINGIFY_PARALLEL(&a, 4);
+    lept_set_number(&a, 1.0);
+    TEST_STRINGIFY_PARALLEL(&a, 4);
+    lept_free(&a);
+    lept_free(&o);
+}
+
+
+static size_t test_hist_sum(const size_t* hist)
+{
+    size_t i, sum = 0;
+    for(i = 0; i < LEPT_PIPELINE_HIST_SIZE; i++)
+        sum += hist[i];
+    return sum;
+}
+
+/*  单线程交替提交和取结果，队列满时先取走结果再重试 */
+static void test_pipeline_run(int nworkers)
+{
+    enum { N = 5000 };
+    static char texts[N][32];
+    static unsigned char seen[N];
+    lept_pipeline* p = lept_pipeline_create(64, nworkers);
+    lept_pipeline_result r[40];
+    lept_pipeline_stats st;
+    size_t i = 0, k, n, got = 0, wrong = 0, errors = 0, full = 0;
+    memset(seen, 0, sizeof(seen));
+    for(i = 0; i < N; i++)
+        sprintf(texts[i], 0 == i % 100 ? "[%lu," : "{\"n\":[%lu]}", (unsigned long)i);
+    for(i = 0; i < N || !lept_pipeline_done(p); )
+    {
+        if(i < N)
+        {
+            if(LEPT_PIPELINE_OK == lept_pipeline_submit(p, texts[i], &seen[i]))
+                i++;
+            else
+                full++;
+            if(N == i)
+            {
+                lept_pipeline_close(p);
+                EXPECT_EQ_INT(LEPT_PIPELINE_CLOSED, lept_pipeline_submit(p, texts[0], NULL));
+            }
+        }
+        n = lept_pipeline_poll(p, r, 40);
+        for(k = 0; k < n; k++)
+        {
+            unsigned char* u = (unsigned char*)r[k].user;
+            size_t idx = (size_t)(u - seen);
+            (*u)++;
+            if(r[k].json != texts[idx])
+                wrong++;
+            if(LEPT_PARSE_OK != r[k].ret)
+                errors++;
+            else if(idx != (size_t)lept_get_number(lept_get_array_element(lept_find_object_value(&r[k].val, "n", 1), 0)))
+                wrong++;
+            lept_free(&r[k].val);
+        }
+        got += n;
+    }
+    EXPECT_EQ_SIZE_T(N, got);
+    EXPECT_EQ_SIZE_T(0, wrong);
+    EXPECT_EQ_SIZE_T(N / 100, errors);
+    for(i = 0, n = 0; i < N; i++)
+        n += 1 == seen[i];
+    EXPECT_EQ_SIZE_T(N, n);
+    lept_pipeline_get_stats(p, &st);
+    EXPECT_EQ_SIZE_T(N, st.submitted);
+    EXPECT_EQ_SIZE_T(N, st.parsed);
+    EXPECT_EQ_SIZE_T(N, st.polled);
+    EXPECT_EQ_SIZE_T(full, st.rejected);
+    EXPECT_EQ_SIZE_T(N, test_hist_sum(st.queue_wait));
+    EXPECT_EQ_SIZE_T(N, test_hist_sum(st.parse));
+    EXPECT_EQ_SIZE_T(N, test_hist_sum(st.result_wait));
+    lept_pipeline_destroy(p);
+}
+
+void test_pipeline()
+{
+    lept_pipeline* p;
+    lept_pipeline_result r;
+    lept_pipeline_stats st;
+    size_t i, k;
+    test_pipeline_run(3);
+    test_pipeline_run(1);
+
+    /*  销毁时释放没有取走的结果 */
+    p = lept_pipeline_create(4, 2);
+    EXPECT_EQ_INT(LEPT_PIPELINE_OK, lept_pipeline_submit(p, "[1,2]", NULL));
+    EXPECT_EQ_INT(LEPT_PIPELINE_OK, lept_pipeline_submit(p, "{\"a\":\"b\"}", NULL));
+    lept_pipeline_destroy(p);
+
+    /*  一直不取结果，解析线程阻塞在满的输出队列上时销毁 */
+    p = lept_pipeline_create(2, 1);
+    for(i = 0; i < 40; i++)
+    {
+        lept_pipeline_submit(p, "{\"a\":[1,2,3]}", NULL);
+        for(k = 0; k < 10000; k++)
+        {
+            lept_pipeline_get_stats(p, &st);
+            if(st.stalls > 0)
+                break;
+        }
+    }
+    lept_pipeline_destroy(p);
+
+    p = lept_pipeline_create(4, 1);
+    EXPECT_EQ_SIZE_T(0, lept_pipeline_poll(p, &r, 1));
+    EXPECT_EQ_INT(0, lept_pipeline_done(p));
+    lept_pipeline_close(p);
+    EXPECT_EQ_INT(1, lept_pipeline_done(p));
+    lept_pipeline_destroy(p);
+}
+
+
+#ifdef LEPT_ENABLE_STATS
+void test_stats()
+{
+    lept_value v;
+    lept_stats st;
+    char* json;
+    size_t len;
+    memset(&st, 0, sizeof(st));
+    EXPECT_EQ_INT(LEPT_PARSE_OK, lept_parse_stats(&v, "{\"a\":[1,true,null,\"x\\ny\"],\"b\":{\"c\":{}}}", &st));
+    EXPECT_EQ_SIZE_T(1, st.values[LEPT_NULL]);
+    EXPECT_EQ_SIZE_T(0, st.values[LEPT_FALSE]);
+    EXPECT_EQ_SIZE_T(1, st.values[LEPT_TRUE]);
+    EXPECT_EQ_SIZE_T(1, st.values[LEPT_NUMBER]);
+    EXPECT_EQ_SIZE_T(1, st.values[LEPT_STRING]);
+    EXPECT_EQ_SIZE_T(1, st.values[LEPT_ARRAY]);
+    EXPECT_EQ_SIZE_T(3, st.values[LEPT_OBJECT]);
+    /*  键 a、b、c 和解码后的 "x\ny" */
+    EXPECT_EQ_SIZE_T(6, st.string_bytes);
+    EXPECT_EQ_SIZE_T(1, st.escapes);
+    EXPECT_EQ_SIZE_T(3, st.max_depth);
+    EXPECT_EQ_SIZE_T(1, st.stack_reallocs);
+    EXPECT_EQ_INT(1, st.stack_high > 0 && st.stack_high < 256);
+    /*  1 个字符串、3 个键、1 个数组和 2 个非空对象的存储 */
+    EXPECT_EQ_SIZE_T(7, st.mallocs);
+    EXPECT_EQ_SIZE_T(4 + 3 * 2 + 4 * sizeof(lept_value) + 3 * sizeof(lept_member), st.malloc_bytes);
+    EXPECT_EQ_INT(1, st.parse_ns >= 0.0);
+
+    memset(&st, 0, sizeof(st));
+    json = lept_stringify_stats(&v, &len, &st);
+    EXPECT_EQ_STRING("{\"a\":[1,true,null,\"x\\ny\"],\"b\":{\"c\":{}}}", json, len);
+    EXPECT_EQ_SIZE_T(3, st.values[LEPT_OBJECT]);
+    EXPECT_EQ_SIZE_T(6, st.string_bytes);
+    EXPECT_EQ_SIZE_T(1, st.escapes);
+    EXPECT_EQ_SIZE_T(3, st.max_depth);
+    EXPECT_EQ_SIZE_T(len + 1, st.stack_high);
+    free(json);
+    lept_free(&v);
+
+    /*  不清零时累加，出错时也统计已经解析的部分 */
+    memset(&st, 0, sizeof(st));
+    EXPECT_EQ_INT(LEPT_PARSE_OK, lept_parse_stats(&v, "[[[1]]]", &st));
+    lept_free(&v);
+    EXPECT_EQ_INT(LEPT_PARSE_MISS_COMMA_OR_SQUARE_BRACKET, lept_parse_stats(&v, "[2 3]", &st));
+    EXPECT_EQ_SIZE_T(2, st.values[LEPT_NUMBER]);
+    EXPECT_EQ_SIZE_T(3, st.values[LEPT_ARRAY]);
+    EXPECT_EQ_SIZE_T(3, st.max_depth);
+}
+#endif
+
+
+void test_cursor()
+{
+    static const char json[] = " {\"id\":7,\"name\":\"a\\nb\",\"skip\":{\"deep\":[1,[2,{\"x\":\"y\"}]]},"
+        "\"list\":[1,\"two\",[3],{\"k\":4}],\"after\":true} ";
+    lept_cursor c;
+    const char* str;
+    size_t len, i;
+    double num;
+    char deep[LEPT_CURSOR_MAX_DEPTH + 2];
+
+    lept_cursor_init(&c, json);
+    EXPECT_EQ_INT(LEPT_OBJECT, lept_cursor_type(&c));
+    EXPECT_EQ_INT(1, lept_cursor_find_field(&c, "name", 4));
+    str = lept_cursor_key(&c, &len);
+    EXPECT_EQ_STRING("name", str, len);
+    EXPECT_EQ_INT(LEPT_PARSE_SCHEMA_MISMATCH, lept_cursor_get_number(&c, &num));
+    EXPECT_EQ_INT(LEPT_PARSE_OK, lept_cursor_get_string(&c, &str, &len));
+    EXPECT_EQ_STRING("a\nb", str, len);
+    /*  跳过没有访问的 "skip" */
+    EXPECT_EQ_INT(1, lept_cursor_find_field(&c, "list", 4));
+    EXPECT_EQ_INT(LEPT_ARRAY, lept_cursor_type(&c));
+    EXPECT_EQ_INT(1, lept_cursor_next(&c));
+    EXPECT_EQ_INT(LEPT_PARSE_OK, lept_cursor_get_number(&c, &num));
+    EXPECT_EQ_DOUBLE(1.0, num);
+    EXPECT_EQ_INT(1, lept_cursor_next(&c));
+    EXPECT_EQ_INT(LEPT_STRING, lept_cursor_type(&c));
+    EXPECT_EQ_INT(1, lept_cursor_next(&c));
+    EXPECT_EQ_INT(LEPT_ARRAY, lept_cursor_type(&c));
+    EXPECT_EQ_INT(1, lept_cursor_next(&c));
+    EXPECT_EQ_INT(LEPT_PARSE_OK, lept_cursor_get_number(&c, &num));
+    EXPECT_EQ_DOUBLE(3.0, num);
+    EXPECT_EQ_INT(0, lept_cursor_next(&c));
+    EXPECT_EQ_INT(1, lept_cursor_next(&c));
+    EXPECT_EQ_INT(1, lept_cursor_find_field(&c, "k", 1));
+    EXPECT_EQ_INT(LEPT_PARSE_OK, lept_cursor_get_number(&c, &num));
+    EXPECT_EQ_DOUBLE(4.0, num);
+    EXPECT_EQ_INT(0, lept_cursor_next(&c));
+    EXPECT_EQ_INT(0, lept_cursor_next(&c));
+    EXPECT_EQ_INT(1, lept_cursor_find_field(&c, "after", 5));
+    EXPECT_EQ_INT(LEPT_TRUE, lept_cursor_type(&c));
+    EXPECT_EQ_INT(0, lept_cursor_next(&c));
+    EXPECT_EQ_INT(0, lept_cursor_next(&c));
+    EXPECT_EQ_INT(LEPT_PARSE_OK, c.ret);
+    lept_cursor_free(&c);
+
+    /*  只能向后查找；读取之后 skip 跳过所在容器剩下的部分 */
+    lept_cursor_init(&c, json);
+    EXPECT_EQ_INT(1, lept_cursor_find_field(&c, "name", 4));
+    EXPECT_EQ_INT(0, lept_cursor_find_field(&c, "id", 2));
+    EXPECT_EQ_INT(LEPT_PARSE_OK, c.ret);
+    lept_cursor_free(&c);
+    lept_cursor_init(&c, json);
+    EXPECT_EQ_INT(1, lept_cursor_find_field(&c, "list", 4));
+    EXPECT_EQ_INT(1, lept_cursor_next(&c));
+    EXPECT_EQ_INT(LEPT_PARSE_OK, lept_cursor_get_number(&c, &num));
+    EXPECT_EQ_INT(LEPT_PARSE_OK, lept_cursor_skip(&c));
+    EXPECT_EQ_INT(1, lept_cursor_find_field(&c, "after", 5));
+    EXPECT_EQ_INT(LEPT_PARSE_OK, lept_cursor_skip(&c));
+    EXPECT_EQ_INT(0, lept_cursor_find_field(&c, "missing", 7));
+    EXPECT_EQ_INT(LEPT_PARSE_OK, c.ret);
+    lept_cursor_free(&c);
+
+    /*  出错之后所有操作都失败 */
+    lept_cursor_init(&c, "[1,2");
+    while(lept_cursor_next(&c))
+        ;
+    EXPECT_EQ_INT(LEPT_PARSE_MISS_COMMA_OR_SQUARE_BRACKET, c.ret);
+    EXPECT_EQ_INT(LEPT_PARSE_MISS_COMMA_OR_SQUARE_BRACKET, lept_cursor_skip(&c));
+    lept_cursor_free(&c);
+    lept_cursor_init(&c, "{\"a\" 1}");
+    EXPECT_EQ_INT(0, lept_cursor_find_field(&c, "a", 1));
+    EXPECT_EQ_INT(LEPT_PARSE_MISS_COLON, c.ret);
+    lept_cursor_free(&c);
+    lept_cursor_init(&c, "[1] x");
+    while(lept_cursor_next(&c))
+        ;
+    EXPECT_EQ_INT(0, lept_cursor_next(&c));
+    EXPECT_EQ_INT(LEPT_PARSE_ROOT_NOT_SINGULAR, c.ret);
+    lept_cursor_free(&c);
+    lept_cursor_init(&c, "{\"a\":[1,{\"b\":\"\\x\"}]}");
+    EXPECT_EQ_INT(1, lept_cursor_find_field(&c, "a", 1));
+    EXPECT_EQ_INT(LEPT_PARSE_INVALID_STRING_ESCAPE, lept_cursor_skip(&c));
+    lept_cursor_free(&c);
+    lept_cursor_init(&c, "  ");
+    EXPECT_EQ_INT(LEPT_PARSE_EXPECT_VALUE, c.ret);
+    lept_cursor_free(&c);
+    for(i = 0; i < LEPT_CURSOR_MAX_DEPTH + 1; i++)
+        deep[i] = '[';
+    deep[i] = '\0';
+    lept_cursor_init(&c, deep);
+    while(lept_cursor_next(&c))
+        ;
+    EXPECT_EQ_INT(LEPT_PARSE_TOO_DEEP, c.ret);
+    lept_cursor_free(&c);
+}
+
+
+/*  每次只交出 1~7 个字节，让元素和字符串跨过读取的边界 */
+typedef struct {
+    const char* json;
+    size_t pos, len;
+    int fail_at;    /*  读到这个位置时报告读取错误，-1 表示不出错 */
+} test_reader;
+
+static int test_read_chunks(void* user, char* buf, size_t size, size_t* nread)
+{
+    test_reader* r = (test_reader*)user;
+    size_t n = r->pos % 7 + 1;
+    if(r->fail_at >= 0 && r->pos >= (size_t)r->fail_at)
+        return -1;
+    if(n > size)
+        n = size;
+    if(n > r->len - r->pos)
+        n = r->len - r->pos;
+    memcpy(buf, r->json + r->pos, n);
+    r->pos += n;
+    *nread = n;
+    return 0;
+}
+
+static int test_array_iter_count(const char* json, int fail_at, int* error)
+{
+    test_reader r;
+    lept_array_iter* it;
+    lept_value v;
+    int n = 0;
+    r.json = json;
+    r.pos = 0;
+    r.len = strlen(json);
+    r.fail_at = fail_at;
+    it = lept_array_iter_open(test_read_chunks, &r);
+    while(lept_array_iter_next(it, &v))
+    {
+        n++;
+        lept_free(&v);
+    }
+    EXPECT_EQ_INT(LEPT_NULL, lept_get_type(&v));
+    *error = lept_array_iter_error(it);
+    lept_array_iter_close(it);
+    return n;
+}
+
+#define TEST_ARRAY_ITER(expect_n, expect_error, json)\
+    do {\
+        int error;\
+        EXPECT_EQ_INT(expect_n, test_array_iter_count(json, -1, &error));\
+        EXPECT_EQ_INT(expect_error, error);\
+    } while(0)
+
+void test_array_iter()
+{
+    const char* json = " [ 1 , \"a],\\\"[,\" ,{\"k\":[2,{\"]\":\"}\"}],\"e\":{}}, [[],[ ]] ,null,\"\\u4e2d\"\t]\n";
+    test_reader r;
+    lept_array_iter* it;
+    lept_value v;
+    size_t len;
+    char* s;
+
+    r.json = json;
+    r.pos = 0;
+    r.len = strlen(json);
+    r.fail_at = -1;
+    it = lept_array_iter_open(test_read_chunks, &r);
+    EXPECT_EQ_INT(1, lept_array_iter_next(it, &v));
+    EXPECT_EQ_DOUBLE(1.0, lept_get_number(&v));
+    lept_free(&v);
+    EXPECT_EQ_INT(1, lept_array_iter_next(it, &v));
+    EXPECT_EQ_STRING("a],\"[,", lept_get_string(&v), lept_get_string_length(&v));
+    lept_free(&v);
+    EXPECT_EQ_INT(1, lept_array_iter_next(it, &v));
+    s = lept_stringify(&v, &len);
+    EXPECT_EQ_STRING("{\"k\":[2,{\"]\":\"}\"}],\"e\":{}}", s, len);
+    free(s);
+    lept_free(&v);
+    EXPECT_EQ_INT(1, lept_array_iter_next(it, &v));
+    EXPECT_EQ_SIZE_T(2, lept_get_array_size(&v));
+    lept_free(&v);
+    EXPECT_EQ_INT(1, lept_array_iter_next(it, &v));
+    EXPECT_EQ_INT(LEPT_NULL, lept_get_type(&v));
+    EXPECT_EQ_INT(1, lept_array_iter_next(it, &v));
+    EXPECT_EQ_STRING("\xE4\xB8\xAD", lept_get_string(&v), lept_get_string_length(&v));
+    lept_free(&v);
+    EXPECT_EQ_INT(0, lept_array_iter_next(it, &v));
+    EXPECT_EQ_INT(LEPT_PARSE_OK, lept_array_iter_error(it));
+    EXPECT_EQ_INT(0, lept_array_iter_next(it, &v));
+    lept_array_iter_close(it);
+
+    TEST_ARRAY_ITER(0, LEPT_PARSE_OK, "[]");
+    TEST_ARRAY_ITER(0, LEPT_PARSE_OK, " [ \n ] ");
+    TEST_ARRAY_ITER(1, LEPT_PARSE_OK, "[null]");
+    TEST_ARRAY_ITER(3, LEPT_PARSE_OK, "[0,-1.5e3,true]");
+    TEST_ARRAY_ITER(0, LEPT_PARSE_EXPECT_VALUE, "");
+    TEST_ARRAY_ITER(0, LEPT_PARSE_EXPECT_VALUE, "  ");
+    TEST_ARRAY_ITER(0, LEPT_PARSE_NOT_ARRAY, "{\"a\":1}");
+    TEST_ARRAY_ITER(0, LEPT_PARSE_NOT_ARRAY, " 1");
+    TEST_ARRAY_ITER(0, LEPT_PARSE_MISS_COMMA_OR_SQUARE_BRACKET, "[");
+    TEST_ARRAY_ITER(1, LEPT_PARSE_EXPECT_VALUE, "[1,]");
+    TEST_ARRAY_ITER(0, LEPT_PARSE_EXPECT_VALUE, "[,1]");
+    TEST_ARRAY_ITER(1, LEPT_PARSE_MISS_COMMA_OR_SQUARE_BRACKET, "[1,2");
+    TEST_ARRAY_ITER(1, LEPT_PARSE_MISS_QUOTATION_MARK, "[1,\"ab");
+    /*  与 lept_parse 相同的错误码 */
+    TEST_ARRAY_ITER(1, LEPT_PARSE_MISS_COMMA_OR_SQUARE_BRACKET, "[1,2 3]");
+    TEST_ARRAY_ITER(0, LEPT_PARSE_MISS_COMMA_OR_SQUARE_BRACKET, "[1 2]");
+    TEST_ARRAY_ITER(0, LEPT_PARSE_MISS_COMMA_OR_SQUARE_BRACKET, "[{} []]");
+    TEST_ARRAY_ITER(0, LEPT_PARSE_MISS_COMMA_OR_SQUARE_BRACKET, "[1 2");
+    TEST_ERROR(LEPT_PARSE_MISS_COMMA_OR_SQUARE_BRACKET, "[1 2]");
+    TEST_ERROR(LEPT_PARSE_MISS_COMMA_OR_SQUARE_BRACKET, "[{} []]");
+    TEST_ARRAY_ITER(2, LEPT_PARSE_INVALID_VALUE, "[1,2,nul]");
+    TEST_ARRAY_ITER(0, LEPT_PARSE_ROOT_NOT_SINGULAR, "[] x");
+    TEST_ARRAY_ITER(0, LEPT_PARSE_ROOT_NOT_SINGULAR, "[1] x");
+
+    /*  读取回调出错 */
+    {
+        int error;
+        EXPECT_EQ_INT(1, test_array_iter_count("[1,2,3,4]", 2, &error));
+        EXPECT_EQ_INT(LEPT_ARRAY_ITER_READ_ERROR, error);
+    }
+}
+
+
+#define COLUMN_VALID(col, i) (((col).valid[(i) / 8] >> ((i) % 8)) & 1)
+
+void test_extract_columns()
+{
+    static const char* docs[] = {
+        "{\"id\":1,\"px\":1.5,\"tags\":[\"x\",\"yz\"],\"a\":{\"b\":{\"c\":true}},\"a/b\":\"s\"}",
+        " {\"px\":null,\"skip\":[{\"id\":[]}],\"id\":2,\"tags\":[\"\\u4e2d\"],\"a\":{\"b\":{}}} ",
+        "{\"tags\":[],\"id\":3,\"id\":4,\"a\":{\"b\":{\"c\":false,\"c\":true}},\"a/b\":\"\"}",
+        "[]",
+        "{\"id\":5,\"px\":2,\"a\":1} x",
+        "{\"id\":6,\"px\":\"1\"}"
+    };
+    static const char* paths[] = { "/id", "/px", "/tags/1", "/a/b/c", "/a~1b" };
+    lept_column cols[5];
+    size_t done, i;
+
+    lept_column_init(&cols[0], LEPT_COLUMN_INT64);
+    lept_column_init(&cols[1], LEPT_COLUMN_NUMBER);
+    lept_column_init(&cols[2], LEPT_COLUMN_STRING);
+    lept_column_init(&cols[3], LEPT_COLUMN_BOOLEAN);
+    lept_column_init(&cols[4], LEPT_COLUMN_STRING);
+    EXPECT_EQ_INT(LEPT_PARSE_ROOT_NOT_SINGULAR, lept_extract_columns(docs, 6, paths, 5, cols, &done));
+    EXPECT_EQ_SIZE_T(4, done);
+    for(i = 0; i < 5; i++)
+        EXPECT_EQ_SIZE_T(4, cols[i].rows);
+
+    EXPECT_EQ_INT(1, COLUMN_VALID(cols[0], 0));
+    EXPECT_EQ_INT(1, (int)cols[0].u.i64[0]);
+    EXPECT_EQ_INT(2, (int)cols[0].u.i64[1]);
+    EXPECT_EQ_INT(3, (int)cols[0].u.i64[2]);
+    EXPECT_EQ_INT(0, COLUMN_VALID(cols[0], 3));
+    EXPECT_EQ_INT(0, (int)cols[0].u.i64[3]);
+
+    EXPECT_EQ_DOUBLE(1.5, cols[1].u.num[0]);
+    EXPECT_EQ_INT(0, COLUMN_VALID(cols[1], 1));
+    EXPECT_EQ_INT(0, COLUMN_VALID(cols[1], 2));
+
+    EXPECT_EQ_SIZE_T(0, cols[2].u.s.offsets[0]);
+    EXPECT_EQ_SIZE_T(2, cols[2].u.s.offsets[1]);
+    EXPECT_EQ_INT(0, memcmp("yz", cols[2].u.s.pool, 2));
+    EXPECT_EQ_INT(1, COLUMN_VALID(cols[2], 0));
+    EXPECT_EQ_INT(0, COLUMN_VALID(cols[2], 1));
+    EXPECT_EQ_SIZE_T(2, cols[2].u.s.offsets[4]);
+
+    EXPECT_EQ_INT(1, COLUMN_VALID(cols[3], 0));
+    EXPECT_EQ_INT(1, cols[3].u.b[0]);
+    EXPECT_EQ_INT(0, COLUMN_VALID(cols[3], 1));
+    EXPECT_EQ_INT(1, COLUMN_VALID(cols[3], 2));
+    EXPECT_EQ_INT(0, cols[3].u.b[2]);
+
+    EXPECT_EQ_INT(1, COLUMN_VALID(cols[4], 0));
+    EXPECT_EQ_INT(0, COLUMN_VALID(cols[4], 1));
+    EXPECT_EQ_INT(1, COLUMN_VALID(cols[4], 2));
+    EXPECT_EQ_SIZE_T(1, cols[4].u.s.offsets[1]);
+    EXPECT_EQ_SIZE_T(1, cols[4].u.s.offsets[3]);
+    EXPECT_EQ_SIZE_T(1, cols[4].u.s.offsets[4]);
+
+    /*  接着追加，类型不符 */
+    EXPECT_EQ_INT(LEPT_PARSE_SCHEMA_MISMATCH, lept_extract_columns(docs + 5, 1, paths, 5, cols, &done));
+    EXPECT_EQ_SIZE_T(0, done);
+    EXPECT_EQ_SIZE_T(4, cols[1].rows);
+    EXPECT_EQ_INT(LEPT_PARSE_OK, lept_extract_columns(docs + 1, 2, paths, 5, cols, NULL));
+    EXPECT_EQ_SIZE_T(6, cols[0].rows);
+    EXPECT_EQ_INT(3, (int)cols[0].u.i64[5]);
+    EXPECT_EQ_SIZE_T(1, cols[4].u.s.offsets[6]);
+    for(i = 0; i < 5; i++)
+        lept_column_free(&cols[i]);
+
+    /*  容器、非整数和各种语法错误 */
+    {
+        static const char* bad[] = { "{\"id\":[1]}", "{\"id\":1.5}", "{\"id\":1,", "{\"id\"}", "", "{\"x\":[1 2],\"id\":1}" };
+        static const int expect[] = { LEPT_PARSE_SCHEMA_MISMATCH, LEPT_PARSE_SCHEMA_MISMATCH, LEPT_PARSE_MISS_KEY,
+            LEPT_PARSE_MISS_COLON, LEPT_PARSE_EXPECT_VALUE, LEPT_PARSE_MISS_COMMA_OR_SQUARE_BRACKET };
+        for(i = 0; i < 6; i++)
+        {
+            lept_column_init(&cols[0], LEPT_COLUMN_INT64);
+            EXPECT_EQ_INT(expect[i], lept_extract_columns(bad + i, 1, paths, 1, cols, &done));
+            EXPECT_EQ_SIZE_T(0, done);
+            EXPECT_EQ_SIZE_T(0, cols[0].rows);
+            lept_column_free(&cols[0]);
+        }
+    }
+
+    /*  空路径是整个文档，"-" 不匹配任何元素，路径不合法 */
+    {
+        static const char* root[] = { "", "/-", "/0" };
+        static const char* invalid[] = { "id" };
+        static const char* tilde[] = { "/a~2" };
+        lept_column_init(&cols[0], LEPT_COLUMN_NUMBER);
+        lept_column_init(&cols[1], LEPT_COLUMN_NUMBER);
+        lept_column_init(&cols[2], LEPT_COLUMN_NUMBER);
+        EXPECT_EQ_INT(LEPT_PARSE_OK, lept_extract_columns(docs + 3, 1, root + 1, 2, cols, &done));
+        EXPECT_EQ_INT(0, COLUMN_VALID(cols[0], 0));
+        EXPECT_EQ_INT(0, COLUMN_VALID(cols[1], 0));
+        {
+            static const char* nums[] = { " 7 ", "[8]" };
+            EXPECT_EQ_INT(LEPT_PARSE_SCHEMA_MISMATCH, lept_extract_columns(nums, 2, root, 1, cols + 2, &done));
+            EXPECT_EQ_SIZE_T(1, done);
+            EXPECT_EQ_DOUBLE(7.0, cols[2].u.num[0]);
+            EXPECT_EQ_INT(LEPT_PARSE_OK, lept_extract_columns(nums + 1, 1, root + 2, 1, cols + 2, &done));
+            EXPECT_EQ_DOUBLE(8.0, cols[2].u.num[1]);
+        }
+        EXPECT_EQ_INT(LEPT_PARSE_INVALID_VALUE, lept_extract_columns(docs, 1, invalid, 1, cols, &done));
+        EXPECT_EQ_INT(LEPT_PARSE_INVALID_VALUE, lept_extract_columns(docs, 1, tilde, 1, cols, &done));
+        EXPECT_EQ_SIZE_T(0, done);
+        EXPECT_EQ_SIZE_T(1, cols[0].rows);
+        for(i = 0; i < 3; i++)
+            lept_column_free(&cols[i]);
+    }
+}
@@ -0,0 +1,219 @@
+/*
+ *  leptjson.hpp 的测试，与 test.c 使用相同的计数方式
+ */
+
+#include <cstdio>
+#include <cstring>
+#include <optional>
+#include <string>
+#include <utility>
+#include <vector>
+#include "leptjson.hpp"
+
+static int main_ret = 0;
+static int test_count = 0;
+static int test_pass = 0;
+
+#define EXPECT_TRUE(cond) \
+    do { \
+        test_count++; \
+        if (cond) \
+            test_pass++; \
+        else { \
+            fprintf(stderr, "%s:%d: expect: %s\n", __FILE__, __LINE__, #cond); \
+            main_ret = 1; \
+        } \
+    } while(0)
+
+static const char book[] =
+    "{\"title\":\"Design Patterns\",\"author\":[\"Erich Gamma\",\"Richard Helm\"],"
+    "\"year\":1994,\"hardcover\":true,\"website\":null,\"nul\":\"a\\u0000\"}";
+
+static void test_access()
+{
+    lept::value v;
+    EXPECT_TRUE(LEPT_PARSE_OK == v.parse(book));
+    EXPECT_TRUE(v.is_object());
+    EXPECT_TRUE(6 == v.size());
+    EXPECT_TRUE("Design Patterns" == v["title"].get_string());
+    EXPECT_TRUE(1994.0 == v["year"].get_number());
+    EXPECT_TRUE(v["hardcover"].get_boolean());
+    EXPECT_TRUE(v["website"].is_null());
+    EXPECT_TRUE(std::string_view("a\0", 2) == v["nul"].get_string());
+    EXPECT_TRUE(!v["missing"]);
+    EXPECT_TRUE(v.contains("author") && !v.contains("auth"));
+    EXPECT_TRUE("Richard Helm" == v["author"][1].get_string());
+    /*  string_view 直接指向树中的字符串，没有复制 */
+    EXPECT_TRUE(lept_get_string(lept_find_object_value(v.c_ptr(), "title", 5)) == v["title"].get_string().data());
+}
+
+static void test_iterate()
+{
+    lept::value v;
+    std::string keys, names;
+    std::size_t n = 0;
+    EXPECT_TRUE(LEPT_PARSE_OK == v.parse(book));
+    for (lept::member m : v.members()) {
+        keys += m.key;
+        keys += ',';
+        if (m.value.is_array())
+            for (lept::view e : m.value)
+                names += e.get_string();
+    }
+    EXPECT_TRUE("title,author,year,hardcover,website,nul," == keys);
+    EXPECT_TRUE("Erich GammaRichard Helm" == names);
+
+    EXPECT_TRUE(LEPT_PARSE_OK == v.parse("[1,2,3]"));
+    for (lept::view e : v)
+        n += static_cast<std::size_t>(e.get_number());
+    EXPECT_TRUE(6 == n);
+    EXPECT_TRUE(LEPT_PARSE_OK == v.parse("[]"));
+    EXPECT_TRUE(v.begin() == v.end());
+
+    /*  紧凑数组直接遍历数据 */
+    double sum = 0.0;
+    EXPECT_TRUE(LEPT_PARSE_OK == v.parse("[0.5,1.5,2]", LEPT_OPT_PACK_NUMBERS));
+    for (double d : v.numbers())
+        sum += d;
+    EXPECT_TRUE(4.0 == sum);
+    EXPECT_TRUE(v.int64s().begin() == v.int64s().end());
+    EXPECT_TRUE(LEPT_PARSE_OK == v.parse("[7,8]", LEPT_OPT_PACK_NUMBERS));
+    EXPECT_TRUE(8 == *(v.int64s().begin() + 1));
+    /*  按下标和迭代器读取元素都不转换紧凑存储 */
+    EXPECT_TRUE(7.0 == v[0].get_number() && 8.0 == v[1].get_number());
+    const std::int64_t* data = v.int64s().begin();
+    double total = 0.0;
+    std::vector<lept::view> kept;
+    for (lept::view e : v)
+    {
+        total += e.get_number();
+        kept.push_back(e);
+    }
+    EXPECT_TRUE(15.0 == total && 7.0 == kept[0].get_number() && 8.0 == kept[1].get_number());
+    EXPECT_TRUE(data == v.int64s().begin() && LEPT_PACKED_INT64 == lept_get_array_packing(v.c_ptr()));
+}
+
+static void test_ownership()
+{
+    lept::value a, b, n;
+    EXPECT_TRUE(LEPT_PARSE_OK == a.parse("{\"k\":[1,{\"x\":\"y\"}]}"));
+    lept::value c = a.clone();
+    EXPECT_TRUE(a == c);
+
+    /*  移动之后原值为 null */
+    b = std::move(a);
+    EXPECT_TRUE(a.is_null());
+    EXPECT_TRUE(b == c);
+    lept::value d(std::move(b));
+    EXPECT_TRUE(b.is_null() && d == c);
+
+    lept::value s = d.share();
+    EXPECT_TRUE(s == d);
+
+    /*  构建 {"list":[true,"str",null]} */
+    lept::value root, list, e;
+    root.set_object();
+    list.set_array(3);
+    e.set_boolean(true);
+    list.push_back(std::move(e));
+    e.set_string("str");
+    list.push_back(std::move(e));
+    list.push_back(std::move(n));
+    root.set("list", std::move(list));
+    EXPECT_TRUE(list.is_null());
+    EXPECT_TRUE("{\"list\":[true,\"str\",null]}" == root.stringify());
+
+    lept_value raw;
+    lept_init(&raw);
+    lept_set_number(&raw, 2.5);
+    lept::value adopted = lept::value::adopt(&raw);
+    EXPECT_TRUE(LEPT_NULL == lept_get_type(&raw));
+    EXPECT_TRUE(2.5 == adopted.get_number());
+}
+
+namespace shop {
+
+struct address {
+    std::string city;
+    int zip = 0;
+};
+LEPT_REFLECT(address, city, zip)
+
+struct order {
+    long id = 0;
+    double price = 0.0;
+    bool paid = false;
+    std::optional<std::string> note;
+    std::vector<std::string> tags;
+    std::vector<std::vector<double>> matrix;
+    address ship;
+    std::vector<address> history;
+};
+LEPT_REFLECT(order, id, price, paid, note, tags, matrix, ship, history)
+
+/*  只有一个字段 */
+struct slots {
+    std::vector<std::optional<int>> v;
+};
+LEPT_REFLECT(slots, v)
+
+}  // namespace shop
+
+static void test_reflect()
+{
+    shop::order o;
+    EXPECT_TRUE(LEPT_PARSE_OK == lept::decode(
+        " {\"id\":42,\"price\":9.5,\"unknown\":{\"a\":[1,{\"b\":null}]},\"paid\":true,\"note\":null,"
+        "\"tags\":[\"a\",\"b\\n\"],\"matrix\":[[1,2],[],[3]],\"ship\":{\"zip\":100,\"city\":\"Paris\"},"
+        "\"history\":[{\"city\":\"Oslo\"}],\"id\":43} ", o));
+    EXPECT_TRUE(43 == o.id);
+    EXPECT_TRUE(9.5 == o.price);
+    EXPECT_TRUE(o.paid);
+    EXPECT_TRUE(!o.note);
+    EXPECT_TRUE(2 == o.tags.size() && "b\n" == o.tags[1]);
+    EXPECT_TRUE(3 == o.matrix.size() && 2 == o.matrix[0].size() && o.matrix[1].empty() && 3.0 == o.matrix[2][0]);
+    EXPECT_TRUE("Paris" == o.ship.city && 100 == o.ship.zip);
+    EXPECT_TRUE(1 == o.history.size() && "Oslo" == o.history[0].city && 0 == o.history[0].zip);
+
+    o.note = "fragile";
+    std::string json = lept::encode(o);
+    EXPECT_TRUE("{\"id\":43,\"price\":9.5,\"paid\":true,\"note\":\"fragile\",\"tags\":[\"a\",\"b\\n\"],"
+                "\"matrix\":[[1,2],[],[3]],\"ship\":{\"city\":\"Paris\",\"zip\":100},"
+                "\"history\":[{\"city\":\"Oslo\",\"zip\":0}]}" == json);
+    shop::order back;
+    EXPECT_TRUE(LEPT_PARSE_OK == lept::decode(json.c_str(), back));
+    EXPECT_TRUE(json == lept::encode(back));
+
+    shop::address a;
+    EXPECT_TRUE(LEPT_PARSE_SCHEMA_MISMATCH == lept::decode("{\"zip\":\"1\"}", a));
+    EXPECT_TRUE(LEPT_PARSE_SCHEMA_MISMATCH == lept::decode("{\"zip\":1.5}", a));
+    EXPECT_TRUE(LEPT_PARSE_SCHEMA_MISMATCH == lept::decode("{\"zip\":3e9}", a));
+    EXPECT_TRUE(LEPT_PARSE_SCHEMA_MISMATCH == lept::decode("[]", a));
+    EXPECT_TRUE(LEPT_PARSE_INVALID_VALUE == lept::decode("{\"zip\":?}", a));
+    EXPECT_TRUE(LEPT_PARSE_MISS_COLON == lept::decode("{\"zip\" 1}", a));
+    EXPECT_TRUE(LEPT_PARSE_MISS_COMMA_OR_CURLY_BRACKET == lept::decode("{\"zip\":1 \"city\":\"x\"}", a));
+    EXPECT_TRUE(LEPT_PARSE_ROOT_NOT_SINGULAR == lept::decode("{} x", a));
+    EXPECT_TRUE(LEPT_PARSE_SCHEMA_MISMATCH == lept::decode("{\"tags\":[1]}", o));
+    EXPECT_TRUE(LEPT_PARSE_MISS_COMMA_OR_SQUARE_BRACKET == lept::decode("{\"tags\":[\"a\" \"b\"]}", o));
+
+    /*  nullopt 写成 null，读回来仍是 nullopt */
+    shop::slots sl, sl2;
+    sl.v = { 1, std::nullopt };
+    EXPECT_TRUE("{\"v\":[1,null]}" == lept::encode(sl));
+    EXPECT_TRUE(LEPT_PARSE_OK == lept::decode(lept::encode(sl).c_str(), sl2));
+    EXPECT_TRUE(2 == sl2.v.size() && 1 == *sl2.v[0] && !sl2.v[1]);
+    std::optional<int> oi = 5;
+    EXPECT_TRUE(LEPT_PARSE_OK == lept::decode(" null ", oi) && !oi);
+    EXPECT_TRUE(LEPT_PARSE_OK == lept::decode("7", oi) && 7 == *oi);
+    EXPECT_TRUE(LEPT_PARSE_INVALID_VALUE == lept::decode("nul", oi));
+}
+
+int main()
+{
+    test_access();
+    test_iterate();
+    test_ownership();
+    test_reflect();
+    printf("%d / %d (%3.2f%%) passed\n", test_pass, test_count, test_pass * 100.0 / test_count);
+    return main_ret;
+}